@@ -0,0 +1,49 @@
+//
+//  XLCorpusGenerator.h
+//  Xenolexia Benchmarks
+//
+//  Deterministic synthetic books and vocabulary for the core benchmarks. The same seed and
+//  settings always produce byte-identical files, so runs on different machines are comparable.
+//
+
+#import <Foundation/Foundation.h>
+
+@class XLStorageService;
+
+typedef NS_ENUM(NSInteger, XLCorpusScript) {
+    XLCorpusScriptLatin = 0,
+    XLCorpusScriptCyrillic,
+    XLCorpusScriptGreek,
+    XLCorpusScriptCJK
+};
+
+@interface XLCorpusGenerator : NSObject
+
+@property (nonatomic, assign) unsigned long long seed;
+@property (nonatomic, assign) NSUInteger chapterCount;
+@property (nonatomic, assign) NSUInteger wordsPerChapter;
+/// Distinct words drawn from (Zipf-like, so common words repeat as in real prose)
+@property (nonatomic, assign) NSUInteger vocabularySize;
+/// Alphabet of the generated words. CJK words are still space-separated so the engine's tokenizer sees them.
+@property (nonatomic, assign) XLCorpusScript script;
+
+/// latin, cyrillic, greek or cjk; NO for anything else
++ (BOOL)getScript:(XLCorpusScript *)script forName:(NSString *)name;
++ (NSString *)nameForScript:(XLCorpusScript)script;
+
+- (NSString *)wordAtRank:(NSUInteger)rank;
+/// Paragraphs of chapter index; independent of the other chapters, so any chapter can be regenerated alone
+- (NSArray *)paragraphsForChapterAtIndex:(NSUInteger)index;
+
+- (BOOL)writeEpubToPath:(NSString *)path error:(NSError **)error;
+- (BOOL)writeFb2ToPath:(NSString *)path error:(NSError **)error;
+/// Chapters separated by blank lines, the way XLBookParserService splits plain text
+- (BOOL)writeTxtToPath:(NSString *)path error:(NSError **)error;
+/// Minimal uncompressed PalmDOC/MOBI 6 file (no EXTH, no indexes); readable when libmobi is linked
+- (BOOL)writeMobiToPath:(NSString *)path error:(NSError **)error;
+
+/// Save count vocabulary items (ids bench-00000000...) with statuses and review dates spread evenly.
+/// Returns how many saves succeeded.
+- (NSUInteger)seedVocabularyItems:(NSUInteger)count intoStorage:(XLStorageService *)storage;
+
+@end
@@ -0,0 +1,385 @@
+//
+//  XLCorpusGenerator.m
+//  Xenolexia Benchmarks
+//
+
+#import "XLCorpusGenerator.h"
+#import "XLStorageService.h"
+#import <zip.h>
+
+static NSString *const XLCorpusGeneratorErrorDomain = @"XLCorpusGenerator";
+
+static const NSUInteger kWordsPerSentence = 12;
+static const NSUInteger kWordsPerParagraph = 60;
+static const NSUInteger kMobiRecordSize = 4096;
+
+/// splitmix64: tiny, fast and identical on every platform (rand_r is not)
+static unsigned long long nextRandom(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static NSError *generatorError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:XLCorpusGeneratorErrorDomain code:code
+                           userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+}
+
+static void appendBigEndian16(NSMutableData *data, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+    [data appendBytes:bytes length:2];
+}
+
+static void appendBigEndian32(NSMutableData *data, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+    [data appendBytes:bytes length:4];
+}
+
+static void putBigEndian32(NSMutableData *data, NSUInteger offset, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+    [data replaceBytesInRange:NSMakeRange(offset, 4) withBytes:bytes];
+}
+
+static void putBigEndian16(NSMutableData *data, NSUInteger offset, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+    [data replaceBytesInRange:NSMakeRange(offset, 2) withBytes:bytes];
+}
+
+@interface XLCorpusGenerator () <XLStorageServiceDelegate> {
+    BOOL _lastSaveSucceeded;
+}
+- (NSString *)chapterTitleAtIndex:(NSUInteger)index;
+- (NSString *)bookTitle;
+@end
+
+@implementation XLCorpusGenerator
+
+@synthesize seed = _seed;
+@synthesize chapterCount = _chapterCount;
+@synthesize wordsPerChapter = _wordsPerChapter;
+@synthesize vocabularySize = _vocabularySize;
+@synthesize script = _script;
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _seed = 1;
+        _chapterCount = 20;
+        _wordsPerChapter = 2000;
+        _vocabularySize = 3000;
+        _script = XLCorpusScriptLatin;
+    }
+    return self;
+}
+
++ (BOOL)getScript:(XLCorpusScript *)script forName:(NSString *)name {
+    NSString *lower = [name lowercaseString];
+    XLCorpusScript value;
+    if ([lower isEqualToString:@"latin"]) value = XLCorpusScriptLatin;
+    else if ([lower isEqualToString:@"cyrillic"]) value = XLCorpusScriptCyrillic;
+    else if ([lower isEqualToString:@"greek"]) value = XLCorpusScriptGreek;
+    else if ([lower isEqualToString:@"cjk"]) value = XLCorpusScriptCJK;
+    else return NO;
+    if (script) *script = value;
+    return YES;
+}
+
++ (NSString *)nameForScript:(XLCorpusScript)script {
+    switch (script) {
+        case XLCorpusScriptCyrillic: return @"cyrillic";
+        case XLCorpusScriptGreek: return @"greek";
+        case XLCorpusScriptCJK: return @"cjk";
+        default: return @"latin";
+    }
+}
+
+#pragma mark - Text
+
+/// Letter for digit (0 <= digit < alphabet size) in the configured script
+static unichar letterForDigit(XLCorpusScript script, NSUInteger digit) {
+    switch (script) {
+        case XLCorpusScriptCyrillic: return (unichar)(0x0430 + digit);                      // а..я
+        case XLCorpusScriptGreek: return (unichar)(0x03B1 + digit + (digit >= 17 ? 1 : 0)); // α..ω without final ς
+        case XLCorpusScriptCJK: return (unichar)(0x4E00 + digit);                           // first 500 ideographs
+        default: return (unichar)('a' + digit);
+    }
+}
+
+static NSUInteger alphabetSize(XLCorpusScript script) {
+    switch (script) {
+        case XLCorpusScriptCyrillic: return 32;
+        case XLCorpusScriptGreek: return 24;
+        case XLCorpusScriptCJK: return 500;
+        default: return 26;
+    }
+}
+
+/// At least two characters so the engine's tokenizer keeps every word
+static NSString *wordInScript(XLCorpusScript script, NSUInteger rank) {
+    NSUInteger base = alphabetSize(script);
+    unichar buffer[16];
+    NSUInteger n = 0;
+    do {
+        buffer[n++] = letterForDigit(script, rank % base);
+        rank /= base;
+    } while (rank > 0 && n < 15);
+    if (n < 2) buffer[n++] = letterForDigit(script, 0);
+    return [NSString stringWithCharacters:buffer length:n];
+}
+
+- (NSString *)wordAtRank:(NSUInteger)rank {
+    return wordInScript(_script, rank);
+}
+
+- (NSArray *)paragraphsForChapterAtIndex:(NSUInteger)index {
+    unsigned long long state = _seed ^ ((unsigned long long)(index + 1) * 0xD1B54A32D192ED03ULL);
+    NSUInteger vocabulary = MAX((NSUInteger)1, _vocabularySize);
+    NSMutableArray *paragraphs = [NSMutableArray array];
+    NSMutableString *paragraph = [NSMutableString stringWithCapacity:kWordsPerParagraph * 6];
+    for (NSUInteger w = 0; w < _wordsPerChapter; w++) {
+        /* Zipf-ish draw (rank ~ 1/u), as in translation_bench */
+        double u = ((double)(nextRandom(&state) >> 11) + 1.0) / 9007199254740992.0;
+        NSUInteger rank = (NSUInteger)(1.0 / u) - 1;
+        [paragraph appendString:[self wordAtRank:rank % vocabulary]];
+        BOOL endOfParagraph = (w % kWordsPerParagraph == kWordsPerParagraph - 1) || w + 1 == _wordsPerChapter;
+        if (endOfParagraph) {
+            [paragraph appendString:@"."];
+            [paragraphs addObject:[[paragraph copy] autorelease]];
+            [paragraph setString:@""];
+        } else {
+            [paragraph appendString:(w % kWordsPerSentence == kWordsPerSentence - 1) ? @". " : @" "];
+        }
+    }
+    return paragraphs;
+}
+
+- (NSString *)chapterTitleAtIndex:(NSUInteger)index {
+    return [NSString stringWithFormat:@"Chapter %lu", (unsigned long)(index + 1)];
+}
+
+- (NSString *)bookTitle {
+    return [NSString stringWithFormat:@"Synthetic %@ %llu", [XLCorpusGenerator nameForScript:_script], _seed];
+}
+
+#pragma mark - Formats
+
+- (BOOL)writeEpubToPath:(NSString *)path error:(NSError **)error {
+    NSMutableArray *names = [NSMutableArray array];
+    NSMutableArray *contents = [NSMutableArray array];
+
+    [names addObject:@"mimetype"];
+    [contents addObject:[@"application/epub+zip" dataUsingEncoding:NSUTF8StringEncoding]];
+    [names addObject:@"META-INF/container.xml"];
+    [contents addObject:[@"<?xml version=\"1.0\"?>\n"
+                          "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                          "  <rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>\n"
+                          "</container>\n" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    NSMutableString *manifest = [NSMutableString string];
+    NSMutableString *spine = [NSMutableString string];
+    for (NSUInteger c = 0; c < _chapterCount; c++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSMutableString *xhtml = [NSMutableString stringWithFormat:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                  "<html xmlns=\"http://www.w3.org/1999/xhtml\"><head><title>%@</title></head><body>\n<h1>%@</h1>\n",
+                                  [self chapterTitleAtIndex:c], [self chapterTitleAtIndex:c]];
+        for (NSString *paragraph in [self paragraphsForChapterAtIndex:c]) {
+            [xhtml appendFormat:@"<p>%@</p>\n", paragraph];
+        }
+        [xhtml appendString:@"</body></html>\n"];
+        [names addObject:[NSString stringWithFormat:@"OEBPS/chapter%04lu.xhtml", (unsigned long)c]];
+        [contents addObject:[xhtml dataUsingEncoding:NSUTF8StringEncoding]];
+        [manifest appendFormat:@"    <item id=\"c%lu\" href=\"chapter%04lu.xhtml\" media-type=\"application/xhtml+xml\"/>\n", (unsigned long)c, (unsigned long)c];
+        [spine appendFormat:@"    <itemref idref=\"c%lu\"/>\n", (unsigned long)c];
+        [pool drain];
+    }
+    NSString *opf = [NSString stringWithFormat:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\" unique-identifier=\"id\">\n"
+                     "  <metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+                     "    <dc:identifier id=\"id\">urn:xenolexia:bench:%llu</dc:identifier>\n"
+                     "    <dc:title>%@</dc:title>\n    <dc:creator>Xenolexia Benchmarks</dc:creator>\n    <dc:language>en</dc:language>\n"
+                     "  </metadata>\n  <manifest>\n%@  </manifest>\n  <spine>\n%@  </spine>\n</package>\n",
+                     _seed, [self bookTitle], manifest, spine];
+    [names addObject:@"OEBPS/content.opf"];
+    [contents addObject:[opf dataUsingEncoding:NSUTF8StringEncoding]];
+
+    int zipError = 0;
+    zip_t *z = zip_open([path fileSystemRepresentation], ZIP_CREATE | ZIP_TRUNCATE, &zipError);
+    if (!z) {
+        if (error) *error = generatorError(1, [NSString stringWithFormat:@"Cannot create %@ (libzip error %d)", path, zipError]);
+        return NO;
+    }
+    /* zip_source_buffer does not copy: contents stays alive until zip_close has written everything */
+    for (NSUInteger i = 0; i < [names count]; i++) {
+        NSData *data = [contents objectAtIndex:i];
+        zip_source_t *source = zip_source_buffer(z, [data bytes], [data length], 0);
+        zip_int64_t entry = source ? zip_file_add(z, [[names objectAtIndex:i] UTF8String], source, ZIP_FL_OVERWRITE | ZIP_FL_ENC_UTF_8) : -1;
+        if (entry < 0) {
+            if (source) zip_source_free(source);
+            zip_discard(z);
+            if (error) *error = generatorError(2, [NSString stringWithFormat:@"Cannot add %@ to %@", [names objectAtIndex:i], path]);
+            return NO;
+        }
+        if (i == 0) {
+            zip_set_file_compression(z, (zip_uint64_t)entry, ZIP_CM_STORE, 0);   // mimetype must be stored
+        }
+    }
+    if (zip_close(z) != 0) {
+        if (error) *error = generatorError(3, [NSString stringWithFormat:@"Cannot write %@: %s", path, zip_strerror(z)]);
+        zip_discard(z);
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL)writeFb2ToPath:(NSString *)path error:(NSError **)error {
+    NSMutableString *xml = [NSMutableString stringWithFormat:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                            "<FictionBook xmlns=\"http://www.gribuser.ru/xml/fictionbook/2.0\">\n"
+                            "<description><title-info><author><first-name>Xenolexia</first-name><last-name>Benchmarks</last-name></author>"
+                            "<book-title>%@</book-title><lang>en</lang></title-info></description>\n<body>\n", [self bookTitle]];
+    for (NSUInteger c = 0; c < _chapterCount; c++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        [xml appendFormat:@"<section><title><p>%@</p></title>\n", [self chapterTitleAtIndex:c]];
+        for (NSString *paragraph in [self paragraphsForChapterAtIndex:c]) {
+            [xml appendFormat:@"<p>%@</p>\n", paragraph];
+        }
+        [xml appendString:@"</section>\n"];
+        [pool drain];
+    }
+    [xml appendString:@"</body>\n</FictionBook>\n"];
+    return [xml writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:error];
+}
+
+- (BOOL)writeTxtToPath:(NSString *)path error:(NSError **)error {
+    NSMutableString *text = [NSMutableString string];
+    for (NSUInteger c = 0; c < _chapterCount; c++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        if (c > 0) [text appendString:@"\n\n"];
+        [text appendString:[[self paragraphsForChapterAtIndex:c] componentsJoinedByString:@"\n"]];
+        [pool drain];
+    }
+    [text appendString:@"\n"];
+    return [text writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:error];
+}
+
+- (BOOL)writeMobiToPath:(NSString *)path error:(NSError **)error {
+    NSMutableString *html = [NSMutableString stringWithString:@"<html><head><guide></guide></head><body>"];
+    for (NSUInteger c = 0; c < _chapterCount; c++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        [html appendFormat:@"<h1>%@</h1>", [self chapterTitleAtIndex:c]];
+        for (NSString *paragraph in [self paragraphsForChapterAtIndex:c]) {
+            [html appendFormat:@"<p>%@</p>", paragraph];
+        }
+        [html appendString:@"<mbp:pagebreak/>"];
+        [pool drain];
+    }
+    [html appendString:@"</body></html>"];
+    NSData *text = [html dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *name = [[self bookTitle] dataUsingEncoding:NSUTF8StringEncoding];
+    NSUInteger textRecords = ([text length] + kMobiRecordSize - 1) / kMobiRecordSize;
+    NSUInteger recordCount = 1 + textRecords;
+    if (recordCount > 0xFFFF) {
+        if (error) *error = generatorError(4, @"Book too large for a PalmDB record list");
+        return NO;
+    }
+
+    /* Record 0: PalmDOC header, MOBI header (232 bytes, no EXTH), full name */
+    const NSUInteger mobiHeaderLength = 232;
+    NSMutableData *record0 = [NSMutableData data];
+    appendBigEndian16(record0, 1);                          // no compression
+    appendBigEndian16(record0, 0);
+    appendBigEndian32(record0, (uint32_t)[text length]);
+    appendBigEndian16(record0, (uint16_t)textRecords);
+    appendBigEndian16(record0, (uint16_t)kMobiRecordSize);
+    appendBigEndian32(record0, 0);                          // no encryption
+    NSUInteger mobi = [record0 length];
+    [record0 increaseLengthBy:mobiHeaderLength];
+    [record0 replaceBytesInRange:NSMakeRange(mobi, 4) withBytes:"MOBI"];
+    putBigEndian32(record0, mobi + 4, (uint32_t)mobiHeaderLength);
+    putBigEndian32(record0, mobi + 8, 2);                   // MOBI book
+    putBigEndian32(record0, mobi + 12, 65001);              // UTF-8
+    putBigEndian32(record0, mobi + 16, (uint32_t)_seed);
+    putBigEndian32(record0, mobi + 20, 6);
+    for (NSUInteger offset = 24; offset < 64; offset += 4) {
+        putBigEndian32(record0, mobi + offset, 0xFFFFFFFF);  // no orthographic, inflection or extra indexes
+    }
+    putBigEndian32(record0, mobi + 64, (uint32_t)recordCount);
+    putBigEndian32(record0, mobi + 68, (uint32_t)(mobi + mobiHeaderLength));
+    putBigEndian32(record0, mobi + 72, (uint32_t)[name length]);
+    putBigEndian32(record0, mobi + 76, 9);                  // English
+    putBigEndian32(record0, mobi + 88, 6);
+    putBigEndian32(record0, mobi + 92, 0xFFFFFFFF);         // no images
+    putBigEndian32(record0, mobi + 148, 0xFFFFFFFF);        // no DRM
+    putBigEndian16(record0, mobi + 172, 1);                 // first content record
+    putBigEndian16(record0, mobi + 174, (uint16_t)textRecords);
+    putBigEndian32(record0, mobi + 176, 1);
+    putBigEndian32(record0, mobi + 180, 0xFFFFFFFF);        // no FCIS
+    putBigEndian32(record0, mobi + 188, 0xFFFFFFFF);        // no FLIS
+    putBigEndian32(record0, mobi + 204, 0xFFFFFFFF);
+    putBigEndian32(record0, mobi + 212, 0xFFFFFFFF);
+    putBigEndian32(record0, mobi + 216, 0xFFFFFFFF);
+    putBigEndian32(record0, mobi + 228, 0xFFFFFFFF);        // no INDX; extra-data flags at +226 stay 0
+    [record0 appendData:name];
+    [record0 increaseLengthBy:4 - [record0 length] % 4];
+
+    /* PalmDB header and record list */
+    const NSUInteger headerLength = 78;
+    NSMutableData *file = [NSMutableData dataWithCapacity:headerLength + recordCount * 8 + 2 + [record0 length] + [text length]];
+    char dbName[32] = { 0 };
+    strncpy(dbName, "Xenolexia_Bench", sizeof(dbName) - 1);
+    [file appendBytes:dbName length:sizeof(dbName)];
+    appendBigEndian16(file, 0);                             // attributes
+    appendBigEndian16(file, 0);                             // version
+    appendBigEndian32(file, 0x7C000000);                    // fixed dates keep the file reproducible
+    appendBigEndian32(file, 0x7C000000);
+    appendBigEndian32(file, 0);
+    appendBigEndian32(file, 0);
+    appendBigEndian32(file, 0);
+    appendBigEndian32(file, 0);
+    [file appendBytes:"BOOKMOBI" length:8];
+    appendBigEndian32(file, (uint32_t)(2 * recordCount - 1)); // unique id seed
+    appendBigEndian32(file, 0);
+    appendBigEndian16(file, (uint16_t)recordCount);
+    NSUInteger offset = headerLength + recordCount * 8 + 2;
+    for (NSUInteger r = 0; r < recordCount; r++) {
+        appendBigEndian32(file, (uint32_t)offset);
+        appendBigEndian32(file, (uint32_t)(2 * r) & 0x00FFFFFF);  // attributes 0, 24-bit unique id
+        offset += (r == 0) ? [record0 length] : MIN(kMobiRecordSize, [text length] - (r - 1) * kMobiRecordSize);
+    }
+    appendBigEndian16(file, 0);
+    [file appendData:record0];
+    [file appendData:text];
+    return [file writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+#pragma mark - Vocabulary
+
+- (void)storageService:(id)service didSaveVocabularyItem:(XLVocabularyItem *)item withSuccess:(BOOL)success error:(NSError *)error {
+    _lastSaveSucceeded = success;
+}
+
+- (NSUInteger)seedVocabularyItems:(NSUInteger)count intoStorage:(XLStorageService *)storage {
+    NSDate *epoch = [NSDate dateWithTimeIntervalSince1970:1700000000];
+    NSUInteger saved = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        XLVocabularyItem *item = [XLVocabularyItem itemWithSourceWord:wordInScript(XLCorpusScriptLatin, i)
+                                                           targetWord:wordInScript(_script, i)
+                                                       sourceLanguage:XLLanguageEnglish
+                                                       targetLanguage:XLLanguageFrench];
+        item.vocabularyId = [NSString stringWithFormat:@"bench-%08lu", (unsigned long)i];
+        item.addedAt = [epoch dateByAddingTimeInterval:(NSTimeInterval)i * 60];
+        item.status = (XLVocabularyStatus)(i % 4);
+        item.reviewCount = (NSInteger)(i % 7);
+        item.interval = (NSInteger)(i % 30);
+        item.lastReviewedAt = item.reviewCount > 0 ? [epoch dateByAddingTimeInterval:(NSTimeInterval)(i % 90) * 86400] : nil;
+        item.bookTitle = [self bookTitle];
+        _lastSaveSucceeded = NO;
+        [storage saveVocabularyItem:item delegate:self];
+        if (_lastSaveSucceeded) saved++;
+        [pool drain];
+    }
+    return saved;
+}
+
+@end
@@ -0,0 +1,37 @@
+//
+//  XLLegacyTranslatorStub.m
+//  Xenolexia Benchmarks
+//
+//  Link-time stand-in for the legacy Microsoft TranslationService (AVFoundation + MSTranslate),
+//  which XLTranslationService references but the benchmarks never use: they run the LibreTranslate backend.
+//
+
+#import "TranslationService.h"
+
+@implementation TranslationService
+
++ (id)sharedTranslator {
+    static TranslationService *sharedTranslator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedTranslator = [[self alloc] init];
+    });
+    return sharedTranslator;
+}
+
+- (void)doSayWord:(NSString*)input {
+}
+
+- (void)doTranslateWord:(NSString*)input withCompletion:(void(^)(NSString *))completion {
+    if (completion) completion(nil);
+}
+
+- (void)doTranslateWord:(NSString*)input from:(NSString*)lang1 to:(NSString*)lang2 withCompletion:(void(^)(NSString *))completion {
+    if (completion) completion(nil);
+}
+
+- (void)doTranslateArray:(NSArray*)keysArray withCompletion:(void(^)(NSArray *))completion {
+    if (completion) completion(nil);
+}
+
+@end
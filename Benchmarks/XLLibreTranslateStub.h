@@ -0,0 +1,62 @@
+//
+//  XLLibreTranslateStub.h
+//  Xenolexia Benchmarks
+//
+//  Loopback stand-in for a LibreTranslate server, for offline load tests.
+//
+
+#import <Foundation/Foundation.h>
+
+/// Speaks enough of the LibreTranslate HTTP API for XLLibreTranslateClient:
+/// POST /translate with JSON {q, source, target, format}; q may be a string or an array (batch),
+/// and translatedText is returned in the same shape. Translations are deterministic ("<target>:<word>").
+/// Binds 127.0.0.1 only, one thread per connection, HTTP/1.1 keep-alive.
+@interface XLLibreTranslateStub : NSObject {
+    int _listenFd;
+    unsigned short _port;
+    volatile BOOL _running;
+    unsigned int _seed;
+    NSUInteger _latencyMs;
+    NSUInteger _jitterMs;
+    double _errorRate;
+    NSUInteger _maxRequestsPerSecond;
+    NSUInteger _maxConcurrent;
+    NSInteger _active;
+    NSUInteger _requestCount;
+    NSUInteger _errorCount;
+    NSUInteger _throttledCount;
+    NSTimeInterval _windowStart;
+    NSUInteger _windowCount;
+    NSMutableArray *_latencies;     // NSNumber seconds, server-side time per request
+    NSCondition *_lock;
+}
+
+/// Fixed service time per request in ms (default 0)
+@property (nonatomic, assign) NSUInteger latencyMs;
+/// Uniform random extra 0..jitterMs per request (default 0)
+@property (nonatomic, assign) NSUInteger jitterMs;
+/// Fraction of requests answered with HTTP 503 (default 0)
+@property (nonatomic, assign) double errorRate;
+/// Requests beyond this many per wall-clock second get HTTP 429; 0 = unlimited
+@property (nonatomic, assign) NSUInteger maxRequestsPerSecond;
+/// Requests served at once; further ones wait, modelling a server with fixed worker count. 0 = unlimited
+@property (nonatomic, assign) NSUInteger maxConcurrent;
+/// Seed for jitter and error injection, so runs are reproducible (default 1)
+@property (nonatomic, assign) unsigned int seed;
+
+/// Listening port after -start: (0 before)
+@property (nonatomic, readonly) unsigned short port;
+/// http://127.0.0.1:<port>
+- (NSString *)baseURL;
+
+/// Bind an ephemeral loopback port and start accepting. Returns NO with error if the socket setup fails.
+- (BOOL)start:(NSError **)error;
+- (void)stop;
+
+- (NSUInteger)requestCount;
+- (NSUInteger)errorCount;
+- (NSUInteger)throttledCount;
+/// Copy of recorded server-side latencies (seconds), including time spent waiting for a worker slot
+- (NSArray *)latencies;
+
+@end
@@ -0,0 +1,333 @@
+//
+//  XLLibreTranslateStub.m
+//  Xenolexia Benchmarks
+//
+
+#import "XLLibreTranslateStub.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <errno.h>
+
+static const size_t kMaxRequestBytes = 1024 * 1024;
+
+@interface XLLibreTranslateStub ()
+- (void)acceptLoop;
+- (void)serveConnection:(int)fd;
+- (NSData *)responseForMethod:(NSString *)method path:(NSString *)path body:(NSData *)body status:(int *)status;
+@end
+
+typedef struct {
+    XLLibreTranslateStub *stub;
+    int fd;
+} XLStubConnection;
+
+static void *XLStubAcceptThread(void *arg) {
+    XLLibreTranslateStub *stub = (XLLibreTranslateStub *)arg;
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    [stub acceptLoop];
+    [pool drain];
+    [stub release];
+    return NULL;
+}
+
+static void *XLStubConnectionThread(void *arg) {
+    XLStubConnection *conn = (XLStubConnection *)arg;
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    [conn->stub serveConnection:conn->fd];
+    [pool drain];
+    [conn->stub release];
+    free(conn);
+    return NULL;
+}
+
+static BOOL XLStubWriteAll(int fd, const void *bytes, size_t len) {
+    const char *p = bytes;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NO;
+        p += n;
+        len -= (size_t)n;
+    }
+    return YES;
+}
+
+@implementation XLLibreTranslateStub
+
+@synthesize latencyMs = _latencyMs;
+@synthesize jitterMs = _jitterMs;
+@synthesize errorRate = _errorRate;
+@synthesize maxRequestsPerSecond = _maxRequestsPerSecond;
+@synthesize maxConcurrent = _maxConcurrent;
+@synthesize seed = _seed;
+@synthesize port = _port;
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _listenFd = -1;
+        _seed = 1;
+        _latencies = [[NSMutableArray alloc] init];
+        _lock = [[NSCondition alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+    [_latencies release];
+    [_lock release];
+    [super dealloc];
+}
+
+- (NSString *)baseURL {
+    return [NSString stringWithFormat:@"http://127.0.0.1:%u", (unsigned)_port];
+}
+
+- (BOOL)start:(NSError **)error {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0
+        || getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        close(fd);
+        return NO;
+    }
+    _listenFd = fd;
+    _port = ntohs(addr.sin_port);
+    _running = YES;
+
+    pthread_t thread;
+    [self retain];
+    if (pthread_create(&thread, NULL, XLStubAcceptThread, self) != 0) {
+        [self release];
+        _running = NO;
+        close(fd);
+        _listenFd = -1;
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    pthread_detach(thread);
+    return YES;
+}
+
+- (void)stop {
+    if (!_running) return;
+    _running = NO;
+    /* shutdown() wakes the blocked accept() */
+    shutdown(_listenFd, SHUT_RDWR);
+    close(_listenFd);
+    _listenFd = -1;
+}
+
+- (void)acceptLoop {
+    while (_running) {
+        int fd = accept(_listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        XLStubConnection *conn = malloc(sizeof(XLStubConnection));
+        conn->stub = [self retain];
+        conn->fd = fd;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, XLStubConnectionThread, conn) != 0) {
+            close(fd);
+            [self release];
+            free(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+/// Minimal HTTP/1.1: request line, Content-Length body, keep-alive unless "Connection: close"
+- (void)serveConnection:(int)fd {
+    NSMutableData *buffer = [[NSMutableData alloc] init];
+    char chunk[16384];
+    while (_running) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSRange headerEnd = NSMakeRange(NSNotFound, 0);
+        NSData *terminator = [NSData dataWithBytes:"\r\n\r\n" length:4];
+        while ((headerEnd = [buffer rangeOfData:terminator options:0 range:NSMakeRange(0, [buffer length])]).location == NSNotFound) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0 || [buffer length] > kMaxRequestBytes) break;
+            [buffer appendBytes:chunk length:(NSUInteger)n];
+        }
+        if (headerEnd.location == NSNotFound) {
+            [pool drain];
+            break;
+        }
+        NSUInteger bodyStart = NSMaxRange(headerEnd);
+        NSString *head = [[[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, headerEnd.location)]
+                                                encoding:NSISOLatin1StringEncoding] autorelease];
+        NSArray *lines = [head componentsSeparatedByString:@"\r\n"];
+        NSArray *requestLine = [[lines firstObject] componentsSeparatedByString:@" "];
+        NSString *method = [requestLine count] > 0 ? [requestLine objectAtIndex:0] : @"";
+        NSString *path = [requestLine count] > 1 ? [requestLine objectAtIndex:1] : @"/";
+        NSUInteger contentLength = 0;
+        BOOL keepAlive = YES;
+        for (NSString *line in lines) {
+            NSRange colon = [line rangeOfString:@":"];
+            if (colon.location == NSNotFound) continue;
+            NSString *name = [[line substringToIndex:colon.location] lowercaseString];
+            NSString *value = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+            if ([name isEqualToString:@"content-length"]) {
+                contentLength = (NSUInteger)[value integerValue];
+            } else if ([name isEqualToString:@"connection"] && [[value lowercaseString] isEqualToString:@"close"]) {
+                keepAlive = NO;
+            }
+        }
+        if (contentLength > kMaxRequestBytes) {
+            [pool drain];
+            break;
+        }
+        while ([buffer length] < bodyStart + contentLength) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            [buffer appendBytes:chunk length:(NSUInteger)n];
+        }
+        if ([buffer length] < bodyStart + contentLength) {
+            [pool drain];
+            break;
+        }
+        NSData *body = [buffer subdataWithRange:NSMakeRange(bodyStart, contentLength)];
+        [buffer replaceBytesInRange:NSMakeRange(0, bodyStart + contentLength) withBytes:NULL length:0];
+
+        int status = 200;
+        NSData *payload = [self responseForMethod:method path:path body:body status:&status];
+        const char *reason = status == 200 ? "OK" : status == 400 ? "Bad Request" : status == 404 ? "Not Found"
+                           : status == 429 ? "Too Many Requests" : "Service Unavailable";
+        NSString *header = [NSString stringWithFormat:@"HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %lu\r\n%@\r\n",
+                            status, reason, (unsigned long)[payload length], keepAlive ? @"" : @"Connection: close\r\n"];
+        NSData *headerData = [header dataUsingEncoding:NSISOLatin1StringEncoding];
+        BOOL ok = XLStubWriteAll(fd, [headerData bytes], [headerData length])
+               && XLStubWriteAll(fd, [payload bytes], [payload length]);
+        [pool drain];
+        if (!ok || !keepAlive) break;
+    }
+    [buffer release];
+    close(fd);
+}
+
+- (NSData *)responseForMethod:(NSString *)method path:(NSString *)path body:(NSData *)body status:(int *)status {
+    NSTimeInterval arrived = [NSDate timeIntervalSinceReferenceDate];
+    if (![method isEqualToString:@"POST"] || ![path hasPrefix:@"/translate"]) {
+        *status = 404;
+        return [NSJSONSerialization dataWithJSONObject:@{ @"error": @"Not found" } options:0 error:NULL];
+    }
+
+    /* Admission: rate limit, error injection and service delay are decided under the lock */
+    [_lock lock];
+    _requestCount++;
+    NSTimeInterval second = floor(arrived);
+    if (second != _windowStart) {
+        _windowStart = second;
+        _windowCount = 0;
+    }
+    _windowCount++;
+    if (_maxRequestsPerSecond > 0 && _windowCount > _maxRequestsPerSecond) {
+        _throttledCount++;
+        [_lock unlock];
+        *status = 429;
+        return [NSJSONSerialization dataWithJSONObject:@{ @"error": @"Slowdown: too many requests" } options:0 error:NULL];
+    }
+    BOOL fail = _errorRate > 0 && (double)rand_r(&_seed) / RAND_MAX < _errorRate;
+    NSUInteger delayMs = _latencyMs + (_jitterMs > 0 ? (NSUInteger)rand_r(&_seed) % (_jitterMs + 1) : 0);
+    while (_maxConcurrent > 0 && _active >= (NSInteger)_maxConcurrent) {
+        [_lock wait];
+    }
+    _active++;
+    [_lock unlock];
+
+    if (delayMs > 0) {
+        usleep((useconds_t)(delayMs * 1000));
+    }
+
+    NSData *payload = nil;
+    if (fail) {
+        *status = 503;
+        payload = [NSJSONSerialization dataWithJSONObject:@{ @"error": @"Injected failure" } options:0 error:NULL];
+    } else {
+        NSDictionary *json = [NSJSONSerialization JSONObjectWithData:body options:0 error:NULL];
+        id q = [json isKindOfClass:[NSDictionary class]] ? [json objectForKey:@"q"] : nil;
+        NSString *target = [json isKindOfClass:[NSDictionary class]] ? [json objectForKey:@"target"] : nil;
+        if (![target isKindOfClass:[NSString class]] || [target length] == 0) target = @"xx";
+        id translated = nil;
+        if ([q isKindOfClass:[NSString class]]) {
+            translated = [NSString stringWithFormat:@"%@:%@", target, q];
+        } else if ([q isKindOfClass:[NSArray class]]) {
+            NSMutableArray *batch = [NSMutableArray arrayWithCapacity:[q count]];
+            for (id item in q) {
+                [batch addObject:[NSString stringWithFormat:@"%@:%@", target, [item description]]];
+            }
+            translated = batch;
+        }
+        if (translated) {
+            payload = [NSJSONSerialization dataWithJSONObject:@{ @"translatedText": translated } options:0 error:NULL];
+        } else {
+            *status = 400;
+            payload = [NSJSONSerialization dataWithJSONObject:@{ @"error": @"Invalid request: missing q parameter" } options:0 error:NULL];
+        }
+    }
+
+    [_lock lock];
+    _active--;
+    if (*status != 200) _errorCount++;
+    [_latencies addObject:@([NSDate timeIntervalSinceReferenceDate] - arrived)];
+    [_lock signal];
+    [_lock unlock];
+    return payload;
+}
+
+- (NSUInteger)requestCount {
+    [_lock lock];
+    NSUInteger n = _requestCount;
+    [_lock unlock];
+    return n;
+}
+
+- (NSUInteger)errorCount {
+    [_lock lock];
+    NSUInteger n = _errorCount;
+    [_lock unlock];
+    return n;
+}
+
+- (NSUInteger)throttledCount {
+    [_lock lock];
+    NSUInteger n = _throttledCount;
+    [_lock unlock];
+    return n;
+}
+
+- (NSArray *)latencies {
+    [_lock lock];
+    NSArray *copy = [[_latencies copy] autorelease];
+    [_lock unlock];
+    return copy;
+}
+
+@end
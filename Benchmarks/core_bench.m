@@ -0,0 +1,510 @@
+//
+//  core_bench.m
+//  Xenolexia Benchmarks
+//
+//  Times the Core hot paths on a generated corpus: EPUB/FB2/TXT/MOBI parsing, XLTranslationEngine
+//  against an in-process stub translator, SM-2 scheduling (per object and batched), XLStorageService
+//  vocabulary queries and rescheduling, and XLExportService formats. Writes JSON results and, given a baseline from an earlier run, fails on regressions.
+//
+//  Usage: XenolexiaCoreBench [--chapters N] [--words N] [--vocab N] [--script latin|cyrillic|greek|cjk]
+//         [--items N] [--cards N] [--iterations N] [--seed N] [--workdir DIR] [--output FILE]
+//         [--baseline FILE] [--threshold F]
+//
+//  Exit status: 0 ok, 1 a case regressed past the threshold, 2 usage error, 3 setup failure.
+//
+
+#import <Foundation/Foundation.h>
+#import "XLCorpusGenerator.h"
+#import "XLBookParserService.h"
+#import "XLEpubParser.h"
+#import "XLNativeParsers.h"
+#import "XLTranslationEngine.h"
+#import "XLSm2.h"
+#import "XLSm2Batch.h"
+#import "XLStorageService.h"
+#import "XLExportService.h"
+#import "XLTrace.h"
+#import <stdio.h>
+#import <stdlib.h>
+
+typedef struct {
+    NSUInteger chapters;
+    NSUInteger wordsPerChapter;
+    NSUInteger vocabulary;
+    NSUInteger items;
+    NSUInteger iterations;
+    unsigned long long seed;
+    double threshold;
+    NSUInteger cards;
+} XLCoreBenchConfig;
+
+/// Work done by one iteration, in the case's unit (chapters, words, rows, ...); 0 means the case could not run
+typedef NSUInteger (^XLBenchCase)(void);
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--chapters N] [--words N] [--vocab N] [--script latin|cyrillic|greek|cjk] [--items N]\n"
+                    "          [--cards N] [--iterations N] [--seed N] [--workdir DIR] [--output FILE] [--baseline FILE] [--threshold F]\n", argv0);
+}
+
+/// Answers every word at once with its reversal, so engine timings exclude the network entirely
+@interface XLStubTranslator : NSObject <XLTranslationService>
+@end
+
+@implementation XLStubTranslator
+
+static NSString *reversedWord(NSString *word) {
+    NSUInteger length = [word length];
+    unichar buffer[32];
+    if (length > 32) return word;
+    for (NSUInteger i = 0; i < length; i++) {
+        buffer[i] = [word characterAtIndex:length - 1 - i];
+    }
+    return [NSString stringWithCharacters:buffer length:length];
+}
+
+- (void)translateWord:(NSString *)word fromLanguage:(XLLanguage)sourceLanguage toLanguage:(XLLanguage)targetLanguage
+       withCompletion:(void(^)(NSString *translatedWord, NSError *error))completion {
+    if (completion) completion(reversedWord(word), nil);
+}
+
+- (void)translateWords:(NSArray *)words fromLanguage:(XLLanguage)sourceLanguage toLanguage:(XLLanguage)targetLanguage
+        withCompletion:(void(^)(NSArray *translatedWords, NSError *error))completion {
+    NSMutableArray *translated = [NSMutableArray arrayWithCapacity:[words count]];
+    for (NSString *word in words) {
+        [translated addObject:reversedWord(word)];
+    }
+    if (completion) completion(translated, nil);
+}
+
+- (void)pronounceWord:(NSString *)word inLanguage:(XLLanguage)language {
+}
+
+@end
+
+/// Synchronous XLStorageService results for the storage cases
+@interface XLBenchStorageDelegate : NSObject <XLStorageServiceDelegate> {
+@public
+    BOOL _success;
+    NSInteger _count;
+    NSUInteger _rows;
+    NSString *_token;
+}
+@end
+
+@implementation XLBenchStorageDelegate
+
+- (void)dealloc {
+    [_token release];
+    [super dealloc];
+}
+
+- (void)storageService:(id)service didInitializeDatabaseWithSuccess:(BOOL)success error:(NSError *)error {
+    _success = success;
+}
+
+- (void)storageService:(id)service didGetVocabularyPage:(XLStoragePage *)page withError:(NSError *)error {
+    _rows = [page.items count];
+    [_token release];
+    _token = [page.continuationToken copy];
+}
+
+- (void)storageService:(id)service didGetVocabularyCount:(NSInteger)count withError:(NSError *)error {
+    _count = count;
+}
+
+- (void)storageService:(id)service didGetVocabularyDueForReview:(NSArray *)items withError:(NSError *)error {
+    _rows = [items count];
+}
+
+- (void)storageService:(id)service didRescheduleVocabularyItems:(NSUInteger)count withSuccess:(BOOL)success error:(NSError *)error {
+    _success = success;
+    _rows = count;
+}
+
+@end
+
+static double median(NSArray *sortedValues) {
+    NSUInteger n = [sortedValues count];
+    if (n == 0) return 0;
+    if (n % 2) return [[sortedValues objectAtIndex:n / 2] doubleValue];
+    return ([[sortedValues objectAtIndex:n / 2 - 1] doubleValue] + [[sortedValues objectAtIndex:n / 2] doubleValue]) / 2.0;
+}
+
+/// One untimed warm-up, then iterations timed runs. nil if the case reported no work (e.g. libmobi not linked).
+static NSDictionary *runCase(NSString *name, NSString *unit, NSUInteger iterations, XLBenchCase body) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    NSUInteger items = body();
+    [pool drain];
+    if (items == 0) {
+        fprintf(stderr, "%-24s skipped\n", [name UTF8String]);
+        return nil;
+    }
+    NSMutableArray *times = [NSMutableArray arrayWithCapacity:iterations];
+    for (NSUInteger i = 0; i < iterations; i++) {
+        pool = [[NSAutoreleasePool alloc] init];
+        NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        items = body();
+        [times addObject:[NSNumber numberWithDouble:([NSDate timeIntervalSinceReferenceDate] - start) * 1000.0]];
+        [pool drain];
+    }
+    [times sortUsingSelector:@selector(compare:)];
+    double medianMs = median(times);
+    double perSecond = medianMs > 0 ? items / (medianMs / 1000.0) : 0;
+    fprintf(stderr, "%-24s median %9.3f ms  min %9.3f ms  %12.1f %s/s\n", [name UTF8String], medianMs,
+            [[times objectAtIndex:0] doubleValue], perSecond, [unit UTF8String]);
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            [NSNumber numberWithUnsignedInteger:iterations], @"iterations",
+            [NSNumber numberWithDouble:medianMs], @"median_ms",
+            [times objectAtIndex:0], @"min_ms",
+            [times lastObject], @"max_ms",
+            [NSNumber numberWithUnsignedInteger:items], @"items",
+            unit, @"unit",
+            [NSNumber numberWithDouble:perSecond], @"items_per_sec",
+            nil];
+}
+
+static NSUInteger chapterCount(XLParsedBook *book) {
+    return [book.chapters count];
+}
+
+static NSUInteger processChapters(XLTranslationEngine *engine, NSArray *chapters, NSUInteger wordsPerChapter) {
+    NSUInteger words = 0;
+    for (XLChapter *chapter in chapters) {
+        dispatch_semaphore_t done = dispatch_semaphore_create(0);
+        __block BOOL ok = NO;
+        [engine processChapter:chapter withCompletion:^(XLProcessedChapter *processedChapter, NSError *error) {
+            ok = (processedChapter != nil);
+            dispatch_semaphore_signal(done);
+        }];
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        dispatch_release(done);
+        if (!ok) return 0;
+        words += wordsPerChapter;
+    }
+    return words;
+}
+
+/// Lists the regressions against baseline (same JSON layout as --output); returns how many cases regressed
+static NSUInteger compareWithBaseline(NSDictionary *results, NSDictionary *baseline, double threshold) {
+    NSDictionary *baseResults = [baseline objectForKey:@"results"];
+    NSUInteger regressions = 0;
+    for (NSString *name in [[results allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        NSDictionary *base = [baseResults objectForKey:name];
+        if (![base isKindOfClass:[NSDictionary class]]) continue;
+        double before = [[base objectForKey:@"median_ms"] doubleValue];
+        double after = [[[results objectForKey:name] objectForKey:@"median_ms"] doubleValue];
+        if (before <= 0) continue;
+        double change = after / before - 1.0;
+        BOOL regressed = change > threshold;
+        if (regressed) regressions++;
+        fprintf(stderr, "%-24s %9.3f -> %9.3f ms  %+6.1f%%%s\n", [name UTF8String], before, after, change * 100.0,
+                regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, const char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    XLTraceStartFromEnvironment();
+    XLCoreBenchConfig config = { 20, 2000, 3000, 5000, 5, 1, 0.10, 500000 };
+    XLCorpusScript script = XLCorpusScriptLatin;
+    NSString *workdir = nil, *outputPath = nil, *baselinePath = nil;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            [pool drain];
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--chapters") == 0) config.chapters = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--words") == 0) config.wordsPerChapter = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--vocab") == 0) config.vocabulary = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--items") == 0) config.items = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--cards") == 0) config.cards = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--iterations") == 0) config.iterations = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0) config.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--threshold") == 0) config.threshold = strtod(value, NULL);
+        else if (strcmp(arg, "--workdir") == 0) workdir = [NSString stringWithUTF8String:value];
+        else if (strcmp(arg, "--output") == 0) outputPath = [NSString stringWithUTF8String:value];
+        else if (strcmp(arg, "--baseline") == 0) baselinePath = [NSString stringWithUTF8String:value];
+        else if (strcmp(arg, "--script") == 0) {
+            if (![XLCorpusGenerator getScript:&script forName:[NSString stringWithUTF8String:value]]) {
+                usage(argv[0]);
+                [pool drain];
+                return 2;
+            }
+        } else {
+            usage(argv[0]);
+            [pool drain];
+            return 2;
+        }
+    }
+    if (config.chapters == 0 || config.wordsPerChapter == 0 || config.vocabulary == 0 || config.iterations == 0 || config.cards == 0) {
+        usage(argv[0]);
+        [pool drain];
+        return 2;
+    }
+
+    NSFileManager *fm = [NSFileManager defaultManager];
+    if (!workdir) {
+        workdir = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                   [NSString stringWithFormat:@"xenolexia-core-bench-%d", [[NSProcessInfo processInfo] processIdentifier]]];
+    }
+    [fm createDirectoryAtPath:workdir withIntermediateDirectories:YES attributes:nil error:NULL];
+
+    XLCorpusGenerator *generator = [[[XLCorpusGenerator alloc] init] autorelease];
+    generator.seed = config.seed;
+    generator.chapterCount = config.chapters;
+    generator.wordsPerChapter = config.wordsPerChapter;
+    generator.vocabularySize = config.vocabulary;
+    generator.script = script;
+
+    NSString *epubPath = [workdir stringByAppendingPathComponent:@"corpus.epub"];
+    NSString *fb2Path = [workdir stringByAppendingPathComponent:@"corpus.fb2"];
+    NSString *txtPath = [workdir stringByAppendingPathComponent:@"corpus.txt"];
+    NSString *mobiPath = [workdir stringByAppendingPathComponent:@"corpus.mobi"];
+    NSError *error = nil;
+    if (![generator writeEpubToPath:epubPath error:&error] || ![generator writeFb2ToPath:fb2Path error:&error] ||
+        ![generator writeTxtToPath:txtPath error:&error] || ![generator writeMobiToPath:mobiPath error:&error]) {
+        fprintf(stderr, "corpus generation failed: %s\n", [[error localizedDescription] UTF8String]);
+        [pool drain];
+        return 3;
+    }
+
+    NSString *databasePath = [workdir stringByAppendingPathComponent:@"bench.db"];
+    [fm removeItemAtPath:databasePath error:NULL];
+    XLStorageService *storage = [[[XLStorageService alloc] initWithDatabasePath:databasePath] autorelease];
+    XLBenchStorageDelegate *results = [[[XLBenchStorageDelegate alloc] init] autorelease];
+    [storage initializeDatabaseWithDelegate:results];
+    if (!results->_success) {
+        fprintf(stderr, "cannot create %s\n", [databasePath UTF8String]);
+        [pool drain];
+        return 3;
+    }
+
+    fprintf(stderr, "chapters=%lu words/chapter=%lu vocab=%lu script=%s items=%lu iterations=%lu seed=%llu\n",
+            (unsigned long)config.chapters, (unsigned long)config.wordsPerChapter, (unsigned long)config.vocabulary,
+            [[XLCorpusGenerator nameForScript:script] UTF8String], (unsigned long)config.items,
+            (unsigned long)config.iterations, config.seed);
+
+    NSMutableDictionary *cases = [NSMutableDictionary dictionary];
+    NSDictionary *result;
+    NSUInteger iterations = config.iterations;
+
+    /* Parsing */
+    result = runCase(@"parse.epub", @"chapters", iterations, ^NSUInteger {
+        return chapterCount([XLEpubParser parseEpubAtPath:epubPath error:NULL]);
+    });
+    if (result) [cases setObject:result forKey:@"parse.epub"];
+    result = runCase(@"parse.fb2", @"chapters", iterations, ^NSUInteger {
+        return chapterCount([XLNativeParsers parseFb2AtPath:fb2Path error:NULL]);
+    });
+    if (result) [cases setObject:result forKey:@"parse.fb2"];
+    result = runCase(@"parse.mobi", @"chapters", iterations, ^NSUInteger {
+        return chapterCount([XLNativeParsers parseMobiAtPath:mobiPath error:NULL]);
+    });
+    if (result) [cases setObject:result forKey:@"parse.mobi"];
+    result = runCase(@"parse.txt", @"chapters", iterations, ^NSUInteger {
+        __block NSUInteger chapters = 0;
+        [[XLBookParserService sharedService] parseBookAtPath:txtPath withCompletion:^(XLParsedBook *parsedBook, NSError *parseError) {
+            chapters = chapterCount(parsedBook);
+        }];
+        return chapters;
+    });
+    if (result) [cases setObject:result forKey:@"parse.txt"];
+
+    /* Translation engine: a cold engine per iteration, then one whose word cache is already full */
+    NSMutableArray *chapters = [NSMutableArray arrayWithCapacity:config.chapters];
+    for (NSUInteger c = 0; c < config.chapters; c++) {
+        XLChapter *chapter = [[[XLChapter alloc] init] autorelease];
+        chapter.chapterId = [NSString stringWithFormat:@"bench-%lu", (unsigned long)c];
+        chapter.index = (NSInteger)c;
+        chapter.content = [[generator paragraphsForChapterAtIndex:c] componentsJoinedByString:@"\n"];
+        chapter.wordCount = (NSInteger)config.wordsPerChapter;
+        [chapters addObject:chapter];
+    }
+    XLStubTranslator *translator = [[[XLStubTranslator alloc] init] autorelease];
+    XLTranslationOptions *options = [XLTranslationOptions optionsWithLanguagePair:[XLLanguagePair pairWithSource:XLLanguageEnglish target:XLLanguageFrench]
+                                                                 proficiencyLevel:XLProficiencyLevelBeginner
+                                                                      wordDensity:0.3];
+    result = runCase(@"engine.process.cold", @"words", iterations, ^NSUInteger {
+        XLTranslationEngine *engine = [[[XLTranslationEngine alloc] initWithOptions:options] autorelease];
+        engine.translationService = translator;
+        return processChapters(engine, chapters, config.wordsPerChapter);
+    });
+    if (result) [cases setObject:result forKey:@"engine.process.cold"];
+    XLTranslationEngine *warmEngine = [[[XLTranslationEngine alloc] initWithOptions:options] autorelease];
+    warmEngine.translationService = translator;
+    result = runCase(@"engine.process.warm", @"words", iterations, ^NSUInteger {
+        return processChapters(warmEngine, chapters, config.wordsPerChapter);
+    });
+    if (result) [cases setObject:result forKey:@"engine.process.warm"];
+
+    /* SM-2: the same deck stepped one XLSm2State at a time and as columns through the batch kernel */
+    NSUInteger cards = config.cards;
+    NSMutableArray *sm2States = [NSMutableArray arrayWithCapacity:cards];
+    int32_t *sm2Quality = malloc(cards * sizeof(int32_t));
+    double *sm2Ease = malloc(cards * sizeof(double));
+    double *sm2Interval = malloc(cards * sizeof(double));
+    int64_t *sm2Count = malloc(cards * sizeof(int64_t));
+    int64_t *sm2Status = malloc(cards * sizeof(int64_t));
+    for (NSUInteger i = 0; i < cards; i++) {
+        XLSm2State *state = [[XLSm2State alloc] init];
+        state.easeFactor = 2.5;
+        [sm2States addObject:state];
+        [state release];
+        sm2Quality[i] = (int32_t)((i * 7) % 6);
+        sm2Ease[i] = 2.5;
+        sm2Interval[i] = 0;
+        sm2Count[i] = 0;
+        sm2Status[i] = XLSm2StatusNew;
+    }
+    result = runCase(@"sm2.step", @"cards", iterations, ^NSUInteger {
+        NSUInteger i = 0;
+        for (XLSm2State *state in sm2States) {
+            XLSm2Step(sm2Quality[i++], state);
+        }
+        return i;
+    });
+    if (result) [cases setObject:result forKey:@"sm2.step"];
+    result = runCase(@"sm2.batch", @"cards", iterations, ^NSUInteger {
+        XLSm2Columns columns = { sm2Ease, sm2Interval, sm2Count, sm2Status };
+        XLSm2StepBatch(sm2Quality, columns, cards);
+        return cards;
+    });
+    if (result) [cases setObject:result forKey:@"sm2.batch"];
+    free(sm2Quality);
+    free(sm2Ease);
+    free(sm2Interval);
+    free(sm2Count);
+    free(sm2Status);
+
+    /* Storage: seeding is timed once (it changes the database), queries are repeated */
+    NSTimeInterval seedStart = [NSDate timeIntervalSinceReferenceDate];
+    NSUInteger seeded = [generator seedVocabularyItems:config.items intoStorage:storage];
+    double seedMs = ([NSDate timeIntervalSinceReferenceDate] - seedStart) * 1000.0;
+    if (seeded != config.items) {
+        fprintf(stderr, "seeded only %lu of %lu vocabulary items\n", (unsigned long)seeded, (unsigned long)config.items);
+        [pool drain];
+        return 3;
+    }
+    fprintf(stderr, "%-24s total     %9.3f ms  %12.1f rows/s\n", "storage.seed", seedMs, seedMs > 0 ? seeded / (seedMs / 1000.0) : 0);
+    [cases setObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                      [NSNumber numberWithUnsignedInteger:1], @"iterations",
+                      [NSNumber numberWithDouble:seedMs], @"median_ms",
+                      [NSNumber numberWithDouble:seedMs], @"min_ms",
+                      [NSNumber numberWithDouble:seedMs], @"max_ms",
+                      [NSNumber numberWithUnsignedInteger:seeded], @"items",
+                      @"rows", @"unit",
+                      [NSNumber numberWithDouble:seedMs > 0 ? seeded / (seedMs / 1000.0) : 0], @"items_per_sec",
+                      nil] forKey:@"storage.seed"];
+
+    result = runCase(@"storage.page.walk", @"rows", iterations, ^NSUInteger {
+        NSUInteger rows = 0;
+        NSString *token = nil;
+        do {
+            [storage getVocabularyPageWithQuery:nil status:nil afterToken:token limit:100 delegate:results];
+            rows += results->_rows;
+            token = [[results->_token retain] autorelease];
+        } while (token);
+        return rows;
+    });
+    if (result) [cases setObject:result forKey:@"storage.page.walk"];
+    result = runCase(@"storage.page.search", @"queries", iterations, ^NSUInteger {
+        [storage getVocabularyPageWithQuery:@"ab" status:nil afterToken:nil limit:100 delegate:results];
+        return 1;
+    });
+    if (result) [cases setObject:result forKey:@"storage.page.search"];
+    result = runCase(@"storage.count", @"queries", iterations, ^NSUInteger {
+        [storage getVocabularyCountWithQuery:nil status:@"learning" delegate:results];
+        return 1;
+    });
+    if (result) [cases setObject:result forKey:@"storage.count"];
+    result = runCase(@"storage.due", @"queries", iterations, ^NSUInteger {
+        [storage getVocabularyDueForReviewWithLimit:20 delegate:results];
+        return 1;
+    });
+    if (result) [cases setObject:result forKey:@"storage.due"];
+    result = runCase(@"storage.reschedule", @"rows", iterations, ^NSUInteger {
+        [storage rescheduleVocabularyWithQualities:^NSInteger(NSString *itemId) {
+            return (NSInteger)([itemId hash] % 6);
+        } reviewedAt:nil delegate:results];
+        return results->_success ? results->_rows : 0;
+    });
+    if (result) [cases setObject:result forKey:@"storage.reschedule"];
+
+    /* Export */
+    XLExportService *exporter = [[[XLExportService alloc] init] autorelease];
+    NSArray *formats = [NSArray arrayWithObjects:@"csv", @"json", @"anki", nil];
+    for (NSUInteger f = 0; f < [formats count]; f++) {
+        NSString *format = [formats objectAtIndex:f];
+        NSString *exportPath = [workdir stringByAppendingPathComponent:[@"export." stringByAppendingString:format]];
+        NSString *name = [@"export." stringByAppendingString:format];
+        result = runCase(name, @"rows", iterations, ^NSUInteger {
+            __block NSUInteger written = 0;
+            __block BOOL ok = NO;
+            [exporter exportVocabularyFromCursor:[storage vocabularyCursorWithQuery:nil status:nil]
+                                          format:(XLExportFormat)f
+                                      toFilePath:exportPath
+                                        progress:^(NSUInteger rows, NSUInteger total, BOOL *stop) {
+                written = rows;
+            } withCompletion:^(BOOL success, NSError *exportError) {
+                ok = success;
+            }];
+            return ok ? MAX(written, (NSUInteger)1) : 0;
+        });
+        if (result) [cases setObject:result forKey:name];
+    }
+
+    NSDictionary *report = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [NSNumber numberWithInt:1], @"schema",
+                            [NSDictionary dictionaryWithObjectsAndKeys:
+                             [NSNumber numberWithUnsignedInteger:config.chapters], @"chapters",
+                             [NSNumber numberWithUnsignedInteger:config.wordsPerChapter], @"words_per_chapter",
+                             [NSNumber numberWithUnsignedInteger:config.vocabulary], @"vocabulary",
+                             [XLCorpusGenerator nameForScript:script], @"script",
+                             [NSNumber numberWithUnsignedInteger:config.items], @"items",
+                             [NSNumber numberWithUnsignedInteger:config.cards], @"cards",
+                             [NSNumber numberWithUnsignedInteger:config.iterations], @"iterations",
+                             [NSNumber numberWithUnsignedLongLong:config.seed], @"seed",
+                             nil], @"config",
+                            cases, @"results",
+                            nil];
+    NSData *json = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:&error];
+    if (!json) {
+        fprintf(stderr, "cannot encode results: %s\n", [[error localizedDescription] UTF8String]);
+        [pool drain];
+        return 3;
+    }
+    if (outputPath) {
+        if (![json writeToFile:outputPath atomically:YES]) {
+            fprintf(stderr, "cannot write %s\n", [outputPath UTF8String]);
+            [pool drain];
+            return 3;
+        }
+    } else {
+        fwrite([json bytes], 1, [json length], stdout);
+        fputc('\n', stdout);
+    }
+
+    int status = 0;
+    if (baselinePath) {
+        NSData *baselineData = [NSData dataWithContentsOfFile:baselinePath];
+        id baseline = baselineData ? [NSJSONSerialization JSONObjectWithData:baselineData options:0 error:NULL] : nil;
+        if (![baseline isKindOfClass:[NSDictionary class]]) {
+            fprintf(stderr, "cannot read baseline %s\n", [baselinePath UTF8String]);
+            [pool drain];
+            return 3;
+        }
+        NSUInteger regressions = compareWithBaseline(cases, baseline, config.threshold);
+        if (regressions > 0) {
+            fprintf(stderr, "%lu case(s) slower than baseline by more than %.0f%%\n", (unsigned long)regressions, config.threshold * 100.0);
+            status = 1;
+        }
+    }
+
+    [pool drain];
+    return status;
+}
@@ -0,0 +1,178 @@
+//
+//  translation_bench.m
+//  Xenolexia Benchmarks
+//
+//  Drives XLTranslationEngine processContent: against local LibreTranslate stand-ins
+//  and reports throughput, latency percentiles and word-cache hit rate. Fully offline.
+//
+//  Usage: XenolexiaTranslationBench [--endpoints N] [--chapters N] [--words N] [--vocab N]
+//         [--latency MS] [--jitter MS] [--error-rate F] [--rps N] [--workers N] [--seed N]
+//
+
+#import <Foundation/Foundation.h>
+#import "XLLibreTranslateStub.h"
+#import "XLTranslationEngine.h"
+#import "XLTranslationService.h"
+#import <stdio.h>
+#import <stdlib.h>
+
+typedef struct {
+    NSUInteger endpoints;
+    NSUInteger chapters;
+    NSUInteger wordsPerChapter;
+    NSUInteger vocabulary;
+    NSUInteger latencyMs;
+    NSUInteger jitterMs;
+    double errorRate;
+    NSUInteger rps;
+    NSUInteger workers;
+    unsigned int seed;
+} XLBenchConfig;
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--endpoints N] [--chapters N] [--words N] [--vocab N] [--latency MS] [--jitter MS]\n"
+                    "          [--error-rate F] [--rps N] [--workers N] [--seed N]\n", argv0);
+}
+
+static BOOL parseArgs(int argc, const char *argv[], XLBenchConfig *config) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) return NO;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--endpoints") == 0) config->endpoints = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--chapters") == 0) config->chapters = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--words") == 0) config->wordsPerChapter = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--vocab") == 0) config->vocabulary = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--latency") == 0) config->latencyMs = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--jitter") == 0) config->jitterMs = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--error-rate") == 0) config->errorRate = strtod(value, NULL);
+        else if (strcmp(arg, "--rps") == 0) config->rps = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--workers") == 0) config->workers = (NSUInteger)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0) config->seed = (unsigned int)strtoul(value, NULL, 10);
+        else return NO;
+    }
+    return config->endpoints > 0 && config->chapters > 0 && config->wordsPerChapter > 0 && config->vocabulary > 0;
+}
+
+/// Letters-only token for vocabulary index i, at least two characters so the tokenizer keeps it
+static NSString *vocabularyWord(NSUInteger i) {
+    char buf[16];
+    NSUInteger n = 0;
+    do {
+        buf[n++] = (char)('a' + i % 26);
+        i /= 26;
+    } while (i > 0 && n < sizeof(buf) - 2);
+    if (n < 2) buf[n++] = 'a';
+    buf[n] = '\0';
+    return [NSString stringWithUTF8String:buf];
+}
+
+/// Zipf-ish draw (rank ~ 1/u) so common words repeat across chapters the way real prose does
+static NSString *chapterText(NSUInteger words, NSUInteger vocabulary, unsigned int *seed) {
+    NSMutableString *text = [NSMutableString stringWithCapacity:words * 6];
+    for (NSUInteger w = 0; w < words; w++) {
+        double u = ((double)rand_r(seed) + 1.0) / ((double)RAND_MAX + 1.0);
+        NSUInteger rank = (NSUInteger)(1.0 / u) - 1;
+        [text appendString:vocabularyWord(rank % vocabulary)];
+        [text appendString:(w % 12 == 11) ? @". " : @" "];
+    }
+    return text;
+}
+
+static double percentile(NSArray *sortedSeconds, double p) {
+    if ([sortedSeconds count] == 0) return 0;
+    NSUInteger idx = (NSUInteger)ceil(p * [sortedSeconds count]);
+    if (idx > 0) idx--;
+    return [[sortedSeconds objectAtIndex:idx] doubleValue] * 1000.0;
+}
+
+int main(int argc, const char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    XLBenchConfig config = { 2, 20, 2000, 3000, 5, 5, 0.0, 0, 8, 1 };
+    if (!parseArgs(argc, argv, &config)) {
+        usage(argv[0]);
+        [pool drain];
+        return 2;
+    }
+
+    NSMutableArray *stubs = [NSMutableArray array];
+    NSMutableArray *urls = [NSMutableArray array];
+    for (NSUInteger i = 0; i < config.endpoints; i++) {
+        XLLibreTranslateStub *stub = [[[XLLibreTranslateStub alloc] init] autorelease];
+        stub.latencyMs = config.latencyMs;
+        stub.jitterMs = config.jitterMs;
+        stub.errorRate = config.errorRate;
+        stub.maxRequestsPerSecond = config.rps;
+        stub.maxConcurrent = config.workers;
+        stub.seed = config.seed + (unsigned int)i;
+        NSError *error = nil;
+        if (![stub start:&error]) {
+            fprintf(stderr, "stub server failed to start: %s\n", [[error description] UTF8String]);
+            [pool drain];
+            return 1;
+        }
+        [stubs addObject:stub];
+        [urls addObject:[stub baseURL]];
+    }
+
+    XLTranslationService *service = [XLTranslationService sharedService];
+    service.translationBackend = XLTranslationBackendLibreTranslate;
+    service.libretranslateBaseURLs = urls;
+
+    XLTranslationOptions *options = [XLTranslationOptions optionsWithLanguagePair:[XLLanguagePair pairWithSource:XLLanguageEnglish target:XLLanguageFrench]
+                                                                 proficiencyLevel:XLProficiencyLevelBeginner
+                                                                      wordDensity:1.0];
+    XLTranslationEngine *engine = [[[XLTranslationEngine alloc] initWithOptions:options] autorelease];
+
+    unsigned int seed = config.seed;
+    NSMutableArray *chapterTimes = [NSMutableArray arrayWithCapacity:config.chapters];
+    NSUInteger replaced = 0;
+    NSTimeInterval benchStart = [NSDate timeIntervalSinceReferenceDate];
+    for (NSUInteger c = 0; c < config.chapters; c++) {
+        NSAutoreleasePool *chapterPool = [[NSAutoreleasePool alloc] init];
+        NSString *text = chapterText(config.wordsPerChapter, config.vocabulary, &seed);
+        dispatch_semaphore_t done = dispatch_semaphore_create(0);
+        __block NSUInteger chapterReplaced = 0;
+        NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        [engine processContent:text withCompletion:^(NSString *processedContent, NSArray *foreignWords, NSError *error) {
+            chapterReplaced = [foreignWords count];
+            dispatch_semaphore_signal(done);
+        }];
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        dispatch_release(done);
+        [chapterTimes addObject:@([NSDate timeIntervalSinceReferenceDate] - start)];
+        replaced += chapterReplaced;
+        [chapterPool drain];
+    }
+    NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - benchStart;
+
+    NSUInteger requests = 0, errors = 0, throttled = 0;
+    NSMutableArray *requestLatencies = [NSMutableArray array];
+    for (XLLibreTranslateStub *stub in stubs) {
+        requests += [stub requestCount];
+        errors += [stub errorCount];
+        throttled += [stub throttledCount];
+        [requestLatencies addObjectsFromArray:[stub latencies]];
+        [stub stop];
+    }
+    [requestLatencies sortUsingSelector:@selector(compare:)];
+    [chapterTimes sortUsingSelector:@selector(compare:)];
+    NSUInteger lookups = engine.cacheHits + engine.cacheMisses;
+    NSUInteger totalWords = config.chapters * config.wordsPerChapter;
+
+    printf("endpoints=%lu chapters=%lu words/chapter=%lu vocab=%lu latency=%lums jitter=%lums error-rate=%.3f rps=%lu workers=%lu\n",
+           (unsigned long)config.endpoints, (unsigned long)config.chapters, (unsigned long)config.wordsPerChapter,
+           (unsigned long)config.vocabulary, (unsigned long)config.latencyMs, (unsigned long)config.jitterMs,
+           config.errorRate, (unsigned long)config.rps, (unsigned long)config.workers);
+    printf("elapsed          %.3f s\n", elapsed);
+    printf("words/sec        %.1f (%lu words, %lu replaced)\n", elapsed > 0 ? totalWords / elapsed : 0, (unsigned long)totalWords, (unsigned long)replaced);
+    printf("requests/sec     %.1f (%lu requests, %lu errors, %lu throttled)\n", elapsed > 0 ? requests / elapsed : 0,
+           (unsigned long)requests, (unsigned long)errors, (unsigned long)throttled);
+    printf("request latency  p50 %.2f ms  p99 %.2f ms (server-side)\n", percentile(requestLatencies, 0.50), percentile(requestLatencies, 0.99));
+    printf("chapter latency  p50 %.2f ms  p99 %.2f ms\n", percentile(chapterTimes, 0.50), percentile(chapterTimes, 0.99));
+    printf("cache hit rate   %.1f%% (%lu of %lu lookups)\n", lookups > 0 ? 100.0 * engine.cacheHits / lookups : 0,
+           (unsigned long)engine.cacheHits, (unsigned long)lookups);
+
+    [pool drain];
+    return 0;
+}
@@ -0,0 +1,563 @@
+//
+//  xenolexia_cli.m
+//  Xenolexia CLI
+//
+//  Headless batch pipeline for build servers: import book files into a library database, process
+//  every chapter for one language pair / proficiency / density into the processed-chapter store,
+//  and export vocabulary. Foundation only; no window server needed.
+//
+//  Usage: XenolexiaCLI [--db PATH] [--import PATH]... [--process] [--source CODE] [--target CODE]
+//         [--level LEVEL] [--density F] [--jobs N] [--libretranslate URL[,URL...]]
+//         [--collect-vocabulary] [--export FILE] [--format csv|json|anki] [--metrics FILE] [--quiet]
+//
+//  Exit status: 0 all done, 1 some books failed, 2 usage error, 3 database or export failure.
+//
+
+#import <Foundation/Foundation.h>
+#import "Book.h"
+#import "Reader.h"
+#import "Vocabulary.h"
+#import "SearchKey.h"
+#import "XLBookParserService.h"
+#import "XLTranslationEngine.h"
+#import "XLTranslationService.h"
+#import "XLStorageService.h"
+#import "XLExportService.h"
+#import "XLMetrics.h"
+#import "XLTrace.h"
+#import <stdio.h>
+#import <stdlib.h>
+
+enum {
+    kExitOK = 0,
+    kExitPartialFailure = 1,
+    kExitUsage = 2,
+    kExitFatal = 3
+};
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--db PATH] [--import PATH]... [--process] [--source CODE] [--target CODE]\n"
+                    "          [--level beginner|intermediate|advanced] [--density 0..1] [--jobs N]\n"
+                    "          [--libretranslate URL[,URL...]] [--collect-vocabulary] [--export FILE]\n"
+                    "          [--format csv|json|anki] [--metrics FILE(.json|.txt)] [--quiet]\n", argv0);
+}
+
+static NSString *const kBookFileExtensions = @"epub fb2 mobi txt";
+
+static XLBookFormat formatForPath(NSString *path) {
+    NSString *extension = [[path pathExtension] lowercaseString];
+    if ([extension isEqualToString:@"epub"]) return XLBookFormatEpub;
+    if ([extension isEqualToString:@"fb2"]) return XLBookFormatFb2;
+    if ([extension isEqualToString:@"mobi"]) return XLBookFormatMobi;
+    return XLBookFormatTxt;
+}
+
+/// Book files under each path (a path may also name a single file), sorted so runs are reproducible
+static NSArray *collectBookFiles(NSArray *paths) {
+    NSSet *extensions = [NSSet setWithArray:[kBookFileExtensions componentsSeparatedByString:@" "]];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSMutableOrderedSet *files = [NSMutableOrderedSet orderedSet];
+    for (NSString *path in paths) {
+        NSString *root = [path stringByStandardizingPath];
+        BOOL isDirectory = NO;
+        if (![fm fileExistsAtPath:root isDirectory:&isDirectory]) {
+            fprintf(stderr, "warning: %s does not exist\n", [root UTF8String]);
+            continue;
+        }
+        if (!isDirectory) {
+            [files addObject:root];
+            continue;
+        }
+        NSMutableArray *found = [NSMutableArray array];
+        NSDirectoryEnumerator *e = [fm enumeratorAtPath:root];
+        for (NSString *relative in e) {
+            if ([extensions containsObject:[[relative pathExtension] lowercaseString]]) {
+                [found addObject:[root stringByAppendingPathComponent:relative]];
+            }
+        }
+        [found sortUsingSelector:@selector(compare:)];
+        [files addObjectsFromArray:found];
+    }
+    return [files array];
+}
+
+/// Rough word count for chapters whose parser left wordCount at 0
+static NSUInteger countWords(NSString *text) {
+    NSUInteger length = [text length], words = 0;
+    BOOL inWord = NO;
+    unichar buffer[512];
+    NSCharacterSet *letters = [NSCharacterSet alphanumericCharacterSet];
+    for (NSUInteger offset = 0; offset < length; offset += 512) {
+        NSUInteger n = MIN((NSUInteger)512, length - offset);
+        [text getCharacters:buffer range:NSMakeRange(offset, n)];
+        for (NSUInteger i = 0; i < n; i++) {
+            BOOL letter = [letters characterIsMember:buffer[i]];
+            if (letter && !inWord) words++;
+            inWord = letter;
+        }
+    }
+    return words;
+}
+
+/// Parser and engine report through completion blocks (possibly on other threads); workers wait on them
+static XLParsedBook *parseBook(NSString *path, NSError **error) {
+    __block XLParsedBook *result = nil;
+    __block NSError *failure = nil;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    [[XLBookParserService sharedService] parseBookAtPath:path withCompletion:^(XLParsedBook *parsedBook, NSError *parseError) {
+        result = [parsedBook retain];
+        failure = [parseError retain];
+        dispatch_semaphore_signal(done);
+    }];
+    dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+    dispatch_release(done);
+    if (error) *error = [failure autorelease];
+    else [failure release];
+    return [result autorelease];
+}
+
+static XLProcessedChapter *processChapter(XLTranslationEngine *engine, XLChapter *chapter, NSError **error) {
+    __block XLProcessedChapter *result = nil;
+    __block NSError *failure = nil;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    [engine processChapter:chapter withCompletion:^(XLProcessedChapter *processedChapter, NSError *processError) {
+        result = [processedChapter retain];
+        failure = [processError retain];
+        dispatch_semaphore_signal(done);
+    }];
+    dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+    dispatch_release(done);
+    if (error) *error = [failure autorelease];
+    else [failure release];
+    return [result autorelease];
+}
+
+/// Result of one storage call. XLStorageService calls back on the calling thread before returning, so each
+/// call gets its own receiver and workers never share callback state.
+@interface XLCLIStorageResult : NSObject <XLStorageServiceDelegate> {
+@public
+    BOOL _success;
+    NSError *_error;
+    NSArray *_books;
+}
+@end
+
+@implementation XLCLIStorageResult
+
+- (void)dealloc {
+    [_error release];
+    [_books release];
+    [super dealloc];
+}
+
+- (void)recordSuccess:(BOOL)success error:(NSError *)error {
+    _success = success;
+    [_error release];
+    _error = [error retain];
+}
+
+- (void)storageService:(id)service didInitializeDatabaseWithSuccess:(BOOL)success error:(NSError *)error {
+    [self recordSuccess:success error:error];
+}
+
+- (void)storageService:(id)service didSaveBook:(XLBook *)book withSuccess:(BOOL)success error:(NSError *)error {
+    [self recordSuccess:success error:error];
+}
+
+- (void)storageService:(id)service didGetAllBooks:(NSArray *)books withError:(NSError *)error {
+    [self recordSuccess:(error == nil) error:error];
+    [_books release];
+    _books = [books retain];
+}
+
+- (void)storageService:(id)service didSaveProcessedChaptersForBookId:(NSString *)bookId withSuccess:(BOOL)success error:(NSError *)error {
+    [self recordSuccess:success error:error];
+}
+
+- (void)storageService:(id)service didSaveVocabularyItem:(XLVocabularyItem *)item withSuccess:(BOOL)success error:(NSError *)error {
+    [self recordSuccess:success error:error];
+}
+
+@end
+
+/// Shared state of one run. Workers are plain threads (they block on parser and engine callbacks, which
+/// must not starve the dispatch pool). XLStorageService serializes their calls itself.
+@interface XLCLIRun : NSObject {
+@public
+    XLStorageService *_storage;
+    XLTranslationEngine *_engine;
+    XLTranslationOptions *_options;
+    BOOL _process;
+    BOOL _collectVocabulary;
+    BOOL _quiet;
+    NSArray *_work;                     // NSDictionary: @"path", optional @"book" (already in the library)
+    NSUInteger _next;
+    NSLock *_lock;                      // guards _next, the counters and _vocabularyKeys
+    dispatch_group_t _workers;
+    NSMutableSet *_vocabularyKeys;      // folded source + target already in the vocabulary table
+    NSUInteger _imported;
+    NSUInteger _failed;
+    NSUInteger _booksProcessed;
+    NSUInteger _chapters;
+    NSUInteger _words;
+    NSUInteger _replaced;
+    NSUInteger _vocabularySaved;
+}
+- (void)workerMain:(id)unused;
+- (void)runItem:(NSDictionary *)item position:(NSUInteger)position;
+- (void)collectVocabularyFromChapters:(NSArray *)chapters book:(XLBook *)book;
+@end
+
+@implementation XLCLIRun
+
+- (void)dealloc {
+    [_storage release];
+    [_engine release];
+    [_options release];
+    [_work release];
+    [_lock release];
+    [_vocabularyKeys release];
+    [super dealloc];
+}
+
+- (void)workerMain:(id)unused {
+    for (;;) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSDictionary *item = nil;
+        NSUInteger position = 0;
+        [_lock lock];
+        if (_next < [_work count]) {
+            item = [_work objectAtIndex:_next];
+            position = ++_next;
+        }
+        [_lock unlock];
+        if (item) {
+            [self runItem:item position:position];
+        }
+        [pool drain];
+        if (!item) break;
+    }
+    dispatch_group_leave(_workers);
+}
+
+- (void)fail:(NSString *)path position:(NSUInteger)position error:(NSError *)error {
+    fprintf(stderr, "[%lu/%lu] FAILED %s: %s\n", (unsigned long)position, (unsigned long)[_work count],
+            [path UTF8String], [[error localizedDescription] ?: @"unknown error" UTF8String]);
+    [_lock lock];
+    _failed++;
+    [_lock unlock];
+}
+
+/// Parse once, then import (for new files) and process every chapter from the same parse
+- (void)runItem:(NSDictionary *)item position:(NSUInteger)position {
+    NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+    NSString *path = [item objectForKey:@"path"];
+    XLBook *book = [item objectForKey:@"book"];
+    NSError *error = nil;
+    XLParsedBook *parsed = parseBook(path, &error);
+    if (!parsed) {
+        [self fail:path position:position error:error];
+        return;
+    }
+
+    if (!book) {
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL];
+        book = [[[XLBook alloc] initWithId:[[NSUUID UUID] UUIDString]
+                                     title:parsed.metadata.title ?: [[path lastPathComponent] stringByDeletingPathExtension]
+                                    author:parsed.metadata.author ?: @"Unknown Author"] autorelease];
+        book.filePath = path;
+        book.format = formatForPath(path);
+        book.fileSize = [[attributes objectForKey:NSFileSize] longLongValue];
+        book.totalChapters = [parsed.chapters count];
+        book.languagePair = _options.languagePair;
+        book.proficiencyLevel = _options.proficiencyLevel;
+        book.wordDensity = _options.wordDensity;
+        XLCLIStorageResult *saved = [[[XLCLIStorageResult alloc] init] autorelease];
+        [_storage saveBook:book delegate:saved];
+        if (!saved->_success) {
+            [self fail:path position:position error:saved->_error];
+            return;
+        }
+        [_lock lock];
+        _imported++;
+        [_lock unlock];
+    }
+
+    if (!_process) {
+        if (!_quiet) {
+            fprintf(stderr, "[%lu/%lu] imported %s\n", (unsigned long)position, (unsigned long)[_work count], [book.title UTF8String]);
+        }
+        return;
+    }
+
+    NSMutableArray *processed = [NSMutableArray arrayWithCapacity:[parsed.chapters count]];
+    NSUInteger words = 0, replaced = 0;
+    for (XLChapter *chapter in parsed.chapters) {
+        NSAutoreleasePool *chapterPool = [[NSAutoreleasePool alloc] init];
+        XLProcessedChapter *result = processChapter(_engine, chapter, &error);
+        if (result) {
+            [processed addObject:result];
+            words += chapter.wordCount > 0 ? (NSUInteger)chapter.wordCount : countWords(chapter.content);
+            replaced += [result.foreignWords count];
+        } else {
+            [error retain];
+        }
+        [chapterPool drain];
+        if (!result) {
+            [self fail:path position:position error:[error autorelease]];
+            return;
+        }
+    }
+    XLCLIStorageResult *saved = [[[XLCLIStorageResult alloc] init] autorelease];
+    [_storage saveProcessedChapters:processed forBookId:book.bookId languagePair:_options.languagePair
+                        proficiency:_options.proficiencyLevel density:_options.wordDensity delegate:saved];
+    if (!saved->_success) {
+        [self fail:path position:position error:saved->_error];
+        return;
+    }
+    if (_collectVocabulary) {
+        [self collectVocabularyFromChapters:processed book:book];
+    }
+    [_lock lock];
+    _booksProcessed++;
+    _chapters += [processed count];
+    _words += words;
+    _replaced += replaced;
+    [_lock unlock];
+    if (!_quiet) {
+        fprintf(stderr, "[%lu/%lu] %s: %lu chapters, %lu words, %lu replaced, %.2f s\n",
+                (unsigned long)position, (unsigned long)[_work count], [book.title UTF8String],
+                (unsigned long)[processed count], (unsigned long)words, (unsigned long)replaced,
+                [NSDate timeIntervalSinceReferenceDate] - start);
+    }
+}
+
+/// Save each translated word the library has not seen yet as a new vocabulary item of this book
+- (void)collectVocabularyFromChapters:(NSArray *)chapters book:(XLBook *)book {
+    NSMutableArray *fresh = [NSMutableArray array];
+    [_lock lock];
+    for (XLProcessedChapter *chapter in chapters) {
+        for (XLForeignWordData *word in chapter.foreignWords) {
+            if ([word.originalWord length] == 0 || [word.foreignWord length] == 0) continue;
+            XLVocabularyItem *item = [XLVocabularyItem itemWithSourceWord:word.originalWord
+                                                               targetWord:word.foreignWord
+                                                           sourceLanguage:_options.languagePair.sourceLanguage
+                                                           targetLanguage:_options.languagePair.targetLanguage];
+            if ([_vocabularyKeys containsObject:item.searchKey]) continue;
+            [_vocabularyKeys addObject:item.searchKey];
+            item.bookId = book.bookId;
+            item.bookTitle = book.title;
+            [fresh addObject:item];
+        }
+    }
+    [_lock unlock];
+    NSUInteger saved = 0;
+    XLCLIStorageResult *result = [[XLCLIStorageResult alloc] init];
+    for (XLVocabularyItem *item in fresh) {
+        [_storage saveVocabularyItem:item delegate:result];
+        if (result->_success) saved++;
+    }
+    [result release];
+    [_lock lock];
+    _vocabularySaved += saved;
+    [_lock unlock];
+}
+
+@end
+
+/// Wait for the workers while letting the main run loop deliver XLStorageService change posts
+static void waitForWorkers(dispatch_group_t group) {
+    while (dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 50 * NSEC_PER_MSEC)) != 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    XLTraceStartFromEnvironment();
+    NSString *databasePath = nil;
+    NSMutableArray *importPaths = [NSMutableArray array];
+    NSString *exportPath = nil;
+    NSString *metricsPath = nil;
+    NSString *sourceCode = @"en", *targetCode = @"fr", *levelCode = @"beginner";
+    double density = 0.3;
+    NSUInteger jobs = [[NSProcessInfo processInfo] activeProcessorCount];
+    NSArray *endpoints = nil;
+    XLExportFormat exportFormat = XLExportFormatCSV;
+    BOOL process = NO, collectVocabulary = NO, quiet = NO;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--process") == 0) { process = YES; continue; }
+        if (strcmp(arg, "--collect-vocabulary") == 0) { collectVocabulary = YES; continue; }
+        if (strcmp(arg, "--quiet") == 0) { quiet = YES; continue; }
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            [pool drain];
+            return kExitOK;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            [pool drain];
+            return kExitUsage;
+        }
+        NSString *value = [NSString stringWithUTF8String:argv[++i]];
+        if (strcmp(arg, "--db") == 0) databasePath = [value stringByStandardizingPath];
+        else if (strcmp(arg, "--import") == 0) [importPaths addObject:value];
+        else if (strcmp(arg, "--export") == 0) exportPath = [value stringByStandardizingPath];
+        else if (strcmp(arg, "--metrics") == 0) metricsPath = [value stringByStandardizingPath];
+        else if (strcmp(arg, "--source") == 0) sourceCode = value;
+        else if (strcmp(arg, "--target") == 0) targetCode = value;
+        else if (strcmp(arg, "--level") == 0) levelCode = value;
+        else if (strcmp(arg, "--density") == 0) density = [value doubleValue];
+        else if (strcmp(arg, "--jobs") == 0) jobs = (NSUInteger)[value integerValue];
+        else if (strcmp(arg, "--libretranslate") == 0) endpoints = [value componentsSeparatedByString:@","];
+        else if (strcmp(arg, "--format") == 0) {
+            if ([value isEqualToString:@"csv"]) exportFormat = XLExportFormatCSV;
+            else if ([value isEqualToString:@"json"]) exportFormat = XLExportFormatJSON;
+            else if ([value isEqualToString:@"anki"]) exportFormat = XLExportFormatAnki;
+            else {
+                usage(argv[0]);
+                [pool drain];
+                return kExitUsage;
+            }
+        } else {
+            usage(argv[0]);
+            [pool drain];
+            return kExitUsage;
+        }
+    }
+    if (([importPaths count] == 0 && !process && !exportPath) || jobs == 0 || density < 0 || density > 1) {
+        usage(argv[0]);
+        [pool drain];
+        return kExitUsage;
+    }
+
+    XLCLIRun *run = [[[XLCLIRun alloc] init] autorelease];
+    run->_storage = databasePath ? [[XLStorageService alloc] initWithDatabasePath:databasePath] : [[XLStorageService sharedService] retain];
+    run->_options = [[XLTranslationOptions optionsWithLanguagePair:[XLLanguagePair pairWithSource:[XLLanguageInfo languageForCodeString:sourceCode]
+                                                                                           target:[XLLanguageInfo languageForCodeString:targetCode]]
+                                                  proficiencyLevel:[XLLanguageInfo proficiencyForCodeString:levelCode]
+                                                       wordDensity:density] retain];
+    run->_process = process;
+    run->_collectVocabulary = collectVocabulary && process;
+    run->_quiet = quiet;
+    run->_lock = [[NSLock alloc] init];
+    run->_vocabularyKeys = [[NSMutableSet alloc] init];
+
+    XLCLIStorageResult *opened = [[[XLCLIStorageResult alloc] init] autorelease];
+    [run->_storage initializeDatabaseWithDelegate:opened];
+    if (!opened->_success) {
+        fprintf(stderr, "cannot open database: %s\n", [[opened->_error localizedDescription] ?: @"unknown error" UTF8String]);
+        [pool drain];
+        return kExitFatal;
+    }
+
+    /* The legacy Microsoft backend needs a desktop session; headless runs always use LibreTranslate */
+    XLTranslationService *translation = [XLTranslationService sharedService];
+    translation.translationBackend = XLTranslationBackendLibreTranslate;
+    if ([endpoints count] > 0) {
+        translation.libretranslateBaseURLs = endpoints;
+    }
+    run->_engine = [[XLTranslationEngine alloc] initWithOptions:run->_options];
+
+    /* Work list: new files first, then (when processing) books already in the library */
+    XLCLIStorageResult *listed = [[[XLCLIStorageResult alloc] init] autorelease];
+    [run->_storage getAllBooksWithDelegate:listed];
+    NSArray *library = listed->_books;
+    if (!listed->_success) {
+        fprintf(stderr, "cannot read library: %s\n", [[listed->_error localizedDescription] ?: @"unknown error" UTF8String]);
+        [pool drain];
+        return kExitFatal;
+    }
+    NSMutableSet *knownPaths = [NSMutableSet setWithCapacity:[library count]];
+    for (XLBook *book in library) {
+        if (book.filePath) [knownPaths addObject:[book.filePath stringByStandardizingPath]];
+    }
+    NSArray *files = collectBookFiles(importPaths);
+    NSUInteger alreadyImported = 0;
+    NSMutableArray *work = [NSMutableArray arrayWithCapacity:[files count] + [library count]];
+    for (NSString *file in files) {
+        if ([knownPaths containsObject:file]) {
+            alreadyImported++;
+            continue;
+        }
+        [work addObject:[NSDictionary dictionaryWithObject:file forKey:@"path"]];
+    }
+    if (process) {
+        for (XLBook *book in library) {
+            if (!book.filePath) continue;
+            [work addObject:[NSDictionary dictionaryWithObjectsAndKeys:book.filePath, @"path", book, @"book", nil]];
+        }
+    }
+    run->_work = [work copy];
+
+    if (run->_collectVocabulary) {
+        XLVocabularyCursor *cursor = [run->_storage vocabularyCursorWithQuery:nil status:nil];
+        XLVocabularyItem *item;
+        while ((item = [cursor nextObject])) {
+            [run->_vocabularyKeys addObject:item.searchKey];
+        }
+        [cursor close];
+    }
+
+    NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+    NSUInteger workers = MIN(jobs, MAX((NSUInteger)1, [work count]));
+    run->_workers = dispatch_group_create();
+    for (NSUInteger w = 0; w < workers && [work count] > 0; w++) {
+        dispatch_group_enter(run->_workers);
+        [NSThread detachNewThreadSelector:@selector(workerMain:) toTarget:run withObject:nil];
+    }
+    waitForWorkers(run->_workers);
+    dispatch_release(run->_workers);
+    NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - start;
+
+    int status = run->_failed > 0 ? kExitPartialFailure : kExitOK;
+    __block NSUInteger exported = 0;
+    if (exportPath) {
+        XLVocabularyCursor *cursor = [run->_storage vocabularyCursorWithQuery:nil status:nil];
+        XLExportService *exporter = [[[XLExportService alloc] init] autorelease];
+        __block BOOL exportOK = NO;
+        __block NSString *exportError = nil;
+        [exporter exportVocabularyFromCursor:cursor format:exportFormat toFilePath:exportPath progress:^(NSUInteger written, NSUInteger total, BOOL *stop) {
+            exported = written;
+        } withCompletion:^(BOOL success, NSError *error) {
+            exportOK = success;
+            exportError = [[error localizedDescription] copy];
+        }];
+        if (!exportOK) {
+            fprintf(stderr, "export failed: %s\n", [exportError ?: @"unknown error" UTF8String]);
+            status = kExitFatal;
+        }
+        [exportError release];
+    }
+
+    NSUInteger lookups = run->_engine.cacheHits + run->_engine.cacheMisses;
+    printf("files              %lu found, %lu imported, %lu already in library, %lu failed\n",
+           (unsigned long)[files count], (unsigned long)run->_imported, (unsigned long)alreadyImported, (unsigned long)run->_failed);
+    if (process) {
+        printf("processed          %lu books, %lu chapters, %lu words (%lu replaced)\n",
+               (unsigned long)run->_booksProcessed, (unsigned long)run->_chapters, (unsigned long)run->_words, (unsigned long)run->_replaced);
+        printf("throughput         %.2f chapters/s, %.1f words/s over %.2f s with %lu jobs\n",
+               elapsed > 0 ? run->_chapters / elapsed : 0, elapsed > 0 ? run->_words / elapsed : 0, elapsed, (unsigned long)workers);
+        printf("translation cache  %.1f%% hit rate (%lu of %lu lookups)\n", lookups > 0 ? 100.0 * run->_engine.cacheHits / lookups : 0,
+               (unsigned long)run->_engine.cacheHits, (unsigned long)lookups);
+    } else {
+        printf("elapsed            %.2f s with %lu jobs\n", elapsed, (unsigned long)workers);
+    }
+    if (run->_collectVocabulary) {
+        printf("vocabulary         %lu new items\n", (unsigned long)run->_vocabularySaved);
+    }
+    if (exportPath) {
+        printf("exported           %lu items to %s\n", (unsigned long)exported, [exportPath UTF8String]);
+    }
+    if (metricsPath) {
+        NSError *metricsError = nil;
+        if (!XLMetricsWriteReport(metricsPath, &metricsError)) {
+            fprintf(stderr, "cannot write metrics: %s\n", [[metricsError localizedDescription] ?: @"unknown error" UTF8String]);
+        }
+    }
+
+    [pool drain];
+    return status;
+}
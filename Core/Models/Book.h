@@ -7,6 +7,8 @@
 #import <Foundation/Foundation.h>
 #import "Language.h"
 
+@class XLChapterText;
+
 
 /// Supported book formats
 typedef NS_ENUM(NSInteger, XLBookFormat) {
@@ -46,6 +48,9 @@ typedef NS_ENUM(NSInteger, XLBookFormat) {
 @property (nonatomic, copy) NSString *sourceUrl;
 @property (nonatomic) BOOL isDownloaded;
 
+/// Folded title and author (see XLFoldedSearchKeyForFields), computed on first use and reset when either changes
+@property (nonatomic, readonly) NSString *searchKey;
+
 + (instancetype)bookWithId:(NSString *)bookId
                      title:(NSString *)title
                     author:(NSString *)author;
@@ -77,7 +82,10 @@ typedef NS_ENUM(NSInteger, XLBookFormat) {
 @property (nonatomic, copy) NSString *chapterId;
 @property (nonatomic, copy) NSString *title;
 @property (nonatomic) NSInteger index;
-@property (nonatomic, copy) NSString *content; // HTML or plain text
+/// HTML or plain text, decoded from contentText on each read; setting it stores a UTF-8 copy
+@property (nonatomic, copy) NSString *content;
+/// The stored text (compact UTF-8, possibly mapped from the book's extracted-text file)
+@property (nonatomic, retain) XLChapterText *contentText;
 @property (nonatomic) NSInteger wordCount;
 @property (nonatomic, copy) NSString *href; // Path to the chapter file in EPUB
 
@@ -4,8 +4,12 @@
 //
 
 #import "Book.h"
+#import "SearchKey.h"
+#import "../Native/XLChapterText.h"
 
-@implementation XLBook
+@implementation XLBook {
+    NSString *_searchKey;
+}
 
 + (instancetype)bookWithId:(NSString *)bookId
                      title:(NSString *)title
@@ -45,6 +49,43 @@
     return [self initWithId:[[NSUUID UUID] UUIDString] title:@"" author:@""];
 }
 
+- (void)dealloc {
+    [_searchKey release];
+    [super dealloc];
+}
+
+- (void)setTitle:(NSString *)title {
+    @synchronized (self) {
+        if (title != _title) {
+            [_title release];
+            _title = [title copy];
+            [_searchKey release];
+            _searchKey = nil;
+        }
+    }
+}
+
+- (void)setAuthor:(NSString *)author {
+    @synchronized (self) {
+        if (author != _author) {
+            [_author release];
+            _author = [author copy];
+            [_searchKey release];
+            _searchKey = nil;
+        }
+    }
+}
+
+/// Read by the library's background filter, so built under the same lock the setters take
+- (NSString *)searchKey {
+    @synchronized (self) {
+        if (!_searchKey) {
+            _searchKey = [XLFoldedSearchKeyForFields(_title, _author) copy];
+        }
+        return [[_searchKey retain] autorelease];
+    }
+}
+
 - (instancetype)initWithCoder:(NSCoder *)aDecoder {
     self = [super init];
     if (self) {
@@ -125,7 +166,9 @@
 
 @end
 
-@implementation XLChapter
+@implementation XLChapter {
+    XLChapterText *_contentText;
+}
 
 + (instancetype)chapterWithId:(NSString *)chapterId
                          title:(NSString *)title
@@ -147,13 +190,37 @@
         self.chapterId = [[NSUUID UUID] UUIDString];
         self.title = @"";
         self.index = 0;
-        self.content = @"";
+        self.contentText = [XLChapterText emptyText];
         self.wordCount = 0;
         self.href = nil;
     }
     return self;
 }
 
+- (void)dealloc {
+    [_contentText release];
+    [super dealloc];
+}
+
+- (XLChapterText *)contentText {
+    return _contentText;
+}
+
+- (void)setContentText:(XLChapterText *)contentText {
+    if (contentText != _contentText) {
+        [_contentText release];
+        _contentText = [(contentText ? contentText : [XLChapterText emptyText]) retain];
+    }
+}
+
+- (NSString *)content {
+    return [_contentText string];
+}
+
+- (void)setContent:(NSString *)content {
+    self.contentText = [XLChapterText textWithString:content];
+}
+
 @end
 
 @implementation XLTOCItem
@@ -11,6 +11,8 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class XLSpanTable;
+
 /// Reader theme
 typedef NS_ENUM(NSInteger, XLReaderTheme) {
     XLReaderThemeLight = 0,
@@ -77,7 +79,11 @@ typedef NS_ENUM(NSInteger, XLTextAlign) {
 @interface XLProcessedChapter : XLChapter
 
 @property (nonatomic, retain) NSArray *foreignWords;
-@property (nonatomic, copy) NSString *processedContent; // HTML with foreign words marked
+@property (nonatomic, copy) NSString *processedContent; // HTML with foreign words marked; decoded on each read
+@property (nonatomic, retain) XLChapterText *processedText;
+/// foreignWords as sorted [startIndex, endIndex) spans whose entryIndex indexes foreignWords.
+/// Built on first access (the engine does this off the main thread); reset when foreignWords changes.
+@property (nonatomic, readonly) XLSpanTable *foreignWordSpans;
 
 @end
 
@@ -108,6 +114,7 @@ typedef NS_ENUM(NSInteger, XLTextAlign) {
 @property (nonatomic) NSTimeInterval averageSessionDuration;
 @property (nonatomic) NSInteger wordsRevealedToday;
 @property (nonatomic) NSInteger wordsSavedToday;
+@property (nonatomic) NSInteger reviewsToday;
 
 @end
 
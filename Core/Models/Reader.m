@@ -4,6 +4,8 @@
 //
 
 #import "Reader.h"
+#import "../Native/XLSpanTable.h"
+#import "../Native/XLChapterText.h"
 
 @implementation XLReaderSettings
 
@@ -135,7 +137,11 @@
 
 @end
 
-@implementation XLProcessedChapter
+@implementation XLProcessedChapter {
+    NSArray *_foreignWords;
+    XLSpanTable *_foreignWordSpans;
+    XLChapterText *_processedText;
+}
 
 - (instancetype)init {
     self = [super init];
@@ -146,6 +152,64 @@
     return self;
 }
 
+- (void)dealloc {
+    [_foreignWords release];
+    [_foreignWordSpans release];
+    [_processedText release];
+    [super dealloc];
+}
+
+- (XLChapterText *)processedText {
+    return _processedText;
+}
+
+- (void)setProcessedText:(XLChapterText *)processedText {
+    if (processedText != _processedText) {
+        [_processedText release];
+        _processedText = [(processedText ? processedText : [XLChapterText emptyText]) retain];
+    }
+}
+
+- (NSString *)processedContent {
+    return [_processedText string];
+}
+
+- (void)setProcessedContent:(NSString *)processedContent {
+    self.processedText = [XLChapterText textWithString:processedContent];
+}
+
+- (NSArray *)foreignWords {
+    return _foreignWords;
+}
+
+- (void)setForeignWords:(NSArray *)foreignWords {
+    @synchronized (self) {
+        if (foreignWords != _foreignWords) {
+            [_foreignWords release];
+            _foreignWords = [foreignWords retain];
+            [_foreignWordSpans release];
+            _foreignWordSpans = nil;
+        }
+    }
+}
+
+- (XLSpanTable *)foreignWordSpans {
+    @synchronized (self) {
+        if (!_foreignWordSpans) {
+            NSUInteger count = [_foreignWords count];
+            _foreignWordSpans = [[XLSpanTable alloc] initWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                XLForeignWordData *word = [_foreignWords objectAtIndex:i];
+                if (word.startIndex < 0 || word.endIndex <= word.startIndex) continue;
+                /* Out of memory: keep the spans so far rather than none */
+                if (![_foreignWordSpans addSpanFrom:(NSUInteger)word.startIndex to:(NSUInteger)word.endIndex entryIndex:i]) break;
+            }
+            [_foreignWordSpans sort];
+        }
+        return [[_foreignWordSpans retain] autorelease];
+    }
+}
+
 @end
 
 @implementation XLReadingSession
@@ -200,6 +264,7 @@
         self.averageSessionDuration = 0;
         self.wordsRevealedToday = 0;
         self.wordsSavedToday = 0;
+        self.reviewsToday = 0;
     }
     return self;
 }
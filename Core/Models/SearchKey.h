@@ -0,0 +1,24 @@
+//
+//  SearchKey.h
+//  Xenolexia
+//
+//  Case- and diacritic-folded keys for substring search in lists
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Separates fields inside one key so a query never matches across a field boundary
+extern NSString *const XLSearchKeyFieldSeparator;
+
+/// Lowercased, diacritic-stripped form of string ("Émile" -> "emile"); @"" for nil.
+/// Queries must be folded the same way before matching against a key.
+NSString *XLFoldedSearchKey(NSString * _Nullable string);
+
+/// Folded fields joined with XLSearchKeyFieldSeparator; nil fields contribute an empty field
+NSString *XLFoldedSearchKeyForFields(NSString * _Nullable first, NSString * _Nullable second);
+
+/// Literal substring test of an already-folded query against a precomputed key. Empty query matches.
+BOOL XLSearchKeyMatches(NSString *key, NSString *foldedQuery);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,22 @@
+//
+//  SearchKey.m
+//  Xenolexia
+//
+
+#import "SearchKey.h"
+
+NSString *const XLSearchKeyFieldSeparator = @"\x1f";
+
+NSString *XLFoldedSearchKey(NSString *string) {
+    if ([string length] == 0) return @"";
+    return [string stringByFoldingWithOptions:(NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch) locale:nil];
+}
+
+NSString *XLFoldedSearchKeyForFields(NSString *first, NSString *second) {
+    return [NSString stringWithFormat:@"%@%@%@", XLFoldedSearchKey(first), XLSearchKeyFieldSeparator, XLFoldedSearchKey(second)];
+}
+
+BOOL XLSearchKeyMatches(NSString *key, NSString *foldedQuery) {
+    if ([foldedQuery length] == 0) return YES;
+    return [key rangeOfString:foldedQuery options:NSLiteralSearch].location != NSNotFound;
+}
@@ -70,6 +70,9 @@ typedef NS_ENUM(NSInteger, XLVocabularyStatus) {
 @property (nonatomic) NSInteger interval; // Days until next review
 @property (nonatomic) XLVocabularyStatus status;
 
+/// Folded source and target word, the same key the vocabulary table stores in search_key
+@property (nonatomic, readonly) NSString *searchKey;
+
 + (instancetype)itemWithSourceWord:(NSString *)sourceWord
                          targetWord:(NSString *)targetWord
                      sourceLanguage:(XLLanguage)sourceLanguage
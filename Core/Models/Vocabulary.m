@@ -4,6 +4,7 @@
 //
 
 #import "Vocabulary.h"
+#import "SearchKey.h"
 
 @implementation XLWordEntry
 
@@ -44,7 +45,9 @@
 
 @end
 
-@implementation XLVocabularyItem
+@implementation XLVocabularyItem {
+    NSString *_searchKey;
+}
 
 + (instancetype)itemWithSourceWord:(NSString *)sourceWord
                          targetWord:(NSString *)targetWord
@@ -86,6 +89,42 @@
     return XLVocabularyStatusNew;
 }
 
+- (void)dealloc {
+    [_searchKey release];
+    [super dealloc];
+}
+
+- (void)setSourceWord:(NSString *)sourceWord {
+    @synchronized (self) {
+        if (sourceWord != _sourceWord) {
+            [_sourceWord release];
+            _sourceWord = [sourceWord copy];
+            [_searchKey release];
+            _searchKey = nil;
+        }
+    }
+}
+
+- (void)setTargetWord:(NSString *)targetWord {
+    @synchronized (self) {
+        if (targetWord != _targetWord) {
+            [_targetWord release];
+            _targetWord = [targetWord copy];
+            [_searchKey release];
+            _searchKey = nil;
+        }
+    }
+}
+
+- (NSString *)searchKey {
+    @synchronized (self) {
+        if (!_searchKey) {
+            _searchKey = [XLFoldedSearchKeyForFields(_sourceWord, _targetWord) copy];
+        }
+        return [[_searchKey retain] autorelease];
+    }
+}
+
 - (instancetype)init {
     self = [super init];
     if (self) {
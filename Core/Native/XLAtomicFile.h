@@ -0,0 +1,18 @@
+//
+//  XLAtomicFile.h
+//  Xenolexia
+//
+//  Whole-file writes that readers never see half done.
+//
+
+#import <Foundation/Foundation.h>
+#include <stdio.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Calls writer with a uniquely named temporary file in path's directory (mkstemp), then renames it over path.
+/// writer returns NO on a failed write. The temporary file is removed on any failure.
+/// Concurrent writers of the same path never share a temporary file; the last rename wins.
+BOOL XLWriteFileAtomically(NSString *path, BOOL (^writer)(FILE *out));
+
+NS_ASSUME_NONNULL_END
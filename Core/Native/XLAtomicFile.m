@@ -0,0 +1,49 @@
+//
+//  XLAtomicFile.m
+//  Xenolexia
+//
+
+#import "XLAtomicFile.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BOOL XLWriteFileAtomically(NSString *path, BOOL (^writer)(FILE *out)) {
+    const char *target = [path fileSystemRepresentation];
+    size_t length = strlen(target);
+    char *temp = malloc(length + sizeof(".XXXXXX"));
+    if (!temp) {
+        errno = ENOMEM;
+        return NO;
+    }
+    memcpy(temp, target, length);
+    memcpy(temp + length, ".XXXXXX", sizeof(".XXXXXX"));
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        free(temp);
+        return NO;
+    }
+    /* mkstemp creates the file 0600; these files are ordinary user data */
+    fchmod(fd, 0644);
+    FILE *out = fdopen(fd, "wb");
+    if (!out) {
+        int saved = errno;
+        close(fd);
+        unlink(temp);
+        free(temp);
+        errno = saved;
+        return NO;
+    }
+    BOOL ok = writer(out);
+    if (fclose(out) != 0) ok = NO;
+    if (ok) ok = (rename(temp, target) == 0);
+    if (!ok) {
+        int saved = errno;
+        unlink(temp);
+        errno = saved;
+    }
+    free(temp);
+    return ok;
+}
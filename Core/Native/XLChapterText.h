@@ -0,0 +1,38 @@
+//
+//  XLChapterText.h
+//  Xenolexia
+//
+//  Chapter text kept as UTF-8 bytes (about half the size of an NSString's UTF-16 for most books),
+//  either owned or a slice of a memory-mapped per-book text file.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Immutable UTF-8 text. -string decodes a new NSString on every call, so callers that need the text
+/// more than once should keep the string only as long as they need it (e.g. for the displayed chapter).
+@interface XLChapterText : NSObject {
+    NSData *_storage;
+    NSRange _range;
+}
+
+/// Empty text shared by chapters that have none
++ (instancetype)emptyText;
+/// UTF-8 copy of string (nil is empty)
++ (instancetype)textWithString:(nullable NSString *)string;
+
+/// Bytes [range] of storage, which is retained (a mapped file stays mapped while any slice lives).
+/// range must lie within storage and hold valid UTF-8.
+- (instancetype)initWithStorage:(NSData *)storage range:(NSRange)range;
+
+- (const char *)UTF8Bytes;
+- (NSUInteger)UTF8Length;
+- (BOOL)isEmpty;
+
+/// Decode to an autoreleased NSString
+- (NSString *)string;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,67 @@
+//
+//  XLChapterText.m
+//  Xenolexia
+//
+
+#import "XLChapterText.h"
+
+@implementation XLChapterText
+
++ (instancetype)emptyText {
+    static XLChapterText *empty = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        empty = [[XLChapterText alloc] initWithStorage:[NSData data] range:NSMakeRange(0, 0)];
+    });
+    return empty;
+}
+
++ (instancetype)textWithString:(NSString *)string {
+    if ([string length] == 0) return [self emptyText];
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    if (!data) return [self emptyText];
+    return [[[XLChapterText alloc] initWithStorage:data range:NSMakeRange(0, [data length])] autorelease];
+}
+
+- (instancetype)init {
+    return [self initWithStorage:[NSData data] range:NSMakeRange(0, 0)];
+}
+
+- (instancetype)initWithStorage:(NSData *)storage range:(NSRange)range {
+    self = [super init];
+    if (self) {
+        if (NSMaxRange(range) > [storage length]) range = NSMakeRange(0, 0);
+        _storage = [storage retain];
+        _range = range;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_storage release];
+    [super dealloc];
+}
+
+- (const char *)UTF8Bytes {
+    return (const char *)[_storage bytes] + _range.location;
+}
+
+- (NSUInteger)UTF8Length {
+    return _range.length;
+}
+
+- (BOOL)isEmpty {
+    return _range.length == 0;
+}
+
+- (NSString *)string {
+    if (_range.length == 0) return @"";
+    NSString *string = [[NSString alloc] initWithBytes:[self UTF8Bytes] length:_range.length encoding:NSUTF8StringEncoding];
+    return string ? [string autorelease] : @"";
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %lu UTF-8 bytes>", NSStringFromClass([self class]), (unsigned long)_range.length];
+}
+
+@end
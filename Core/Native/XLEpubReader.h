@@ -31,6 +31,10 @@ NS_ASSUME_NONNULL_BEGIN
 /// Read file bytes (e.g. spine path). Returns nil on failure.
 - (nullable NSData *)readFileAtPath:(NSString *)path;
 
+/// libxml2 dictionary shared by this book's documents; pass it to XLHTMLReadMemory when parsing chapters
+/// (on the thread that reads the book)
+- (nullable struct _xmlDict *)xmlDictionary;
+
 /// Cover image bytes. Returns nil if not found.
 - (nullable NSData *)copyCover;
 
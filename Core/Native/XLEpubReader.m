@@ -6,6 +6,8 @@
 //
 
 #import "XLEpubReader.h"
+#import "XLTrace.h"
+#import "XLXMLParserPool.h"
 #import <libxml/parser.h>
 #import <libxml/tree.h>
 #import <libxml/xpath.h>
@@ -25,6 +27,7 @@
 @property (nonatomic, copy) NSArray<NSDictionary<NSString *, id> *> *tocEntries; // title, href, level
 @property (nonatomic, assign) xmlDoc *opfDoc;
 @property (nonatomic, assign) xmlXPathContext *opfXpath;
+@property (nonatomic, assign) xmlDict *dict;
 @end
 
 static NSString *resolvePath(NSString *basePath, NSString *path) {
@@ -37,6 +40,7 @@ static NSString *resolvePath(NSString *basePath, NSString *path) {
 
 static NSData *readZipEntry(zip_t *z, const char *path) {
     if (!z || !path) return nil;
+    XL_TRACE_SCOPE("zip.read", "epub");
     zip_file_t *f = zip_fopen(z, path, 0);
     if (!f) return nil;
     NSMutableData *out = [NSMutableData data];
@@ -53,11 +57,13 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
 - (void)dealloc {
     if (_opfXpath) xmlXPathFreeContext(_opfXpath);
     if (_opfDoc) xmlFreeDoc(_opfDoc);
+    XLXMLDictRelease(_dict);
     if (_zip) zip_close(_zip);
     [super dealloc];
 }
 
 + (nullable instancetype)openAtPath:(NSString *)path error:(NSError **)error {
+    XL_TRACE_SCOPE("epub.open", "epub");
     if (!path || [path length] == 0) {
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1001 userInfo:@{NSLocalizedDescriptionKey: @"Path is empty"}];
         return nil;
@@ -76,8 +82,11 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
         return nil;
     }
 
-    xmlDoc *containerDoc = xmlReadMemory((const char *)[containerData bytes], (int)[containerData length], NULL, NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
+    // One dictionary for container.xml, the OPF and (through -xmlDictionary) the chapters
+    xmlDict *dict = XLXMLDictCreate();
+    xmlDoc *containerDoc = XLXMLReadMemory([containerData bytes], [containerData length], dict, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
     if (!containerDoc) {
+        XLXMLDictRelease(dict);
         zip_close(z);
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1002 userInfo:@{NSLocalizedDescriptionKey: @"Invalid container.xml"}];
         return nil;
@@ -104,6 +113,7 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
     xmlFreeDoc(containerDoc);
 
     if (!rootPath || [rootPath length] == 0) {
+        XLXMLDictRelease(dict);
         zip_close(z);
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1002 userInfo:@{NSLocalizedDescriptionKey: @"No rootfile in container"}];
         return nil;
@@ -111,13 +121,15 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
 
     NSData *opfData = readZipEntry(z, [rootPath UTF8String]);
     if (!opfData || [opfData length] == 0) {
+        XLXMLDictRelease(dict);
         zip_close(z);
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1002 userInfo:@{NSLocalizedDescriptionKey: @"Missing OPF"}];
         return nil;
     }
 
-    xmlDoc *opfDoc = xmlReadMemory((const char *)[opfData bytes], (int)[opfData length], NULL, NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
+    xmlDoc *opfDoc = XLXMLReadMemory([opfData bytes], [opfData length], dict, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
     if (!opfDoc) {
+        XLXMLDictRelease(dict);
         zip_close(z);
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1002 userInfo:@{NSLocalizedDescriptionKey: @"Invalid OPF"}];
         return nil;
@@ -126,6 +138,7 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
     xmlXPathContext *opfXpath = xmlXPathNewContext(opfDoc);
     if (!opfXpath) {
         xmlFreeDoc(opfDoc);
+        XLXMLDictRelease(dict);
         zip_close(z);
         if (error) *error = [NSError errorWithDomain:@"XLEpubReader" code:1099 userInfo:@{NSLocalizedDescriptionKey: @"XPath context"}];
         return nil;
@@ -137,6 +150,7 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
     reader.rootDir = [rootPath stringByDeletingLastPathComponent];
     reader.opfDoc = opfDoc;
     reader.opfXpath = opfXpath;
+    reader.dict = dict;
 
     xmlNode *opfRoot = xmlDocGetRootElement(opfDoc);
     NSString *title = @"";
@@ -234,6 +248,10 @@ static NSData *readZipEntry(zip_t *z, const char *path) {
     return readZipEntry(_zip, [path UTF8String]);
 }
 
+- (struct _xmlDict *)xmlDictionary {
+    return _dict;
+}
+
 - (NSData *)copyCover {
     if (!_opfDoc) return nil;
     xmlNode *meta = xmlDocGetRootElement(_opfDoc);
@@ -6,6 +6,7 @@
 //
 
 #import "XLFB2Reader.h"
+#import "XLXMLParserPool.h"
 #import <libxml/parser.h>
 #import <libxml/tree.h>
 #import <libxml/xpath.h>
@@ -77,7 +78,7 @@ static NSString *getSectionText(xmlNode *section) {
         if (error) *error = [NSError errorWithDomain:@"XLFB2Reader" code:1001 userInfo:@{NSLocalizedDescriptionKey: @"Path is empty"}];
         return nil;
     }
-    xmlDoc *doc = xmlReadFile([path UTF8String], NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
+    xmlDoc *doc = XLXMLReadFile([path UTF8String], NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR);
     if (!doc) {
         if (error) *error = [NSError errorWithDomain:@"XLFB2Reader" code:1008 userInfo:@{NSLocalizedDescriptionKey: @"Failed to parse FB2"}];
         return nil;
@@ -0,0 +1,48 @@
+//
+//  XLKnownWordSet.h
+//  Xenolexia
+//
+//  Words a reader already knows in one language pair (learned vocabulary plus words marked known),
+//  tested once per token during word selection.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Open-addressing set of 64-bit word fingerprints behind a blocked Bloom filter: a token that is not in
+/// the set (almost every token) is usually rejected by one 64-bit word of the filter, which is an eighth
+/// of the table's size and stays in cache. Words are compared lowercased, by fingerprint.
+/// There is no removal: rebuild the set when a word stops being known.
+/// Not thread-safe while adding; a set nobody adds to may be shared across threads (hand workers a -copy).
+@interface XLKnownWordSet : NSObject <NSCopying> {
+    uint64_t *_slots;           // fingerprints, 0 = empty; capacity is a power of two, at most half full
+    NSUInteger _capacity;
+    NSUInteger _count;
+    uint64_t *_bloom;           // capacity / 8 words
+    NSUInteger _bloomMask;
+}
+
+/// Sized for about capacity words without growing
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/// Read a snapshot written by -writeToFile:stamp:error:; *stamp receives the stamp it was written with
++ (nullable instancetype)setWithContentsOfFile:(NSString *)path stamp:(int64_t *)stamp error:(NSError **)error;
+/// Write a snapshot (to a temporary file renamed into place); stamp lets the owner detect a stale file
+- (BOOL)writeToFile:(NSString *)path stamp:(int64_t)stamp error:(NSError **)error;
+/// -addWord:, then bring the snapshot at path up to date in place: append the word's fingerprint and restamp it.
+/// NO, with the word still added, if path was not a snapshot of the set before the word; rewrite it then.
+- (BOOL)addWord:(NSString *)word appendingToFile:(NSString *)path stamp:(int64_t)stamp error:(NSError **)error;
+
+/// Lowercases word; empty words are ignored
+- (void)addWord:(NSString *)word;
+- (void)addWords:(NSArray *)words;
+
+/// word must already be lowercased (as the translation engine's tokens are). O(1).
+- (BOOL)containsWord:(NSString *)word;
+
+- (NSUInteger)count;
+
+@end
+
+NS_ASSUME_NONNULL_END
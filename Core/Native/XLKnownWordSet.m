@@ -0,0 +1,273 @@
+//
+//  XLKnownWordSet.m
+//  Xenolexia
+//
+
+#import "XLKnownWordSet.h"
+#import "XLAtomicFile.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const NSUInteger kMinCapacity = 64;
+
+/// Snapshot layout (native byte order; the file is a local cache): header, then count fingerprints
+static const char kSnapshotMagic[4] = { 'X', 'L', 'K', 'W' };
+static const uint32_t kSnapshotVersion = 1;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    int64_t stamp;
+} XLKnownWordSnapshotHeader;
+
+static NSError *knownWordSetError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:@"XLKnownWordSet" code:code userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+/// FNV-1a over the UTF-16 units, then the splitmix64 finalizer (FNV's low bits are weak and both the
+/// table and the filter index by them). Never 0, which marks an empty slot.
+static uint64_t XLWordFingerprint(NSString *word) {
+    unichar buffer[64];
+    NSUInteger length = [word length];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (NSUInteger start = 0; start < length; start += 64) {
+        NSUInteger n = MIN(length - start, (NSUInteger)64);
+        [word getCharacters:buffer range:NSMakeRange(start, n)];
+        for (NSUInteger i = 0; i < n; i++) {
+            hash = (hash ^ (buffer[i] & 0xff)) * 0x100000001b3ULL;
+            hash = (hash ^ (buffer[i] >> 8)) * 0x100000001b3ULL;
+        }
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash ? hash : 1;
+}
+
+/// The four filter bits of a fingerprint, all within one 64-bit word
+static inline uint64_t XLBloomBits(uint64_t fp) {
+    return (1ULL << (fp & 63)) | (1ULL << ((fp >> 6) & 63)) | (1ULL << ((fp >> 12) & 63)) | (1ULL << ((fp >> 18) & 63));
+}
+
+@interface XLKnownWordSet ()
+- (BOOL)allocateCapacity:(NSUInteger)capacity;
+- (void)placeFingerprint:(uint64_t)fp;
+- (void)addFingerprint:(uint64_t)fp;
+@end
+
+@implementation XLKnownWordSet
+
+- (instancetype)init {
+    return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        NSUInteger slots = kMinCapacity;
+        while (slots < capacity * 2) slots *= 2;
+        if (![self allocateCapacity:slots]) {
+            [self release];
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_slots);
+    free(_bloom);
+    [super dealloc];
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    XLKnownWordSet *copy = [[[self class] allocWithZone:zone] initWithCapacity:0];
+    uint64_t *slots = malloc(_capacity * sizeof(uint64_t));
+    uint64_t *bloom = malloc((_bloomMask + 1) * sizeof(uint64_t));
+    if (!copy || !slots || !bloom) {
+        free(slots);
+        free(bloom);
+        [copy release];
+        return nil;
+    }
+    memcpy(slots, _slots, _capacity * sizeof(uint64_t));
+    memcpy(bloom, _bloom, (_bloomMask + 1) * sizeof(uint64_t));
+    free(copy->_slots);
+    free(copy->_bloom);
+    copy->_slots = slots;
+    copy->_bloom = bloom;
+    copy->_capacity = _capacity;
+    copy->_count = _count;
+    copy->_bloomMask = _bloomMask;
+    return copy;
+}
+
+/// Empty table and filter of the given size; NO, leaving the set as it was, when out of memory
+- (BOOL)allocateCapacity:(NSUInteger)capacity {
+    NSUInteger bloomWords = MAX(capacity / 8, (NSUInteger)1);
+    uint64_t *slots = calloc(capacity, sizeof(uint64_t));
+    uint64_t *bloom = calloc(bloomWords, sizeof(uint64_t));
+    if (!slots || !bloom) {
+        free(slots);
+        free(bloom);
+        return NO;
+    }
+    _slots = slots;
+    _bloom = bloom;
+    _capacity = capacity;
+    _count = 0;
+    _bloomMask = bloomWords - 1;
+    return YES;
+}
+
+/// Insert without growing; fp must not be present
+- (void)placeFingerprint:(uint64_t)fp {
+    NSUInteger mask = _capacity - 1;
+    NSUInteger i = (NSUInteger)(fp >> 32) & mask;
+    while (_slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    _slots[i] = fp;
+    _count++;
+    _bloom[(NSUInteger)(fp >> 24) & _bloomMask] |= XLBloomBits(fp);
+}
+
+- (void)addFingerprint:(uint64_t)fp {
+    NSUInteger mask = _capacity - 1;
+    for (NSUInteger i = (NSUInteger)(fp >> 32) & mask; _slots[i] != 0; i = (i + 1) & mask) {
+        if (_slots[i] == fp) return;
+    }
+    if ((_count + 1) * 2 > _capacity) {
+        /* Keep the table at most half full; the filter is rebuilt at the new size */
+        uint64_t *old = _slots;
+        uint64_t *oldBloom = _bloom;
+        NSUInteger oldCapacity = _capacity;
+        if ([self allocateCapacity:oldCapacity * 2]) {
+            for (NSUInteger i = 0; i < oldCapacity; i++) {
+                if (old[i] != 0) [self placeFingerprint:old[i]];
+            }
+            free(old);
+            free(oldBloom);
+        } else if (_count + 1 >= _capacity) {
+            /* Out of memory and no free slot to spare: the word stays unknown */
+            return;
+        }
+    }
+    [self placeFingerprint:fp];
+}
+
+- (void)addWord:(NSString *)word {
+    if ([word length] == 0) return;
+    [self addFingerprint:XLWordFingerprint([word lowercaseString])];
+}
+
+- (void)addWords:(NSArray *)words {
+    for (NSString *word in words) {
+        [self addWord:word];
+    }
+}
+
+- (BOOL)containsWord:(NSString *)word {
+    if (_count == 0) return NO;
+    uint64_t fp = XLWordFingerprint(word);
+    uint64_t bits = XLBloomBits(fp);
+    if ((_bloom[(NSUInteger)(fp >> 24) & _bloomMask] & bits) != bits) return NO;
+    NSUInteger mask = _capacity - 1;
+    for (NSUInteger i = (NSUInteger)(fp >> 32) & mask; _slots[i] != 0; i = (i + 1) & mask) {
+        if (_slots[i] == fp) return YES;
+    }
+    return NO;
+}
+
+- (NSUInteger)count {
+    return _count;
+}
+
+#pragma mark - Snapshots
+
++ (instancetype)setWithContentsOfFile:(NSString *)path stamp:(int64_t *)stamp error:(NSError **)error {
+    NSData *data = [NSData dataWithContentsOfFile:path options:0 error:error];
+    if (!data) return nil;
+    XLKnownWordSnapshotHeader header;
+    if ([data length] < sizeof(header)) {
+        if (error) *error = knownWordSetError(1, @"Known-word snapshot is truncated");
+        return nil;
+    }
+    memcpy(&header, [data bytes], sizeof(header));
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 || header.version != kSnapshotVersion
+        || header.count != ([data length] - sizeof(header)) / sizeof(uint64_t)
+        || ([data length] - sizeof(header)) % sizeof(uint64_t) != 0) {
+        if (error) *error = knownWordSetError(2, @"Not a known-word snapshot of this version");
+        return nil;
+    }
+    XLKnownWordSet *set = [[[self alloc] initWithCapacity:(NSUInteger)header.count] autorelease];
+    const uint8_t *fingerprints = (const uint8_t *)[data bytes] + sizeof(header);
+    for (uint64_t i = 0; i < header.count; i++) {
+        uint64_t fp;
+        memcpy(&fp, fingerprints + i * sizeof(uint64_t), sizeof(fp));
+        if (fp != 0) [set addFingerprint:fp];
+    }
+    if (stamp) *stamp = header.stamp;
+    return set;
+}
+
+- (BOOL)writeToFile:(NSString *)path stamp:(int64_t)stamp error:(NSError **)error {
+    XLKnownWordSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.count = _count;
+    header.stamp = stamp;
+    BOOL ok = XLWriteFileAtomically(path, ^BOOL(FILE *out) {
+        BOOL written = fwrite(&header, sizeof(header), 1, out) == 1;
+        for (NSUInteger i = 0; written && i < _capacity; i++) {
+            if (_slots[i] != 0) written = fwrite(&_slots[i], sizeof(uint64_t), 1, out) == 1;
+        }
+        return written;
+    });
+    if (!ok && error) *error = knownWordSetError(3, [NSString stringWithFormat:@"Cannot write %@", path]);
+    return ok;
+}
+
+- (BOOL)addWord:(NSString *)word appendingToFile:(NSString *)path stamp:(int64_t)stamp error:(NSError **)error {
+    NSUInteger before = _count;
+    [self addWord:word];
+    int fd = open([path fileSystemRepresentation], O_RDWR);
+    if (fd < 0) {
+        if (error) *error = knownWordSetError(3, [NSString stringWithFormat:@"Cannot write %@", path]);
+        return NO;
+    }
+    XLKnownWordSnapshotHeader header;
+    struct stat st;
+    uint64_t end = sizeof(header) + (uint64_t)before * sizeof(uint64_t);
+    BOOL ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fstat(fd, &st) == 0
+        && memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) == 0 && header.version == kSnapshotVersion
+        && header.count == before && (uint64_t)st.st_size == end;
+    if (!ok) {
+        close(fd);
+        if (error) *error = knownWordSetError(2, @"Not a snapshot of this set");
+        return NO;
+    }
+    /* Fingerprint first, then the header: a file cut short in between fails the size check on load */
+    if (_count > before) {
+        uint64_t fp = XLWordFingerprint([word lowercaseString]);
+        ok = pwrite(fd, &fp, sizeof(fp), (off_t)end) == (ssize_t)sizeof(fp);
+    }
+    if (ok) {
+        header.count = _count;
+        header.stamp = stamp;
+        ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    }
+    if (close(fd) != 0) ok = NO;
+    if (!ok && error) *error = knownWordSetError(3, [NSString stringWithFormat:@"Cannot write %@", path]);
+    return ok;
+}
+
+@end
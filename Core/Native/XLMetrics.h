@@ -0,0 +1,71 @@
+//
+//  XLMetrics.h
+//  Xenolexia
+//
+//  Process-wide counters, gauges and latency histograms. Updating a metric is a relaxed atomic add
+//  (no locks); only the first use of each name, snapshots and reset take the registry lock.
+//
+
+#import <Foundation/Foundation.h>
+#import "XLTrace.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, XLMetricKind) {
+    XLMetricKindCounter = 0,
+    XLMetricKindGauge,
+    XLMetricKindHistogram
+};
+
+typedef struct XLMetric XLMetric;
+
+/// Metric for name, created on first use. name must be a string literal or otherwise outlive the process;
+/// asking for an existing name with another kind returns NULL.
+XLMetric * _Nullable XLMetricsRegister(const char *name, XLMetricKind kind);
+
+/// Look a metric up once per call site and cache it (GNU statement expression, as used by GCC and clang)
+#define XL_METRIC(name, kind) ({ \
+    static XLMetric *_xlMetric = NULL; \
+    XLMetric *_xlFound = __atomic_load_n(&_xlMetric, __ATOMIC_ACQUIRE); \
+    if (!_xlFound) { \
+        _xlFound = XLMetricsRegister(name, kind); \
+        __atomic_store_n(&_xlMetric, _xlFound, __ATOMIC_RELEASE); \
+    } \
+    _xlFound; })
+#define XL_COUNTER(name) XL_METRIC(name, XLMetricKindCounter)
+#define XL_GAUGE(name) XL_METRIC(name, XLMetricKindGauge)
+#define XL_HISTOGRAM(name) XL_METRIC(name, XLMetricKindHistogram)
+
+/// Counters and gauges; NULL metrics are ignored
+void XLMetricAdd(XLMetric * _Nullable metric, int64_t delta);
+void XLMetricSet(XLMetric * _Nullable metric, int64_t value);
+
+/// Histograms record nanoseconds in log-linear buckets (8 per power of two, so within 12.5%)
+void XLMetricRecord(XLMetric * _Nullable histogram, uint64_t nanoseconds);
+/// Record XLTraceNow() - start
+void XLMetricRecordSince(XLMetric * _Nullable histogram, uint64_t start);
+
+/// State for XL_METRIC_TIMER
+typedef struct {
+    XLMetric *histogram;
+    uint64_t start;
+} XLMetricTimer;
+
+void XLMetricTimerEnd(XLMetricTimer *timer);
+
+/// Record how long the rest of the enclosing block takes (one per block)
+#define XL_METRIC_TIMER(name) \
+    XLMetricTimer _xlMetricTimer __attribute__((cleanup(XLMetricTimerEnd), unused)) = { XL_HISTOGRAM(name), XLTraceNow() }
+
+/// @"counters" and @"gauges" map name -> NSNumber; @"histograms" maps name -> NSDictionary with
+/// count, mean_ms, p50_ms, p90_ms, p99_ms and max_ms
+NSDictionary *XLMetricsSnapshot(void);
+/// One aligned line per metric, sorted by name
+NSString *XLMetricsTextReport(void);
+NSData * _Nullable XLMetricsJSONReport(void);
+/// JSON when path ends in .json, text otherwise
+BOOL XLMetricsWriteReport(NSString *path, NSError * _Nullable * _Nullable error);
+/// Zero every metric (registrations are kept)
+void XLMetricsReset(void);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,216 @@
+//
+//  XLMetrics.m
+//  Xenolexia
+//
+
+#import "XLMetrics.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Values below 8 get their own bucket; above that, 8 linear buckets per power of two up to 2^64 */
+#define XL_HISTOGRAM_SUB_BITS 3
+#define XL_HISTOGRAM_SUB_COUNT (1 << XL_HISTOGRAM_SUB_BITS)
+#define XL_HISTOGRAM_BUCKETS (XL_HISTOGRAM_SUB_COUNT + (64 - XL_HISTOGRAM_SUB_BITS) * XL_HISTOGRAM_SUB_COUNT)
+
+struct XLMetric {
+    XLMetric *next;
+    const char *name;
+    XLMetricKind kind;
+    int64_t value;          // counter or gauge
+    uint64_t count;         // histogram
+    uint64_t sum;
+    uint64_t max;
+    uint64_t *buckets;      // XL_HISTOGRAM_BUCKETS, histograms only
+};
+
+static pthread_mutex_t metricsLock = PTHREAD_MUTEX_INITIALIZER;
+static XLMetric *metrics = NULL;    // guarded by metricsLock; entries are never freed
+
+XLMetric *XLMetricsRegister(const char *name, XLMetricKind kind) {
+    if (!name) return NULL;
+    pthread_mutex_lock(&metricsLock);
+    XLMetric *metric = metrics;
+    while (metric && strcmp(metric->name, name) != 0) metric = metric->next;
+    if (metric) {
+        pthread_mutex_unlock(&metricsLock);
+        return metric->kind == kind ? metric : NULL;
+    }
+    metric = calloc(1, sizeof(XLMetric));
+    if (metric && kind == XLMetricKindHistogram) {
+        metric->buckets = calloc(XL_HISTOGRAM_BUCKETS, sizeof(uint64_t));
+        if (!metric->buckets) {
+            free(metric);
+            metric = NULL;
+        }
+    }
+    if (metric) {
+        metric->name = name;
+        metric->kind = kind;
+        metric->next = metrics;
+        metrics = metric;
+    }
+    pthread_mutex_unlock(&metricsLock);
+    return metric;
+}
+
+void XLMetricAdd(XLMetric *metric, int64_t delta) {
+    if (metric) __atomic_fetch_add(&metric->value, delta, __ATOMIC_RELAXED);
+}
+
+void XLMetricSet(XLMetric *metric, int64_t value) {
+    if (metric) __atomic_store_n(&metric->value, value, __ATOMIC_RELAXED);
+}
+
+static unsigned bucketForValue(uint64_t value) {
+    if (value < XL_HISTOGRAM_SUB_COUNT) return (unsigned)value;
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value);
+    unsigned sub = (unsigned)(value >> (exponent - XL_HISTOGRAM_SUB_BITS)) & (XL_HISTOGRAM_SUB_COUNT - 1);
+    return XL_HISTOGRAM_SUB_COUNT + (exponent - XL_HISTOGRAM_SUB_BITS) * XL_HISTOGRAM_SUB_COUNT + sub;
+}
+
+/// Midpoint of a bucket's value range
+static double valueForBucket(unsigned bucket) {
+    if (bucket < XL_HISTOGRAM_SUB_COUNT) return bucket;
+    unsigned exponent = (bucket - XL_HISTOGRAM_SUB_COUNT) / XL_HISTOGRAM_SUB_COUNT + XL_HISTOGRAM_SUB_BITS;
+    unsigned sub = (bucket - XL_HISTOGRAM_SUB_COUNT) % XL_HISTOGRAM_SUB_COUNT;
+    double width = (double)(1ULL << (exponent - XL_HISTOGRAM_SUB_BITS));
+    return (double)(XL_HISTOGRAM_SUB_COUNT + sub) * width + width / 2.0;
+}
+
+void XLMetricRecord(XLMetric *histogram, uint64_t nanoseconds) {
+    if (!histogram || !histogram->buckets) return;
+    __atomic_fetch_add(&histogram->buckets[bucketForValue(nanoseconds)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum, nanoseconds, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (nanoseconds > max && !__atomic_compare_exchange_n(&histogram->max, &max, nanoseconds, YES, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void XLMetricRecordSince(XLMetric *histogram, uint64_t start) {
+    uint64_t now = XLTraceNow();
+    XLMetricRecord(histogram, now > start ? now - start : 0);
+}
+
+void XLMetricTimerEnd(XLMetricTimer *timer) {
+    XLMetricRecordSince(timer->histogram, timer->start);
+}
+
+#pragma mark - Reports
+
+/// Percentiles from a copy of the buckets; concurrent records may make count and buckets differ slightly
+static NSDictionary *histogramSummary(XLMetric *histogram) {
+    uint64_t *buckets = malloc(XL_HISTOGRAM_BUCKETS * sizeof(uint64_t));
+    if (!buckets) return [NSDictionary dictionary];
+    uint64_t total = 0;
+    for (unsigned i = 0; i < XL_HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+        total += buckets[i];
+    }
+    uint64_t sum = __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+    double max = (double)__atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    static const double quantiles[3] = { 0.50, 0.90, 0.99 };
+    double values[3] = { 0, 0, 0 };
+    uint64_t seen = 0;
+    unsigned q = 0;
+    for (unsigned i = 0; i < XL_HISTOGRAM_BUCKETS && q < 3 && total > 0; i++) {
+        seen += buckets[i];
+        while (q < 3 && seen >= (uint64_t)ceil(quantiles[q] * (double)total)) {
+            values[q++] = MIN(valueForBucket(i), max);
+        }
+    }
+    free(buckets);
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            [NSNumber numberWithUnsignedLongLong:total], @"count",
+            [NSNumber numberWithDouble:total > 0 ? (double)sum / (double)total / 1e6 : 0], @"mean_ms",
+            [NSNumber numberWithDouble:values[0] / 1e6], @"p50_ms",
+            [NSNumber numberWithDouble:values[1] / 1e6], @"p90_ms",
+            [NSNumber numberWithDouble:values[2] / 1e6], @"p99_ms",
+            [NSNumber numberWithDouble:max / 1e6], @"max_ms",
+            nil];
+}
+
+NSDictionary *XLMetricsSnapshot(void) {
+    NSMutableDictionary *counters = [NSMutableDictionary dictionary];
+    NSMutableDictionary *gauges = [NSMutableDictionary dictionary];
+    NSMutableDictionary *histograms = [NSMutableDictionary dictionary];
+    pthread_mutex_lock(&metricsLock);
+    for (XLMetric *metric = metrics; metric; metric = metric->next) {
+        NSString *name = [NSString stringWithUTF8String:metric->name];
+        switch (metric->kind) {
+            case XLMetricKindCounter:
+                [counters setObject:[NSNumber numberWithLongLong:__atomic_load_n(&metric->value, __ATOMIC_RELAXED)] forKey:name];
+                break;
+            case XLMetricKindGauge:
+                [gauges setObject:[NSNumber numberWithLongLong:__atomic_load_n(&metric->value, __ATOMIC_RELAXED)] forKey:name];
+                break;
+            case XLMetricKindHistogram:
+                [histograms setObject:histogramSummary(metric) forKey:name];
+                break;
+        }
+    }
+    pthread_mutex_unlock(&metricsLock);
+    return [NSDictionary dictionaryWithObjectsAndKeys:counters, @"counters", gauges, @"gauges", histograms, @"histograms", nil];
+}
+
+NSString *XLMetricsTextReport(void) {
+    NSDictionary *snapshot = XLMetricsSnapshot();
+    NSMutableString *report = [NSMutableString string];
+    NSDictionary *counters = [snapshot objectForKey:@"counters"];
+    NSDictionary *gauges = [snapshot objectForKey:@"gauges"];
+    NSDictionary *histograms = [snapshot objectForKey:@"histograms"];
+    if ([counters count] > 0) [report appendString:@"Counters\n"];
+    for (NSString *name in [[counters allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        [report appendFormat:@"  %-36s %12lld\n", [name UTF8String], [[counters objectForKey:name] longLongValue]];
+    }
+    if ([gauges count] > 0) [report appendString:@"Gauges\n"];
+    for (NSString *name in [[gauges allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        [report appendFormat:@"  %-36s %12lld\n", [name UTF8String], [[gauges objectForKey:name] longLongValue]];
+    }
+    if ([histograms count] > 0) {
+        [report appendFormat:@"Latency (ms)%30s %9s %9s %9s %9s %9s\n", "count", "mean", "p50", "p90", "p99", "max"];
+    }
+    for (NSString *name in [[histograms allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        NSDictionary *h = [histograms objectForKey:name];
+        [report appendFormat:@"  %-36s %9llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", [name UTF8String],
+         [[h objectForKey:@"count"] unsignedLongLongValue], [[h objectForKey:@"mean_ms"] doubleValue],
+         [[h objectForKey:@"p50_ms"] doubleValue], [[h objectForKey:@"p90_ms"] doubleValue],
+         [[h objectForKey:@"p99_ms"] doubleValue], [[h objectForKey:@"max_ms"] doubleValue]];
+    }
+    if ([report length] == 0) [report appendString:@"No metrics recorded yet\n"];
+    return report;
+}
+
+NSData *XLMetricsJSONReport(void) {
+    return [NSJSONSerialization dataWithJSONObject:XLMetricsSnapshot() options:NSJSONWritingPrettyPrinted error:NULL];
+}
+
+BOOL XLMetricsWriteReport(NSString *path, NSError **error) {
+    if ([[[path pathExtension] lowercaseString] isEqualToString:@"json"]) {
+        NSData *json = XLMetricsJSONReport();
+        if (!json) {
+            if (error) *error = [NSError errorWithDomain:@"XLMetrics" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"Cannot encode metrics" }];
+            return NO;
+        }
+        return [json writeToFile:path options:NSDataWritingAtomic error:error];
+    }
+    return [XLMetricsTextReport() writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:error];
+}
+
+void XLMetricsReset(void) {
+    pthread_mutex_lock(&metricsLock);
+    for (XLMetric *metric = metrics; metric; metric = metric->next) {
+        __atomic_store_n(&metric->value, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&metric->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&metric->sum, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&metric->max, 0, __ATOMIC_RELAXED);
+        if (metric->buckets) {
+            for (unsigned i = 0; i < XL_HISTOGRAM_BUCKETS; i++) {
+                __atomic_store_n(&metric->buckets[i], 0, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    pthread_mutex_unlock(&metricsLock);
+}
@@ -0,0 +1,33 @@
+//
+//  XLReviewForecast.h
+//  Xenolexia
+//
+//  Review workload forecast: simulates SM-2 reviews of every card over the next N days, with grades drawn
+//  from a distribution, and reports the expected number of reviews due and of cards reaching "learned" per day.
+//
+
+#import <Foundation/Foundation.h>
+#import "XLSm2Batch.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct {
+    /// Length of the forecast; day 0 is the next 24 hours
+    size_t days;
+    /// Relative weights of grades 0-5 (need not sum to 1)
+    double gradeWeights[6];
+    /// Simulations per card, averaged; more runs smooth the curve
+    size_t runs;
+    uint64_t seed;
+} XLReviewForecastOptions;
+
+/// Defaults: 30 days, 4 runs, grades mostly 3-5
+XLReviewForecastOptions XLReviewForecastDefaultOptions(void);
+
+/// cards are the current scheduling columns (left unchanged) and dueDay the first day each card is due
+/// (0 for overdue). Cards already learned are never due. due and learned receive options.days expected
+/// counts each. Cards are split across threads; results do not depend on the thread count.
+void XLReviewForecastRun(XLSm2Columns cards, const int32_t *dueDay, size_t count,
+                         const XLReviewForecastOptions *options, double *due, double *learned);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,96 @@
+//
+//  XLReviewForecast.m
+//  Xenolexia
+//
+
+#import "XLReviewForecast.h"
+#import "XLSm2.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// Cards per parallel task; each task keeps its own day histograms
+#define XL_FORECAST_STRIPE 2048
+
+XLReviewForecastOptions XLReviewForecastDefaultOptions(void) {
+    XLReviewForecastOptions options = { 30, { 0.04, 0.04, 0.07, 0.25, 0.40, 0.20 }, 4, 1 };
+    return options;
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/// Simulate one card until it is learned or the horizon ends; counts are added to due/learned
+static void simulateCard(XLSm2Columns cards, size_t index, int32_t firstDue, const XLReviewForecastOptions *options,
+                         const double *cumulative, uint64_t rng, uint32_t *due, uint32_t *learned) {
+    double ef = cards.easeFactor[index];
+    double iv = cards.interval[index];
+    int64_t rc = cards.reviewCount[index];
+    int64_t st = cards.status[index];
+    XLSm2Columns one = { &ef, &iv, &rc, &st };
+    size_t day = firstDue > 0 ? (size_t)firstDue : 0;
+    while (day < options->days) {
+        due[day]++;
+        double u = (double)(splitmix64(&rng) >> 11) * (1.0 / 9007199254740992.0);
+        int32_t quality = 0;
+        while (quality < 5 && u >= cumulative[quality]) quality++;
+        XLSm2StepBatch(&quality, one, 1);
+        if (st == XLSm2StatusLearned) {
+            learned[day]++;
+            return;
+        }
+        /* A lapsed card (interval 0) comes back the next day */
+        if (iv >= (double)(options->days - day)) return;
+        day += iv >= 1 ? (size_t)iv : 1;
+    }
+}
+
+void XLReviewForecastRun(XLSm2Columns cards, const int32_t *dueDay, size_t count,
+                         const XLReviewForecastOptions *options, double *due, double *learned) {
+    size_t days = options->days;
+    memset(due, 0, days * sizeof(double));
+    memset(learned, 0, days * sizeof(double));
+    if (days == 0 || count == 0 || options->runs == 0) return;
+
+    double cumulative[6];
+    double total = 0;
+    for (int q = 0; q < 6; q++) total += options->gradeWeights[q] > 0 ? options->gradeWeights[q] : 0;
+    double running = 0;
+    for (int q = 0; q < 6; q++) {
+        running += options->gradeWeights[q] > 0 ? options->gradeWeights[q] : 0;
+        cumulative[q] = total > 0 ? running / total : (q + 1) / 6.0;
+    }
+
+    /* Each stripe fills its own integer histograms; merging them in stripe order keeps the sum deterministic */
+    size_t stripes = (count + XL_FORECAST_STRIPE - 1) / XL_FORECAST_STRIPE;
+    uint32_t *histograms = calloc(stripes * days * 2, sizeof(uint32_t));
+    if (!histograms) return;
+    dispatch_apply(stripes, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t stripe) {
+        uint32_t *stripeDue = histograms + stripe * days * 2;
+        uint32_t *stripeLearned = stripeDue + days;
+        size_t end = MIN(count, (stripe + 1) * XL_FORECAST_STRIPE);
+        for (size_t i = stripe * XL_FORECAST_STRIPE; i < end; i++) {
+            if (cards.status[i] == XLSm2StatusLearned || dueDay[i] >= (int32_t)days) continue;
+            for (size_t run = 0; run < options->runs; run++) {
+                uint64_t rng = options->seed ^ ((uint64_t)i * 0xD1B54A32D192ED03ULL) ^ ((uint64_t)run << 48);
+                simulateCard(cards, i, dueDay[i], options, cumulative, rng, stripeDue, stripeLearned);
+            }
+        }
+    });
+    for (size_t stripe = 0; stripe < stripes; stripe++) {
+        const uint32_t *stripeDue = histograms + stripe * days * 2;
+        const uint32_t *stripeLearned = stripeDue + days;
+        for (size_t day = 0; day < days; day++) {
+            due[day] += stripeDue[day];
+            learned[day] += stripeLearned[day];
+        }
+    }
+    free(histograms);
+    for (size_t day = 0; day < days; day++) {
+        due[day] /= (double)options->runs;
+        learned[day] /= (double)options->runs;
+    }
+}
@@ -0,0 +1,27 @@
+//
+//  XLSha256.h
+//  Xenolexia
+//
+//  SHA-256 (FIPS 180-4) in plain C, for download integrity checks without an OpenSSL dependency.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;        // bytes hashed so far
+    uint8_t buffer[64];
+    size_t buffered;
+} XLSha256Context;
+
+void XLSha256Init(XLSha256Context *ctx);
+void XLSha256Update(XLSha256Context *ctx, const void *bytes, size_t length);
+void XLSha256Final(XLSha256Context *ctx, uint8_t digest[32]);
+
+/// Lowercase hex digest of a file, read in 1 MB chunks. nil with error if the file cannot be read.
+/// stop, if given, is polled between chunks; returns nil (no error) when it becomes YES.
+NSString * _Nullable XLSha256HexOfFile(NSString *path, volatile BOOL * _Nullable stop, NSError * _Nullable * _Nullable error);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,28 @@
+//
+//  XLSm2Batch.h
+//  Xenolexia
+//
+//  SM-2 over columns of plain arrays, for rescheduling many cards at once. Same arithmetic as XLSm2Step,
+//  written without branches so the loop auto-vectorizes (e.g. GCC -O3 with an AVX2 target).
+//
+
+#import <Foundation/Foundation.h>
+#include <stddef.h>
+#include <stdint.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// One array per SM-2 field, all of the same length. interval holds whole days as doubles so the loop needs
+/// no integer/floating-point conversions (exact up to 2^53 days); status holds XLSm2Status values.
+typedef struct {
+    double *easeFactor;
+    double *interval;
+    int64_t *reviewCount;
+    int64_t *status;
+} XLSm2Columns;
+
+/// Apply one SM-2 step to rows [0, count): row i gets quality[i] (0-5); a negative quality leaves the row as it is.
+/// Results equal calling XLSm2Step on each row.
+void XLSm2StepBatch(const int32_t *quality, XLSm2Columns columns, size_t count);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,51 @@
+//
+//  XLSm2Batch.m
+//  Xenolexia
+//
+
+#import "XLSm2Batch.h"
+#import "XLSm2.h"
+#include <math.h>
+
+/* GCC will not if-convert floating-point arithmetic that might trap; nothing here inspects FP exceptions */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("no-trapping-math")
+#endif
+
+#define MIN_EASE_FACTOR     1.3
+#define NEW_INTERVAL       1
+#define GRADUATING_INTERVAL 6
+
+void XLSm2StepBatch(const int32_t *quality, XLSm2Columns columns, size_t count) {
+    const int32_t *restrict grades = quality;
+    double *restrict easeFactor = columns.easeFactor;
+    double *restrict interval = columns.interval;
+    int64_t *restrict reviewCount = columns.reviewCount;
+    int64_t *restrict status = columns.status;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t q = grades[i];
+        double ef = easeFactor[i];
+        double iv = interval[i];
+        int64_t rc = reviewCount[i] + 1;
+
+        /* Both outcomes of XLSm2Step are computed and one is selected; every select is a single
+           ?: over values already computed, and & replaces &&, so the body has no branches */
+        double fromFive = (double)(5 - q);
+        double grownEase = ef + (0.1 - fromFive * (0.08 + fromFive * 0.02));
+        grownEase = grownEase < MIN_EASE_FACTOR ? MIN_EASE_FACTOR : grownEase;
+        double grownInterval = trunc(iv * ef + 0.5);
+        grownInterval = iv == 0 ? NEW_INTERVAL : grownInterval;
+        grownInterval = iv == 1 ? GRADUATING_INTERVAL : grownInterval;
+        int64_t passedStatus = rc >= 2 ? XLSm2StatusReview : XLSm2StatusLearning;
+        passedStatus = ((rc >= 5) & (q >= 4)) ? XLSm2StatusLearned : passedStatus;
+
+        int64_t passed = q >= 3;
+        int64_t graded = q >= 0;
+        easeFactor[i] = passed ? grownEase : ef;
+        interval[i] = passed ? grownInterval : (graded ? 0 : iv);
+        reviewCount[i] = graded ? rc : rc - 1;
+        int64_t gradedStatus = passed ? passedStatus : XLSm2StatusLearning;
+        status[i] = graded ? gradedStatus : status[i];
+    }
+}
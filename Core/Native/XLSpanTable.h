@@ -0,0 +1,48 @@
+//
+//  XLSpanTable.h
+//  Xenolexia
+//
+//  Sorted, non-overlapping text spans in one flat array (foreign words in a chapter).
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Half-open character span [start, end) tagged with the index of its entry in a caller-owned array
+typedef struct {
+    NSUInteger start;
+    NSUInteger end;
+    NSUInteger entryIndex;
+} XLSpan;
+
+/// Build with -addSpan..., then -sort once; lookups binary-search the start offsets.
+/// Not thread-safe while building; immutable use after -sort may be shared across threads.
+@interface XLSpanTable : NSObject {
+    XLSpan *_spans;
+    NSUInteger _count;
+    NSUInteger _capacity;
+}
+
+/// nil if the span array cannot be allocated
+- (nullable instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/// Empty spans (end <= start) are ignored. NO if the table could not grow; the span is dropped and the
+/// table keeps the spans added so far.
+- (BOOL)addSpanFrom:(NSUInteger)start to:(NSUInteger)end entryIndex:(NSUInteger)entryIndex;
+/// Order by start offset and drop spans that overlap an earlier one
+- (void)sort;
+
+- (NSUInteger)count;
+- (XLSpan)spanAtIndex:(NSUInteger)index;
+
+/// Index of the span containing location, or NSNotFound. O(log n).
+- (NSUInteger)indexOfSpanContainingLocation:(NSUInteger)location;
+/// Span indexes lying entirely inside range, as a contiguous index range. O(log n).
+- (NSRange)spanIndexesInRange:(NSRange)range;
+/// Spans inside range merged where they touch, so callers apply attributes once per run
+- (void)enumerateRunsInRange:(NSRange)range usingBlock:(void (^)(NSRange run))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
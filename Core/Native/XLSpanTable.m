@@ -0,0 +1,123 @@
+//
+//  XLSpanTable.m
+//  Xenolexia
+//
+
+#import "XLSpanTable.h"
+#import <stdlib.h>
+
+static int XLSpanCompare(const void *a, const void *b) {
+    const XLSpan *x = a, *y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->end < y->end ? -1 : (x->end > y->end ? 1 : 0);
+}
+
+@implementation XLSpanTable
+
+- (instancetype)init {
+    return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = MAX(capacity, (NSUInteger)16);
+        _spans = _capacity <= NSUIntegerMax / sizeof(XLSpan) ? malloc(_capacity * sizeof(XLSpan)) : NULL;
+        _count = 0;
+        if (!_spans) {
+            [self release];
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_spans);
+    [super dealloc];
+}
+
+- (BOOL)addSpanFrom:(NSUInteger)start to:(NSUInteger)end entryIndex:(NSUInteger)entryIndex {
+    if (end <= start) return YES;
+    if (_count == _capacity) {
+        /* Grow into a temporary so a failed realloc leaves the table as it was */
+        XLSpan *grown = _capacity <= NSUIntegerMax / 2 / sizeof(XLSpan) ? realloc(_spans, _capacity * 2 * sizeof(XLSpan)) : NULL;
+        if (!grown) return NO;
+        _spans = grown;
+        _capacity *= 2;
+    }
+    _spans[_count].start = start;
+    _spans[_count].end = end;
+    _spans[_count].entryIndex = entryIndex;
+    _count++;
+    return YES;
+}
+
+- (void)sort {
+    if (_count < 2) return;
+    qsort(_spans, _count, sizeof(XLSpan), XLSpanCompare);
+    NSUInteger kept = 1;
+    for (NSUInteger i = 1; i < _count; i++) {
+        if (_spans[i].start >= _spans[kept - 1].end) {
+            _spans[kept++] = _spans[i];
+        }
+    }
+    _count = kept;
+}
+
+- (NSUInteger)count {
+    return _count;
+}
+
+- (XLSpan)spanAtIndex:(NSUInteger)index {
+    NSAssert(index < _count, @"span index out of range");
+    return _spans[index];
+}
+
+/// First span whose start is >= location
+- (NSUInteger)lowerBoundForLocation:(NSUInteger)location {
+    NSUInteger lo = 0, hi = _count;
+    while (lo < hi) {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (_spans[mid].start < location) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+- (NSUInteger)indexOfSpanContainingLocation:(NSUInteger)location {
+    /* Last span starting at or before location; spans do not overlap so only it can contain location */
+    NSUInteger i = [self lowerBoundForLocation:location + 1];
+    if (i == 0) return NSNotFound;
+    i--;
+    return location < _spans[i].end ? i : NSNotFound;
+}
+
+- (NSRange)spanIndexesInRange:(NSRange)range {
+    NSUInteger first = [self lowerBoundForLocation:range.location];
+    NSUInteger limit = NSMaxRange(range);
+    NSUInteger last = [self lowerBoundForLocation:limit];
+    /* Spans are disjoint and sorted, so only the last one starting before limit can extend past it */
+    if (last > first && _spans[last - 1].end > limit) {
+        last--;
+    }
+    return NSMakeRange(first, last - first);
+}
+
+- (void)enumerateRunsInRange:(NSRange)range usingBlock:(void (^)(NSRange run))block {
+    NSRange indexes = [self spanIndexesInRange:range];
+    NSUInteger i = indexes.location;
+    NSUInteger end = NSMaxRange(indexes);
+    while (i < end) {
+        NSUInteger runStart = _spans[i].start;
+        NSUInteger runEnd = _spans[i].end;
+        i++;
+        while (i < end && _spans[i].start == runEnd) {
+            runEnd = _spans[i].end;
+            i++;
+        }
+        block(NSMakeRange(runStart, runEnd - runStart));
+    }
+}
+
+@end
@@ -0,0 +1,56 @@
+//
+//  XLTrace.h
+//  Xenolexia
+//
+//  Hot-path tracing: timed spans kept in per-thread ring buffers and written as Chrome trace JSON
+//  (open in chrome://tracing or ui.perfetto.dev). Off unless started; a disabled span costs one branch.
+//
+
+#import <Foundation/Foundation.h>
+#include <stdint.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Non-zero while tracing; read through XLTraceIsEnabled()
+extern volatile int XLTraceActive;
+
+static inline BOOL XLTraceIsEnabled(void) {
+    return __builtin_expect(XLTraceActive != 0, 0);
+}
+
+/// Monotonic clock in nanoseconds
+uint64_t XLTraceNow(void);
+
+/// Span state for XL_TRACE_SCOPE; start is 0 when tracing was off at the beginning of the scope
+typedef struct {
+    const char *name;
+    const char *category;
+    uint64_t start;
+} XLTraceScope;
+
+static inline XLTraceScope XLTraceScopeBegin(const char *name, const char *category) {
+    XLTraceScope scope = { name, category, XLTraceIsEnabled() ? XLTraceNow() : 0 };
+    return scope;
+}
+
+void XLTraceScopeEnd(XLTraceScope *scope);
+
+/// Time the rest of the enclosing block (one per block). name and category are stored by pointer,
+/// so they must be string literals.
+#define XL_TRACE_SCOPE(name, category) \
+    XLTraceScope _xlTraceScope __attribute__((cleanup(XLTraceScopeEnd), unused)) = XLTraceScopeBegin(name, category)
+
+/// Record work that began at start (an XLTraceNow() value, or 0 if tracing was off) and ends now,
+/// possibly on another thread, e.g. in a network completion. Shown as an async span.
+void XLTraceRecordAsync(const char *name, const char *category, uint64_t start);
+
+/// Start recording; XLTraceStop() (or process exit) writes the trace to outputPath
+void XLTraceStart(NSString *outputPath);
+/// Start if the XENOLEXIA_TRACE environment variable or the XenolexiaTracePath default names an output file
+BOOL XLTraceStartFromEnvironment(void);
+/// Write what the ring buffers hold now (the newest 16384 spans per thread). Spans recorded while writing may be torn.
+BOOL XLTraceWriteToPath(NSString *path, NSError * _Nullable * _Nullable error);
+/// Stop recording and write the trace to the path given to XLTraceStart
+void XLTraceStop(void);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,250 @@
+//
+//  XLTrace.m
+//  Xenolexia
+//
+
+#import "XLTrace.h"
+#import "XLAtomicFile.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XL_TRACE_RING_CAPACITY 16384
+
+typedef struct {
+    const char *name;
+    const char *category;
+    uint64_t start;
+    uint64_t end;
+    int async;
+} XLTraceEvent;
+
+/// One per thread that recorded a span, reused when tracing restarts. A thread's spans outlive it: its
+/// buffer is freed when the thread exits with nothing recorded, else once those spans are written or discarded.
+typedef struct XLTraceBuffer {
+    struct XLTraceBuffer *next;
+    uint32_t tid;
+    int exited;                     // guarded by buffersLock
+    char threadName[64];
+    uint64_t written;               // total events recorded; the slot is written % capacity
+    XLTraceEvent events[XL_TRACE_RING_CAPACITY];
+} XLTraceBuffer;
+
+volatile int XLTraceActive = 0;
+
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t bufferKey;
+static pthread_mutex_t buffersLock = PTHREAD_MUTEX_INITIALIZER;
+static XLTraceBuffer *buffers = NULL;   // guarded by buffersLock
+static uint32_t nextTid = 1;            // guarded by buffersLock
+static uint64_t traceOrigin = 0;
+static NSString *traceOutputPath = nil; // guarded by buffersLock
+
+uint64_t XLTraceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// buffersLock held. Frees the buffers of threads that have exited (only that buffer, if one is given).
+static void freeExitedBuffers(XLTraceBuffer *only) {
+    XLTraceBuffer **link = &buffers;
+    while (*link) {
+        XLTraceBuffer *buffer = *link;
+        if (buffer->exited && (!only || buffer == only)) {
+            *link = buffer->next;
+            free(buffer);
+        } else {
+            link = &buffer->next;
+        }
+    }
+}
+
+/// Thread-exit destructor: keep the buffer for the next write only while it holds spans of an active trace
+static void releaseThreadBuffer(void *value) {
+    XLTraceBuffer *buffer = value;
+    pthread_mutex_lock(&buffersLock);
+    buffer->exited = 1;
+    if (!XLTraceIsEnabled()) {
+        freeExitedBuffers(NULL);
+    } else if (__atomic_load_n(&buffer->written, __ATOMIC_ACQUIRE) == 0) {
+        freeExitedBuffers(buffer);
+    }
+    pthread_mutex_unlock(&buffersLock);
+}
+
+static void makeBufferKey(void) {
+    pthread_key_create(&bufferKey, releaseThreadBuffer);
+}
+
+static XLTraceBuffer *currentBuffer(void) {
+    pthread_once(&bufferKeyOnce, makeBufferKey);
+    XLTraceBuffer *buffer = pthread_getspecific(bufferKey);
+    if (buffer) return buffer;
+    buffer = calloc(1, sizeof(XLTraceBuffer));
+    if (!buffer) return NULL;
+    /* Thread name, else the label of the dispatch queue that first traced on this thread */
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    NSString *threadName = [NSThread isMainThread] ? @"main" : [[NSThread currentThread] name];
+    const char *name = [threadName length] > 0 ? [threadName UTF8String] : dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL);
+    if (name) strncpy(buffer->threadName, name, sizeof(buffer->threadName) - 1);
+    [pool drain];
+    pthread_mutex_lock(&buffersLock);
+    buffer->tid = nextTid++;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&buffersLock);
+    pthread_setspecific(bufferKey, buffer);
+    return buffer;
+}
+
+static void recordEvent(const char *name, const char *category, uint64_t start, uint64_t end, int async) {
+    XLTraceBuffer *buffer = currentBuffer();
+    if (!buffer) return;
+    uint64_t written = buffer->written;
+    XLTraceEvent *event = &buffer->events[written % XL_TRACE_RING_CAPACITY];
+    event->name = name;
+    event->category = category;
+    event->start = start;
+    event->end = end;
+    event->async = async;
+    /* Publish after the slot is filled so a concurrent writer of the file sees whole events */
+    __atomic_store_n(&buffer->written, written + 1, __ATOMIC_RELEASE);
+}
+
+void XLTraceScopeEnd(XLTraceScope *scope) {
+    if (scope->start == 0 || !XLTraceIsEnabled()) return;
+    recordEvent(scope->name, scope->category, scope->start, XLTraceNow(), 0);
+}
+
+void XLTraceRecordAsync(const char *name, const char *category, uint64_t start) {
+    if (start == 0 || !XLTraceIsEnabled()) return;
+    recordEvent(name, category, start, XLTraceNow(), 1);
+}
+
+static void writeJSONString(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+/// Microseconds since tracing started, as Chrome expects
+static double traceMicros(uint64_t ns) {
+    return ns > traceOrigin ? (double)(ns - traceOrigin) / 1000.0 : 0.0;
+}
+
+static void writeTraceEvents(FILE *out) {
+    int pid = (int)getpid();
+    unsigned long asyncId = 0;
+    BOOL first = YES;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+    pthread_mutex_lock(&buffersLock);
+    for (XLTraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", pid, buffer->tid);
+        first = NO;
+        if (buffer->threadName[0]) {
+            writeJSONString(out, buffer->threadName);
+        } else {
+            fprintf(out, "\"thread %u\"", buffer->tid);
+        }
+        fputs("}}", out);
+        uint64_t written = __atomic_load_n(&buffer->written, __ATOMIC_ACQUIRE);
+        uint64_t count = written < XL_TRACE_RING_CAPACITY ? written : XL_TRACE_RING_CAPACITY;
+        for (uint64_t i = written - count; i < written; i++) {
+            XLTraceEvent event = buffer->events[i % XL_TRACE_RING_CAPACITY];
+            if (event.async) {
+                asyncId++;
+                for (int edge = 0; edge < 2; edge++) {
+                    fputs(",\n{\"name\":", out);
+                    writeJSONString(out, event.name);
+                    fputs(",\"cat\":", out);
+                    writeJSONString(out, event.category);
+                    fprintf(out, ",\"ph\":\"%c\",\"id\":%lu,\"pid\":%d,\"tid\":%u,\"ts\":%.3f}", edge == 0 ? 'b' : 'e',
+                            asyncId, pid, buffer->tid, traceMicros(edge == 0 ? event.start : event.end));
+                }
+            } else {
+                fputs(",\n{\"name\":", out);
+                writeJSONString(out, event.name);
+                fputs(",\"cat\":", out);
+                writeJSONString(out, event.category);
+                fprintf(out, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", pid, buffer->tid,
+                        traceMicros(event.start), (double)(event.end - event.start) / 1000.0);
+            }
+        }
+    }
+    pthread_mutex_unlock(&buffersLock);
+    fputs("\n]}\n", out);
+}
+
+BOOL XLTraceWriteToPath(NSString *path, NSError **error) {
+    BOOL ok = XLWriteFileAtomically(path, ^BOOL(FILE *out) {
+        writeTraceEvents(out);
+        return ferror(out) == 0;
+    });
+    if (!ok && error) {
+        *error = [NSError errorWithDomain:@"XLTrace" code:2
+                                 userInfo:@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Cannot write %@", path] }];
+    }
+    return ok;
+}
+
+void XLTraceStart(NSString *outputPath) {
+    pthread_mutex_lock(&buffersLock);
+    /* Spans of exited threads would be discarded below anyway */
+    freeExitedBuffers(NULL);
+    for (XLTraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+        __atomic_store_n(&buffer->written, 0, __ATOMIC_RELEASE);
+    }
+    [traceOutputPath release];
+    traceOutputPath = [outputPath copy];
+    traceOrigin = XLTraceNow();
+    pthread_mutex_unlock(&buffersLock);
+    __atomic_store_n(&XLTraceActive, 1, __ATOMIC_RELEASE);
+}
+
+void XLTraceStop(void) {
+    if (!XLTraceIsEnabled()) return;
+    __atomic_store_n(&XLTraceActive, 0, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&buffersLock);
+    NSString *path = [[traceOutputPath retain] autorelease];
+    pthread_mutex_unlock(&buffersLock);
+    if (!path) return;
+    NSError *error = nil;
+    if (XLTraceWriteToPath(path, &error)) {
+        NSLog(@"XLTrace: wrote %@", path);
+    } else {
+        NSLog(@"XLTrace: %@", [error localizedDescription]);
+    }
+    pthread_mutex_lock(&buffersLock);
+    freeExitedBuffers(NULL);
+    pthread_mutex_unlock(&buffersLock);
+}
+
+static void stopAtExit(void) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    XLTraceStop();
+    [pool drain];
+}
+
+static void registerStopAtExit(void) {
+    atexit(stopAtExit);
+}
+
+BOOL XLTraceStartFromEnvironment(void) {
+    const char *env = getenv("XENOLEXIA_TRACE");
+    NSString *path = (env && *env) ? [NSString stringWithUTF8String:env]
+                                   : [[NSUserDefaults standardUserDefaults] stringForKey:@"XenolexiaTracePath"];
+    if ([path length] == 0) return NO;
+    static pthread_once_t atExitOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&atExitOnce, registerStopAtExit);
+    XLTraceStart([path stringByExpandingTildeInPath]);
+    return YES;
+}
@@ -0,0 +1,26 @@
+//
+//  XLXMLParserPool.h
+//  Xenolexia
+//
+//  libxml2 parsing through per-thread parser contexts that are reset between documents instead of
+//  being rebuilt, with an optional dictionary shared by all the documents of one book.
+//
+
+#import <Foundation/Foundation.h>
+#import <libxml/tree.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A dictionary interns element and attribute names. Documents keep a reference to the dictionary they
+/// were parsed with, so it may be released while they are still in use. A dictionary is not thread-safe:
+/// use a book's dictionary on one thread at a time (a book is parsed on one thread).
+xmlDict * _Nullable XLXMLDictCreate(void);
+void XLXMLDictRelease(xmlDict * _Nullable dict);
+
+/// Parse with this thread's reusable XML or HTML parser context. A NULL dict uses the thread's own
+/// dictionary, which is replaced once it grows large. Returns NULL on failure; free with xmlFreeDoc.
+xmlDoc * _Nullable XLXMLReadMemory(const void *bytes, size_t length, xmlDict * _Nullable dict, int options);
+xmlDoc * _Nullable XLXMLReadFile(const char *path, xmlDict * _Nullable dict, int options);
+xmlDoc * _Nullable XLHTMLReadMemory(const void *bytes, size_t length, xmlDict * _Nullable dict, int options);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,124 @@
+//
+//  XLXMLParserPool.m
+//  Xenolexia
+//
+
+#import "XLXMLParserPool.h"
+#import "XLMetrics.h"
+#import <libxml/parser.h>
+#import <libxml/HTMLparser.h>
+#import <libxml/dict.h>
+#import <limits.h>
+#import <pthread.h>
+#import <stdlib.h>
+
+/* The thread's own dictionary is swapped for a fresh one past this many names, so a long-lived
+   worker parsing many unrelated books does not grow it without bound */
+#define XL_THREAD_DICT_MAX_ENTRIES 16384
+
+typedef struct {
+    xmlParserCtxtPtr xml;
+    htmlParserCtxtPtr html;
+    xmlDict *dict;
+} XLXMLThreadParsers;
+
+static pthread_once_t parsersKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t parsersKey;
+
+static void freeThreadParsers(void *value) {
+    XLXMLThreadParsers *parsers = value;
+    if (parsers->xml) xmlFreeParserCtxt(parsers->xml);
+    if (parsers->html) htmlFreeParserCtxt(parsers->html);
+    if (parsers->dict) xmlDictFree(parsers->dict);
+    free(parsers);
+}
+
+static void makeParsersKey(void) {
+    xmlInitParser();
+    pthread_key_create(&parsersKey, freeThreadParsers);
+}
+
+static XLXMLThreadParsers *threadParsers(void) {
+    pthread_once(&parsersKeyOnce, makeParsersKey);
+    XLXMLThreadParsers *parsers = pthread_getspecific(parsersKey);
+    if (parsers) return parsers;
+    parsers = calloc(1, sizeof(XLXMLThreadParsers));
+    if (parsers) pthread_setspecific(parsersKey, parsers);
+    return parsers;
+}
+
+xmlDict *XLXMLDictCreate(void) {
+    pthread_once(&parsersKeyOnce, makeParsersKey);
+    return xmlDictCreate();
+}
+
+void XLXMLDictRelease(xmlDict *dict) {
+    if (dict) xmlDictFree(dict);
+}
+
+/// Point ctxt at dict (or the thread's own). The context's reset re-interns its cached "xml"/"xmlns"
+/// names, so the swap must happen before the ReadMemory/ReadFile call, which resets first.
+static void useDictionary(XLXMLThreadParsers *parsers, xmlParserCtxtPtr ctxt, xmlDict *dict) {
+    if (!dict) {
+        if (!parsers->dict || xmlDictSize(parsers->dict) > XL_THREAD_DICT_MAX_ENTRIES) {
+            if (parsers->dict) xmlDictFree(parsers->dict);
+            parsers->dict = xmlDictCreate();
+        }
+        dict = parsers->dict;
+    }
+    if (!dict || ctxt->dict == dict) return;
+    if (xmlDictReference(dict) != 0) return;
+    if (ctxt->dict) xmlDictFree(ctxt->dict);
+    ctxt->dict = dict;
+}
+
+static xmlParserCtxtPtr xmlContext(XLXMLThreadParsers *parsers) {
+    if (!parsers->xml) {
+        parsers->xml = xmlNewParserCtxt();
+    } else {
+        XLMetricAdd(XL_COUNTER("xml.context.reused"), 1);
+    }
+    return parsers->xml;
+}
+
+static htmlParserCtxtPtr htmlContext(XLXMLThreadParsers *parsers) {
+    if (!parsers->html) {
+        parsers->html = htmlNewParserCtxt();
+    } else {
+        XLMetricAdd(XL_COUNTER("xml.context.reused"), 1);
+    }
+    return parsers->html;
+}
+
+xmlDoc *XLXMLReadMemory(const void *bytes, size_t length, xmlDict *dict, int options) {
+    if (!bytes || length > INT_MAX) return NULL;
+    XLXMLThreadParsers *parsers = threadParsers();
+    xmlParserCtxtPtr ctxt = parsers ? xmlContext(parsers) : NULL;
+    if (!ctxt) return xmlReadMemory(bytes, (int)length, NULL, NULL, options);
+    useDictionary(parsers, ctxt, dict);
+    xmlDoc *doc = xmlCtxtReadMemory(ctxt, bytes, (int)length, NULL, NULL, options);
+    xmlCtxtReset(ctxt);     // drop references to the input now rather than at the next parse
+    return doc;
+}
+
+xmlDoc *XLXMLReadFile(const char *path, xmlDict *dict, int options) {
+    if (!path) return NULL;
+    XLXMLThreadParsers *parsers = threadParsers();
+    xmlParserCtxtPtr ctxt = parsers ? xmlContext(parsers) : NULL;
+    if (!ctxt) return xmlReadFile(path, NULL, options);
+    useDictionary(parsers, ctxt, dict);
+    xmlDoc *doc = xmlCtxtReadFile(ctxt, path, NULL, options);
+    xmlCtxtReset(ctxt);
+    return doc;
+}
+
+xmlDoc *XLHTMLReadMemory(const void *bytes, size_t length, xmlDict *dict, int options) {
+    if (!bytes || length > INT_MAX) return NULL;
+    XLXMLThreadParsers *parsers = threadParsers();
+    htmlParserCtxtPtr ctxt = parsers ? htmlContext(parsers) : NULL;
+    if (!ctxt) return htmlReadMemory(bytes, (int)length, NULL, NULL, options);
+    useDictionary(parsers, ctxt, dict);
+    xmlDoc *doc = htmlCtxtReadMemory(ctxt, bytes, (int)length, NULL, NULL, options);
+    htmlCtxtReset(ctxt);
+    return doc;
+}
@@ -6,20 +6,25 @@
 #import "XLBookParserService.h"
 #import "XLEpubParser.h"
 #import "XLNativeParsers.h"
+#import "XLBookTextFile.h"
 #import "SSFileSystem.h"
+#import "../Native/XLMetrics.h"
+#import "../Native/XLTrace.h"
 
 @implementation XLBookParserService
 
 + (instancetype)sharedService {
     static XLBookParserService *sharedService = nil;
-    if (sharedService == nil) {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
         sharedService = [[self alloc] init];
-    }
+    });
     return sharedService;
 }
 
 - (void)parseBookAtPath:(NSString *)filePath
           withCompletion:(void(^)(XLParsedBook * _Nullable parsedBook, NSError * _Nullable error))completion {
+    XL_TRACE_SCOPE("book.parse", "parse");
     if (!filePath || filePath.length == 0) {
         if (completion) {
             NSDictionary *userInfo = [NSDictionary dictionaryWithObject:@"File path is empty"
@@ -46,22 +51,40 @@
     // Detect format
     XLBookFormat format = [self detectFormat:filePath];
     
+    // Time each format separately and count failures
+    XLMetric *parseHistogram = NULL;
+    switch (format) {
+        case XLBookFormatEpub: parseHistogram = XL_HISTOGRAM("parse.epub"); break;
+        case XLBookFormatTxt: parseHistogram = XL_HISTOGRAM("parse.txt"); break;
+        case XLBookFormatPdf: parseHistogram = XL_HISTOGRAM("parse.pdf"); break;
+        case XLBookFormatFb2: parseHistogram = XL_HISTOGRAM("parse.fb2"); break;
+        case XLBookFormatMobi: parseHistogram = XL_HISTOGRAM("parse.mobi"); break;
+        default: break;
+    }
+    uint64_t parseStart = XLTraceNow();
+    void (^timedCompletion)(XLParsedBook *, NSError *) = ^(XLParsedBook *parsedBook, NSError *error) {
+        XLMetricRecordSince(parseHistogram, parseStart);
+        if (!parsedBook) XLMetricAdd(XL_COUNTER("parse.errors"), 1);
+        else [self mapChaptersOfBook:parsedBook fromPath:filePath];
+        if (completion) completion(parsedBook, error);
+    };
+    
     // Parse based on format
     switch (format) {
         case XLBookFormatEpub:
-            [self parseEpubAtPath:filePath withCompletion:completion];
+            [self parseEpubAtPath:filePath withCompletion:timedCompletion];
             break;
         case XLBookFormatTxt:
-            [self parseTxtAtPath:filePath withCompletion:completion];
+            [self parseTxtAtPath:filePath withCompletion:timedCompletion];
             break;
         case XLBookFormatPdf:
-            [self parsePdfAtPath:filePath withCompletion:completion];
+            [self parsePdfAtPath:filePath withCompletion:timedCompletion];
             break;
         case XLBookFormatFb2:
-            [self parseFb2AtPath:filePath withCompletion:completion];
+            [self parseFb2AtPath:filePath withCompletion:timedCompletion];
             break;
         case XLBookFormatMobi:
-            [self parseMobiAtPath:filePath withCompletion:completion];
+            [self parseMobiAtPath:filePath withCompletion:timedCompletion];
             break;
         default:
             if (completion) {
@@ -76,6 +99,14 @@
 - (void)getChapterAtIndex:(NSInteger)chapterIndex
                  fromPath:(NSString *)filePath
            withCompletion:(void(^)(XLChapter * _Nullable chapter, NSError * _Nullable error))completion {
+    // Opened before: map the extracted text instead of parsing the whole book again
+    NSString *textPath = [XLBookTextFile pathForBookAtPath:filePath];
+    NSArray *cached = textPath ? [XLBookTextFile chaptersWithContentsOfFile:textPath error:NULL] : nil;
+    if (cached && chapterIndex >= 0 && chapterIndex < (NSInteger)[cached count]) {
+        XLMetricAdd(XL_COUNTER("parse.text_file.hit"), 1);
+        if (completion) completion([cached objectAtIndex:chapterIndex], nil);
+        return;
+    }
     [self parseBookAtPath:filePath withCompletion:^(XLParsedBook * _Nullable parsedBook, NSError * _Nullable error) {
         if (error) {
             if (completion) completion(nil, error);
@@ -129,6 +160,29 @@
 
 #pragma mark - Private Methods
 
+/// Save the book's chapter text to its extracted-text file (first parse only) and point each chapter at
+/// its slice of the mapped file, releasing the parsed copies. On failure the chapters keep their own UTF-8.
+- (void)mapChaptersOfBook:(XLParsedBook *)parsedBook fromPath:(NSString *)filePath {
+    XL_TRACE_SCOPE("book.mapText", "parse");
+    NSString *textPath = [XLBookTextFile pathForBookAtPath:filePath];
+    if (!textPath) return;
+    NSArray *chapters = parsedBook.chapters;
+    NSArray *mapped = [XLBookTextFile chaptersWithContentsOfFile:textPath error:NULL];
+    if ([mapped count] != [chapters count]) {
+        NSError *error = nil;
+        if (![XLBookTextFile writeChapters:chapters toPath:textPath error:&error]) {
+            NSLog(@"XLBookParserService: %@", [error localizedDescription]);
+            return;
+        }
+        mapped = [XLBookTextFile chaptersWithContentsOfFile:textPath error:NULL];
+        if ([mapped count] != [chapters count]) return;
+    }
+    for (NSUInteger i = 0; i < [chapters count]; i++) {
+        XLChapter *chapter = [chapters objectAtIndex:i];
+        chapter.contentText = [(XLChapter *)[mapped objectAtIndex:i] contentText];
+    }
+}
+
 - (XLBookFormat)detectFormat:(NSString *)filePath {
     NSString *extension = [[filePath pathExtension] lowercaseString];
     if ([extension isEqualToString:@"epub"]) return XLBookFormatEpub;
@@ -141,6 +195,7 @@
 
 - (void)parseTxtAtPath:(NSString *)filePath
         withCompletion:(void(^)(XLParsedBook * _Nullable parsedBook, NSError * _Nullable error))completion {
+    XL_TRACE_SCOPE("txt.parse", "parse");
     NSError *error = nil;
     NSString *content = [NSString stringWithContentsOfFile:filePath
                                                    encoding:NSUTF8StringEncoding
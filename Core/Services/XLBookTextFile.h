@@ -0,0 +1,28 @@
+//
+//  XLBookTextFile.h
+//  Xenolexia
+//
+//  Per-book extracted-text file: every chapter's title, href, word count and UTF-8 text in one file
+//  that is memory-mapped rather than read, so only the pages of chapters actually used become resident.
+
+#import <Foundation/Foundation.h>
+#import "../Models/Book.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface XLBookTextFile : NSObject
+
+/// Cache path for the book file at bookPath (under the cache directory). The name is derived from the
+/// path, size and modification date, so an edited or replaced book gets a fresh file. nil if the book is missing.
++ (nullable NSString *)pathForBookAtPath:(NSString *)bookPath;
+
+/// Write chapters in order, atomically (a uniquely named temporary file renamed into place)
++ (BOOL)writeChapters:(NSArray *)chapters toPath:(NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+/// Chapters read from a mapped file; their contentText slices the mapping and keeps it alive.
+/// nil if the file is missing, truncated or from another format version.
++ (nullable NSArray *)chaptersWithContentsOfFile:(NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,153 @@
+//
+//  XLBookTextFile.m
+//  Xenolexia
+//
+
+#import "XLBookTextFile.h"
+#import "SSFileSystem.h"
+#import "../Native/XLChapterText.h"
+#import "../Native/XLSha256.h"
+#import "../Native/XLAtomicFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Layout (native byte order; the file is a local cache): header, count entries, then for each chapter
+/// its title, href and content bytes back to back starting at the entry's offset.
+static const char kTextFileMagic[4] = { 'X', 'L', 'T', 'X' };
+static const uint32_t kTextFileVersion = 1;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} XLTextFileHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t contentLength;
+    uint32_t titleLength;
+    uint32_t hrefLength;
+    int64_t wordCount;
+} XLTextFileEntry;
+
+static NSError *textFileError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:@"XLBookTextFile" code:code userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+@implementation XLBookTextFile
+
++ (NSString *)pathForBookAtPath:(NSString *)bookPath {
+    SSFileSystem *fs = [SSFileSystem sharedFileSystem];
+    NSDictionary *attributes = [fs attributesOfItemAtPath:bookPath error:NULL];
+    if (!attributes) return nil;
+    NSString *key = [NSString stringWithFormat:@"%@\n%llu\n%.0f", [bookPath stringByStandardizingPath],
+                     [[attributes objectForKey:NSFileSize] unsignedLongLongValue],
+                     [[attributes objectForKey:NSFileModificationDate] timeIntervalSince1970]];
+    const char *keyBytes = [key UTF8String];
+    XLSha256Context ctx;
+    uint8_t digest[32];
+    XLSha256Init(&ctx);
+    XLSha256Update(&ctx, keyBytes, strlen(keyBytes));
+    XLSha256Final(&ctx, digest);
+    NSMutableString *name = [NSMutableString stringWithCapacity:40];
+    for (int i = 0; i < 16; i++) {
+        [name appendFormat:@"%02x", digest[i]];
+    }
+    [name appendString:@".xltext"];
+    NSString *dir = [[[fs cacheDirectory] stringByAppendingPathComponent:@"xenolexia"] stringByAppendingPathComponent:@"text"];
+    if (![fs fileExistsAtPath:dir]) {
+        [fs createDirectoryAtPath:dir error:NULL];
+    }
+    return [dir stringByAppendingPathComponent:name];
+}
+
++ (BOOL)writeChapters:(NSArray *)chapters toPath:(NSString *)path error:(NSError **)error {
+    NSUInteger count = [chapters count];
+    XLTextFileEntry *entries = calloc(count > 0 ? count : 1, sizeof(XLTextFileEntry));
+    if (!entries) {
+        if (error) *error = textFileError(1, @"Out of memory");
+        return NO;
+    }
+    NSMutableArray *titles = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray *hrefs = [NSMutableArray arrayWithCapacity:count];
+    uint64_t offset = sizeof(XLTextFileHeader) + count * sizeof(XLTextFileEntry);
+    for (NSUInteger i = 0; i < count; i++) {
+        XLChapter *chapter = [chapters objectAtIndex:i];
+        NSData *title = [chapter.title ?: @"" dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+        NSData *href = [chapter.href ?: @"" dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+        [titles addObject:title];
+        [hrefs addObject:href];
+        entries[i].offset = offset;
+        entries[i].titleLength = (uint32_t)[title length];
+        entries[i].hrefLength = (uint32_t)[href length];
+        entries[i].contentLength = [chapter.contentText UTF8Length];
+        entries[i].wordCount = chapter.wordCount;
+        offset += entries[i].titleLength + entries[i].hrefLength + entries[i].contentLength;
+    }
+
+    XLTextFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTextFileMagic, sizeof(header.magic));
+    header.version = kTextFileVersion;
+    header.count = (uint32_t)count;
+    BOOL ok = XLWriteFileAtomically(path, ^BOOL(FILE *out) {
+        BOOL written = fwrite(&header, sizeof(header), 1, out) == 1;
+        if (written && count > 0) written = fwrite(entries, sizeof(XLTextFileEntry), count, out) == count;
+        for (NSUInteger i = 0; written && i < count; i++) {
+            NSData *title = [titles objectAtIndex:i];
+            NSData *href = [hrefs objectAtIndex:i];
+            XLChapterText *text = [(XLChapter *)[chapters objectAtIndex:i] contentText];
+            written = fwrite([title bytes], 1, [title length], out) == [title length]
+                && fwrite([href bytes], 1, [href length], out) == [href length]
+                && fwrite([text UTF8Bytes], 1, [text UTF8Length], out) == [text UTF8Length];
+        }
+        return written;
+    });
+    free(entries);
+    if (!ok && error) *error = textFileError(2, [NSString stringWithFormat:@"Cannot write %@", path]);
+    return ok;
+}
+
++ (NSArray *)chaptersWithContentsOfFile:(NSString *)path error:(NSError **)error {
+    NSData *storage = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:error];
+    if (!storage) return nil;
+    const uint8_t *bytes = [storage bytes];
+    uint64_t length = [storage length];
+    XLTextFileHeader header;
+    if (length < sizeof(header)) {
+        if (error) *error = textFileError(3, @"Extracted text file is truncated");
+        return nil;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, kTextFileMagic, sizeof(header.magic)) != 0 || header.version != kTextFileVersion
+        || (uint64_t)header.count > (length - sizeof(header)) / sizeof(XLTextFileEntry)) {
+        if (error) *error = textFileError(4, @"Not an extracted text file of this version");
+        return nil;
+    }
+    NSMutableArray *chapters = [NSMutableArray arrayWithCapacity:header.count];
+    for (uint32_t i = 0; i < header.count; i++) {
+        XLTextFileEntry entry;
+        memcpy(&entry, bytes + sizeof(header) + i * sizeof(XLTextFileEntry), sizeof(entry));
+        uint64_t prefix = (uint64_t)entry.titleLength + entry.hrefLength;
+        if (entry.offset > length || prefix > length - entry.offset || entry.contentLength > length - entry.offset - prefix) {
+            if (error) *error = textFileError(3, @"Extracted text file is truncated");
+            return nil;
+        }
+        const char *title = (const char *)bytes + entry.offset;
+        XLChapter *chapter = [[[XLChapter alloc] init] autorelease];
+        chapter.index = i;
+        chapter.title = [[[NSString alloc] initWithBytes:title length:entry.titleLength encoding:NSUTF8StringEncoding] autorelease] ?: @"";
+        if (entry.hrefLength > 0) {
+            chapter.href = [[[NSString alloc] initWithBytes:title + entry.titleLength length:entry.hrefLength encoding:NSUTF8StringEncoding] autorelease];
+        }
+        chapter.wordCount = (NSInteger)entry.wordCount;
+        chapter.contentText = [[[XLChapterText alloc] initWithStorage:storage
+                                                                range:NSMakeRange((NSUInteger)(entry.offset + prefix), (NSUInteger)entry.contentLength)] autorelease];
+        [chapters addObject:chapter];
+    }
+    return chapters;
+}
+
+@end
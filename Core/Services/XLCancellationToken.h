@@ -0,0 +1,31 @@
+//
+//  XLCancellationToken.h
+//  Xenolexia
+//
+//  Cooperative cancellation shared between a caller and the work it started.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Thread-safe, one-way cancellation flag. Work either polls -isCancelled or registers a handler.
+@interface XLCancellationToken : NSObject {
+    NSLock *_lock;
+    BOOL _cancelled;
+    NSMutableArray *_handlers;
+}
+
++ (instancetype)token;
+
+/// Mark cancelled and run registered handlers once, on the calling thread. Later calls do nothing.
+- (void)cancel;
+- (BOOL)isCancelled;
+
+/// Run handler on cancellation; runs immediately if already cancelled. Returns a registration to unregister with.
+- (id)registerCancellationHandler:(void(^)(void))handler;
+- (void)unregisterCancellationHandler:(nullable id)registration;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,74 @@
+//
+//  XLCancellationToken.m
+//  Xenolexia
+//
+
+#import "XLCancellationToken.h"
+
+@implementation XLCancellationToken
+
++ (instancetype)token {
+    return [[[self alloc] init] autorelease];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _lock = [[NSLock alloc] init];
+        _cancelled = NO;
+        _handlers = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_lock release];
+    [_handlers release];
+    [super dealloc];
+}
+
+- (void)cancel {
+    [_lock lock];
+    if (_cancelled) {
+        [_lock unlock];
+        return;
+    }
+    _cancelled = YES;
+    NSArray *handlers = [_handlers copy];
+    [_handlers removeAllObjects];
+    [_lock unlock];
+    for (void (^handler)(void) in handlers) {
+        handler();
+    }
+    [handlers release];
+}
+
+- (BOOL)isCancelled {
+    [_lock lock];
+    BOOL cancelled = _cancelled;
+    [_lock unlock];
+    return cancelled;
+}
+
+- (id)registerCancellationHandler:(void(^)(void))handler {
+    id registration = [[handler copy] autorelease];
+    [_lock lock];
+    BOOL runNow = _cancelled;
+    if (!runNow) {
+        [_handlers addObject:registration];
+    }
+    [_lock unlock];
+    if (runNow) {
+        handler();
+    }
+    return registration;
+}
+
+- (void)unregisterCancellationHandler:(id)registration {
+    if (!registration) return;
+    [_lock lock];
+    [_handlers removeObjectIdenticalTo:registration];
+    [_lock unlock];
+}
+
+@end
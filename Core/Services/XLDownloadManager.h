@@ -0,0 +1,121 @@
+//
+//  XLDownloadManager.h
+//  Xenolexia
+//
+//  Queued, resumable, segmented book downloads with integrity checks.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, XLDownloadState) {
+    XLDownloadStateQueued = 0,
+    XLDownloadStateDownloading,
+    XLDownloadStateVerifying,
+    XLDownloadStateCompleted,
+    XLDownloadStateFailed,
+    XLDownloadStatePaused
+};
+
+extern NSString *const XLDownloadManagerErrorDomain;
+
+typedef NS_ENUM(NSInteger, XLDownloadError) {
+    XLDownloadErrorFailed = 1,
+    XLDownloadErrorSizeMismatch = 2,
+    XLDownloadErrorHashMismatch = 3,
+    XLDownloadErrorCancelled = 4
+};
+
+/// One requested download. Configure before enqueueing; the state fields are updated by the manager
+/// before each delegate callback.
+@interface XLDownloadItem : NSObject {
+    NSString *_identifier;
+    NSURL *_url;
+    NSString *_destinationPath;
+    int64_t _expectedSize;
+    NSString *_expectedSHA256;
+    BOOL _importWhenDone;
+    XLDownloadState _state;
+    int64_t _bytesReceived;
+    int64_t _totalBytes;
+    NSError *_error;
+}
+
++ (instancetype)itemWithURL:(NSURL *)url destinationPath:(NSString *)destinationPath;
+
+@property (nonatomic, readonly, copy) NSString *identifier;
+@property (nonatomic, readonly, retain) NSURL *url;
+@property (nonatomic, readonly, copy) NSString *destinationPath;
+/// Required final size in bytes; 0 = accept whatever Content-Length says
+@property (nonatomic, assign) int64_t expectedSize;
+/// Lowercase hex SHA-256 the finished file must match; nil = no hash check
+@property (nonatomic, copy, nullable) NSString *expectedSHA256;
+/// Hand the verified file to XLManager's import pipeline (default YES)
+@property (nonatomic, assign) BOOL importWhenDone;
+
+@property (nonatomic, readonly) XLDownloadState state;
+@property (nonatomic, readonly) int64_t bytesReceived;
+/// 0 until known
+@property (nonatomic, readonly) int64_t totalBytes;
+@property (nonatomic, readonly, retain, nullable) NSError *error;
+
+@end
+
+@class XLDownloadManager;
+@class XLBook;
+
+/// Callbacks arrive on the main queue. Progress is coalesced to a few updates per second per item.
+@protocol XLDownloadManagerDelegate <NSObject>
+@optional
+- (void)downloadManager:(XLDownloadManager *)manager didUpdateItem:(XLDownloadItem *)item;
+/// error is set for failed, cancelled and unverifiable downloads (nil when paused or completed)
+- (void)downloadManager:(XLDownloadManager *)manager didFinishItem:(XLDownloadItem *)item error:(nullable NSError *)error;
+- (void)downloadManager:(XLDownloadManager *)manager didImportItem:(XLDownloadItem *)item book:(nullable XLBook *)book error:(nullable NSError *)error;
+@end
+
+/// Runs up to maxConcurrentDownloads items at once; the rest wait FIFO.
+/// - Data goes to "<destination>.part"; a "<destination>.part.plist" sidecar records the URL, validator
+///   (ETag/Last-Modified) and per-segment progress, so an interrupted or paused item resumes with Range.
+/// - When HEAD reports Accept-Ranges and a known length, large files are split into up to
+///   maxSegmentsPerDownload ranges fetched in parallel and written in place with pwrite.
+/// - Transient segment failures retry with backoff from where they stopped.
+/// - On completion the size and optional SHA-256 are verified before the .part file is renamed.
+@interface XLDownloadManager : NSObject {
+    dispatch_queue_t _queue;
+    NSMutableArray *_pending;       // XLDownloadItem, FIFO
+    NSMutableArray *_jobs;          // active XLDownloadJob
+    NSUInteger _maxConcurrentDownloads;
+    NSUInteger _maxSegmentsPerDownload;
+    int64_t _minSegmentSize;
+    NSUInteger _maxRetries;
+    id<XLDownloadManagerDelegate> _delegate;
+}
+
++ (instancetype)sharedManager;
+
+/// Default 3
+@property (nonatomic, assign) NSUInteger maxConcurrentDownloads;
+/// Default 4
+@property (nonatomic, assign) NSUInteger maxSegmentsPerDownload;
+/// Files smaller than twice this are fetched as one range (default 4 MB)
+@property (nonatomic, assign) int64_t minSegmentSize;
+/// Retries per segment before the item fails, resuming from the last byte written (default 5)
+@property (nonatomic, assign) NSUInteger maxRetries;
+@property (nonatomic, assign, nullable) id<XLDownloadManagerDelegate> delegate;
+
+- (void)enqueueItem:(XLDownloadItem *)item;
+/// Convenience: queue url into directory under its last path component
+- (XLDownloadItem *)enqueueDownloadFromURL:(NSURL *)url toDirectory:(NSString *)directory;
+
+/// Stop transfers but keep the .part file and sidecar; enqueue the item again to resume
+- (void)pauseItem:(XLDownloadItem *)item;
+/// Stop transfers and delete partial data
+- (void)cancelItem:(XLDownloadItem *)item;
+
+/// Snapshot of queued and active items
+- (NSArray *)items;
+
+@end
+
+NS_ASSUME_NONNULL_END
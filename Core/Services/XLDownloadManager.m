@@ -0,0 +1,689 @@
+//
+//  XLDownloadManager.m
+//  Xenolexia
+//
+
+#import "XLDownloadManager.h"
+#import "XLHTTPClient.h"
+#import "XLCancellationToken.h"
+#import "XLManager.h"
+#import "../Native/XLMetrics.h"
+#import "../Native/XLSha256.h"
+#import <curl/curl.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <errno.h>
+#import <sys/stat.h>
+#import <math.h>
+
+NSString *const XLDownloadManagerErrorDomain = @"XLDownloadManager";
+
+static const NSTimeInterval kProgressInterval = 0.25;
+static const NSTimeInterval kSidecarInterval = 2.0;
+static const NSTimeInterval kMaxRetryDelay = 30.0;
+
+typedef NS_ENUM(NSInteger, XLDownloadStop) {
+    XLDownloadStopNone = 0,
+    XLDownloadStopPause,
+    XLDownloadStopCancel,
+    XLDownloadStopFail
+};
+
+static NSError *XLDownloadError(XLDownloadError code, NSString *description) {
+    return [NSError errorWithDomain:XLDownloadManagerErrorDomain code:code userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+#pragma mark - XLDownloadItem
+
+@interface XLDownloadItem ()
+@property (nonatomic, readwrite) XLDownloadState state;
+@property (nonatomic, readwrite) int64_t bytesReceived;
+@property (nonatomic, readwrite) int64_t totalBytes;
+@property (nonatomic, readwrite, retain) NSError *error;
+@end
+
+@implementation XLDownloadItem
+
+@synthesize identifier = _identifier;
+@synthesize url = _url;
+@synthesize destinationPath = _destinationPath;
+@synthesize expectedSize = _expectedSize;
+@synthesize expectedSHA256 = _expectedSHA256;
+@synthesize importWhenDone = _importWhenDone;
+@synthesize state = _state;
+@synthesize bytesReceived = _bytesReceived;
+@synthesize totalBytes = _totalBytes;
+@synthesize error = _error;
+
++ (instancetype)itemWithURL:(NSURL *)url destinationPath:(NSString *)destinationPath {
+    XLDownloadItem *item = [[[self alloc] init] autorelease];
+    item->_identifier = [[[NSUUID UUID] UUIDString] copy];
+    item->_url = [url retain];
+    item->_destinationPath = [destinationPath copy];
+    item->_importWhenDone = YES;
+    return item;
+}
+
+- (void)dealloc {
+    [_identifier release];
+    [_url release];
+    [_destinationPath release];
+    [_expectedSHA256 release];
+    [_error release];
+    [super dealloc];
+}
+
+@end
+
+#pragma mark - Private job state (manager queue only)
+
+/// Byte range [start, end] (end -1 = open-ended); next is the first byte not yet written
+@interface XLDownloadSegment : NSObject {
+@public
+    int64_t _start;
+    int64_t _end;
+    int64_t _next;
+    int64_t _written;
+    NSUInteger _retries;
+    BOOL _active;
+    BOOL _retired;                  // cancelled after a full-body reset; still holds the fd until it reports back
+    XLCancellationToken *_token;
+}
+@end
+
+@implementation XLDownloadSegment
+
+- (void)dealloc {
+    [_token release];
+    [super dealloc];
+}
+
+- (BOOL)isDone {
+    return _end >= 0 && _next > _end;
+}
+
+@end
+
+@interface XLDownloadJob : NSObject {
+@public
+    XLDownloadItem *_item;
+    NSString *_partPath;
+    NSString *_sidecarPath;
+    NSMutableArray *_segments;
+    NSString *_validator;
+    int64_t _total;
+    int _fd;
+    NSUInteger _retiredInFlight;    // retired segments not yet reported back
+    BOOL _retiredWrote;             // a retired segment wrote after the reset; its bytes may clobber the new body
+    BOOL _probing;
+    BOOL _verifying;
+    XLCancellationToken *_probeToken;
+    XLDownloadStop _stop;
+    NSError *_stopError;
+    NSTimeInterval _lastProgress;
+    NSTimeInterval _lastSidecar;
+    uint64_t _startedAt;
+}
+@end
+
+@implementation XLDownloadJob
+
+- (void)dealloc {
+    [_item release];
+    [_partPath release];
+    [_sidecarPath release];
+    [_segments release];
+    [_validator release];
+    [_probeToken release];
+    [_stopError release];
+    [super dealloc];
+}
+
+@end
+
+@interface XLDownloadManager ()
+- (XLDownloadJob *)jobForItem:(XLDownloadItem *)item;
+- (void)startPendingJobs;
+- (void)beginJob:(XLDownloadJob *)job;
+- (BOOL)restoreJobFromSidecar:(XLDownloadJob *)job;
+- (void)planSegmentsForJob:(XLDownloadJob *)job acceptsRanges:(BOOL)acceptsRanges;
+- (BOOL)openPartFileForJob:(XLDownloadJob *)job fresh:(BOOL)fresh;
+- (void)startSegment:(XLDownloadSegment *)segment ofJob:(XLDownloadJob *)job;
+- (void)segment:(XLDownloadSegment *)segment ofJob:(XLDownloadJob *)job finishedFrom:(int64_t)base status:(long)status error:(NSError *)error;
+- (void)settleResetOfJob:(XLDownloadJob *)job;
+- (void)persistSidecarForJob:(XLDownloadJob *)job;
+- (void)updateProgressForJob:(XLDownloadJob *)job force:(BOOL)force;
+- (void)stopJob:(XLDownloadJob *)job reason:(XLDownloadStop)reason error:(NSError *)error;
+- (void)finalizeJobIfIdle:(XLDownloadJob *)job;
+- (void)verifyJob:(XLDownloadJob *)job;
+- (void)finishJob:(XLDownloadJob *)job state:(XLDownloadState)state error:(NSError *)error;
+- (void)importItem:(XLDownloadItem *)item;
+@end
+
+@implementation XLDownloadManager
+
+@synthesize maxConcurrentDownloads = _maxConcurrentDownloads;
+@synthesize maxSegmentsPerDownload = _maxSegmentsPerDownload;
+@synthesize minSegmentSize = _minSegmentSize;
+@synthesize maxRetries = _maxRetries;
+@synthesize delegate = _delegate;
+
++ (instancetype)sharedManager {
+    static XLDownloadManager *sharedManager = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("xenolexia.downloads", DISPATCH_QUEUE_SERIAL);
+        _pending = [[NSMutableArray alloc] init];
+        _jobs = [[NSMutableArray alloc] init];
+        _maxConcurrentDownloads = 3;
+        _maxSegmentsPerDownload = 4;
+        _minSegmentSize = 4 * 1024 * 1024;
+        _maxRetries = 5;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    dispatch_release(_queue);
+    [_pending release];
+    [_jobs release];
+    [super dealloc];
+}
+
+#pragma mark - Public API
+
+- (void)enqueueItem:(XLDownloadItem *)item {
+    dispatch_async(_queue, ^{
+        if ([_pending indexOfObjectIdenticalTo:item] != NSNotFound || [self jobForItem:item]) return;
+        item.state = XLDownloadStateQueued;
+        item.error = nil;
+        [_pending addObject:item];
+        [self startPendingJobs];
+    });
+}
+
+- (XLDownloadItem *)enqueueDownloadFromURL:(NSURL *)url toDirectory:(NSString *)directory {
+    NSString *filename = [url lastPathComponent];
+    if ([filename length] == 0) filename = @"download";
+    XLDownloadItem *item = [XLDownloadItem itemWithURL:url destinationPath:[directory stringByAppendingPathComponent:filename]];
+    [self enqueueItem:item];
+    return item;
+}
+
+- (void)pauseItem:(XLDownloadItem *)item {
+    dispatch_async(_queue, ^{
+        if ([_pending indexOfObjectIdenticalTo:item] != NSNotFound) {
+            [_pending removeObjectIdenticalTo:item];
+            item.state = XLDownloadStatePaused;
+            return;
+        }
+        XLDownloadJob *job = [self jobForItem:item];
+        if (job) [self stopJob:job reason:XLDownloadStopPause error:nil];
+    });
+}
+
+- (void)cancelItem:(XLDownloadItem *)item {
+    dispatch_async(_queue, ^{
+        if ([_pending indexOfObjectIdenticalTo:item] != NSNotFound) {
+            [_pending removeObjectIdenticalTo:item];
+            item.state = XLDownloadStateFailed;
+            item.error = XLDownloadError(XLDownloadErrorCancelled, @"Download cancelled");
+            return;
+        }
+        XLDownloadJob *job = [self jobForItem:item];
+        if (job) [self stopJob:job reason:XLDownloadStopCancel error:XLDownloadError(XLDownloadErrorCancelled, @"Download cancelled")];
+    });
+}
+
+- (NSArray *)items {
+    __block NSMutableArray *items = [NSMutableArray array];
+    dispatch_sync(_queue, ^{
+        for (XLDownloadJob *job in _jobs) {
+            [items addObject:job->_item];
+        }
+        [items addObjectsFromArray:_pending];
+    });
+    return items;
+}
+
+#pragma mark - Scheduling
+
+- (XLDownloadJob *)jobForItem:(XLDownloadItem *)item {
+    for (XLDownloadJob *job in _jobs) {
+        if (job->_item == item) return job;
+    }
+    return nil;
+}
+
+- (void)startPendingJobs {
+    while ([_jobs count] < MAX(_maxConcurrentDownloads, (NSUInteger)1) && [_pending count] > 0) {
+        XLDownloadItem *item = [[_pending objectAtIndex:0] retain];
+        [_pending removeObjectAtIndex:0];
+        XLDownloadJob *job = [[XLDownloadJob alloc] init];
+        job->_item = item;
+        job->_partPath = [[[item destinationPath] stringByAppendingString:@".part"] copy];
+        job->_sidecarPath = [[job->_partPath stringByAppendingString:@".plist"] copy];
+        job->_segments = [[NSMutableArray alloc] init];
+        job->_fd = -1;
+        [_jobs addObject:job];
+        XLMetricSet(XL_GAUGE("download.active"), (int64_t)[_jobs count]);
+        [self beginJob:job];
+        [job release];
+    }
+}
+
+- (void)beginJob:(XLDownloadJob *)job {
+    job->_item.state = XLDownloadStateDownloading;
+    job->_startedAt = XLTraceNow();
+    if ([self restoreJobFromSidecar:job]) {
+        if ([self openPartFileForJob:job fresh:NO]) {
+            [self updateProgressForJob:job force:YES];
+            for (XLDownloadSegment *segment in job->_segments) {
+                [self startSegment:segment ofJob:job];
+            }
+            [self finalizeJobIfIdle:job];
+        }
+        return;
+    }
+
+    /* Probe size, range support and validator; if HEAD is refused a single open-ended GET still works */
+    job->_probing = YES;
+    job->_probeToken = [[XLCancellationToken token] retain];
+    [[XLHTTPClient sharedClient] fetchHeadersForURL:[job->_item.url absoluteString]
+                                            timeout:0
+                                  cancellationToken:job->_probeToken
+                                         completion:^(NSDictionary *headers, long statusCode, NSError *error) {
+        dispatch_async(_queue, ^{
+            job->_probing = NO;
+            if (job->_stop != XLDownloadStopNone) {
+                [self finalizeJobIfIdle:job];
+                return;
+            }
+            BOOL acceptsRanges = NO;
+            if (!error && statusCode >= 200 && statusCode < 300) {
+                job->_total = [[headers objectForKey:@"content-length"] longLongValue];
+                acceptsRanges = [[[headers objectForKey:@"accept-ranges"] lowercaseString] rangeOfString:@"bytes"].location != NSNotFound;
+                /* If-Range needs a strong validator */
+                NSString *etag = [headers objectForKey:@"etag"];
+                NSString *validator = ([etag length] > 0 && ![etag hasPrefix:@"W/"]) ? etag : [headers objectForKey:@"last-modified"];
+                job->_validator = [validator copy];
+            }
+            [self planSegmentsForJob:job acceptsRanges:acceptsRanges];
+            if (![self openPartFileForJob:job fresh:YES]) return;
+            [self persistSidecarForJob:job];
+            for (XLDownloadSegment *segment in job->_segments) {
+                [self startSegment:segment ofJob:job];
+            }
+        });
+    }];
+}
+
+- (void)planSegmentsForJob:(XLDownloadJob *)job acceptsRanges:(BOOL)acceptsRanges {
+    [job->_segments removeAllObjects];
+    NSUInteger count = 1;
+    int64_t minSegment = MAX(_minSegmentSize, (int64_t)1);
+    if (acceptsRanges && job->_total >= 2 * minSegment) {
+        count = (NSUInteger)MIN((int64_t)MAX(_maxSegmentsPerDownload, (NSUInteger)1), job->_total / minSegment);
+    }
+    int64_t size = count > 1 ? job->_total / (int64_t)count : 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        XLDownloadSegment *segment = [[XLDownloadSegment alloc] init];
+        segment->_start = (int64_t)i * size;
+        segment->_next = segment->_start;
+        if (i + 1 < count) {
+            segment->_end = segment->_start + size - 1;
+        } else {
+            segment->_end = job->_total > 0 ? job->_total - 1 : -1;
+        }
+        [job->_segments addObject:segment];
+        [segment release];
+    }
+}
+
+- (BOOL)openPartFileForJob:(XLDownloadJob *)job fresh:(BOOL)fresh {
+    int flags = O_RDWR | O_CREAT | (fresh ? O_TRUNC : 0);
+    int fd = open([job->_partPath fileSystemRepresentation], flags, 0644);
+    if (fd < 0) {
+        [self stopJob:job reason:XLDownloadStopFail error:[NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]];
+        return NO;
+    }
+    /* Parallel segments write out of order; reserve the full length up front */
+    if (fresh && [job->_segments count] > 1 && job->_total > 0) {
+        if (ftruncate(fd, (off_t)job->_total) != 0) {
+            NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            close(fd);
+            [self stopJob:job reason:XLDownloadStopFail error:error];
+            return NO;
+        }
+    }
+    job->_fd = fd;
+    return YES;
+}
+
+#pragma mark - Resume state
+
+- (BOOL)restoreJobFromSidecar:(XLDownloadJob *)job {
+    NSFileManager *fm = [NSFileManager defaultManager];
+    if (![fm fileExistsAtPath:job->_partPath]) return NO;
+    NSDictionary *state = [NSDictionary dictionaryWithContentsOfFile:job->_sidecarPath];
+    if (![[state objectForKey:@"url"] isEqual:[job->_item.url absoluteString]]) return NO;
+    NSArray *ranges = [state objectForKey:@"segments"];
+    if ([ranges count] == 0) return NO;
+    job->_total = [[state objectForKey:@"total"] longLongValue];
+    job->_validator = [[state objectForKey:@"validator"] copy];
+    [job->_segments removeAllObjects];
+    for (NSArray *range in ranges) {
+        if (![range isKindOfClass:[NSArray class]] || [range count] != 3) return NO;
+        XLDownloadSegment *segment = [[XLDownloadSegment alloc] init];
+        segment->_start = [[range objectAtIndex:0] longLongValue];
+        segment->_end = [[range objectAtIndex:1] longLongValue];
+        segment->_next = [[range objectAtIndex:2] longLongValue];
+        [job->_segments addObject:segment];
+        [segment release];
+    }
+    return YES;
+}
+
+/// Flush data before recording progress, so the sidecar never claims bytes that are not on disk
+- (void)persistSidecarForJob:(XLDownloadJob *)job {
+    if (job->_fd >= 0) fdatasync(job->_fd);
+    NSMutableArray *ranges = [NSMutableArray arrayWithCapacity:[job->_segments count]];
+    for (XLDownloadSegment *segment in job->_segments) {
+        [ranges addObject:@[ @(segment->_start), @(segment->_end), @(segment->_next) ]];
+    }
+    NSMutableDictionary *state = [NSMutableDictionary dictionary];
+    [state setObject:[job->_item.url absoluteString] forKey:@"url"];
+    [state setObject:@(job->_total) forKey:@"total"];
+    [state setObject:ranges forKey:@"segments"];
+    if (job->_validator) [state setObject:job->_validator forKey:@"validator"];
+    [state writeToFile:job->_sidecarPath atomically:YES];
+    job->_lastSidecar = [NSDate timeIntervalSinceReferenceDate];
+}
+
+#pragma mark - Transfers
+
+- (void)startSegment:(XLDownloadSegment *)segment ofJob:(XLDownloadJob *)job {
+    if ([segment isDone] || segment->_active || job->_stop != XLDownloadStopNone) return;
+    segment->_active = YES;
+    segment->_written = 0;
+    [segment->_token release];
+    segment->_token = [[XLCancellationToken token] retain];
+    int64_t base = segment->_next;
+    int64_t length = segment->_end >= 0 ? segment->_end - base + 1 : 0;
+    [[XLHTTPClient sharedClient] downloadURL:[job->_item.url absoluteString]
+                                  fromOffset:base
+                                      length:length
+                            toFileDescriptor:job->_fd
+                                     ifRange:job->_validator
+                                     timeout:0
+                           cancellationToken:segment->_token
+                                    progress:^(int64_t bytesWritten) {
+        dispatch_async(_queue, ^{
+            if (segment->_retired) {
+                job->_retiredWrote = YES;
+                return;
+            }
+            if (!segment->_active) return;
+            segment->_written = bytesWritten;
+            segment->_next = base + bytesWritten;
+            [self updateProgressForJob:job force:NO];
+        });
+    }
+                                  completion:^(NSData *data, long statusCode, NSError *error) {
+        dispatch_async(_queue, ^{
+            [self segment:segment ofJob:job finishedFrom:base status:statusCode error:error];
+        });
+    }];
+}
+
+- (void)segment:(XLDownloadSegment *)segment ofJob:(XLDownloadJob *)job finishedFrom:(int64_t)base status:(long)status error:(NSError *)error {
+    segment->_active = NO;
+    XLMetricAdd(XL_COUNTER("download.bytes"), segment->_written);
+    if (segment->_retired) {
+        segment->_retired = NO;
+        if (--job->_retiredInFlight == 0) [self settleResetOfJob:job];
+        [self finalizeJobIfIdle:job];
+        return;
+    }
+    if (job->_stop != XLDownloadStopNone) {
+        [self finalizeJobIfIdle:job];
+        return;
+    }
+    if (!error) {
+        if (status != 206 && (base > 0 || [job->_segments count] > 1)) {
+            /* Server sent the whole resource from byte 0 (Range ignored, or If-Range saw a new version).
+               The other transfers still write into the fd until they report back; truncate after that. */
+            for (XLDownloadSegment *other in job->_segments) {
+                if (other != segment && other->_active) {
+                    other->_retired = YES;
+                    job->_retiredInFlight++;
+                    [other->_token cancel];
+                }
+            }
+            [segment retain];
+            [job->_segments removeAllObjects];
+            segment->_start = 0;
+            segment->_end = segment->_written - 1;
+            segment->_next = segment->_written;
+            [job->_segments addObject:segment];
+            [segment release];
+            job->_total = segment->_written;
+            if (job->_retiredInFlight == 0) [self settleResetOfJob:job];
+        } else if (segment->_end < 0) {
+            segment->_end = segment->_next - 1;
+            job->_total = segment->_next;
+        } else {
+            /* A 2xx short of the range end: connection closed early; resume the rest */
+            if (![segment isDone]) {
+                [self startSegment:segment ofJob:job];
+                return;
+            }
+        }
+        [self updateProgressForJob:job force:NO];
+        if ([NSDate timeIntervalSinceReferenceDate] - job->_lastSidecar >= kSidecarInterval) {
+            [self persistSidecarForJob:job];
+        }
+        [self finalizeJobIfIdle:job];
+        return;
+    }
+
+    BOOL cancelled = [[error domain] isEqualToString:XLHTTPClientErrorDomain] && [error code] == CURLE_ABORTED_BY_CALLBACK;
+    if (cancelled) {
+        [self finalizeJobIfIdle:job];
+        return;
+    }
+    NSInteger code = [error code];
+    BOOL permanent = [[error domain] isEqualToString:XLHTTPClientErrorDomain] && code >= 400 && code < 500 && code != 408 && code != 429;
+    if (permanent || segment->_retries >= _maxRetries) {
+        [self stopJob:job reason:XLDownloadStopFail error:error];
+        return;
+    }
+    segment->_retries++;
+    [self persistSidecarForJob:job];
+    NSTimeInterval delay = MIN(kMaxRetryDelay, pow(2.0, (double)segment->_retries));
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        [self startSegment:segment ofJob:job];
+        [self finalizeJobIfIdle:job];
+    });
+}
+
+/// All transfers from before a full-body reset have reported back: trim the file to the new body, or fetch it
+/// again if a late write from an old range may have landed inside it
+- (void)settleResetOfJob:(XLDownloadJob *)job {
+    if (job->_fd < 0) return;
+    XLDownloadSegment *segment = [job->_segments count] == 1 ? [job->_segments objectAtIndex:0] : nil;
+    if (job->_retiredWrote && segment) {
+        job->_retiredWrote = NO;
+        segment->_next = 0;
+        ftruncate(job->_fd, 0);
+        [self persistSidecarForJob:job];
+        [self startSegment:segment ofJob:job];
+        return;
+    }
+    ftruncate(job->_fd, (off_t)job->_total);
+}
+
+- (void)updateProgressForJob:(XLDownloadJob *)job force:(BOOL)force {
+    int64_t received = 0;
+    for (XLDownloadSegment *segment in job->_segments) {
+        received += MAX((int64_t)0, segment->_next - segment->_start);
+    }
+    XLDownloadItem *item = job->_item;
+    item.bytesReceived = received;
+    item.totalBytes = job->_total;
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    if (!force && now - job->_lastProgress < kProgressInterval) return;
+    job->_lastProgress = now;
+    if (job->_stop == XLDownloadStopNone && job->_fd >= 0 && now - job->_lastSidecar >= kSidecarInterval) {
+        [self persistSidecarForJob:job];
+    }
+    id<XLDownloadManagerDelegate> delegate = _delegate;
+    if ([delegate respondsToSelector:@selector(downloadManager:didUpdateItem:)]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [delegate downloadManager:self didUpdateItem:item];
+        });
+    }
+}
+
+#pragma mark - Completion
+
+- (void)stopJob:(XLDownloadJob *)job reason:(XLDownloadStop)reason error:(NSError *)error {
+    if (job->_stop != XLDownloadStopNone) return;
+    job->_stop = reason;
+    job->_stopError = [error retain];
+    [job->_probeToken cancel];
+    for (XLDownloadSegment *segment in job->_segments) {
+        if (segment->_active) [segment->_token cancel];
+    }
+    [self finalizeJobIfIdle:job];
+}
+
+/// Transfers still hold the fd until they report back; only then is it safe to close and settle the job
+- (void)finalizeJobIfIdle:(XLDownloadJob *)job {
+    if (job->_probing || job->_verifying || job->_retiredInFlight > 0 || [_jobs indexOfObjectIdenticalTo:job] == NSNotFound) return;
+    BOOL allDone = YES;
+    for (XLDownloadSegment *segment in job->_segments) {
+        if (segment->_active) return;
+        if (![segment isDone]) allDone = NO;
+    }
+    if (job->_stop == XLDownloadStopNone && !allDone) return;
+
+    if (job->_stop == XLDownloadStopNone) {
+        [self verifyJob:job];
+        return;
+    }
+    if (job->_stop != XLDownloadStopCancel && [job->_segments count] > 0) {
+        [self persistSidecarForJob:job];
+    }
+    if (job->_fd >= 0) {
+        close(job->_fd);
+        job->_fd = -1;
+    }
+    if (job->_stop == XLDownloadStopCancel) {
+        unlink([job->_partPath fileSystemRepresentation]);
+        unlink([job->_sidecarPath fileSystemRepresentation]);
+    }
+    XLDownloadState state = job->_stop == XLDownloadStopPause ? XLDownloadStatePaused : XLDownloadStateFailed;
+    [self finishJob:job state:state error:job->_stopError];
+}
+
+- (void)verifyJob:(XLDownloadJob *)job {
+    job->_verifying = YES;
+    fdatasync(job->_fd);
+    close(job->_fd);
+    job->_fd = -1;
+    job->_item.state = XLDownloadStateVerifying;
+    [self updateProgressForJob:job force:YES];
+
+    XLDownloadItem *item = job->_item;
+    NSString *partPath = job->_partPath;
+    NSString *sidecarPath = job->_sidecarPath;
+    int64_t total = job->_total;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSError *error = nil;
+        struct stat st;
+        int64_t size = stat([partPath fileSystemRepresentation], &st) == 0 ? (int64_t)st.st_size : -1;
+        if ((total > 0 && size != total) || (item.expectedSize > 0 && size != item.expectedSize)) {
+            error = XLDownloadError(XLDownloadErrorSizeMismatch,
+                                    [NSString stringWithFormat:@"Downloaded %lld bytes, expected %lld", (long long)size,
+                                     (long long)(item.expectedSize > 0 ? item.expectedSize : total)]);
+        } else if ([item.expectedSHA256 length] > 0) {
+            NSError *hashError = nil;
+            NSString *digest = XLSha256HexOfFile(partPath, NULL, &hashError);
+            if (!digest) {
+                error = hashError;
+            } else if ([digest caseInsensitiveCompare:item.expectedSHA256] != NSOrderedSame) {
+                error = XLDownloadError(XLDownloadErrorHashMismatch, @"SHA-256 does not match");
+            }
+        }
+        if (!error) {
+            if (rename([partPath fileSystemRepresentation], [[item destinationPath] fileSystemRepresentation]) != 0) {
+                error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+        }
+        if (!error || [[error domain] isEqualToString:XLDownloadManagerErrorDomain]) {
+            /* Verified (renamed) or corrupt: either way the partial state is no longer useful */
+            if (error) unlink([partPath fileSystemRepresentation]);
+            unlink([sidecarPath fileSystemRepresentation]);
+        }
+        [error retain];
+        dispatch_async(_queue, ^{
+            job->_verifying = NO;
+            [self finishJob:job state:error ? XLDownloadStateFailed : XLDownloadStateCompleted error:error];
+            [error release];
+        });
+        [pool drain];
+    });
+}
+
+- (void)finishJob:(XLDownloadJob *)job state:(XLDownloadState)state error:(NSError *)error {
+    [[job retain] autorelease];
+    [_jobs removeObjectIdenticalTo:job];
+    XLMetricSet(XL_GAUGE("download.active"), (int64_t)[_jobs count]);
+    if (state == XLDownloadStateCompleted) {
+        XLMetricAdd(XL_COUNTER("download.completed"), 1);
+        XLMetricRecordSince(XL_HISTOGRAM("download.duration"), job->_startedAt);
+    } else if (state == XLDownloadStateFailed) {
+        XLMetricAdd(XL_COUNTER("download.failed"), 1);
+    }
+    XLDownloadItem *item = job->_item;
+    item.state = state;
+    item.error = error;
+    [self updateProgressForJob:job force:YES];
+
+    id<XLDownloadManagerDelegate> delegate = _delegate;
+    if ([delegate respondsToSelector:@selector(downloadManager:didFinishItem:error:)]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [delegate downloadManager:self didFinishItem:item error:error];
+        });
+    }
+    if (state == XLDownloadStateCompleted && item.importWhenDone) {
+        [self importItem:item];
+    }
+    [self startPendingJobs];
+}
+
+- (void)importItem:(XLDownloadItem *)item {
+    [item retain];
+    /* XLManager parses on an executor worker at import priority */
+    [[XLManager sharedManager] importBookAtPath:[item destinationPath] withCompletion:^(XLBook *book, NSError *error) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            id<XLDownloadManagerDelegate> delegate = _delegate;
+            if ([delegate respondsToSelector:@selector(downloadManager:didImportItem:book:error:)]) {
+                [delegate downloadManager:self didImportItem:item book:book error:error];
+            }
+            [item release];
+        });
+    }];
+}
+
+@end
@@ -8,6 +8,8 @@
 #import "XLEpubParser.h"
 #import "../Models/Book.h"
 #import "XLEpubReader.h"
+#import "../Native/XLTrace.h"
+#import "../Native/XLXMLParserPool.h"
 #import <libxml/parser.h>
 #import <libxml/tree.h>
 #import <libxml/HTMLparser.h>
@@ -35,12 +37,12 @@ static void collectTextFromNode(xmlNode *node, NSMutableString *out) {
         collectTextFromNode(cur, out);
 }
 
-/** Extract plain text from HTML/XHTML bytes using libxml2 (FOSS). Returns nil on parse failure. */
-static NSString *plainTextFromHTMLData(NSData *data) {
+/** Extract plain text from HTML/XHTML bytes using libxml2 (FOSS) and the thread's pooled HTML parser.
+    dict is the book's shared dictionary, or NULL. Returns nil on parse failure. */
+static NSString *plainTextFromHTMLData(NSData *data, xmlDict *dict) {
     if (!data || [data length] == 0) return nil;
-    const char *bytes = (const char *)[data bytes];
-    int len = (int)[data length];
-    xmlDoc *doc = htmlReadMemory(bytes, len, NULL, NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+    XL_TRACE_SCOPE("html.text", "parse");
+    xmlDoc *doc = XLHTMLReadMemory([data bytes], [data length], dict, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
     if (!doc) return nil;
     xmlNode *root = xmlDocGetRootElement(doc);
     NSMutableString *result = [NSMutableString string];
@@ -67,6 +69,7 @@ static BOOL dataLooksLikeHTML(NSData *data) {
 @implementation XLEpubParser
 
 + (XLParsedBook *)parseEpubAtPath:(NSString *)filePath error:(NSError **)error {
+    XL_TRACE_SCOPE("epub.parse", "parse");
     if (!filePath || [filePath length] == 0) {
         if (error) {
             *error = [NSError errorWithDomain:@"XLEpubParser" code:1
@@ -95,7 +98,7 @@ static BOOL dataLooksLikeHTML(NSData *data) {
         NSData *data = [epub readFileAtPath:path];
         if (!data || [data length] == 0) continue;
 
-        NSString *chapterContent = [self stringFromChapterData:data];
+        NSString *chapterContent = [self stringFromChapterData:data dictionary:[epub xmlDictionary]];
         if (!chapterContent || [chapterContent length] == 0) continue;
 
         XLChapter *chapter = [[XLChapter alloc] init];
@@ -170,7 +173,7 @@ static BOOL dataLooksLikeHTML(NSData *data) {
 }
 
 + (NSString *)parseChapterContent:(NSData *)chapterData error:(NSError **)error {
-    return [self stringFromChapterData:chapterData];
+    return [self stringFromChapterData:chapterData dictionary:NULL];
 }
 
 /** Normalize href for comparison (strip fragment, leading ./). */
@@ -203,10 +206,10 @@ static BOOL dataLooksLikeHTML(NSData *data) {
 }
 
 /** Extract readable text from chapter bytes. Uses libxml2 (FOSS) for HTML→text when content looks like HTML; otherwise UTF-8/ISO Latin-1 decode. */
-+ (NSString *)stringFromChapterData:(NSData *)data {
++ (NSString *)stringFromChapterData:(NSData *)data dictionary:(xmlDict *)dict {
     if (!data || [data length] == 0) return nil;
     if (dataLooksLikeHTML(data)) {
-        NSString *plain = plainTextFromHTMLData(data);
+        NSString *plain = plainTextFromHTMLData(data, dict);
         if (plain) return plain;
     }
     NSString *s = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
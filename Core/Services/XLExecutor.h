@@ -0,0 +1,73 @@
+//
+//  XLExecutor.h
+//  Xenolexia
+//
+//  Shared bounded worker pool for Core background work, scheduled by priority class.
+//
+
+#import <Foundation/Foundation.h>
+#import "XLCancellationToken.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Priority classes, highest first. Work of a higher class always starts before queued work of a lower one.
+typedef NS_ENUM(NSInteger, XLWorkPriority) {
+    XLWorkPriorityVisible = 0,      // the chapter on screen
+    XLWorkPriorityPrefetch,         // chapters the reader is likely to open next
+    XLWorkPriorityImport,           // bulk imports
+    XLWorkPriorityMaintenance       // rollups, reschedules, cache upkeep
+};
+#define XLWorkPriorityCount 4
+
+/// Work submitted together: cancelling the group skips its items that have not started, and running
+/// items can poll -isCancelled (or pass cancellationToken to cancellable APIs). Thread-safe.
+@interface XLWorkGroup : NSObject {
+    XLCancellationToken *_token;
+    dispatch_group_t _group;
+}
+
++ (instancetype)group;
+
+- (void)cancel;
+- (BOOL)isCancelled;
+- (XLCancellationToken *)cancellationToken;
+
+/// Block until every item submitted so far has run or been skipped
+- (void)waitUntilFinished;
+
+@end
+
+/// Fixed pool of worker threads. Each worker keeps its own deque per priority class: work a task submits
+/// goes to its own worker (newest first, for cache locality); idle workers take the highest class available
+/// from their deque, then the shared queue, then steal the oldest item from another worker.
+/// Import and maintenance work may occupy all but one worker, so visible and prefetch work never waits
+/// behind a bulk import. Thread-safe.
+@interface XLExecutor : NSObject {
+    NSCondition *_condition;
+    NSMutableArray *_injected[XLWorkPriorityCount];     // XLWorkItem, FIFO, from non-worker threads
+    NSMutableArray *_workers;                           // XLExecutorWorker
+    NSUInteger _backgroundRunning;                      // import + maintenance items running
+    NSUInteger _backgroundLimit;
+    NSUInteger _queued;
+}
+
++ (instancetype)sharedExecutor;
+
+/// count workers (the shared executor uses the processor count, between 2 and 8)
+- (instancetype)initWithWorkerCount:(NSUInteger)count;
+
+- (void)submitWithPriority:(XLWorkPriority)priority block:(void (^)(void))block;
+/// Skipped if group is cancelled before a worker starts it
+- (void)submitWithPriority:(XLWorkPriority)priority group:(nullable XLWorkGroup *)group block:(void (^)(void))block;
+/// Submit block once every block entered into dispatchGroup has left (e.g. outstanding network requests)
+- (void)submitAfterDispatchGroup:(dispatch_group_t)dispatchGroup
+                        priority:(XLWorkPriority)priority
+                           group:(nullable XLWorkGroup *)group
+                           block:(void (^)(void))block;
+
+/// Items waiting to start, for diagnostics
+- (NSUInteger)queuedCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
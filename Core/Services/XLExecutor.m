@@ -0,0 +1,288 @@
+//
+//  XLExecutor.m
+//  Xenolexia
+//
+
+#import "XLExecutor.h"
+#import "../Native/XLMetrics.h"
+#import "../Native/XLTrace.h"
+#import <pthread.h>
+
+/* Workers kept free of import and maintenance work */
+static const NSUInteger kReservedForegroundWorkers = 1;
+
+@interface XLWorkGroup ()
+- (void)enter;
+- (void)leave;
+@end
+
+@implementation XLWorkGroup
+
++ (instancetype)group {
+    return [[[self alloc] init] autorelease];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _token = [[XLCancellationToken alloc] init];
+        _group = dispatch_group_create();
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_token release];
+    dispatch_release(_group);
+    [super dealloc];
+}
+
+- (void)cancel {
+    [_token cancel];
+}
+
+- (BOOL)isCancelled {
+    return [_token isCancelled];
+}
+
+- (XLCancellationToken *)cancellationToken {
+    return _token;
+}
+
+- (void)waitUntilFinished {
+    dispatch_group_wait(_group, DISPATCH_TIME_FOREVER);
+}
+
+- (void)enter {
+    dispatch_group_enter(_group);
+}
+
+- (void)leave {
+    dispatch_group_leave(_group);
+}
+
+@end
+
+@interface XLWorkItem : NSObject {
+@public
+    void (^_block)(void);
+    XLWorkPriority _priority;
+    XLWorkGroup *_group;
+    uint64_t _enqueuedAt;
+}
+@end
+
+@implementation XLWorkItem
+
+- (void)dealloc {
+    [_block release];
+    [_group release];
+    [super dealloc];
+}
+
+@end
+
+@interface XLExecutorWorker : NSObject {
+@public
+    XLExecutor *_executor;                              // not retained; executors live for the process
+    NSMutableArray *_deques[XLWorkPriorityCount];       // XLWorkItem, guarded by the executor's condition
+}
+@end
+
+@implementation XLExecutorWorker
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        for (NSInteger p = 0; p < XLWorkPriorityCount; p++) _deques[p] = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (NSInteger p = 0; p < XLWorkPriorityCount; p++) [_deques[p] release];
+    [super dealloc];
+}
+
+@end
+
+static pthread_once_t workerKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t workerKey;
+
+static void makeWorkerKey(void) {
+    pthread_key_create(&workerKey, NULL);
+}
+
+/// How long items of each class waited to start
+static XLMetric *waitHistogram(XLWorkPriority priority) {
+    switch (priority) {
+        case XLWorkPriorityVisible: return XL_HISTOGRAM("executor.wait.visible");
+        case XLWorkPriorityPrefetch: return XL_HISTOGRAM("executor.wait.prefetch");
+        case XLWorkPriorityImport: return XL_HISTOGRAM("executor.wait.import");
+        default: return XL_HISTOGRAM("executor.wait.maintenance");
+    }
+}
+
+@implementation XLExecutor
+
++ (instancetype)sharedExecutor {
+    static XLExecutor *sharedExecutor = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSUInteger cpus = [[NSProcessInfo processInfo] activeProcessorCount];
+        sharedExecutor = [[self alloc] initWithWorkerCount:MIN(MAX(cpus, (NSUInteger)2), (NSUInteger)8)];
+    });
+    return sharedExecutor;
+}
+
+- (instancetype)init {
+    return [self initWithWorkerCount:2];
+}
+
+- (instancetype)initWithWorkerCount:(NSUInteger)count {
+    self = [super init];
+    if (self) {
+        pthread_once(&workerKeyOnce, makeWorkerKey);
+        count = MAX(count, (NSUInteger)1);
+        _condition = [[NSCondition alloc] init];
+        for (NSInteger p = 0; p < XLWorkPriorityCount; p++) _injected[p] = [[NSMutableArray alloc] init];
+        _workers = [[NSMutableArray alloc] initWithCapacity:count];
+        _backgroundLimit = count > kReservedForegroundWorkers ? count - kReservedForegroundWorkers : 1;
+        for (NSUInteger i = 0; i < count; i++) {
+            XLExecutorWorker *worker = [[XLExecutorWorker alloc] init];
+            worker->_executor = self;
+            [_workers addObject:worker];
+            NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(runWorker:) object:worker];
+            [thread setName:[NSString stringWithFormat:@"xenolexia.executor.%lu", (unsigned long)i]];
+            [thread start];
+            [thread release];
+            [worker release];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    /* Workers retain the executor through their threads, so this only runs for a failed init */
+    [_condition release];
+    for (NSInteger p = 0; p < XLWorkPriorityCount; p++) [_injected[p] release];
+    [_workers release];
+    [super dealloc];
+}
+
+- (void)submitWithPriority:(XLWorkPriority)priority block:(void (^)(void))block {
+    [self submitWithPriority:priority group:nil block:block];
+}
+
+- (void)submitWithPriority:(XLWorkPriority)priority group:(XLWorkGroup *)group block:(void (^)(void))block {
+    if (!block) return;
+    if (priority < XLWorkPriorityVisible || priority >= XLWorkPriorityCount) priority = XLWorkPriorityMaintenance;
+    XLWorkItem *item = [[XLWorkItem alloc] init];
+    item->_block = [block copy];
+    item->_priority = priority;
+    item->_group = [group retain];
+    item->_enqueuedAt = XLTraceNow();
+    [group enter];
+
+    XLExecutorWorker *current = pthread_getspecific(workerKey);
+    [_condition lock];
+    if (current && current->_executor == self) {
+        [current->_deques[priority] addObject:item];
+    } else {
+        [_injected[priority] addObject:item];
+    }
+    _queued++;
+    XLMetricSet(XL_GAUGE("executor.queued"), (int64_t)_queued);
+    [_condition signal];
+    [_condition unlock];
+    [item release];
+}
+
+- (void)submitAfterDispatchGroup:(dispatch_group_t)dispatchGroup
+                        priority:(XLWorkPriority)priority
+                           group:(XLWorkGroup *)group
+                           block:(void (^)(void))block {
+    if (!block) return;
+    [group enter];
+    [group retain];
+    void (^copied)(void) = [block copy];
+    dispatch_group_notify(dispatchGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self submitWithPriority:priority group:group block:copied];
+        [copied release];
+        [group leave];
+        [group release];
+    });
+}
+
+- (NSUInteger)queuedCount {
+    [_condition lock];
+    NSUInteger queued = _queued;
+    [_condition unlock];
+    return queued;
+}
+
+#pragma mark - Workers
+
+/// Highest class first: own deque (newest), shared queue (oldest), then steal another worker's oldest.
+/// Called with the condition locked; returns a retained item or nil.
+- (XLWorkItem *)takeItemForWorker:(XLExecutorWorker *)worker {
+    for (NSInteger p = 0; p < XLWorkPriorityCount; p++) {
+        BOOL background = p >= XLWorkPriorityImport;
+        if (background && _backgroundRunning >= _backgroundLimit) break;
+        XLWorkItem *item = [[worker->_deques[p] lastObject] retain];
+        if (item) {
+            [worker->_deques[p] removeLastObject];
+        } else if ([_injected[p] count] > 0) {
+            item = [[_injected[p] objectAtIndex:0] retain];
+            [_injected[p] removeObjectAtIndex:0];
+        } else {
+            for (XLExecutorWorker *victim in _workers) {
+                if (victim == worker || [victim->_deques[p] count] == 0) continue;
+                item = [[victim->_deques[p] objectAtIndex:0] retain];
+                [victim->_deques[p] removeObjectAtIndex:0];
+                XLMetricAdd(XL_COUNTER("executor.steals"), 1);
+                break;
+            }
+        }
+        if (item) {
+            if (background) _backgroundRunning++;
+            _queued--;
+            XLMetricSet(XL_GAUGE("executor.queued"), (int64_t)_queued);
+            return item;
+        }
+    }
+    return nil;
+}
+
+- (void)runWorker:(XLExecutorWorker *)worker {
+    pthread_setspecific(workerKey, worker);
+    for (;;) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        [_condition lock];
+        XLWorkItem *item = nil;
+        while (!(item = [self takeItemForWorker:worker])) {
+            [_condition wait];
+        }
+        [_condition unlock];
+
+        XLMetricRecordSince(waitHistogram(item->_priority), item->_enqueuedAt);
+        if (item->_group && [item->_group isCancelled]) {
+            XLMetricAdd(XL_COUNTER("executor.skipped"), 1);
+        } else {
+            item->_block();
+        }
+
+        if (item->_priority >= XLWorkPriorityImport) {
+            /* A background slot opened: any worker may now take queued import or maintenance work */
+            [_condition lock];
+            _backgroundRunning--;
+            [_condition broadcast];
+            [_condition unlock];
+        }
+        [item->_group leave];
+        [item release];
+        [pool drain];
+    }
+}
+
+@end
@@ -7,6 +7,8 @@
 #import <Foundation/Foundation.h>
 #import "../Models/Vocabulary.h"
 
+@class XLVocabularyCursor;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /// Export formats
@@ -16,6 +18,16 @@ typedef NS_ENUM(NSInteger, XLExportFormat) {
     XLExportFormatAnki
 };
 
+/// Progress callback for streaming exports: rows written so far and rows expected (0 if unknown).
+/// Set *stop to YES to cancel; the partial file is removed and completion gets XLExportErrorCancelled.
+typedef void (^XLExportProgressBlock)(NSUInteger written, NSUInteger total, BOOL *stop);
+
+/// Error codes in the XLExportService domain
+typedef NS_ENUM(NSInteger, XLExportError) {
+    XLExportErrorFailed = 1,
+    XLExportErrorCancelled = 2
+};
+
 /// Export service
 @interface XLExportService : NSObject
 
@@ -25,6 +37,22 @@ typedef NS_ENUM(NSInteger, XLExportFormat) {
                     toFilePath:(NSString *)filePath
                 withCompletion:(void(^)(BOOL success, NSError *error))completion;
 
+/// Stream rows from a storage cursor straight to filePath; memory stays bounded regardless of row count.
+/// Runs synchronously on the calling thread (call it off the main thread for large exports). Closes the cursor.
+- (void)exportVocabularyFromCursor:(XLVocabularyCursor *)cursor
+                            format:(XLExportFormat)format
+                        toFilePath:(NSString *)filePath
+                          progress:(nullable XLExportProgressBlock)progress
+                    withCompletion:(void(^)(BOOL success, NSError * _Nullable error))completion;
+
+/// Stream XLVocabularyItem objects from any enumerator. Output goes to filePath.part and is renamed on success.
+- (void)exportVocabularyFromEnumerator:(NSEnumerator *)items
+                                 total:(NSUInteger)total
+                                format:(XLExportFormat)format
+                            toFilePath:(NSString *)filePath
+                              progress:(nullable XLExportProgressBlock)progress
+                        withCompletion:(void(^)(BOOL success, NSError * _Nullable error))completion;
+
 /// Export to CSV format
 - (NSString *)exportToCSV:(NSArray *)items;
 
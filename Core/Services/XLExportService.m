@@ -3,15 +3,48 @@
 //  Xenolexia
 //
 
+#import <stdio.h>
+#import <errno.h>
+#import <string.h>
 #import "XLExportService.h"
+#import "XLVocabularyCursor.h"
 #import "../Models/Language.h"
 #import "../Models/Vocabulary.h"
 #import "SSFileSystem.h"
 #import "CHCSVParser.h"
 
+/// Rows written between progress callbacks and autorelease pool drains
+static const NSUInteger kExportBatchRows = 256;
+
+static NSError *XLExportErrorWithCode(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:@"XLExportService"
+                               code:code
+                           userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+}
+
+/// Write all of data, looping over short writes. NO on stream error.
+static BOOL XLStreamWriteData(NSOutputStream *stream, NSData *data) {
+    const uint8_t *bytes = (const uint8_t *)[data bytes];
+    NSUInteger remaining = [data length];
+    while (remaining > 0) {
+        NSInteger n = [stream write:bytes maxLength:remaining];
+        if (n <= 0) return NO;
+        bytes += n;
+        remaining -= (NSUInteger)n;
+    }
+    return YES;
+}
+
+static BOOL XLStreamWriteString(NSOutputStream *stream, NSString *string) {
+    return XLStreamWriteData(stream, [string dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
 @interface XLExportService () {
     SSFileSystem *_fileSystem;
 }
+- (NSArray *)csvFieldsForItem:(XLVocabularyItem *)item dateFormatter:(NSDateFormatter *)dateFmt;
+- (NSDictionary *)jsonObjectForItem:(XLVocabularyItem *)item dateFormatter:(NSISO8601DateFormatter *)iso;
+- (NSString *)ankiLineForItem:(XLVocabularyItem *)item;
 @end
 
 @implementation XLExportService
@@ -28,40 +61,191 @@
                         format:(XLExportFormat)format
                     toFilePath:(NSString *)filePath
                 withCompletion:(void(^)(BOOL success, NSError * _Nullable error))completion {
-    NSString *content = nil;
-    
+    [self exportVocabularyFromEnumerator:[items objectEnumerator]
+                                   total:[items count]
+                                  format:format
+                              toFilePath:filePath
+                                progress:nil
+                          withCompletion:completion];
+}
+
+- (void)exportVocabularyFromCursor:(XLVocabularyCursor *)cursor
+                            format:(XLExportFormat)format
+                        toFilePath:(NSString *)filePath
+                          progress:(XLExportProgressBlock)progress
+                    withCompletion:(void(^)(BOOL success, NSError * _Nullable error))completion {
+    NSError *openError = nil;
+    if (![cursor open:&openError]) {
+        if (completion) {
+            completion(NO, openError ?: XLExportErrorWithCode(XLExportErrorFailed, @"Failed to read vocabulary"));
+        }
+        return;
+    }
+    [self exportVocabularyFromEnumerator:cursor
+                                   total:[cursor count]
+                                  format:format
+                              toFilePath:filePath
+                                progress:progress
+                          withCompletion:completion];
+    [cursor close];
+}
+
+- (void)exportVocabularyFromEnumerator:(NSEnumerator *)items
+                                 total:(NSUInteger)total
+                                format:(XLExportFormat)format
+                            toFilePath:(NSString *)filePath
+                              progress:(XLExportProgressBlock)progress
+                        withCompletion:(void(^)(BOOL success, NSError * _Nullable error))completion {
+    // Write beside the target and rename at the end, so a failed or cancelled export never leaves a truncated file
+    NSString *partPath = [filePath stringByAppendingPathExtension:@"part"];
+    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:partPath append:NO];
+    [stream open];
+    if ([stream streamStatus] != NSStreamStatusOpen) {
+        if (completion) {
+            completion(NO, [stream streamError] ?: XLExportErrorWithCode(XLExportErrorFailed, @"Could not open export file"));
+        }
+        return;
+    }
+
+    NSDateFormatter *dateFmt = [[NSDateFormatter alloc] init];
+    dateFmt.dateFormat = @"yyyy-MM-dd";
+    NSISO8601DateFormatter *iso = [[NSISO8601DateFormatter alloc] init];
+    CHCSVWriter *csv = nil;
+    BOOL ok = YES;
     switch (format) {
         case XLExportFormatCSV:
-            content = [self exportToCSV:items];
+            csv = [[CHCSVWriter alloc] initWithOutputStream:stream encoding:NSUTF8StringEncoding delimiter:(unichar)','];
+            ok = (csv != nil);
+            // Spec 04-algorithms: source_word, target_word, source_language, target_language [, context_sentence] [, book_title] [, status, review_count, ease_factor, interval, added_at]
+            [csv writeLineOfFields:@[ @"source_word", @"target_word", @"source_language", @"target_language", @"context_sentence", @"book_title", @"status", @"review_count", @"ease_factor", @"interval", @"added_at" ]];
             break;
         case XLExportFormatJSON:
-            content = [self exportToJSON:items];
+            ok = XLStreamWriteString(stream, [NSString stringWithFormat:@"{\n  \"format\" : \"xenolexia-vocabulary-v1\",\n  \"exportedAt\" : \"%@\",\n  \"items\" : [", [iso stringFromDate:[NSDate date]]]);
             break;
         case XLExportFormatAnki:
-            content = [self exportToAnki:items];
+            ok = XLStreamWriteString(stream, @"#separator:tab\n#html:true\n#tags column:3\n");
             break;
     }
-    
-    if (!content) {
-        if (completion) {
-            NSDictionary *userInfo = [NSDictionary dictionaryWithObject:@"Failed to generate export content"
-                                                                  forKey:NSLocalizedDescriptionKey];
-            completion(NO, [NSError errorWithDomain:@"XLExportService"
-                                               code:1
-                                           userInfo:userInfo]);
+
+    NSUInteger written = 0;
+    BOOL stop = NO;
+    BOOL exhausted = NO;
+    while (ok && !stop && !exhausted) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSUInteger batch = 0;
+        while (ok && batch < kExportBatchRows) {
+            XLVocabularyItem *item = [items nextObject];
+            if (!item) {
+                exhausted = YES;
+                break;
+            }
+            switch (format) {
+                case XLExportFormatCSV:
+                    [csv writeLineOfFields:[self csvFieldsForItem:item dateFormatter:dateFmt]];
+                    break;
+                case XLExportFormatJSON: {
+                    NSData *row = [NSJSONSerialization dataWithJSONObject:[self jsonObjectForItem:item dateFormatter:iso] options:0 error:NULL];
+                    ok = row && XLStreamWriteString(stream, written > 0 ? @",\n    " : @"\n    ") && XLStreamWriteData(stream, row);
+                    break;
+                }
+                case XLExportFormatAnki:
+                    ok = XLStreamWriteString(stream, [self ankiLineForItem:item]);
+                    break;
+            }
+            batch++;
+            written++;
+        }
+        if ([stream streamStatus] == NSStreamStatusError) {
+            ok = NO;
+        }
+        [pool drain];
+        if (ok && progress) {
+            progress(written, total, &stop);
         }
-        return;
     }
-    
-    // Use SmallStep for cross-platform file writing
-    NSError *error = nil;
-    BOOL success = [_fileSystem writeString:content toPath:filePath error:&error];
-    
+
+    if (ok && !stop && format == XLExportFormatJSON) {
+        ok = XLStreamWriteString(stream, [NSString stringWithFormat:@"%@],\n  \"itemCount\" : %lu\n}\n", written > 0 ? @"\n  " : @"", (unsigned long)written]);
+    }
+    NSError *error = ok ? nil : ([stream streamError] ?: XLExportErrorWithCode(XLExportErrorFailed, @"Failed to write export file"));
+    if (csv) {
+        [csv closeStream];
+        [csv release];
+    } else {
+        [stream close];
+    }
+    [dateFmt release];
+    [iso release];
+
+    if (ok && stop) {
+        ok = NO;
+        error = XLExportErrorWithCode(XLExportErrorCancelled, @"Export cancelled");
+    }
+    if (ok && rename([partPath fileSystemRepresentation], [filePath fileSystemRepresentation]) != 0) {
+        ok = NO;
+        error = XLExportErrorWithCode(XLExportErrorFailed, [NSString stringWithUTF8String:strerror(errno)]);
+    }
+    if (!ok) {
+        [_fileSystem deleteFileAtPath:partPath error:NULL];
+    }
     if (completion) {
-        completion(success, error);
+        completion(ok, error);
     }
 }
 
+#pragma mark - Rows
+
+- (NSArray *)csvFieldsForItem:(XLVocabularyItem *)item dateFormatter:(NSDateFormatter *)dateFmt {
+    return @[
+        item.sourceWord ?: @"",
+        item.targetWord ?: @"",
+        [XLLanguageInfo codeStringForLanguage:item.sourceLanguage],
+        [XLLanguageInfo codeStringForLanguage:item.targetLanguage],
+        item.contextSentence ?: @"",
+        item.bookTitle ?: @"",
+        [XLVocabularyItem codeStringForStatus:item.status],
+        [NSString stringWithFormat:@"%ld", (long)item.reviewCount],
+        [NSString stringWithFormat:@"%.2f", item.easeFactor],
+        [NSString stringWithFormat:@"%ld", (long)item.interval],
+        [dateFmt stringFromDate:item.addedAt]
+    ];
+}
+
+- (NSDictionary *)jsonObjectForItem:(XLVocabularyItem *)item dateFormatter:(NSISO8601DateFormatter *)iso {
+    NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+        item.sourceWord, @"sourceWord",
+        item.targetWord, @"targetWord",
+        [XLLanguageInfo codeStringForLanguage:item.sourceLanguage], @"sourceLanguage",
+        [XLLanguageInfo codeStringForLanguage:item.targetLanguage], @"targetLanguage",
+        nil];
+    if (item.contextSentence) [dict setObject:item.contextSentence forKey:@"contextSentence"];
+    if (item.bookId) [dict setObject:item.bookId forKey:@"bookId"];
+    if (item.bookTitle) [dict setObject:item.bookTitle forKey:@"bookTitle"];
+    [dict setObject:[iso stringFromDate:item.addedAt] forKey:@"addedAt"];
+    if (item.lastReviewedAt) [dict setObject:[iso stringFromDate:item.lastReviewedAt] forKey:@"lastReviewedAt"];
+    [dict setObject:@(item.reviewCount) forKey:@"reviewCount"];
+    [dict setObject:@(item.easeFactor) forKey:@"easeFactor"];
+    [dict setObject:@(item.interval) forKey:@"interval"];
+    [dict setObject:[XLVocabularyItem codeStringForStatus:item.status] forKey:@"status"];
+    return dict;
+}
+
+- (NSString *)ankiLineForItem:(XLVocabularyItem *)item {
+    // Spec 04-algorithms: front = target (foreign), back = source + context; tags = sourceLang-targetLang status
+    NSString *front = item.targetWord;
+    NSMutableString *back = [NSMutableString stringWithString:item.sourceWord];
+    if (item.contextSentence.length) {
+        [back appendFormat:@"<br><br><i>\"%@\"</i>", item.contextSentence];
+    }
+    if (item.bookTitle.length) {
+        [back appendFormat:@"<br><small>From: %@</small>", item.bookTitle];
+    }
+    NSString *tags = [NSString stringWithFormat:@"%@-%@ %@", [XLLanguageInfo codeStringForLanguage:item.sourceLanguage], [XLLanguageInfo codeStringForLanguage:item.targetLanguage], [XLVocabularyItem codeStringForStatus:item.status]];
+    return [NSString stringWithFormat:@"%@\t%@\t%@\n", front, back, tags];
+}
+
+#pragma mark - In-memory export
+
 - (NSString *)exportToCSV:(NSArray *)items {
     // Use CHCSVWriter (FOSS) for correct CSV escaping; write to memory then return string
     NSOutputStream *stream = [NSOutputStream outputStreamToMemory];
@@ -69,25 +253,13 @@
     if (!writer) {
         return nil;
     }
-    // Spec 04-algorithms: source_word, target_word, source_language, target_language [, context_sentence] [, book_title] [, status, review_count, ease_factor, interval, added_at]
     [writer writeLineOfFields:@[ @"source_word", @"target_word", @"source_language", @"target_language", @"context_sentence", @"book_title", @"status", @"review_count", @"ease_factor", @"interval", @"added_at" ]];
     NSDateFormatter *dateFmt = [[NSDateFormatter alloc] init];
     dateFmt.dateFormat = @"yyyy-MM-dd";
     for (XLVocabularyItem *item in items) {
-        [writer writeLineOfFields:@[
-            item.sourceWord ?: @"",
-            item.targetWord ?: @"",
-            [XLLanguageInfo codeStringForLanguage:item.sourceLanguage],
-            [XLLanguageInfo codeStringForLanguage:item.targetLanguage],
-            item.contextSentence ?: @"",
-            item.bookTitle ?: @"",
-            [XLVocabularyItem codeStringForStatus:item.status],
-            [NSString stringWithFormat:@"%ld", (long)item.reviewCount],
-            [NSString stringWithFormat:@"%.2f", item.easeFactor],
-            [NSString stringWithFormat:@"%ld", (long)item.interval],
-            [dateFmt stringFromDate:item.addedAt]
-        ]];
+        [writer writeLineOfFields:[self csvFieldsForItem:item dateFormatter:dateFmt]];
     }
+    [dateFmt release];
     [writer closeStream];
     NSData *data = [stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
     [writer release];
@@ -101,22 +273,7 @@
     NSMutableArray<NSDictionary *> *jsonItems = [NSMutableArray array];
     NSISO8601DateFormatter *iso = [[NSISO8601DateFormatter alloc] init];
     for (XLVocabularyItem *item in items) {
-        NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithObjectsAndKeys:
-            item.sourceWord, @"sourceWord",
-            item.targetWord, @"targetWord",
-            [XLLanguageInfo codeStringForLanguage:item.sourceLanguage], @"sourceLanguage",
-            [XLLanguageInfo codeStringForLanguage:item.targetLanguage], @"targetLanguage",
-            nil];
-        if (item.contextSentence) [dict setObject:item.contextSentence forKey:@"contextSentence"];
-        if (item.bookId) [dict setObject:item.bookId forKey:@"bookId"];
-        if (item.bookTitle) [dict setObject:item.bookTitle forKey:@"bookTitle"];
-        [dict setObject:[iso stringFromDate:item.addedAt] forKey:@"addedAt"];
-        if (item.lastReviewedAt) [dict setObject:[iso stringFromDate:item.lastReviewedAt] forKey:@"lastReviewedAt"];
-        [dict setObject:@(item.reviewCount) forKey:@"reviewCount"];
-        [dict setObject:@(item.easeFactor) forKey:@"easeFactor"];
-        [dict setObject:@(item.interval) forKey:@"interval"];
-        [dict setObject:[XLVocabularyItem codeStringForStatus:item.status] forKey:@"status"];
-        [jsonItems addObject:dict];
+        [jsonItems addObject:[self jsonObjectForItem:item dateFormatter:iso]];
     }
     NSDictionary *wrapper = @{
         @"exportedAt": [iso stringFromDate:[NSDate date]],
@@ -124,6 +281,7 @@
         @"format": @"xenolexia-vocabulary-v1",
         @"items": jsonItems
     };
+    [iso release];
     NSError *error = nil;
     NSData *jsonData = [NSJSONSerialization dataWithJSONObject:wrapper options:NSJSONWritingPrettyPrinted error:&error];
     if (error) return @"{}";
@@ -132,19 +290,9 @@
 
 - (NSString *)exportToAnki:(NSArray *)items {
     NSMutableString *tsv = [[NSMutableString alloc] init];
-    // Spec 04-algorithms: front = target (foreign), back = source + context; tags = sourceLang-targetLang status
     [tsv appendString:@"#separator:tab\n#html:true\n#tags column:3\n"];
     for (XLVocabularyItem *item in items) {
-        NSString *front = item.targetWord;
-        NSMutableString *back = [NSMutableString stringWithString:item.sourceWord];
-        if (item.contextSentence.length) {
-            [back appendFormat:@"<br><br><i>\"%@\"</i>", item.contextSentence];
-        }
-        if (item.bookTitle.length) {
-            [back appendFormat:@"<br><small>From: %@</small>", item.bookTitle];
-        }
-        NSString *tags = [NSString stringWithFormat:@"%@-%@ %@", [XLLanguageInfo codeStringForLanguage:item.sourceLanguage], [XLLanguageInfo codeStringForLanguage:item.targetLanguage], [XLVocabularyItem codeStringForStatus:item.status]];
-        [tsv appendFormat:@"%@\t%@\t%@\n", front, back, tags];
+        [tsv appendString:[self ankiLineForItem:item]];
     }
     return [tsv copy];
 }
@@ -0,0 +1,126 @@
+//
+//  XLHTTPClient.h
+//  Xenolexia
+//
+//  Long-lived libcurl client: pooled easy handles plus a shared DNS / TLS session / connection cache.
+//
+
+#import <Foundation/Foundation.h>
+#import "XLCancellationToken.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Error domain for transport errors; codes are CURLcode values (CURLE_OPERATION_TIMEDOUT for a missed
+/// deadline, CURLE_ABORTED_BY_CALLBACK for a cancelled request) or the HTTP status for failed downloads.
+extern NSString *const XLHTTPClientErrorDomain;
+
+/// Completion for async requests. data is nil for downloads and on transport errors.
+typedef void (^XLHTTPCompletion)(NSData * _Nullable data, long statusCode, NSError * _Nullable error);
+/// Completion for header probes. Names are lowercased; only the final response's headers (after redirects).
+typedef void (^XLHTTPHeadersCompletion)(NSDictionary * _Nullable headers, long statusCode, NSError * _Nullable error);
+/// Bytes written so far by one ranged download. Runs on the I/O thread, once per received chunk: keep it cheap.
+typedef void (^XLHTTPProgressBlock)(int64_t bytesWritten);
+
+/// HTTP(S) over reused connections. Thread-safe; each request borrows an easy handle from the pool,
+/// so concurrent requests get separate handles but share resolved hosts, TLS sessions and open
+/// connections through one CURLSH. Pool settings apply to handles configured after the change.
+///
+/// Async requests run on one I/O thread driving curl_multi, so any number can be in flight without a
+/// thread each. Completions are delivered in order on a private serial queue, never on the I/O thread.
+/// The I/O thread starts with the first async request and retains the client for the process lifetime.
+@interface XLHTTPClient : NSObject {
+    void *_share;                   // CURLSH *
+    void *_shareLocks;              // pthread_mutex_t[CURL_LOCK_DATA_LAST]
+    NSMutableArray *_idleHandles;   // NSValue(pointer) of idle CURL *
+    NSLock *_poolLock;
+    NSUInteger _maxIdleHandles;
+    NSUInteger _maxConnectionsPerHost;
+    NSUInteger _maxTotalConnections;
+    BOOL _http2Enabled;
+    long _timeoutSeconds;
+    long _connectTimeoutSeconds;
+    void *_multi;                   // CURLM *, owned by the I/O thread once started
+    NSThread *_ioThread;
+    NSRecursiveLock *_queueLock;   // recursive: a cancellation handler may run inline while submitting
+    NSMutableArray *_pendingTasks;  // submitted, not yet added to the multi handle
+    NSMutableArray *_pendingCancels;
+    NSMutableArray *_activeTasks;   // I/O thread only
+    dispatch_queue_t _callbackQueue;
+}
+
+/// Idle easy handles kept for reuse (default 8); extra handles are cleaned up on release
+@property (nonatomic, assign) NSUInteger maxIdleHandles;
+/// CURLOPT_MAX_HOST_CONNECTIONS (default 6)
+@property (nonatomic, assign) NSUInteger maxConnectionsPerHost;
+/// CURLOPT_MAXCONNECTS per handle's cache (default 16)
+@property (nonatomic, assign) NSUInteger maxTotalConnections;
+/// Negotiate HTTP/2 over TLS and wait to multiplex on an existing connection (default YES)
+@property (nonatomic, assign) BOOL http2Enabled;
+/// Whole-request timeout in seconds; 0 for none (default 30)
+@property (nonatomic, assign) long timeoutSeconds;
+/// Connect-phase timeout in seconds (default 10)
+@property (nonatomic, assign) long connectTimeoutSeconds;
+
++ (instancetype)sharedClient;
+
+/// Perform a request and return the response body (nil on transport error). method defaults to GET,
+/// or POST when body is set. statusCode receives the HTTP status (0 if none). Errors are in the
+/// XLHTTPClient domain with the CURLcode as error code.
+- (nullable NSData *)dataForURL:(NSString *)url
+                         method:(nullable NSString *)method
+                        headers:(nullable NSDictionary *)headers
+                           body:(nullable NSData *)body
+                     statusCode:(nullable long *)statusCode
+                          error:(NSError * _Nullable * _Nullable)error;
+
+/// Stream a GET response body into path (follows redirects). NO on transport error or non-2xx status.
+- (BOOL)downloadURL:(NSString *)url
+             toPath:(NSString *)path
+         statusCode:(nullable long *)statusCode
+              error:(NSError * _Nullable * _Nullable)error;
+
+/// Start a request on the I/O thread and return immediately. timeout is the whole-request deadline in
+/// seconds (<= 0 uses timeoutSeconds); cancelling token aborts the transfer and completes with an error.
+- (void)sendRequestToURL:(NSString *)url
+                  method:(nullable NSString *)method
+                 headers:(nullable NSDictionary *)headers
+                    body:(nullable NSData *)body
+                 timeout:(NSTimeInterval)timeout
+       cancellationToken:(nullable XLCancellationToken *)token
+              completion:(XLHTTPCompletion)completion;
+
+/// Async download into path (follows redirects); timeout <= 0 means no deadline.
+/// Non-2xx statuses, errors and cancellation complete with an error and remove the file.
+- (void)downloadURL:(NSString *)url
+             toPath:(NSString *)path
+            timeout:(NSTimeInterval)timeout
+  cancellationToken:(nullable XLCancellationToken *)token
+         completion:(XLHTTPCompletion)completion;
+
+/// HEAD request returning the response headers (content-length, accept-ranges, etag, ...)
+- (void)fetchHeadersForURL:(NSString *)url
+                   timeout:(NSTimeInterval)timeout
+         cancellationToken:(nullable XLCancellationToken *)token
+                completion:(XLHTTPHeadersCompletion)completion;
+
+/// Async GET of bytes [offset, offset + length) written with pwrite into fd starting at offset; length <= 0
+/// reads to the end. The caller owns fd and must keep it open until completion. validator (ETag or
+/// Last-Modified) is sent as If-Range. If the server answers 200 instead of 206 (Range unsupported or the
+/// resource changed), the body is the whole resource and is written from offset 0; statusCode tells which.
+/// Non-2xx responses are never written and complete with an error whose code is the HTTP status.
+- (void)downloadURL:(NSString *)url
+         fromOffset:(int64_t)offset
+             length:(int64_t)length
+   toFileDescriptor:(int)fd
+            ifRange:(nullable NSString *)validator
+            timeout:(NSTimeInterval)timeout
+  cancellationToken:(nullable XLCancellationToken *)token
+           progress:(nullable XLHTTPProgressBlock)progress
+         completion:(XLHTTPCompletion)completion;
+
+/// Drop idle handles (their connections close); the share cache survives
+- (void)purgeIdleHandles;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,670 @@
+//
+//  XLHTTPClient.m
+//  Xenolexia
+//
+
+#import "XLHTTPClient.h"
+#import <curl/curl.h>
+#import <pthread.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <errno.h>
+#import <unistd.h>
+
+NSString *const XLHTTPClientErrorDomain = @"XLHTTPClient";
+
+/* curl_multi_poll/curl_multi_wakeup arrived in 7.68; older libcurl falls back to a short curl_multi_wait */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define XL_HAVE_MULTI_POLL 1
+#endif
+
+static size_t XLHTTPWriteData(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    NSMutableData *data = (NSMutableData *)userdata;
+    if (data && ptr) {
+        [data appendBytes:ptr length:size * nmemb];
+    }
+    return size * nmemb;
+}
+
+static size_t XLHTTPWriteFile(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    return fwrite(ptr, size, nmemb, (FILE *)userdata) * size;
+}
+
+/* CURLSH is used from several threads at once; libcurl asks for one lock per shared data kind */
+static void XLHTTPShareLock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle; (void)access;
+    pthread_mutex_lock(&((pthread_mutex_t *)userptr)[data]);
+}
+
+static void XLHTTPShareUnlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    pthread_mutex_unlock(&((pthread_mutex_t *)userptr)[data]);
+}
+
+static NSError *XLHTTPError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:XLHTTPClientErrorDomain code:code userInfo:@{ NSLocalizedDescriptionKey: description ?: @"HTTP request failed" }];
+}
+
+/// One async transfer: owns everything the easy handle points into until it completes
+@interface XLHTTPTask : NSObject {
+@public
+    CURL *_curl;
+    struct curl_slist *_headerList;
+    NSData *_body;
+    NSMutableData *_data;
+    FILE *_file;
+    NSString *_path;
+    XLCancellationToken *_token;
+    id _registration;
+    XLHTTPCompletion _completion;
+    XLHTTPHeadersCompletion _headersCompletion;
+    NSMutableDictionary *_responseHeaders;
+    BOOL _writesToDescriptor;       // ranged download into a caller-owned fd
+    int _fd;
+    int64_t _fileOffset;
+    int64_t _written;
+    BOOL _statusChecked;
+    XLHTTPProgressBlock _progress;
+    char _errbuf[CURL_ERROR_SIZE];
+}
+@end
+
+@implementation XLHTTPTask
+
+- (void)dealloc {
+    if (_headerList) curl_slist_free_all(_headerList);
+    if (_file) fclose(_file);
+    [_body release];
+    [_data release];
+    [_path release];
+    [_token release];
+    [_registration release];
+    [_completion release];
+    [_headersCompletion release];
+    [_responseHeaders release];
+    [_progress release];
+    [super dealloc];
+}
+
+@end
+
+static size_t XLHTTPWriteRange(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    XLHTTPTask *task = (XLHTTPTask *)userdata;
+    size_t len = size * nmemb;
+    if (!task->_statusChecked) {
+        long code = 0;
+        curl_easy_getinfo(task->_curl, CURLINFO_RESPONSE_CODE, &code);
+        /* Never write an error page into the caller's file; returning 0 aborts the transfer */
+        if (code < 200 || code >= 300) return 0;
+        if (code != 206) task->_fileOffset = 0;
+        task->_statusChecked = YES;
+    }
+    /* A cancelled transfer must stop writing into the shared fd now, not when the multi loop aborts it */
+    if ([task->_token isCancelled]) return 0;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(task->_fd, ptr + done, len - done, (off_t)task->_fileOffset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        done += (size_t)n;
+        task->_fileOffset += n;
+    }
+    task->_written += (int64_t)len;
+    if (task->_progress) task->_progress(task->_written);
+    return len;
+}
+
+static size_t XLHTTPHeaderLine(char *buffer, size_t size, size_t nitems, void *userdata) {
+    XLHTTPTask *task = (XLHTTPTask *)userdata;
+    size_t len = size * nitems;
+    NSString *line = [[NSString alloc] initWithBytes:buffer length:len encoding:NSISOLatin1StringEncoding];
+    if ([line hasPrefix:@"HTTP/"]) {
+        /* Each redirect hop starts a new header block */
+        [task->_responseHeaders removeAllObjects];
+    } else {
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location != NSNotFound) {
+            NSString *name = [[line substringToIndex:colon.location] lowercaseString];
+            NSString *value = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+            [task->_responseHeaders setObject:value forKey:name];
+        }
+    }
+    [line release];
+    return len;
+}
+
+@interface XLHTTPClient ()
+- (CURL *)acquireHandle;
+- (void)releaseHandle:(CURL *)curl;
+- (struct curl_slist *)headerListForHeaders:(NSDictionary *)headers;
+- (void)configureHandle:(CURL *)curl
+                    url:(NSString *)url
+                 method:(NSString *)method
+             headerList:(struct curl_slist *)headerList
+                   body:(NSData *)body
+              timeoutMs:(long)timeoutMs
+            errorBuffer:(char *)errbuf;
+- (BOOL)performURL:(NSString *)url
+            method:(NSString *)method
+           headers:(NSDictionary *)headers
+              body:(NSData *)body
+     writeFunction:(curl_write_callback)writeFunction
+         writeData:(void *)writeData
+        statusCode:(long *)statusCode
+             error:(NSError **)error;
+- (void)submitTask:(XLHTTPTask *)task;
+- (void)cancelTask:(XLHTTPTask *)task;
+- (void)wakeIOThread;
+- (void)ioThreadMain:(id)unused;
+- (void)finishTask:(XLHTTPTask *)task result:(CURLcode)result;
+@end
+
+@implementation XLHTTPClient
+
+@synthesize maxIdleHandles = _maxIdleHandles;
+@synthesize maxConnectionsPerHost = _maxConnectionsPerHost;
+@synthesize maxTotalConnections = _maxTotalConnections;
+@synthesize http2Enabled = _http2Enabled;
+@synthesize timeoutSeconds = _timeoutSeconds;
+@synthesize connectTimeoutSeconds = _connectTimeoutSeconds;
+
++ (void)initialize {
+    if (self == [XLHTTPClient class]) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+}
+
++ (instancetype)sharedClient {
+    static XLHTTPClient *sharedClient = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedClient = [[self alloc] init];
+    });
+    return sharedClient;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _maxIdleHandles = 8;
+        _maxConnectionsPerHost = 6;
+        _maxTotalConnections = 16;
+        _http2Enabled = YES;
+        _timeoutSeconds = 30;
+        _connectTimeoutSeconds = 10;
+        _idleHandles = [[NSMutableArray alloc] init];
+        _poolLock = [[NSLock alloc] init];
+        _queueLock = [[NSRecursiveLock alloc] init];
+        _pendingTasks = [[NSMutableArray alloc] init];
+        _pendingCancels = [[NSMutableArray alloc] init];
+        _activeTasks = [[NSMutableArray alloc] init];
+        _ioThread = nil;
+        _multi = NULL;
+        _callbackQueue = dispatch_queue_create("xenolexia.http.callbacks", DISPATCH_QUEUE_SERIAL);
+
+        pthread_mutex_t *locks = calloc(CURL_LOCK_DATA_LAST, sizeof(pthread_mutex_t));
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_init(&locks[i], NULL);
+        }
+        _shareLocks = locks;
+        CURLSH *share = curl_share_init();
+        if (share) {
+            curl_share_setopt(share, CURLSHOPT_LOCKFUNC, XLHTTPShareLock);
+            curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, XLHTTPShareUnlock);
+            curl_share_setopt(share, CURLSHOPT_USERDATA, locks);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+        }
+        _share = share;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    /* Only reached when the I/O thread never started (it retains the client) */
+    if (_multi) {
+        curl_multi_cleanup((CURLM *)_multi);
+    }
+    [self purgeIdleHandles];
+    if (_share) {
+        curl_share_cleanup((CURLSH *)_share);
+    }
+    pthread_mutex_t *locks = (pthread_mutex_t *)_shareLocks;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&locks[i]);
+    }
+    free(locks);
+    [_idleHandles release];
+    [_poolLock release];
+    [_queueLock release];
+    [_pendingTasks release];
+    [_pendingCancels release];
+    [_activeTasks release];
+    dispatch_release(_callbackQueue);
+    [super dealloc];
+}
+
+#pragma mark - Handle pool
+
+- (CURL *)acquireHandle {
+    CURL *curl = NULL;
+    [_poolLock lock];
+    NSValue *last = [_idleHandles lastObject];
+    if (last) {
+        curl = (CURL *)[last pointerValue];
+        [_idleHandles removeLastObject];
+    }
+    [_poolLock unlock];
+    if (curl) {
+        /* Clears options only; the handle keeps its connection cache and TLS state */
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+    }
+    return curl;
+}
+
+- (void)releaseHandle:(CURL *)curl {
+    if (!curl) return;
+    /* Drop pointers into the finished request before the handle idles in the pool */
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, NULL);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, NULL);
+    BOOL keep = NO;
+    [_poolLock lock];
+    if ([_idleHandles count] < _maxIdleHandles) {
+        [_idleHandles addObject:[NSValue valueWithPointer:curl]];
+        keep = YES;
+    }
+    [_poolLock unlock];
+    if (!keep) {
+        curl_easy_cleanup(curl);
+    }
+}
+
+- (void)purgeIdleHandles {
+    [_poolLock lock];
+    NSArray *idle = [[_idleHandles copy] autorelease];
+    [_idleHandles removeAllObjects];
+    [_poolLock unlock];
+    for (NSValue *v in idle) {
+        curl_easy_cleanup((CURL *)[v pointerValue]);
+    }
+}
+
+#pragma mark - Request setup
+
+- (struct curl_slist *)headerListForHeaders:(NSDictionary *)headers {
+    struct curl_slist *headerList = NULL;
+    for (NSString *name in headers) {
+        NSString *line = [NSString stringWithFormat:@"%@: %@", name, [headers objectForKey:name]];
+        headerList = curl_slist_append(headerList, [line UTF8String]);
+    }
+    return headerList;
+}
+
+- (void)configureHandle:(CURL *)curl
+                    url:(NSString *)url
+                 method:(NSString *)method
+             headerList:(struct curl_slist *)headerList
+                   body:(NSData *)body
+              timeoutMs:(long)timeoutMs
+            errorBuffer:(char *)errbuf {
+    curl_easy_setopt(curl, CURLOPT_URL, [url UTF8String]);
+    if (_share) curl_easy_setopt(curl, CURLOPT_SHARE, (CURLSH *)_share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Xenolexia/1.0");
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, (long)_maxTotalConnections);
+    curl_easy_setopt(curl, CURLOPT_MAX_HOST_CONNECTIONS, (long)_maxConnectionsPerHost);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, _connectTimeoutSeconds);
+    if (_http2Enabled) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    }
+    if (headerList) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+    if (body) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, [body bytes]);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)[body length]);
+    }
+    if ([method length] > 0) {
+        if ([method isEqualToString:@"HEAD"]) {
+            curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        } else if (![method isEqualToString:(body ? @"POST" : @"GET")]) {
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, [method UTF8String]);
+        }
+    }
+}
+
+#pragma mark - Synchronous requests
+
+- (BOOL)performURL:(NSString *)url
+            method:(NSString *)method
+           headers:(NSDictionary *)headers
+              body:(NSData *)body
+     writeFunction:(curl_write_callback)writeFunction
+         writeData:(void *)writeData
+        statusCode:(long *)statusCode
+             error:(NSError **)error {
+    if (statusCode) *statusCode = 0;
+    CURL *curl = [self acquireHandle];
+    if (!curl) {
+        if (error) *error = XLHTTPError(CURLE_FAILED_INIT, @"curl init failed");
+        return NO;
+    }
+    char errbuf[CURL_ERROR_SIZE];
+    errbuf[0] = '\0';
+    struct curl_slist *headerList = [self headerListForHeaders:headers];
+    [self configureHandle:curl url:url method:method headerList:headerList body:body timeoutMs:_timeoutSeconds * 1000 errorBuffer:errbuf];
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunction);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, writeData);
+
+    CURLcode res = curl_easy_perform(curl);
+    long httpCode = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    [self releaseHandle:curl];
+    curl_slist_free_all(headerList);
+
+    if (statusCode) *statusCode = httpCode;
+    if (res != CURLE_OK) {
+        if (error) {
+            *error = XLHTTPError((NSInteger)res, errbuf[0] ? [NSString stringWithUTF8String:errbuf] : [NSString stringWithUTF8String:curl_easy_strerror(res)]);
+        }
+        return NO;
+    }
+    return YES;
+}
+
+- (NSData *)dataForURL:(NSString *)url
+                method:(NSString *)method
+               headers:(NSDictionary *)headers
+                  body:(NSData *)body
+            statusCode:(long *)statusCode
+                 error:(NSError **)error {
+    NSMutableData *data = [NSMutableData data];
+    if (![self performURL:url method:method headers:headers body:body writeFunction:XLHTTPWriteData writeData:data statusCode:statusCode error:error]) {
+        return nil;
+    }
+    return data;
+}
+
+- (BOOL)downloadURL:(NSString *)url toPath:(NSString *)path statusCode:(long *)statusCode error:(NSError **)error {
+    FILE *fp = fopen([path fileSystemRepresentation], "wb");
+    if (!fp) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    long httpCode = 0;
+    BOOL ok = [self performURL:url method:nil headers:nil body:nil writeFunction:XLHTTPWriteFile writeData:fp statusCode:&httpCode error:error];
+    fclose(fp);
+    if (statusCode) *statusCode = httpCode;
+    if (ok && httpCode != 0 && (httpCode < 200 || httpCode >= 300)) {
+        if (error) *error = XLHTTPError(httpCode, [NSString stringWithFormat:@"HTTP %ld", httpCode]);
+        ok = NO;
+    }
+    return ok;
+}
+
+#pragma mark - Async requests
+
+- (void)sendRequestToURL:(NSString *)url
+                  method:(NSString *)method
+                 headers:(NSDictionary *)headers
+                    body:(NSData *)body
+                 timeout:(NSTimeInterval)timeout
+       cancellationToken:(XLCancellationToken *)token
+              completion:(XLHTTPCompletion)completion {
+    XLHTTPTask *task = [[[XLHTTPTask alloc] init] autorelease];
+    task->_curl = [self acquireHandle];
+    task->_errbuf[0] = '\0';
+    task->_completion = [completion copy];
+    if (!task->_curl) {
+        dispatch_async(_callbackQueue, ^{ completion(nil, 0, XLHTTPError(CURLE_FAILED_INIT, @"curl init failed")); });
+        return;
+    }
+    task->_body = [body copy];
+    task->_data = [[NSMutableData alloc] init];
+    task->_headerList = [self headerListForHeaders:headers];
+    long timeoutMs = timeout > 0 ? (long)(timeout * 1000.0) : _timeoutSeconds * 1000;
+    [self configureHandle:task->_curl url:url method:method headerList:task->_headerList body:task->_body timeoutMs:timeoutMs errorBuffer:task->_errbuf];
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEFUNCTION, XLHTTPWriteData);
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEDATA, task->_data);
+    curl_easy_setopt(task->_curl, CURLOPT_PRIVATE, task);
+    task->_token = [token retain];
+    [self submitTask:task];
+}
+
+- (void)downloadURL:(NSString *)url
+             toPath:(NSString *)path
+            timeout:(NSTimeInterval)timeout
+  cancellationToken:(XLCancellationToken *)token
+         completion:(XLHTTPCompletion)completion {
+    XLHTTPTask *task = [[[XLHTTPTask alloc] init] autorelease];
+    task->_completion = [completion copy];
+    task->_file = fopen([path fileSystemRepresentation], "wb");
+    if (!task->_file) {
+        NSError *err = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        dispatch_async(_callbackQueue, ^{ completion(nil, 0, err); });
+        return;
+    }
+    task->_path = [path copy];
+    task->_curl = [self acquireHandle];
+    task->_errbuf[0] = '\0';
+    if (!task->_curl) {
+        dispatch_async(_callbackQueue, ^{ completion(nil, 0, XLHTTPError(CURLE_FAILED_INIT, @"curl init failed")); });
+        return;
+    }
+    long timeoutMs = timeout > 0 ? (long)(timeout * 1000.0) : 0;
+    [self configureHandle:task->_curl url:url method:nil headerList:NULL body:nil timeoutMs:timeoutMs errorBuffer:task->_errbuf];
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEFUNCTION, XLHTTPWriteFile);
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEDATA, task->_file);
+    curl_easy_setopt(task->_curl, CURLOPT_PRIVATE, task);
+    task->_token = [token retain];
+    [self submitTask:task];
+}
+
+- (void)fetchHeadersForURL:(NSString *)url
+                   timeout:(NSTimeInterval)timeout
+         cancellationToken:(XLCancellationToken *)token
+                completion:(XLHTTPHeadersCompletion)completion {
+    XLHTTPTask *task = [[[XLHTTPTask alloc] init] autorelease];
+    task->_curl = [self acquireHandle];
+    task->_errbuf[0] = '\0';
+    task->_headersCompletion = [completion copy];
+    if (!task->_curl) {
+        dispatch_async(_callbackQueue, ^{ completion(nil, 0, XLHTTPError(CURLE_FAILED_INIT, @"curl init failed")); });
+        return;
+    }
+    task->_responseHeaders = [[NSMutableDictionary alloc] init];
+    long timeoutMs = timeout > 0 ? (long)(timeout * 1000.0) : _timeoutSeconds * 1000;
+    [self configureHandle:task->_curl url:url method:@"HEAD" headerList:NULL body:nil timeoutMs:timeoutMs errorBuffer:task->_errbuf];
+    curl_easy_setopt(task->_curl, CURLOPT_HEADERFUNCTION, XLHTTPHeaderLine);
+    curl_easy_setopt(task->_curl, CURLOPT_HEADERDATA, task);
+    curl_easy_setopt(task->_curl, CURLOPT_PRIVATE, task);
+    task->_token = [token retain];
+    [self submitTask:task];
+}
+
+- (void)downloadURL:(NSString *)url
+         fromOffset:(int64_t)offset
+             length:(int64_t)length
+   toFileDescriptor:(int)fd
+            ifRange:(NSString *)validator
+            timeout:(NSTimeInterval)timeout
+  cancellationToken:(XLCancellationToken *)token
+           progress:(XLHTTPProgressBlock)progress
+         completion:(XLHTTPCompletion)completion {
+    XLHTTPTask *task = [[[XLHTTPTask alloc] init] autorelease];
+    task->_curl = [self acquireHandle];
+    task->_errbuf[0] = '\0';
+    task->_completion = [completion copy];
+    if (!task->_curl) {
+        dispatch_async(_callbackQueue, ^{ completion(nil, 0, XLHTTPError(CURLE_FAILED_INIT, @"curl init failed")); });
+        return;
+    }
+    task->_writesToDescriptor = YES;
+    task->_fd = fd;
+    task->_fileOffset = offset;
+    task->_progress = [progress copy];
+    NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+    if (offset > 0 || length > 0) {
+        NSString *range = length > 0
+            ? [NSString stringWithFormat:@"bytes=%lld-%lld", (long long)offset, (long long)(offset + length - 1)]
+            : [NSString stringWithFormat:@"bytes=%lld-", (long long)offset];
+        [headers setObject:range forKey:@"Range"];
+        if ([validator length] > 0) {
+            [headers setObject:validator forKey:@"If-Range"];
+        }
+    }
+    task->_headerList = [self headerListForHeaders:headers];
+    long timeoutMs = timeout > 0 ? (long)(timeout * 1000.0) : 0;
+    [self configureHandle:task->_curl url:url method:nil headerList:task->_headerList body:nil timeoutMs:timeoutMs errorBuffer:task->_errbuf];
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEFUNCTION, XLHTTPWriteRange);
+    curl_easy_setopt(task->_curl, CURLOPT_WRITEDATA, task);
+    curl_easy_setopt(task->_curl, CURLOPT_PRIVATE, task);
+    task->_token = [token retain];
+    [self submitTask:task];
+}
+
+- (void)submitTask:(XLHTTPTask *)task {
+    [_queueLock lock];
+    if (task->_token) {
+        /* Registered before the I/O thread can see the task, so -finishTask: always has a registration to drop.
+           The handler runs on the cancelling thread (inline here if already cancelled) and only queues the
+           cancel; the I/O thread picks up the add and the cancel from the same snapshot. */
+        task->_registration = [[task->_token registerCancellationHandler:^{
+            [self cancelTask:task];
+        }] retain];
+    }
+    [_pendingTasks addObject:task];
+    if (!_ioThread) {
+        CURLM *multi = curl_multi_init();
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)_maxConnectionsPerHost);
+        curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)_maxTotalConnections);
+        if (_http2Enabled) {
+            curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+        }
+        _multi = multi;
+        _ioThread = [[NSThread alloc] initWithTarget:self selector:@selector(ioThreadMain:) object:nil];
+        [_ioThread setName:@"xenolexia.http.io"];
+        [_ioThread start];
+    }
+    [_queueLock unlock];
+    [self wakeIOThread];
+}
+
+- (void)cancelTask:(XLHTTPTask *)task {
+    [_queueLock lock];
+    [_pendingCancels addObject:task];
+    [_queueLock unlock];
+    [self wakeIOThread];
+}
+
+- (void)wakeIOThread {
+#ifdef XL_HAVE_MULTI_POLL
+    if (_multi) curl_multi_wakeup((CURLM *)_multi);
+#endif
+}
+
+- (void)ioThreadMain:(id)unused {
+    CURLM *multi = (CURLM *)_multi;
+    for (;;) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        [_queueLock lock];
+        NSArray *adds = [[_pendingTasks copy] autorelease];
+        NSArray *cancels = [[_pendingCancels copy] autorelease];
+        [_pendingTasks removeAllObjects];
+        [_pendingCancels removeAllObjects];
+        [_queueLock unlock];
+
+        for (XLHTTPTask *task in adds) {
+            [_activeTasks addObject:task];
+            curl_multi_add_handle(multi, task->_curl);
+        }
+        for (XLHTTPTask *task in cancels) {
+            if ([_activeTasks indexOfObjectIdenticalTo:task] == NSNotFound) continue;
+            curl_multi_remove_handle(multi, task->_curl);
+            [self finishTask:task result:CURLE_ABORTED_BY_CALLBACK];
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int remaining = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(multi, &remaining))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            XLHTTPTask *task = nil;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&task);
+            CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            if (task) [self finishTask:task result:result];
+        }
+        [pool drain];
+
+#ifdef XL_HAVE_MULTI_POLL
+        curl_multi_poll(multi, NULL, 0, 1000, NULL);
+#else
+        int numfds = 0;
+        curl_multi_wait(multi, NULL, 0, running > 0 ? 50 : 100, &numfds);
+#endif
+    }
+}
+
+/// I/O thread only. The easy handle has already been removed from the multi handle.
+- (void)finishTask:(XLHTTPTask *)task result:(CURLcode)result {
+    [[task retain] autorelease];
+    [_activeTasks removeObjectIdenticalTo:task];
+    /* The handler block retains the task; dropping it here breaks that cycle */
+    [task->_token unregisterCancellationHandler:task->_registration];
+    [task->_registration release];
+    task->_registration = nil;
+
+    long httpCode = 0;
+    curl_easy_getinfo(task->_curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    NSError *error = nil;
+    if (result == CURLE_ABORTED_BY_CALLBACK) {
+        error = XLHTTPError(result, @"Request cancelled");
+    } else if (result != CURLE_OK) {
+        error = XLHTTPError(result, task->_errbuf[0] ? [NSString stringWithUTF8String:task->_errbuf] : [NSString stringWithUTF8String:curl_easy_strerror(result)]);
+    }
+    [self releaseHandle:task->_curl];
+    task->_curl = NULL;
+
+    NSData *data = nil;
+    if (task->_writesToDescriptor) {
+        /* The write callback refuses non-2xx bodies; report the status rather than the write error */
+        if (result != CURLE_ABORTED_BY_CALLBACK && httpCode != 0 && (httpCode < 200 || httpCode >= 300)) {
+            error = XLHTTPError(httpCode, [NSString stringWithFormat:@"HTTP %ld", httpCode]);
+        }
+    } else if (task->_file) {
+        fclose(task->_file);
+        task->_file = NULL;
+        if (!error && httpCode != 0 && (httpCode < 200 || httpCode >= 300)) {
+            error = XLHTTPError(httpCode, [NSString stringWithFormat:@"HTTP %ld", httpCode]);
+        }
+        if (error) {
+            unlink([task->_path fileSystemRepresentation]);
+        }
+    } else if (!error) {
+        data = [[task->_data copy] autorelease];
+    }
+    XLHTTPHeadersCompletion headersCompletion = [[task->_headersCompletion retain] autorelease];
+    if (headersCompletion) {
+        NSDictionary *headers = error ? nil : [[task->_responseHeaders copy] autorelease];
+        dispatch_async(_callbackQueue, ^{ headersCompletion(headers, httpCode, error); });
+        return;
+    }
+    XLHTTPCompletion completion = [[task->_completion retain] autorelease];
+    if (completion) {
+        dispatch_async(_callbackQueue, ^{ completion(data, httpCode, error); });
+    }
+}
+
+@end
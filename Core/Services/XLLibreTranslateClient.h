@@ -7,11 +7,23 @@
 
 #import <Foundation/Foundation.h>
 
+@class XLCancellationToken;
+
 /// Calls LibreTranslate API (POST /translate). Base URL e.g. https://libretranslate.com
+/// Requests are non-blocking (XLHTTPClient I/O thread); completion runs on the HTTP callback queue.
 @interface XLLibreTranslateClient : NSObject
 + (void)translateText:(NSString *)text
        fromLanguage:(NSString *)sourceCode
          toLanguage:(NSString *)targetCode
             baseURL:(NSString *)baseURL
          completion:(void(^)(NSString *translatedText, NSError *error))completion;
+
+/// Same, with a per-request deadline in seconds (<= 0 for the client default) and optional cancellation
++ (void)translateText:(NSString *)text
+       fromLanguage:(NSString *)sourceCode
+         toLanguage:(NSString *)targetCode
+            baseURL:(NSString *)baseURL
+            timeout:(NSTimeInterval)timeout
+  cancellationToken:(XLCancellationToken *)token
+         completion:(void(^)(NSString *translatedText, NSError *error))completion;
 @end
@@ -8,6 +8,7 @@
 #import "../Models/Book.h"
 #import "../Models/Vocabulary.h"
 #import "../Models/Reader.h"
+#import "XLCancellationToken.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -34,16 +35,23 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (instancetype)sharedManager;
 
-// Book operations (block-based - for platforms with block support)
+// Book operations (block-based - for platforms with block support).
+// Parsing and processing run on XLExecutor workers (imports as XLWorkPriorityImport, chapters as
+// XLWorkPriorityVisible); completions are called on a worker thread.
 - (void)importBookAtPath:(NSString *)filePath
           withCompletion:(void(^)(XLBook * _Nullable book, NSError * _Nullable error))completion;
 
-- (void)processBook:(XLBook *)book
-     withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion;
+/// Returns a handle for the run: cancel it when the chapter is no longer wanted (e.g. the reader moved on).
+/// Cancelling stops tokenizing, drops translation requests not yet sent, and completes with
+/// XLTranslationEngineErrorCancelled instead of a result.
+- (XLCancellationToken *)processBook:(XLBook *)book
+                      withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion;
 
-// Book operations (delegate-based - GNUStep compatible)
+// Book operations (delegate-based - GNUStep compatible); delegates are called on the main thread
 - (void)importBookAtPath:(NSString *)filePath delegate:(id<XLManagerDelegate>)delegate;
-- (void)processBook:(XLBook *)book delegate:(id<XLManagerDelegate>)delegate;
+/// Nothing is delivered for a run whose handle was cancelled before its result reached the main thread,
+/// so cancelling on the main thread is enough to keep a superseded chapter off the screen.
+- (XLCancellationToken *)processBook:(XLBook *)book delegate:(id<XLManagerDelegate>)delegate;
 
 // Translation operations (block-based)
 - (void)translateWord:(NSString *)word
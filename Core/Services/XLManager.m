@@ -9,6 +9,7 @@
 #import "XLTranslationService.h"
 #import "XLStorageService.h"
 #import "XLExportService.h"
+#import "XLExecutor.h"
 #import "SSFileSystem.h"
 #import "../../DictionaryService.h"
 #import "../../DownloadService.h"
@@ -29,9 +30,10 @@
 
 + (instancetype)sharedManager {
     static XLManager *sharedManager = nil;
-    if (sharedManager == nil) {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
         sharedManager = [[self alloc] init];
-    }
+    });
     return sharedManager;
 }
 
@@ -55,6 +57,14 @@
 
 - (void)importBookAtPath:(NSString *)filePath
           withCompletion:(void(^)(XLBook *book, NSError *error))completion {
+    // Parse off the caller's thread, behind any chapter the reader is waiting for
+    [[XLExecutor sharedExecutor] submitWithPriority:XLWorkPriorityImport block:^{
+        [self importBookNowAtPath:filePath withCompletion:completion];
+    }];
+}
+
+- (void)importBookNowAtPath:(NSString *)filePath
+             withCompletion:(void(^)(XLBook *book, NSError *error))completion {
     // Get file size
     NSFileManager *fileManager = [NSFileManager defaultManager];
     NSDictionary *fileAttributes = [fileManager attributesOfItemAtPath:filePath error:nil];
@@ -96,13 +106,23 @@
 - (void)importBookAtPath:(NSString *)filePath delegate:(id<XLManagerDelegate>)delegate {
     // Use block-based method internally and bridge to delegate
     [self importBookAtPath:filePath withCompletion:^(XLBook *book, NSError *error) {
-        if ([delegate respondsToSelector:@selector(manager:didImportBook:withError:)]) {
-            [delegate manager:self didImportBook:book withError:error];
-        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if ([delegate respondsToSelector:@selector(manager:didImportBook:withError:)]) {
+                [delegate manager:self didImportBook:book withError:error];
+            }
+        });
     }];
 }
 
+- (XLCancellationToken *)processBook:(XLBook *)book
+                      withCompletion:(void(^)(XLProcessedChapter *processedChapter, NSError *error))completion {
+    XLCancellationToken *token = [XLCancellationToken token];
+    [self processBook:book cancellationToken:token withCompletion:completion];
+    return token;
+}
+
 - (void)processBook:(XLBook *)book
+  cancellationToken:(XLCancellationToken *)token
      withCompletion:(void(^)(XLProcessedChapter *processedChapter, NSError *error))completion {
     // Create translation options from book settings
     XLTranslationOptions *options = [XLTranslationOptions optionsWithLanguagePair:book.languagePair
@@ -110,30 +130,51 @@
                                                                      wordDensity:book.wordDensity];
     
     // Create translation engine
-    self.translationEngine = [[XLTranslationEngine alloc] initWithOptions:options];
+    XLTranslationEngine *engine = [[[XLTranslationEngine alloc] initWithOptions:options] autorelease];
+    engine.priority = XLWorkPriorityVisible;
+    self.translationEngine = engine;
+    NSInteger chapterIndex = book.currentChapter;
+    NSString *filePath = [[book.filePath copy] autorelease];
+    XLBookParserService *parser = self.bookParser;
+    XLStorageService *storage = self.storageService;
     
-    // Get current chapter
-    [self.bookParser getChapterAtIndex:book.currentChapter
-                              fromPath:book.filePath
-                        withCompletion:^(XLChapter *chapter, NSError *error) {
-        if (error) {
-            if (completion) completion(nil, error);
+    // Get current chapter on a worker, ahead of imports and maintenance
+    [[XLExecutor sharedExecutor] submitWithPriority:XLWorkPriorityVisible block:^{
+        if ([token isCancelled]) {
+            if (completion) completion(nil, [NSError errorWithDomain:XLTranslationEngineErrorDomain code:XLTranslationEngineErrorCancelled
+                                                            userInfo:@{ NSLocalizedDescriptionKey: @"Chapter processing cancelled" }]);
             return;
         }
-        
-        // Process chapter
-        [self.translationEngine processChapter:chapter withCompletion:completion];
+        // Learned and known words are never replaced
+        options.knownWords = [storage knownWordSetForLanguagePair:options.languagePair];
+        [parser getChapterAtIndex:chapterIndex
+                         fromPath:filePath
+                   withCompletion:^(XLChapter *chapter, NSError *error) {
+            if (error) {
+                if (completion) completion(nil, error);
+                return;
+            }
+            
+            // Process chapter
+            [engine processChapter:chapter cancellationToken:token withCompletion:completion];
+        }];
     }];
 }
 
 // Delegate-based version (GNUStep compatible)
-- (void)processBook:(XLBook *)book delegate:(id<XLManagerDelegate>)delegate {
+- (XLCancellationToken *)processBook:(XLBook *)book delegate:(id<XLManagerDelegate>)delegate {
     // Use block-based method internally and bridge to delegate
-    [self processBook:book withCompletion:^(XLProcessedChapter *processedChapter, NSError *error) {
-        if ([delegate respondsToSelector:@selector(manager:didProcessChapter:withError:)]) {
-            [delegate manager:self didProcessChapter:processedChapter withError:error];
-        }
+    XLCancellationToken *token = [XLCancellationToken token];
+    [self processBook:book cancellationToken:token withCompletion:^(XLProcessedChapter *processedChapter, NSError *error) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            // Checked on the main thread, where callers cancel: a superseded chapter is never delivered
+            if ([token isCancelled]) return;
+            if ([delegate respondsToSelector:@selector(manager:didProcessChapter:withError:)]) {
+                [delegate manager:self didProcessChapter:processedChapter withError:error];
+            }
+        });
     }];
+    return token;
 }
 
 #pragma mark - Translation Operations
@@ -0,0 +1,45 @@
+//
+//  XLStorageChangeSet.h
+//  Xenolexia
+//
+//  Typed change events published by XLStorageService after each commit
+
+#import <Foundation/Foundation.h>
+
+/// Posted on the main thread, at most once per run-loop turn, with every change committed since the last post.
+/// userInfo[XLStorageChangeSetKey] is an XLStorageChangeSet.
+extern NSString *const XLStorageServiceDidChangeNotification;
+extern NSString *const XLStorageChangeSetKey;
+
+/// Table names used in change sets
+extern NSString *const XLStorageTableBooks;
+extern NSString *const XLStorageTableVocabulary;
+extern NSString *const XLStorageTableReadingSessions;
+extern NSString *const XLStorageTableDailyStats;
+extern NSString *const XLStorageTablePreferences;
+/// Row ids for this table are book ids: any processed chapter of that book changed
+extern NSString *const XLStorageTableProcessedChapters;
+/// Row ids for this table are language pairs ("en-fr"): a word was marked known in that pair
+extern NSString *const XLStorageTableKnownWords;
+
+/// Inserted / updated / deleted row ids per table. Recording is coalescing:
+/// insert+update stays an insert, insert+delete cancels out, delete+insert becomes an update.
+@interface XLStorageChangeSet : NSObject <NSCopying> {
+    NSMutableDictionary *_inserted;
+    NSMutableDictionary *_updated;
+    NSMutableDictionary *_deleted;
+}
+
+- (void)recordInsertedId:(NSString *)rowId inTable:(NSString *)table;
+- (void)recordUpdatedId:(NSString *)rowId inTable:(NSString *)table;
+- (void)recordDeletedId:(NSString *)rowId inTable:(NSString *)table;
+
+- (NSSet *)insertedIdsForTable:(NSString *)table;
+- (NSSet *)updatedIdsForTable:(NSString *)table;
+- (NSSet *)deletedIdsForTable:(NSString *)table;
+
+/// YES if any row of table was inserted, updated or deleted
+- (BOOL)touchesTable:(NSString *)table;
+- (BOOL)isEmpty;
+
+@end
@@ -0,0 +1,120 @@
+//
+//  XLStorageChangeSet.m
+//  Xenolexia
+//
+
+#import "XLStorageChangeSet.h"
+
+NSString *const XLStorageServiceDidChangeNotification = @"XLStorageServiceDidChangeNotification";
+NSString *const XLStorageChangeSetKey = @"changeSet";
+
+NSString *const XLStorageTableBooks = @"books";
+NSString *const XLStorageTableVocabulary = @"vocabulary";
+NSString *const XLStorageTableReadingSessions = @"reading_sessions";
+NSString *const XLStorageTableDailyStats = @"daily_stats";
+NSString *const XLStorageTablePreferences = @"preferences";
+NSString *const XLStorageTableProcessedChapters = @"processed_chapters";
+NSString *const XLStorageTableKnownWords = @"known_words";
+
+static NSMutableSet *idsForTable(NSMutableDictionary *byTable, NSString *table) {
+    NSMutableSet *ids = [byTable objectForKey:table];
+    if (!ids) {
+        ids = [NSMutableSet set];
+        [byTable setObject:ids forKey:table];
+    }
+    return ids;
+}
+
+@implementation XLStorageChangeSet
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _inserted = [[NSMutableDictionary alloc] init];
+        _updated = [[NSMutableDictionary alloc] init];
+        _deleted = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_inserted release];
+    [_updated release];
+    [_deleted release];
+    [super dealloc];
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    XLStorageChangeSet *copy = [[XLStorageChangeSet allocWithZone:zone] init];
+    for (NSString *table in _inserted) {
+        [idsForTable(copy->_inserted, table) unionSet:[_inserted objectForKey:table]];
+    }
+    for (NSString *table in _updated) {
+        [idsForTable(copy->_updated, table) unionSet:[_updated objectForKey:table]];
+    }
+    for (NSString *table in _deleted) {
+        [idsForTable(copy->_deleted, table) unionSet:[_deleted objectForKey:table]];
+    }
+    return copy;
+}
+
+- (void)recordInsertedId:(NSString *)rowId inTable:(NSString *)table {
+    if (!rowId || !table) return;
+    NSMutableSet *deleted = [_deleted objectForKey:table];
+    if ([deleted containsObject:rowId]) {
+        [deleted removeObject:rowId];
+        [idsForTable(_updated, table) addObject:rowId];
+        return;
+    }
+    [idsForTable(_inserted, table) addObject:rowId];
+}
+
+- (void)recordUpdatedId:(NSString *)rowId inTable:(NSString *)table {
+    if (!rowId || !table) return;
+    if ([[_inserted objectForKey:table] containsObject:rowId]) return;
+    [idsForTable(_updated, table) addObject:rowId];
+}
+
+- (void)recordDeletedId:(NSString *)rowId inTable:(NSString *)table {
+    if (!rowId || !table) return;
+    NSMutableSet *inserted = [_inserted objectForKey:table];
+    if ([inserted containsObject:rowId]) {
+        [inserted removeObject:rowId];
+        return;
+    }
+    [[_updated objectForKey:table] removeObject:rowId];
+    [idsForTable(_deleted, table) addObject:rowId];
+}
+
+- (NSSet *)insertedIdsForTable:(NSString *)table {
+    return [[[_inserted objectForKey:table] copy] autorelease] ?: [NSSet set];
+}
+
+- (NSSet *)updatedIdsForTable:(NSString *)table {
+    return [[[_updated objectForKey:table] copy] autorelease] ?: [NSSet set];
+}
+
+- (NSSet *)deletedIdsForTable:(NSString *)table {
+    return [[[_deleted objectForKey:table] copy] autorelease] ?: [NSSet set];
+}
+
+- (BOOL)touchesTable:(NSString *)table {
+    return [[_inserted objectForKey:table] count] > 0
+        || [[_updated objectForKey:table] count] > 0
+        || [[_deleted objectForKey:table] count] > 0;
+}
+
+- (BOOL)isEmpty {
+    for (NSDictionary *byTable in [NSArray arrayWithObjects:_inserted, _updated, _deleted, nil]) {
+        for (NSString *table in byTable) {
+            if ([[byTable objectForKey:table] count] > 0) return NO;
+        }
+    }
+    return YES;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@ inserted=%@ updated=%@ deleted=%@>", NSStringFromClass([self class]), _inserted, _updated, _deleted];
+}
+
+@end
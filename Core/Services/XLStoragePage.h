@@ -0,0 +1,24 @@
+//
+//  XLStoragePage.h
+//  Xenolexia
+//
+//  One page of rows from a keyset-paginated storage query
+
+#import <Foundation/Foundation.h>
+
+/// A page of books or vocabulary items plus an opaque continuation token.
+/// Pass the token back to the same query to get the next page; nil means this was the last page.
+@interface XLStoragePage : NSObject {
+    NSArray *_items;
+    NSString *_continuationToken;
+}
+
+@property (nonatomic, retain) NSArray *items;
+@property (nonatomic, copy) NSString *continuationToken;
+
++ (instancetype)pageWithItems:(NSArray *)items continuationToken:(NSString *)token;
+
+/// YES when continuationToken is set (more rows follow this page)
+- (BOOL)hasMore;
+
+@end
@@ -0,0 +1,39 @@
+//
+//  XLStoragePage.m
+//  Xenolexia
+//
+
+#import "XLStoragePage.h"
+
+@implementation XLStoragePage
+
+@synthesize items = _items;
+@synthesize continuationToken = _continuationToken;
+
++ (instancetype)pageWithItems:(NSArray *)items continuationToken:(NSString *)token {
+    XLStoragePage *page = [[[self alloc] init] autorelease];
+    page.items = items ?: [NSArray array];
+    page.continuationToken = token;
+    return page;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _items = [[NSArray alloc] init];
+        _continuationToken = nil;
+    }
+    return self;
+}
+
+- (BOOL)hasMore {
+    return _continuationToken != nil;
+}
+
+- (void)dealloc {
+    [_items release];
+    [_continuationToken release];
+    [super dealloc];
+}
+
+@end
@@ -9,6 +9,11 @@
 #import "../Models/Vocabulary.h"
 #import "../Models/Reader.h"
 #import "XLStorageServiceDelegate.h"
+#import "XLStoragePage.h"
+#import "XLStorageChangeSet.h"
+#import "XLVocabularyCursor.h"
+
+@class XLKnownWordSet;
 
 /// Storage service protocol
 @protocol XLStorageService <NSObject>
@@ -19,6 +24,12 @@
 - (void)getAllBooksWithDelegate:(id<XLStorageServiceDelegate>)delegate;
 - (void)getAllBooksWithSortBy:(NSString *)sortBy order:(NSString *)order delegate:(id<XLStorageServiceDelegate>)delegate;
 - (void)deleteBookWithId:(NSString *)bookId delegate:(id<XLStorageServiceDelegate>)delegate;
+/// Keyset-paginated books: pass nil token for the first page, then the previous page's continuationToken.
+/// Rows are ordered by (sortBy, id) so pages stay stable while rows are added or removed.
+- (void)getBooksPageWithSortBy:(NSString *)sortBy order:(NSString *)order afterToken:(NSString *)token limit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate;
+- (void)getBookCountWithDelegate:(id<XLStorageServiceDelegate>)delegate;
+/// Fetch several books by id (e.g. the ids of an XLStorageChangeSet); missing ids are skipped
+- (void)getBooksWithIds:(NSArray *)bookIds delegate:(id<XLStorageServiceDelegate>)delegate;
 
 // Vocabulary operations
 - (void)saveVocabularyItem:(XLVocabularyItem *)item delegate:(id<XLStorageServiceDelegate>)delegate;
@@ -26,10 +37,29 @@
 - (void)getAllVocabularyItemsWithDelegate:(id<XLStorageServiceDelegate>)delegate;
 - (void)deleteVocabularyItemWithId:(NSString *)itemId delegate:(id<XLStorageServiceDelegate>)delegate;
 - (void)searchVocabularyWithQuery:(NSString *)query delegate:(id<XLStorageServiceDelegate>)delegate;
+/// Keyset-paginated vocabulary (newest first). query matches source/target word (nil or empty = all);
+/// status is a spec status string (new, learning, review, learned) or nil for all.
+- (void)getVocabularyPageWithQuery:(NSString *)query status:(NSString *)status afterToken:(NSString *)token limit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate;
+- (void)getVocabularyCountWithQuery:(NSString *)query status:(NSString *)status delegate:(id<XLStorageServiceDelegate>)delegate;
+- (void)getVocabularyItemsWithIds:(NSArray *)itemIds delegate:(id<XLStorageServiceDelegate>)delegate;
+/// Streaming read of the same rows as the vocabulary pages, on a separate connection (usable from a background thread).
+- (XLVocabularyCursor *)vocabularyCursorWithQuery:(NSString *)query status:(NSString *)status;
 /// Spec: items due for review (status != learned and last_reviewed_at + interval*86400000 <= now), limit default 20
 - (void)getVocabularyDueForReviewWithLimit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate;
 /// Spec: record one SM-2 review step (quality 0-5); formula matches xenolexia-shared-c/sm2.c
 - (void)recordReviewForItemId:(NSString *)itemId quality:(NSInteger)quality delegate:(id<XLStorageServiceDelegate>)delegate;
+/// Apply one SM-2 step to many items in one transaction (imported reviews, re-grading a deck, load simulation).
+/// qualityForItem is called once per vocabulary row and returns 0-5, or -1 to leave the row alone.
+/// reviewedAt, when not nil, becomes last_reviewed_at of every graded row.
+- (void)rescheduleVocabularyWithQualities:(NSInteger (^)(NSString *itemId))qualityForItem reviewedAt:(NSDate *)reviewedAt delegate:(id<XLStorageServiceDelegate>)delegate;
+
+// Known words: learned vocabulary plus words marked known, never chosen for replacement
+/// Copy of the language pair's known-word set, usable from any thread. Loaded from its on-disk snapshot (or
+/// rebuilt from the database when the snapshot is missing or stale) on first use, then kept current as items
+/// are saved, graded or marked known.
+- (XLKnownWordSet *)knownWordSetForLanguagePair:(XLLanguagePair *)languagePair;
+/// "I knew this": word is excluded from replacement in this language pair from now on
+- (void)markWordKnown:(NSString *)word languagePair:(XLLanguagePair *)languagePair delegate:(id<XLStorageServiceDelegate>)delegate;
 
 // Preferences (Phase 0)
 - (void)getPreferencesWithDelegate:(id<XLStorageServiceDelegate>)delegate;
@@ -45,24 +75,42 @@
 
 // Statistics (Phase 0)
 - (void)getReadingStatsWithDelegate:(id<XLStorageServiceDelegate>)delegate;
+// Processed chapters: translated output keyed by (book, chapter index, language pair, proficiency, density)
+/// Store processed chapters of one book in a single transaction, replacing earlier output for the same settings
+- (void)saveProcessedChapters:(NSArray *)chapters forBookId:(NSString *)bookId languagePair:(XLLanguagePair *)languagePair proficiency:(XLProficiencyLevel)proficiency density:(double)density delegate:(id<XLStorageServiceDelegate>)delegate;
+- (void)getProcessedChapterForBookId:(NSString *)bookId chapterIndex:(NSInteger)chapterIndex languagePair:(XLLanguagePair *)languagePair proficiency:(XLProficiencyLevel)proficiency density:(double)density delegate:(id<XLStorageServiceDelegate>)delegate;
+
 /// Last N days: words revealed per day. Delegate receives array of NSDictionary with @"dayLabel" (e.g. @"Mon 27"), @"wordsRevealed" (NSNumber).
 - (void)getWordsRevealedByDayWithLastDays:(NSInteger)lastDays delegate:(id<XLStorageServiceDelegate>)delegate;
+/// Next N days (day 0 = next 24 hours) of simulated SM-2 reviews. gradeWeights: 6 NSNumbers weighting grades 0-5, or nil
+/// for the defaults. Delegate receives NSDictionary items with @"dayLabel", @"due" and @"learned" (expected counts, NSNumber).
+- (void)getReviewForecastForDays:(NSInteger)days gradeWeights:(NSArray *)gradeWeights delegate:(id<XLStorageServiceDelegate>)delegate;
 
 @end
 
 @class SSFileSystem;
 @class FMDatabase;
 
-/// Storage service implementation (uses FMDB for SQLite access)
+/// Storage service implementation (uses FMDB for SQLite access).
+/// Committed writes are also published as XLStorageServiceDidChangeNotification (see XLStorageChangeSet.h).
 @interface XLStorageService : NSObject <XLStorageService> {
     NSString *_databasePath;
     FMDatabase *_database;
+    NSRecursiveLock *_databaseLock;     // serializes every call that uses _database
     SSFileSystem *_fileSystem;
     id<XLStorageServiceDelegate> _currentDelegate;
+    XLStorageChangeSet *_pendingChanges;
+    BOOL _changePostScheduled;
+    NSMutableDictionary *_knownWordSets;    // "en-fr" -> XLKnownWordSet, guarded by _databaseLock
 }
 
 + (instancetype)sharedService;
 
+/// Storage backed by the database at path (sharedService uses xenolexia.db in the documents directory).
+/// Thread-safe: calls from several threads (e.g. XLExecutor workers) are serialized on one connection,
+/// and each call's delegate callbacks run on the calling thread before it returns.
+- (instancetype)initWithDatabasePath:(NSString *)path;
+
 /// Initialize the database (creates tables if needed)
 - (void)initializeDatabaseWithDelegate:(id<XLStorageServiceDelegate>)delegate;
 
@@ -8,10 +8,110 @@
 #import "../Models/Language.h"
 #import "../Models/Vocabulary.h"
 #import "../Models/Reader.h"
+#import "../Models/SearchKey.h"
 #import "SSFileSystem.h"
-#import "../Native/XLSm2.h"
 #import "FMDatabase.h"
 #import "FMResultSet.h"
+#import "../Native/XLChapterText.h"
+#import "../Native/XLKnownWordSet.h"
+#import "../Native/XLMetrics.h"
+#import "../Native/XLReviewForecast.h"
+#import "../Native/XLSm2.h"
+#import "../Native/XLSm2Batch.h"
+#import "../Native/XLTrace.h"
+#import <math.h>
+#import <sqlite3.h>
+
+/// Trace span plus latency histogram for one storage call
+#define XL_STORAGE_SPAN(name) XL_TRACE_SCOPE(name, "sqlite"); XL_METRIC_TIMER(name)
+
+static void XLStorageUnlock(NSRecursiveLock **lock) {
+    [*lock unlock];
+}
+
+/// Hold the database lock for the rest of the block. Every public entry point takes it before touching
+/// _database or _currentDelegate; it is recursive so the lazy-initialize-and-retry path can re-enter.
+#define XL_STORAGE_LOCKED() \
+    NSRecursiveLock *_xlStorageLock __attribute__((cleanup(XLStorageUnlock), unused)) = ({ [_databaseLock lock]; _databaseLock; })
+
+/// What happened to a row, for the change feed
+typedef NS_ENUM(NSInteger, XLStorageChange) {
+    XLStorageChangeInserted,
+    XLStorageChangeUpdated,
+    XLStorageChangeDeleted
+};
+
+/// Column lists matching bookFromResultSet: / vocabularyItemFromResultSet:
+static NSString *const kBookColumns = @"id, title, author, cover_path, file_path, format, file_size, added_at, last_read_at, source_lang, target_lang, proficiency, density, progress, current_location, current_chapter, total_chapters, current_page, total_pages, reading_time_minutes, source_url, is_downloaded";
+static NSString *const kVocabularyColumns = @"id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status";
+static const NSInteger kBookColumnCount = 22;
+static const NSInteger kDefaultPageSize = 50;
+/// Rows per XLSm2StepBatch call when rescheduling the vocabulary table
+enum { kRescheduleChunk = 4096 };
+
+/// vocabulary.status values, indexed by XLSm2Status
+static const char *const kSm2StatusNames[] = { "new", "learning", "review", "learned" };
+
+static int64_t XLSm2StatusForName(const char *name) {
+    for (int64_t status = 0; name && status < 4; status++) {
+        if (strcmp(name, kSm2StatusNames[status]) == 0) return status;
+    }
+    return XLSm2StatusNew;
+}
+
+/// Sort key expression for a book sort field; matches the idx_books_* expression indexes.
+static NSString *XLBookSortKeyExpression(NSString *sortBy) {
+    if ([sortBy isEqualToString:@"addedAt"]) return @"added_at";
+    if ([sortBy isEqualToString:@"title"]) return @"title";
+    if ([sortBy isEqualToString:@"author"]) return @"COALESCE(author, '')";
+    if ([sortBy isEqualToString:@"progress"]) return @"COALESCE(progress, 0)";
+    return @"COALESCE(last_read_at, 0)";
+}
+
+/// Continuation token: JSON [sortKey, lastSortValue, lastId]. Opaque to callers.
+/// A REAL sort value (progress) is written as ["<its 64 bits in hex>"]: a JSON number would round it, and the
+/// next page would then repeat or skip the rows that share it.
+static NSString *XLEncodePageToken(NSString *sortKey, id sortValue, NSString *rowId) {
+    if (!sortValue || !rowId) return nil;
+    if ([sortValue isKindOfClass:[NSNumber class]]) {
+        const char *type = [sortValue objCType];
+        if (strcmp(type, @encode(double)) == 0 || strcmp(type, @encode(float)) == 0) {
+            double real = [sortValue doubleValue];
+            uint64_t bits;
+            memcpy(&bits, &real, sizeof(bits));
+            sortValue = [NSArray arrayWithObject:[NSString stringWithFormat:@"%016llx", (unsigned long long)bits]];
+        }
+    }
+    NSArray *parts = [NSArray arrayWithObjects:sortKey, sortValue, rowId, nil];
+    NSData *data = [NSJSONSerialization dataWithJSONObject:parts options:0 error:NULL];
+    if (!data) return nil;
+    return [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+}
+
+static BOOL XLDecodePageToken(NSString *token, NSString *sortKey, id *sortValue, NSString **rowId) {
+    NSData *data = [token dataUsingEncoding:NSUTF8StringEncoding];
+    id parts = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+    if (![parts isKindOfClass:[NSArray class]] || [parts count] != 3) return NO;
+    if (![[parts objectAtIndex:0] isEqual:sortKey]) return NO;
+    id value = [parts objectAtIndex:1];
+    id rid = [parts objectAtIndex:2];
+    if (![rid isKindOfClass:[NSString class]]) return NO;
+    if ([value isKindOfClass:[NSArray class]]) {
+        NSString *hex = [value count] == 1 ? [value objectAtIndex:0] : nil;
+        if (![hex isKindOfClass:[NSString class]] || [hex length] != 16) return NO;
+        char *end = NULL;
+        uint64_t bits = strtoull([hex UTF8String], &end, 16);
+        if (!end || *end != '\0') return NO;
+        double real;
+        memcpy(&real, &bits, sizeof(real));
+        value = [NSNumber numberWithDouble:real];
+    } else if (![value isKindOfClass:[NSString class]] && ![value isKindOfClass:[NSNumber class]]) {
+        return NO;
+    }
+    *sortValue = value;
+    *rowId = rid;
+    return YES;
+}
 
 @interface XLStorageService ()
 
@@ -24,6 +124,27 @@
 - (XLTextAlign)textAlignForString:(NSString *)s;
 - (NSString *)stringForTextAlign:(XLTextAlign)align;
 - (XLReadingSession *)readingSessionFromResultSet:(FMResultSet *)rs;
+- (NSMutableArray *)vocabularyConditionsForQuery:(NSString *)query status:(NSString *)status arguments:(NSMutableArray *)args;
+- (void)migrateVocabularySearchKeys;
+- (NSError *)databaseErrorWithDescription:(NSString *)fallback;
+- (BOOL)commitTransactionWithError:(NSError **)error description:(NSString *)description;
+- (void)rebuildStatsRollupIfNeeded;
+- (void)recomputeStreakState;
+- (NSString *)localDayForMs:(long long)ms;
+- (NSString *)rollUpSessionForBookId:(NSString *)bookId endedAtMs:(long long)endedMs seconds:(long long)seconds wordsRevealed:(NSInteger)wordsRevealed wordsSaved:(NSInteger)wordsSaved sign:(NSInteger)sign;
+- (NSString *)rollUpReviewAtMs:(long long)nowMs;
+- (BOOL)rowExistsWithId:(NSString *)rowId inTable:(NSString *)table;
+- (NSArray *)rowsWithIds:(NSArray *)rowIds table:(NSString *)table columns:(NSString *)columns isBook:(BOOL)isBook;
+- (void)noteChange:(XLStorageChange)kind ofId:(NSString *)rowId inTable:(NSString *)table;
+- (void)postPendingChanges;
+- (NSArray *)learnedWordOfVocabularyItemId:(NSString *)itemId;
+- (void)bumpKnownWordVersionForSource:(NSString *)source target:(NSString *)target;
+- (int64_t)knownWordVersionForSource:(NSString *)source target:(NSString *)target;
+- (NSString *)knownWordSnapshotPathForSource:(NSString *)source target:(NSString *)target;
+- (XLKnownWordSet *)loadKnownWordSetForSource:(NSString *)source target:(NSString *)target;
+- (void)writeKnownWordSet:(XLKnownWordSet *)set toPath:(NSString *)path stamp:(int64_t)stamp;
+- (void)addKnownWord:(NSString *)word source:(NSString *)source target:(NSString *)target;
+- (void)discardKnownWordSetForSource:(NSString *)source target:(NSString *)target;
 
 @end
 
@@ -31,24 +152,32 @@
 
 + (instancetype)sharedService {
     static XLStorageService *sharedService = nil;
-    if (sharedService == nil) {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
         sharedService = [[self alloc] init];
-    }
+    });
     return sharedService;
 }
 
 - (instancetype)init {
+    // Use SmallStep for cross-platform file system access
+    NSString *documentsDirectory = [[SSFileSystem sharedFileSystem] documentsDirectory];
+    return [self initWithDatabasePath:[documentsDirectory stringByAppendingPathComponent:@"xenolexia.db"]];
+}
+
+- (instancetype)initWithDatabasePath:(NSString *)path {
     self = [super init];
     if (self) {
-        // Use SmallStep for cross-platform file system access
         _fileSystem = [SSFileSystem sharedFileSystem];
-        NSString *documentsDirectory = [_fileSystem documentsDirectory];
-        _databasePath = [[documentsDirectory stringByAppendingPathComponent:@"xenolexia.db"] retain];
+        _databasePath = [path copy];
+        _databaseLock = [[NSRecursiveLock alloc] init];
     }
     return self;
 }
 
 - (void)initializeDatabaseWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.initialize");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     
     if (_database) {
@@ -70,6 +199,10 @@
         _database = nil;
         return;
     }
+    // WAL lets background readers (XLVocabularyCursor) run while this connection writes
+    FMResultSet *walRs = [_database executeQuery:@"PRAGMA journal_mode=WAL"];
+    [walRs next];
+    [walRs close];
     
     // Create tables (Xenolexia Core Spec 02-sql-schema: snake_case, TEXT for lang/status, INTEGER ms timestamps)
     NSString *createBooksTable = @"CREATE TABLE IF NOT EXISTS books ("
@@ -111,6 +244,7 @@
                                        "ease_factor REAL DEFAULT 2.5, "
                                        "interval INTEGER DEFAULT 0, "
                                        "status TEXT DEFAULT 'new', "
+                                       "search_key TEXT, "
                                        "FOREIGN KEY (book_id) REFERENCES books(id) ON DELETE SET NULL)";
     
     if (![_database executeUpdate:createBooksTable]) {
@@ -156,6 +290,62 @@
     [_database executeUpdate:createSessionsTable];
     [_database executeUpdate:createPreferencesTable];
     [_database executeUpdate:createWordListTable];
+    [self migrateVocabularySearchKeys];
+    // Keyset pagination indexes: (sort key, id) so each page is an index range scan
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_books_last_read ON books(COALESCE(last_read_at, 0), id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_books_added ON books(added_at, id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_books_title ON books(title, id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_books_author ON books(COALESCE(author, ''), id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_books_progress ON books(COALESCE(progress, 0), id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_vocabulary_added ON vocabulary(added_at, id)"];
+    [_database executeUpdate:@"CREATE INDEX IF NOT EXISTS idx_vocabulary_status_added ON vocabulary(status, added_at, id)"];
+    // Statistics rollups: one row per local day plus a single running-totals/streak row,
+    // maintained by endReadingSessionWithId: and recordReviewForItemId: so stats never scan sessions
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS daily_stats ("
+        "day TEXT PRIMARY KEY, "
+        "sessions INTEGER NOT NULL DEFAULT 0, "
+        "reading_seconds INTEGER NOT NULL DEFAULT 0, "
+        "words_revealed INTEGER NOT NULL DEFAULT 0, "
+        "words_saved INTEGER NOT NULL DEFAULT 0, "
+        "reviews INTEGER NOT NULL DEFAULT 0)"];
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS stats_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1), "
+        "total_sessions INTEGER NOT NULL DEFAULT 0, "
+        "total_seconds INTEGER NOT NULL DEFAULT 0, "
+        "books_read INTEGER NOT NULL DEFAULT 0, "
+        "last_day INTEGER NOT NULL DEFAULT 0, "
+        "current_streak INTEGER NOT NULL DEFAULT 0, "
+        "longest_streak INTEGER NOT NULL DEFAULT 0)"];
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS stats_books (book_id TEXT PRIMARY KEY)"];
+    // Processed chapters: density is stored in thousandths so the key compares exactly
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS processed_chapters ("
+        "book_id TEXT NOT NULL, "
+        "chapter_index INTEGER NOT NULL, "
+        "source_lang TEXT NOT NULL, "
+        "target_lang TEXT NOT NULL, "
+        "proficiency TEXT NOT NULL, "
+        "density_milli INTEGER NOT NULL, "
+        "chapter_id TEXT, "
+        "title TEXT, "
+        "word_count INTEGER, "
+        "processed_content TEXT NOT NULL, "
+        "foreign_words TEXT NOT NULL, "
+        "processed_at INTEGER NOT NULL, "
+        "PRIMARY KEY (book_id, chapter_index, source_lang, target_lang, proficiency, density_milli))"];
+    // Known words: "I knew this" exclusions, and a version per language pair that is bumped before every
+    // change to the pair's known-word set, so an older on-disk snapshot of the set is recognized as stale
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS known_words ("
+        "source_lang TEXT NOT NULL, "
+        "target_lang TEXT NOT NULL, "
+        "word TEXT NOT NULL, "
+        "added_at INTEGER NOT NULL, "
+        "PRIMARY KEY (source_lang, target_lang, word))"];
+    [_database executeUpdate:@"CREATE TABLE IF NOT EXISTS known_word_state ("
+        "source_lang TEXT NOT NULL, "
+        "target_lang TEXT NOT NULL, "
+        "version INTEGER NOT NULL, "
+        "PRIMARY KEY (source_lang, target_lang))"];
+    [self rebuildStatsRollupIfNeeded];
     // Non-fatal: continue so books/vocabulary still work
     
     if ([delegate respondsToSelector:@selector(storageService:didInitializeDatabaseWithSuccess:error:)]) {
@@ -163,7 +353,35 @@
     }
 }
 
+/// Databases created before search_key get the column added and backfilled once, in one transaction
+- (void)migrateVocabularySearchKeys {
+    BOOL hasColumn = NO;
+    FMResultSet *info = [_database executeQuery:@"PRAGMA table_info(vocabulary)"];
+    while (info && [info next]) {
+        if ([[info stringForColumn:@"name"] isEqualToString:@"search_key"]) hasColumn = YES;
+    }
+    [info close];
+    if (!hasColumn && ![_database executeUpdate:@"ALTER TABLE vocabulary ADD COLUMN search_key TEXT"]) return;
+
+    NSMutableArray *rows = [NSMutableArray array];
+    FMResultSet *rs = [_database executeQuery:@"SELECT id, source_word, target_word FROM vocabulary WHERE search_key IS NULL"];
+    while (rs && [rs next]) {
+        NSString *rowId = [rs stringForColumnIndex:0];
+        if (!rowId) continue;
+        [rows addObject:@[ rowId, XLFoldedSearchKeyForFields([rs stringForColumnIndex:1], [rs stringForColumnIndex:2]) ]];
+    }
+    [rs close];
+    if ([rows count] == 0) return;
+    [_database beginTransaction];
+    for (NSArray *row in rows) {
+        [_database executeUpdate:@"UPDATE vocabulary SET search_key = ? WHERE id = ?", [row objectAtIndex:1], [row objectAtIndex:0]];
+    }
+    [self commitTransactionWithError:NULL description:nil];
+}
+
 - (void)saveBook:(XLBook *)book delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.saveBook");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     
     if (!_database) {
@@ -177,6 +395,7 @@
     
     long long addedMs = (long long)([book.addedAt timeIntervalSince1970] * 1000);
     long long lastReadMs = book.lastReadAt ? (long long)([book.lastReadAt timeIntervalSince1970] * 1000) : 0;
+    BOOL existed = [self rowExistsWithId:book.bookId inTable:XLStorageTableBooks];
     BOOL ok = [_database executeUpdate:@"INSERT OR REPLACE INTO books (id, title, author, cover_path, file_path, format, file_size, added_at, last_read_at, source_lang, target_lang, proficiency, density, progress, current_location, current_chapter, total_chapters, current_page, total_pages, reading_time_minutes, source_url, is_downloaded) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
         book.bookId,
         book.title,
@@ -207,12 +426,21 @@
         [delegate storageService:self didSaveBook:book withSuccess:NO error:error];
         return;
     }
+    if (ok) {
+        if (existed) {
+            [self noteChange:XLStorageChangeUpdated ofId:book.bookId inTable:XLStorageTableBooks];
+        } else {
+            [self noteChange:XLStorageChangeInserted ofId:book.bookId inTable:XLStorageTableBooks];
+        }
+    }
     if ([delegate respondsToSelector:@selector(storageService:didSaveBook:withSuccess:error:)]) {
         [delegate storageService:self didSaveBook:book withSuccess:YES error:nil];
     }
 }
 
 - (void)getBookWithId:(NSString *)bookId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getBook");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     
     if (!_database) {
@@ -240,6 +468,8 @@
 }
 
 - (void)getAllBooksWithSortBy:(NSString *)sortBy order:(NSString *)order delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getAllBooks");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     
     if (!_database) {
@@ -282,6 +512,8 @@
 }
 
 - (void)deleteBookWithId:(NSString *)bookId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.deleteBook");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     
     if (!_database) {
@@ -292,19 +524,150 @@
         return;
     }
     
+    [_database beginTransaction];
     BOOL ok = [_database executeUpdate:@"DELETE FROM books WHERE id = ?", bookId];
+    BOOL deleted = ok && [_database changes] > 0;
+    NSMutableArray *sessionIds = [NSMutableArray array];
+    NSMutableSet *days = [NSMutableSet set];
+    if (deleted) {
+        [_database executeUpdate:@"DELETE FROM processed_chapters WHERE book_id = ?", bookId];
+        /* The book's sessions go with it (the schema's ON DELETE CASCADE; foreign keys are not enforced),
+           and so does their share of the rollups */
+        NSMutableArray *ended = [NSMutableArray array];
+        FMResultSet *rs = [_database executeQuery:@"SELECT id, started_at, ended_at, words_revealed, words_saved FROM reading_sessions WHERE book_id = ?", bookId];
+        while (rs && [rs next]) {
+            NSString *sessionId = [rs stringForColumnIndex:0];
+            if (sessionId) [sessionIds addObject:sessionId];
+            if ([rs longLongIntForColumnIndex:2] > 0) {
+                [ended addObject:@[ [NSNumber numberWithLongLong:[rs longLongIntForColumnIndex:1]], [NSNumber numberWithLongLong:[rs longLongIntForColumnIndex:2]],
+                                    [NSNumber numberWithInt:[rs intForColumnIndex:3]], [NSNumber numberWithInt:[rs intForColumnIndex:4]] ]];
+            }
+        }
+        [rs close];
+        ok = [_database executeUpdate:@"DELETE FROM reading_sessions WHERE book_id = ?", bookId];
+        for (NSArray *session in ended) {
+            long long startedMs = [[session objectAtIndex:0] longLongValue];
+            long long endedMs = [[session objectAtIndex:1] longLongValue];
+            NSString *day = [self rollUpSessionForBookId:bookId endedAtMs:endedMs seconds:(endedMs - startedMs) / 1000
+                                           wordsRevealed:[[session objectAtIndex:2] integerValue] wordsSaved:[[session objectAtIndex:3] integerValue] sign:-1];
+            if (day) [days addObject:day];
+        }
+    }
+    NSError *error = nil;
+    if (ok) {
+        ok = [self commitTransactionWithError:&error description:@"Failed to delete book"];
+    } else {
+        error = [self databaseErrorWithDescription:@"Failed to delete book"];
+        [_database rollback];
+    }
     if (!ok && [delegate respondsToSelector:@selector(storageService:didDeleteBookWithId:withSuccess:error:)]) {
-        NSError *error = [NSError errorWithDomain:@"XLStorageService" code:[_database lastErrorCode]
-            userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: @"Failed to delete book" }];
         [delegate storageService:self didDeleteBookWithId:bookId withSuccess:NO error:error];
         return;
     }
+    if (ok && deleted) {
+        [self noteChange:XLStorageChangeDeleted ofId:bookId inTable:XLStorageTableBooks];
+        for (NSString *sessionId in sessionIds) {
+            [self noteChange:XLStorageChangeDeleted ofId:sessionId inTable:XLStorageTableReadingSessions];
+        }
+        for (NSString *day in days) {
+            [self noteChange:XLStorageChangeUpdated ofId:day inTable:XLStorageTableDailyStats];
+        }
+    }
     if ([delegate respondsToSelector:@selector(storageService:didDeleteBookWithId:withSuccess:error:)]) {
         [delegate storageService:self didDeleteBookWithId:bookId withSuccess:YES error:nil];
     }
 }
 
+- (void)getBooksPageWithSortBy:(NSString *)sortBy order:(NSString *)order afterToken:(NSString *)token limit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getBooksPage");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getBooksPageWithSortBy:sortBy order:order afterToken:token limit:limit delegate:delegate]; }
+        return;
+    }
+    NSString *sortKey = XLBookSortKeyExpression(sortBy);
+    BOOL ascending = [[order uppercaseString] isEqualToString:@"ASC"];
+    NSString *dir = ascending ? @"ASC" : @"DESC";
+    NSString *cmp = ascending ? @">" : @"<";
+    if (limit <= 0) limit = kDefaultPageSize;
+
+    NSMutableArray *args = [NSMutableArray array];
+    NSMutableString *sql = [NSMutableString stringWithFormat:@"SELECT %@, %@ FROM books", kBookColumns, sortKey];
+    if (token) {
+        id lastValue = nil;
+        NSString *lastId = nil;
+        if (!XLDecodePageToken(token, sortKey, &lastValue, &lastId)) {
+            if ([delegate respondsToSelector:@selector(storageService:didGetBooksPage:withError:)]) {
+                NSError *err = [NSError errorWithDomain:@"XLStorageService" code:3 userInfo:@{ NSLocalizedDescriptionKey: @"Invalid continuation token" }];
+                [delegate storageService:self didGetBooksPage:nil withError:err];
+            }
+            return;
+        }
+        [sql appendFormat:@" WHERE (%@ %@ ? OR (%@ = ? AND id %@ ?))", sortKey, cmp, sortKey, cmp];
+        [args addObject:lastValue];
+        [args addObject:lastValue];
+        [args addObject:lastId];
+    }
+    /* Fetch one extra row to learn whether another page follows */
+    [sql appendFormat:@" ORDER BY %@ %@, id %@ LIMIT ?", sortKey, dir, dir];
+    [args addObject:[NSNumber numberWithInteger:limit + 1]];
+
+    FMResultSet *rs = [_database executeQuery:sql withArgumentsInArray:args];
+    if (!rs) {
+        if ([delegate respondsToSelector:@selector(storageService:didGetBooksPage:withError:)]) {
+            [delegate storageService:self didGetBooksPage:nil withError:[self databaseErrorWithDescription:@"Failed to load books"]];
+        }
+        return;
+    }
+    NSMutableArray *books = [NSMutableArray arrayWithCapacity:(NSUInteger)limit];
+    id lastValue = nil;
+    NSString *lastId = nil;
+    BOOL more = NO;
+    while ([rs next]) {
+        if ((NSInteger)[books count] == limit) {
+            more = YES;
+            break;
+        }
+        XLBook *book = [self bookFromResultSet:rs];
+        if (book) {
+            [books addObject:book];
+            lastValue = [rs objectForColumnIndex:(int)kBookColumnCount];
+            lastId = book.bookId;
+        }
+    }
+    [rs close];
+
+    XLStoragePage *page = [XLStoragePage pageWithItems:books continuationToken:more ? XLEncodePageToken(sortKey, lastValue, lastId) : nil];
+    if ([delegate respondsToSelector:@selector(storageService:didGetBooksPage:withError:)]) {
+        [delegate storageService:self didGetBooksPage:page withError:nil];
+    }
+}
+
+- (void)getBookCountWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getBookCount");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getBookCountWithDelegate:delegate]; }
+        return;
+    }
+    NSInteger count = 0;
+    FMResultSet *rs = [_database executeQuery:@"SELECT COUNT(*) FROM books"];
+    if ([rs next]) {
+        count = [rs intForColumnIndex:0];
+    }
+    [rs close];
+    if ([delegate respondsToSelector:@selector(storageService:didGetBookCount:withError:)]) {
+        [delegate storageService:self didGetBookCount:count withError:rs ? nil : [self databaseErrorWithDescription:@"Failed to count books"]];
+    }
+}
+
 - (void)saveVocabularyItem:(XLVocabularyItem *)item delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.saveVocabularyItem");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -313,12 +676,23 @@
     }
     long long addedMs = (long long)([item.addedAt timeIntervalSince1970] * 1000);
     long long lastRevMs = item.lastReviewedAt ? (long long)([item.lastReviewedAt timeIntervalSince1970] * 1000) : 0;
-    BOOL ok = [_database executeUpdate:@"INSERT OR REPLACE INTO vocabulary (id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+    BOOL existed = [self rowExistsWithId:item.vocabularyId inTable:XLStorageTableVocabulary];
+    NSString *sourceCode = [XLLanguageInfo codeStringForLanguage:item.sourceLanguage];
+    NSString *targetCode = [XLLanguageInfo codeStringForLanguage:item.targetLanguage];
+    NSArray *learnedBefore = existed ? [self learnedWordOfVocabularyItemId:item.vocabularyId] : nil;
+    NSArray *learnedAfter = (item.status == XLVocabularyStatusLearned && item.sourceWord)
+        ? [NSArray arrayWithObjects:item.sourceWord, sourceCode, targetCode, nil] : nil;
+    BOOL knownChanged = (learnedBefore || learnedAfter) && ![learnedBefore isEqual:learnedAfter];
+    if (knownChanged) {
+        if (learnedBefore) [self bumpKnownWordVersionForSource:[learnedBefore objectAtIndex:1] target:[learnedBefore objectAtIndex:2]];
+        if (learnedAfter) [self bumpKnownWordVersionForSource:sourceCode target:targetCode];
+    }
+    BOOL ok = [_database executeUpdate:@"INSERT OR REPLACE INTO vocabulary (id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status, search_key) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
         item.vocabularyId,
         item.sourceWord,
         item.targetWord,
-        [XLLanguageInfo codeStringForLanguage:item.sourceLanguage],
-        [XLLanguageInfo codeStringForLanguage:item.targetLanguage],
+        sourceCode,
+        targetCode,
         item.contextSentence ?: [NSNull null],
         item.bookId ?: [NSNull null],
         item.bookTitle ?: [NSNull null],
@@ -327,7 +701,20 @@
         [NSNumber numberWithInt:(int)item.reviewCount],
         [NSNumber numberWithDouble:item.easeFactor],
         [NSNumber numberWithInt:(int)item.interval],
-        [XLVocabularyItem codeStringForStatus:item.status]];
+        [XLVocabularyItem codeStringForStatus:item.status],
+        item.searchKey];
+    if (ok) {
+        if (existed) {
+            [self noteChange:XLStorageChangeUpdated ofId:item.vocabularyId inTable:XLStorageTableVocabulary];
+        } else {
+            [self noteChange:XLStorageChangeInserted ofId:item.vocabularyId inTable:XLStorageTableVocabulary];
+        }
+        if (knownChanged) {
+            /* A word that stops being known cannot be taken out of a set: rebuild that pair's on next use */
+            if (learnedBefore) [self discardKnownWordSetForSource:[learnedBefore objectAtIndex:1] target:[learnedBefore objectAtIndex:2]];
+            if (learnedAfter) [self addKnownWord:item.sourceWord source:sourceCode target:targetCode];
+        }
+    }
     if ([delegate respondsToSelector:@selector(storageService:didSaveVocabularyItem:withSuccess:error:)]) {
         NSError *err = ok ? nil : [NSError errorWithDomain:@"XLStorageService" code:[_database lastErrorCode] userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: @"Save failed" }];
         [delegate storageService:self didSaveVocabularyItem:item withSuccess:ok error:err];
@@ -335,6 +722,7 @@
 }
 
 - (void)getVocabularyItemWithId:(NSString *)itemId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -353,6 +741,8 @@
 }
 
 - (void)getAllVocabularyItemsWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getAllVocabulary");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -372,27 +762,35 @@
 }
 
 - (void)deleteVocabularyItemWithId:(NSString *)itemId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
         if (_database) { [self deleteVocabularyItemWithId:itemId delegate:delegate]; }
         return;
     }
+    NSArray *learnedBefore = [self learnedWordOfVocabularyItemId:itemId];
+    if (learnedBefore) [self bumpKnownWordVersionForSource:[learnedBefore objectAtIndex:1] target:[learnedBefore objectAtIndex:2]];
     BOOL ok = [_database executeUpdate:@"DELETE FROM vocabulary WHERE id = ?", itemId];
+    if (ok && [_database changes] > 0) {
+        [self noteChange:XLStorageChangeDeleted ofId:itemId inTable:XLStorageTableVocabulary];
+        if (learnedBefore) [self discardKnownWordSetForSource:[learnedBefore objectAtIndex:1] target:[learnedBefore objectAtIndex:2]];
+    }
     if ([delegate respondsToSelector:@selector(storageService:didDeleteVocabularyItemWithId:withSuccess:error:)]) {
         [delegate storageService:self didDeleteVocabularyItemWithId:itemId withSuccess:ok error:nil];
     }
 }
 
 - (void)searchVocabularyWithQuery:(NSString *)query delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.searchVocabulary");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
         if (_database) { [self searchVocabularyWithQuery:query delegate:delegate]; }
         return;
     }
-    NSString *pattern = [NSString stringWithFormat:@"%%%@%%", query];
-    FMResultSet *rs = [_database executeQuery:@"SELECT id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status FROM vocabulary WHERE source_word LIKE ? OR target_word LIKE ? ORDER BY added_at DESC", pattern, pattern];
+    FMResultSet *rs = [_database executeQuery:@"SELECT id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status FROM vocabulary WHERE instr(search_key, ?) > 0 ORDER BY added_at DESC", XLFoldedSearchKey(query)];
     NSMutableArray *items = [NSMutableArray array];
     while (rs && [rs next]) {
         XLVocabularyItem *item = [self vocabularyItemFromResultSet:rs];
@@ -404,6 +802,121 @@
     }
 }
 
+- (NSMutableArray *)vocabularyConditionsForQuery:(NSString *)query status:(NSString *)status arguments:(NSMutableArray *)args {
+    NSMutableArray *conditions = [NSMutableArray array];
+    /* search_key holds the folded words, so matching is case- and accent-blind and needs no LIKE escaping */
+    if ([query length] > 0) {
+        [conditions addObject:@"instr(search_key, ?) > 0"];
+        [args addObject:XLFoldedSearchKey(query)];
+    }
+    if ([status length] > 0) {
+        [conditions addObject:@"status = ?"];
+        [args addObject:status];
+    }
+    return conditions;
+}
+
+- (void)getVocabularyPageWithQuery:(NSString *)query status:(NSString *)status afterToken:(NSString *)token limit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getVocabularyPage");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getVocabularyPageWithQuery:query status:status afterToken:token limit:limit delegate:delegate]; }
+        return;
+    }
+    if (limit <= 0) limit = kDefaultPageSize;
+    NSMutableArray *args = [NSMutableArray array];
+    NSMutableArray *conditions = [self vocabularyConditionsForQuery:query status:status arguments:args];
+    if (token) {
+        id lastValue = nil;
+        NSString *lastId = nil;
+        if (!XLDecodePageToken(token, @"added_at", &lastValue, &lastId)) {
+            if ([delegate respondsToSelector:@selector(storageService:didGetVocabularyPage:withError:)]) {
+                NSError *err = [NSError errorWithDomain:@"XLStorageService" code:3 userInfo:@{ NSLocalizedDescriptionKey: @"Invalid continuation token" }];
+                [delegate storageService:self didGetVocabularyPage:nil withError:err];
+            }
+            return;
+        }
+        [conditions addObject:@"(added_at < ? OR (added_at = ? AND id < ?))"];
+        [args addObject:lastValue];
+        [args addObject:lastValue];
+        [args addObject:lastId];
+    }
+    NSMutableString *sql = [NSMutableString stringWithFormat:@"SELECT %@ FROM vocabulary", kVocabularyColumns];
+    if ([conditions count] > 0) {
+        [sql appendFormat:@" WHERE %@", [conditions componentsJoinedByString:@" AND "]];
+    }
+    [sql appendString:@" ORDER BY added_at DESC, id DESC LIMIT ?"];
+    [args addObject:[NSNumber numberWithInteger:limit + 1]];
+
+    FMResultSet *rs = [_database executeQuery:sql withArgumentsInArray:args];
+    if (!rs) {
+        if ([delegate respondsToSelector:@selector(storageService:didGetVocabularyPage:withError:)]) {
+            [delegate storageService:self didGetVocabularyPage:nil withError:[self databaseErrorWithDescription:@"Failed to load vocabulary"]];
+        }
+        return;
+    }
+    NSMutableArray *items = [NSMutableArray arrayWithCapacity:(NSUInteger)limit];
+    id lastValue = nil;
+    NSString *lastId = nil;
+    BOOL more = NO;
+    while ([rs next]) {
+        if ((NSInteger)[items count] == limit) {
+            more = YES;
+            break;
+        }
+        XLVocabularyItem *item = [self vocabularyItemFromResultSet:rs];
+        if (item) {
+            [items addObject:item];
+            lastValue = [NSNumber numberWithLongLong:[rs longLongIntForColumnIndex:8]];
+            lastId = item.vocabularyId;
+        }
+    }
+    [rs close];
+
+    XLStoragePage *page = [XLStoragePage pageWithItems:items continuationToken:more ? XLEncodePageToken(@"added_at", lastValue, lastId) : nil];
+    if ([delegate respondsToSelector:@selector(storageService:didGetVocabularyPage:withError:)]) {
+        [delegate storageService:self didGetVocabularyPage:page withError:nil];
+    }
+}
+
+- (void)getVocabularyCountWithQuery:(NSString *)query status:(NSString *)status delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getVocabularyCount");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getVocabularyCountWithQuery:query status:status delegate:delegate]; }
+        return;
+    }
+    NSMutableArray *args = [NSMutableArray array];
+    NSMutableArray *conditions = [self vocabularyConditionsForQuery:query status:status arguments:args];
+    NSMutableString *sql = [NSMutableString stringWithString:@"SELECT COUNT(*) FROM vocabulary"];
+    if ([conditions count] > 0) {
+        [sql appendFormat:@" WHERE %@", [conditions componentsJoinedByString:@" AND "]];
+    }
+    NSInteger count = 0;
+    FMResultSet *rs = [_database executeQuery:sql withArgumentsInArray:args];
+    if ([rs next]) {
+        count = [rs intForColumnIndex:0];
+    }
+    [rs close];
+    if ([delegate respondsToSelector:@selector(storageService:didGetVocabularyCount:withError:)]) {
+        [delegate storageService:self didGetVocabularyCount:count withError:rs ? nil : [self databaseErrorWithDescription:@"Failed to count vocabulary"]];
+    }
+}
+
+- (XLVocabularyCursor *)vocabularyCursorWithQuery:(NSString *)query status:(NSString *)status {
+    NSMutableArray *args = [NSMutableArray array];
+    NSMutableArray *conditions = [self vocabularyConditionsForQuery:query status:status arguments:args];
+    XLVocabularyCursor *cursor = [[XLVocabularyCursor alloc] initWithStorage:self
+                                                                databasePath:_databasePath
+                                                                 whereClause:[conditions componentsJoinedByString:@" AND "]
+                                                                   arguments:args];
+    return [cursor autorelease];
+}
+
 - (NSString *)formatStringForBookFormat:(XLBookFormat)format {
     switch (format) {
         case XLBookFormatEpub: return @"epub";
@@ -485,6 +998,8 @@
 }
 
 - (void)getVocabularyDueForReviewWithLimit:(NSInteger)limit delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getDueForReview");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -505,59 +1020,317 @@
 }
 
 - (void)recordReviewForItemId:(NSString *)itemId quality:(NSInteger)quality delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.recordReview");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
         if (_database) { [self recordReviewForItemId:itemId quality:quality delegate:delegate]; }
         return;
     }
-    FMResultSet *selRs = [_database executeQuery:@"SELECT id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status FROM vocabulary WHERE id = ?", itemId];
-    if (![selRs next]) {
-        [selRs close];
-        if ([delegate respondsToSelector:@selector(storageService:didRecordReviewForItemId:withSuccess:error:)]) {
-            [delegate storageService:self didRecordReviewForItemId:itemId withSuccess:NO error:[NSError errorWithDomain:@"XLStorageService" code:2 userInfo:@{ NSLocalizedDescriptionKey: @"Item not found" }]];
+    /* One UPDATE per grade: the SM-2 step (same arithmetic as XLSm2Step) runs inside SQLite, so there is
+       no read-modify-write round trip. SET expressions all see the pre-update row. */
+    NSNumber *q = [NSNumber numberWithInteger:quality];
+    long long nowMs = (long long)([[NSDate date] timeIntervalSince1970] * 1000);
+    [_database beginTransaction];
+    NSArray *learnedBefore = [self learnedWordOfVocabularyItemId:itemId];
+    BOOL ok = [_database executeUpdate:@"UPDATE vocabulary SET "
+        "last_reviewed_at = ?, "
+        "review_count = COALESCE(review_count, 0) + 1, "
+        "interval = CASE WHEN ? >= 3 THEN (CASE COALESCE(interval, 0) WHEN 0 THEN 1 WHEN 1 THEN 6 "
+            "ELSE CAST(interval * COALESCE(ease_factor, 2.5) + 0.5 AS INTEGER) END) ELSE 0 END, "
+        "ease_factor = CASE WHEN ? >= 3 THEN MAX(1.3, COALESCE(ease_factor, 2.5) + (0.1 - (5 - ?) * (0.08 + (5 - ?) * 0.02))) "
+            "ELSE COALESCE(ease_factor, 2.5) END, "
+        "status = CASE WHEN ? < 3 THEN 'learning' "
+            "WHEN COALESCE(review_count, 0) + 1 >= 5 AND ? >= 4 THEN 'learned' "
+            "WHEN COALESCE(review_count, 0) + 1 >= 2 THEN 'review' ELSE 'learning' END "
+        "WHERE id = ?",
+        [NSNumber numberWithLongLong:nowMs], q, q, q, q, q, q, itemId];
+    NSError *error = nil;
+    if (ok && [_database changes] == 0) {
+        ok = NO;
+        error = [NSError errorWithDomain:@"XLStorageService" code:2 userInfo:@{ NSLocalizedDescriptionKey: @"Item not found" }];
+    }
+    if (ok) {
+        /* The grade may have moved the word into or out of the known set (same transaction as the version bump) */
+        NSArray *learnedAfter = [self learnedWordOfVocabularyItemId:itemId];
+        NSArray *learned = learnedAfter ?: learnedBefore;
+        BOOL knownChanged = (learnedBefore != nil) != (learnedAfter != nil);
+        if (knownChanged) [self bumpKnownWordVersionForSource:[learned objectAtIndex:1] target:[learned objectAtIndex:2]];
+        NSString *day = [self rollUpReviewAtMs:nowMs];
+        ok = [self commitTransactionWithError:&error description:@"Failed to record review"];
+        if (ok) {
+            [self noteChange:XLStorageChangeUpdated ofId:itemId inTable:XLStorageTableVocabulary];
+            [self noteChange:XLStorageChangeUpdated ofId:day inTable:XLStorageTableDailyStats];
+            if (knownChanged && learnedAfter) {
+                [self addKnownWord:[learned objectAtIndex:0] source:[learned objectAtIndex:1] target:[learned objectAtIndex:2]];
+            } else if (knownChanged) {
+                [self discardKnownWordSetForSource:[learned objectAtIndex:1] target:[learned objectAtIndex:2]];
+            }
         }
+    } else {
+        if (!error) error = [self databaseErrorWithDescription:@"Failed to record review"];
+        [_database rollback];
+    }
+    if ([delegate respondsToSelector:@selector(storageService:didRecordReviewForItemId:withSuccess:error:)]) {
+        [delegate storageService:self didRecordReviewForItemId:itemId withSuccess:ok error:error];
+    }
+}
+
+- (void)rescheduleVocabularyWithQualities:(NSInteger (^)(NSString *itemId))qualityForItem reviewedAt:(NSDate *)reviewedAt delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.rescheduleVocabulary");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self rescheduleVocabularyWithQualities:qualityForItem reviewedAt:reviewedAt delegate:delegate]; }
         return;
     }
-    XLVocabularyItem *item = [self vocabularyItemFromResultSet:selRs];
-    [selRs close];
-    if (!item) {
-        if ([delegate respondsToSelector:@selector(storageService:didRecordReviewForItemId:withSuccess:error:)]) {
-            [delegate storageService:self didRecordReviewForItemId:itemId withSuccess:NO error:[NSError errorWithDomain:@"XLStorageService" code:2 userInfo:nil]];
+    /* Rows stream through in rowid order, kRescheduleChunk at a time, into plain column arrays for the batch
+       SM-2 kernel; results go back through one prepared UPDATE, all inside a single transaction.
+       Reviews recorded this way are not counted in the daily review stats. */
+    sqlite3 *db = (sqlite3 *)[_database sqliteHandle];
+    sqlite3_stmt *select = NULL;
+    sqlite3_stmt *update = NULL;
+    int32_t *quality = malloc(kRescheduleChunk * sizeof(int32_t));
+    sqlite3_int64 *rowids = malloc(kRescheduleChunk * sizeof(sqlite3_int64));
+    double *easeFactor = malloc(kRescheduleChunk * sizeof(double));
+    double *interval = malloc(kRescheduleChunk * sizeof(double));
+    int64_t *reviewCount = malloc(kRescheduleChunk * sizeof(int64_t));
+    int64_t *status = malloc(kRescheduleChunk * sizeof(int64_t));
+    NSMutableArray *updatedIds = [NSMutableArray array];
+    NSMutableArray *chunkIds = [NSMutableArray arrayWithCapacity:kRescheduleChunk];
+    BOOL ok = quality && rowids && easeFactor && interval && reviewCount && status && [_database beginTransaction];
+    ok = ok && sqlite3_prepare_v2(db, "SELECT rowid, id, COALESCE(ease_factor, 2.5), COALESCE(interval, 0), COALESCE(review_count, 0), status "
+                                      "FROM vocabulary WHERE rowid > ? ORDER BY rowid LIMIT ?", -1, &select, NULL) == SQLITE_OK;
+    ok = ok && sqlite3_prepare_v2(db, "UPDATE vocabulary SET ease_factor = ?, interval = ?, review_count = ?, status = ?, "
+                                      "last_reviewed_at = COALESCE(?, last_reviewed_at) WHERE rowid = ?", -1, &update, NULL) == SQLITE_OK;
+    sqlite3_int64 lastRowid = 0;
+    while (ok) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        sqlite3_bind_int64(select, 1, lastRowid);
+        sqlite3_bind_int(select, 2, kRescheduleChunk);
+        size_t scanned = 0, graded = 0;
+        int rc;
+        [chunkIds removeAllObjects];
+        while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+            scanned++;
+            lastRowid = sqlite3_column_int64(select, 0);
+            const unsigned char *idText = sqlite3_column_text(select, 1);
+            NSString *itemId = idText ? [NSString stringWithUTF8String:(const char *)idText] : nil;
+            NSInteger q = itemId ? qualityForItem(itemId) : -1;
+            if (q < 0 || q > 5) continue;
+            quality[graded] = (int32_t)q;
+            rowids[graded] = lastRowid;
+            easeFactor[graded] = sqlite3_column_double(select, 2);
+            interval[graded] = (double)sqlite3_column_int64(select, 3);
+            reviewCount[graded] = sqlite3_column_int64(select, 4);
+            status[graded] = XLSm2StatusForName((const char *)sqlite3_column_text(select, 5));
+            [chunkIds addObject:itemId];
+            graded++;
         }
+        sqlite3_reset(select);
+        ok = (rc == SQLITE_DONE);
+        if (ok && graded > 0) {
+            XLSm2Columns columns = { easeFactor, interval, reviewCount, status };
+            XLSm2StepBatch(quality, columns, graded);
+            for (size_t i = 0; i < graded && ok; i++) {
+                sqlite3_bind_double(update, 1, easeFactor[i]);
+                sqlite3_bind_int64(update, 2, (sqlite3_int64)interval[i]);
+                sqlite3_bind_int64(update, 3, reviewCount[i]);
+                sqlite3_bind_text(update, 4, kSm2StatusNames[status[i]], -1, SQLITE_STATIC);
+                if (reviewedAt) {
+                    sqlite3_bind_int64(update, 5, (sqlite3_int64)([reviewedAt timeIntervalSince1970] * 1000));
+                } else {
+                    sqlite3_bind_null(update, 5);
+                }
+                sqlite3_bind_int64(update, 6, rowids[i]);
+                ok = (sqlite3_step(update) == SQLITE_DONE);
+                sqlite3_reset(update);
+            }
+            [updatedIds addObjectsFromArray:chunkIds];
+        }
+        [pool drain];
+        if (scanned < kRescheduleChunk) break;
+    }
+    sqlite3_finalize(select);
+    sqlite3_finalize(update);
+    free(quality);
+    free(rowids);
+    free(easeFactor);
+    free(interval);
+    free(reviewCount);
+    free(status);
+
+    NSError *error = ok ? nil : [self databaseErrorWithDescription:@"Failed to reschedule vocabulary"];
+    if (ok) {
+        /* Any row may have gained or lost learned status: every pair's known-word set is rebuilt on next use */
+        if ([updatedIds count] > 0) [_database executeUpdate:@"UPDATE known_word_state SET version = version + 1"];
+        ok = [self commitTransactionWithError:&error description:@"Failed to commit rescheduled vocabulary"];
+        if (ok) {
+            for (NSString *itemId in updatedIds) {
+                [self noteChange:XLStorageChangeUpdated ofId:itemId inTable:XLStorageTableVocabulary];
+            }
+            if ([updatedIds count] > 0) [_knownWordSets removeAllObjects];
+        }
+    } else if ([_database inTransaction]) {
+        [_database rollback];
+    }
+    if ([delegate respondsToSelector:@selector(storageService:didRescheduleVocabularyItems:withSuccess:error:)]) {
+        [delegate storageService:self didRescheduleVocabularyItems:(ok ? [updatedIds count] : 0) withSuccess:ok error:error];
+    }
+}
+
+#pragma mark - Known Words
+
+- (XLKnownWordSet *)knownWordSetForLanguagePair:(XLLanguagePair *)languagePair {
+    XL_STORAGE_SPAN("sqlite.knownWordSet");
+    XL_STORAGE_LOCKED();
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:nil];
+        if (!_database) return [[[XLKnownWordSet alloc] init] autorelease];
+    }
+    NSString *source = [XLLanguageInfo codeStringForLanguage:languagePair.sourceLanguage];
+    NSString *target = [XLLanguageInfo codeStringForLanguage:languagePair.targetLanguage];
+    NSString *key = [NSString stringWithFormat:@"%@-%@", source, target];
+    XLKnownWordSet *set = [_knownWordSets objectForKey:key];
+    if (!set) {
+        set = [self loadKnownWordSetForSource:source target:target];
+        if (!set) return nil;
+        if (!_knownWordSets) _knownWordSets = [[NSMutableDictionary alloc] init];
+        [_knownWordSets setObject:set forKey:key];
+    }
+    return [[set copy] autorelease];
+}
+
+- (void)markWordKnown:(NSString *)word languagePair:(XLLanguagePair *)languagePair delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.markWordKnown");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self markWordKnown:word languagePair:languagePair delegate:delegate]; }
         return;
     }
-    /* Use native ObjC SM-2 (XLSm2) for identical behaviour with C# / xenolexia-shared-c */
-    XLSm2State *state = [[[XLSm2State alloc] init] autorelease];
-    state.easeFactor = item.easeFactor;
-    state.interval = item.interval;
-    state.reviewCount = item.reviewCount;
-    state.status = (XLSm2Status)item.status;
-    XLSm2Step((NSInteger)quality, state);
-    NSInteger rc = state.reviewCount;
-    double ef = state.easeFactor;
-    NSInteger iv = state.interval;
-    XLVocabularyStatus newStatus = item.status;
-    switch (state.status) {
-        case XLSm2StatusLearning: newStatus = XLVocabularyStatusLearning; break;
-        case XLSm2StatusReview:   newStatus = XLVocabularyStatusReview; break;
-        case XLSm2StatusLearned:  newStatus = XLVocabularyStatusLearned; break;
-        default:                  newStatus = XLVocabularyStatusNew; break;
+    NSString *folded = [[word stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] lowercaseString];
+    NSString *source = [XLLanguageInfo codeStringForLanguage:languagePair.sourceLanguage];
+    NSString *target = [XLLanguageInfo codeStringForLanguage:languagePair.targetLanguage];
+    NSError *error = nil;
+    BOOL ok = [folded length] > 0;
+    if (!ok) {
+        error = [NSError errorWithDomain:@"XLStorageService" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"No word to mark known" }];
+    } else {
+        long long nowMs = (long long)([[NSDate date] timeIntervalSince1970] * 1000);
+        [_database beginTransaction];
+        [self bumpKnownWordVersionForSource:source target:target];
+        ok = [_database executeUpdate:@"INSERT OR IGNORE INTO known_words (source_lang, target_lang, word, added_at) VALUES (?, ?, ?, ?)",
+              source, target, folded, [NSNumber numberWithLongLong:nowMs]];
+        if (ok) {
+            ok = [self commitTransactionWithError:&error description:@"Failed to mark word known"];
+        } else {
+            error = [self databaseErrorWithDescription:@"Failed to mark word known"];
+            [_database rollback];
+        }
+        if (ok) {
+            [self addKnownWord:folded source:source target:target];
+            [self noteChange:XLStorageChangeUpdated ofId:[NSString stringWithFormat:@"%@-%@", source, target] inTable:XLStorageTableKnownWords];
+        }
+    }
+    if ([delegate respondsToSelector:@selector(storageService:didMarkWordKnown:withSuccess:error:)]) {
+        [delegate storageService:self didMarkWordKnown:word withSuccess:ok error:error];
+    }
+}
+
+/// [source_word, source_lang, target_lang] of a learned vocabulary row, or nil
+- (NSArray *)learnedWordOfVocabularyItemId:(NSString *)itemId {
+    if (!itemId) return nil;
+    FMResultSet *rs = [_database executeQuery:@"SELECT source_word, source_lang, target_lang FROM vocabulary WHERE id = ? AND status = 'learned'", itemId];
+    NSArray *learned = nil;
+    if ([rs next]) {
+        NSString *word = [rs stringForColumnIndex:0];
+        NSString *source = [rs stringForColumnIndex:1];
+        NSString *target = [rs stringForColumnIndex:2];
+        if (word && source && target) learned = [NSArray arrayWithObjects:word, source, target, nil];
     }
+    [rs close];
+    return learned;
+}
+
+/// Called before the change it announces, so no snapshot written earlier can pass for current.
+/// A pair's first version is the current time, so a snapshot left over from a deleted database is stale too.
+- (void)bumpKnownWordVersionForSource:(NSString *)source target:(NSString *)target {
     long long nowMs = (long long)([[NSDate date] timeIntervalSince1970] * 1000);
-    BOOL ok = [_database executeUpdate:@"UPDATE vocabulary SET last_reviewed_at = ?, review_count = ?, ease_factor = ?, interval = ?, status = ? WHERE id = ?",
-        [NSNumber numberWithLongLong:nowMs],
-        [NSNumber numberWithInt:(int)rc],
-        [NSNumber numberWithDouble:ef],
-        [NSNumber numberWithInt:(int)iv],
-        [XLVocabularyItem codeStringForStatus:newStatus],
-        itemId];
-    if ([delegate respondsToSelector:@selector(storageService:didRecordReviewForItemId:withSuccess:error:)]) {
-        [delegate storageService:self didRecordReviewForItemId:itemId withSuccess:ok error:nil];
+    [_database executeUpdate:@"INSERT OR IGNORE INTO known_word_state (source_lang, target_lang, version) VALUES (?, ?, ?)",
+        source, target, [NSNumber numberWithLongLong:nowMs]];
+    [_database executeUpdate:@"UPDATE known_word_state SET version = version + 1 WHERE source_lang = ? AND target_lang = ?", source, target];
+}
+
+- (int64_t)knownWordVersionForSource:(NSString *)source target:(NSString *)target {
+    FMResultSet *rs = [_database executeQuery:@"SELECT version FROM known_word_state WHERE source_lang = ? AND target_lang = ?", source, target];
+    int64_t version = -1;
+    if ([rs next]) {
+        version = [rs longLongIntForColumnIndex:0];
+    }
+    [rs close];
+    return version;
+}
+
+/// Next to the database, like SQLite's own -wal file
+- (NSString *)knownWordSnapshotPathForSource:(NSString *)source target:(NSString *)target {
+    return [_databasePath stringByAppendingFormat:@"-known-%@-%@", source, target];
+}
+
+- (XLKnownWordSet *)loadKnownWordSetForSource:(NSString *)source target:(NSString *)target {
+    int64_t version = [self knownWordVersionForSource:source target:target];
+    if (version < 0) {
+        [self bumpKnownWordVersionForSource:source target:target];
+        version = [self knownWordVersionForSource:source target:target];
+    }
+    NSString *path = [self knownWordSnapshotPathForSource:source target:target];
+    int64_t stamp = -1;
+    XLKnownWordSet *set = [XLKnownWordSet setWithContentsOfFile:path stamp:&stamp error:NULL];
+    if (set && stamp == version) {
+        XLMetricAdd(XL_COUNTER("known_words.snapshot.hit"), 1);
+        return set;
+    }
+    XLMetricAdd(XL_COUNTER("known_words.rebuild"), 1);
+    set = [[[XLKnownWordSet alloc] init] autorelease];
+    FMResultSet *rs = [_database executeQuery:@"SELECT source_word FROM vocabulary WHERE status = 'learned' AND source_lang = ? AND target_lang = ? "
+                                               "UNION ALL SELECT word FROM known_words WHERE source_lang = ? AND target_lang = ?",
+                       source, target, source, target];
+    while (rs && [rs next]) {
+        NSString *word = [rs stringForColumnIndex:0];
+        if (word) [set addWord:word];
+    }
+    [rs close];
+    [self writeKnownWordSet:set toPath:path stamp:version];
+    return set;
+}
+
+/// A snapshot that could not be replaced is removed, so it can never be extended as if it matched the set
+- (void)writeKnownWordSet:(XLKnownWordSet *)set toPath:(NSString *)path stamp:(int64_t)stamp {
+    if (![set writeToFile:path stamp:stamp error:NULL]) {
+        [[SSFileSystem sharedFileSystem] deleteFileAtPath:path error:NULL];
+    }
+}
+
+/// After the commit that made word known: extend the loaded set, and its snapshot by one fingerprint
+- (void)addKnownWord:(NSString *)word source:(NSString *)source target:(NSString *)target {
+    XLKnownWordSet *set = [_knownWordSets objectForKey:[NSString stringWithFormat:@"%@-%@", source, target]];
+    if (!set) return;
+    NSString *path = [self knownWordSnapshotPathForSource:source target:target];
+    int64_t version = [self knownWordVersionForSource:source target:target];
+    if (![set addWord:word appendingToFile:path stamp:version error:NULL]) {
+        [self writeKnownWordSet:set toPath:path stamp:version];
     }
 }
 
+- (void)discardKnownWordSetForSource:(NSString *)source target:(NSString *)target {
+    [_knownWordSets removeObjectForKey:[NSString stringWithFormat:@"%@-%@", source, target]];
+}
+
 - (void)getPreferencesWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -607,6 +1380,7 @@
 }
 
 - (void)savePreferences:(XLUserPreferences *)prefs delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -633,6 +1407,9 @@
     ];
     for (NSArray *kv in pairs) {
         BOOL ok = [_database executeUpdate:@"INSERT OR REPLACE INTO preferences (key, value) VALUES (?, ?)", [kv objectAtIndex:0], [kv objectAtIndex:1]];
+        if (ok) {
+            [self noteChange:XLStorageChangeUpdated ofId:[kv objectAtIndex:0] inTable:XLStorageTablePreferences];
+        }
         if (!ok) {
             if ([delegate respondsToSelector:@selector(storageService:didSavePreferencesWithSuccess:error:)]) {
                 NSError *err = [NSError errorWithDomain:@"XLStorageService" code:1 userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: @"Save failed" }];
@@ -647,6 +1424,7 @@
 }
 
 - (void)getLibraryViewModeWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -665,6 +1443,7 @@
 }
 
 - (void)saveLibraryViewMode:(BOOL)grid delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -672,12 +1451,16 @@
         return;
     }
     BOOL ok = [_database executeUpdate:@"INSERT OR REPLACE INTO preferences (key, value) VALUES ('library_view_mode', ?)", grid ? @"grid" : @"list"];
+    if (ok) {
+        [self noteChange:XLStorageChangeUpdated ofId:@"library_view_mode" inTable:XLStorageTablePreferences];
+    }
     if ([delegate respondsToSelector:@selector(storageService:didSaveLibraryViewModeWithSuccess:error:)]) {
         [delegate storageService:self didSaveLibraryViewModeWithSuccess:ok error:nil];
     }
 }
 
 - (void)startReadingSessionForBookId:(NSString *)bookId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -692,12 +1475,17 @@
         [delegate storageService:self didStartReadingSessionWithId:nil error:err];
         return;
     }
+    if (ok) {
+        [self noteChange:XLStorageChangeInserted ofId:sessionId inTable:XLStorageTableReadingSessions];
+    }
     if ([delegate respondsToSelector:@selector(storageService:didStartReadingSessionWithId:error:)]) {
         [delegate storageService:self didStartReadingSessionWithId:sessionId error:nil];
     }
 }
 
 - (void)endReadingSessionWithId:(NSString *)sessionId wordsRevealed:(NSInteger)wordsRevealed wordsSaved:(NSInteger)wordsSaved delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.endReadingSession");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -705,13 +1493,50 @@
         return;
     }
     long long nowMs = (long long)([[NSDate date] timeIntervalSince1970] * 1000);
+    BOOL found = NO;
+    NSString *bookId = nil;
+    long long startedMs = 0, prevEndedMs = 0;
+    NSInteger prevRevealed = 0, prevSaved = 0;
+    FMResultSet *rs = [_database executeQuery:@"SELECT book_id, started_at, ended_at, words_revealed, words_saved FROM reading_sessions WHERE id = ?", sessionId];
+    if ([rs next]) {
+        found = YES;
+        bookId = [rs stringForColumnIndex:0] ?: @"";
+        startedMs = [rs longLongIntForColumnIndex:1];
+        prevEndedMs = [rs longLongIntForColumnIndex:2];
+        prevRevealed = [rs intForColumnIndex:3];
+        prevSaved = [rs intForColumnIndex:4];
+    }
+    [rs close];
+
+    [_database beginTransaction];
     BOOL ok = [_database executeUpdate:@"UPDATE reading_sessions SET ended_at = ?, words_revealed = ?, words_saved = ? WHERE id = ?", [NSNumber numberWithLongLong:nowMs], [NSNumber numberWithInt:(int)wordsRevealed], [NSNumber numberWithInt:(int)wordsSaved], sessionId];
+    NSString *prevDay = nil, *day = nil;
+    if (ok && found) {
+        /* Ending an already-ended session replaces its previous contribution */
+        if (prevEndedMs > 0) {
+            prevDay = [self rollUpSessionForBookId:bookId endedAtMs:prevEndedMs seconds:(prevEndedMs - startedMs) / 1000 wordsRevealed:prevRevealed wordsSaved:prevSaved sign:-1];
+        }
+        day = [self rollUpSessionForBookId:bookId endedAtMs:nowMs seconds:(nowMs - startedMs) / 1000 wordsRevealed:wordsRevealed wordsSaved:wordsSaved sign:1];
+    }
+    NSError *error = nil;
+    if (ok) {
+        ok = [self commitTransactionWithError:&error description:@"Failed to end reading session"];
+    } else {
+        error = [self databaseErrorWithDescription:@"Failed to end reading session"];
+        [_database rollback];
+    }
+    if (ok && found) {
+        [self noteChange:XLStorageChangeUpdated ofId:sessionId inTable:XLStorageTableReadingSessions];
+        [self noteChange:XLStorageChangeUpdated ofId:prevDay inTable:XLStorageTableDailyStats];
+        [self noteChange:XLStorageChangeUpdated ofId:day inTable:XLStorageTableDailyStats];
+    }
     if ([delegate respondsToSelector:@selector(storageService:didEndReadingSessionWithSuccess:error:)]) {
-        [delegate storageService:self didEndReadingSessionWithSuccess:ok error:nil];
+        [delegate storageService:self didEndReadingSessionWithSuccess:ok error:error];
     }
 }
 
 - (void)getActiveSessionForBookId:(NSString *)bookId delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -730,100 +1555,52 @@
 }
 
 - (void)getReadingStatsWithDelegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getReadingStats");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
         if (_database) { [self getReadingStatsWithDelegate:delegate]; }
         return;
     }
-    NSMutableSet *bookIds = [NSMutableSet set];
-    NSMutableArray *sessionDates = [NSMutableArray array];
-    NSInteger totalSeconds = 0;
+    /* Constant-time: read the rollup rows instead of scanning reading_sessions */
+    XLReadingStats *stats = [[XLReadingStats alloc] init];
     NSInteger sessionCount = 0;
-    NSInteger wordsRevealedToday = 0;
-    NSInteger wordsSavedToday = 0;
-    NSCalendar *cal = [NSCalendar currentCalendar];
-    NSDate *today = [NSDate date];
-    NSInteger todayYear = 0, todayMonth = 0, todayDay = 0;
-    [cal getEra:nil year:&todayYear month:&todayMonth day:&todayDay fromDate:today];
-
-    FMResultSet *rs = [_database executeQuery:@"SELECT book_id, started_at, ended_at, words_revealed, words_saved FROM reading_sessions WHERE ended_at IS NOT NULL"];
-    while (rs && [rs next]) {
-        NSString *bookId = [rs stringForColumnIndex:0] ?: @"";
-        long long startedMs = [rs longLongIntForColumnIndex:1];
-        long long endedMs = [rs longLongIntForColumnIndex:2];
-        NSInteger wr = [rs intForColumnIndex:3];
-        NSInteger ws = [rs intForColumnIndex:4];
-        [bookIds addObject:bookId];
-        totalSeconds += (NSInteger)((endedMs - startedMs) / 1000);
-        sessionCount++;
-        NSDate *endedDate = [NSDate dateWithTimeIntervalSince1970:endedMs / 1000.0];
-        [sessionDates addObject:endedDate];
-        NSDateComponents *comp = [cal components:NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay fromDate:endedDate];
-        if ([comp year] == todayYear && [comp month] == todayMonth && [comp day] == todayDay) {
-            wordsRevealedToday += wr;
-            wordsSavedToday += ws;
-        }
+    NSInteger longestStreak = 0;
+    FMResultSet *rs = [_database executeQuery:@"SELECT total_sessions, total_seconds, books_read, current_streak, longest_streak FROM stats_state WHERE id = 1"];
+    if ([rs next]) {
+        sessionCount = [rs intForColumnIndex:0];
+        stats.totalReadingTime = (NSTimeInterval)[rs longLongIntForColumnIndex:1];
+        stats.totalBooksRead = [rs intForColumnIndex:2];
+        stats.currentStreak = [rs intForColumnIndex:3];
+        longestStreak = [rs intForColumnIndex:4];
     }
     [rs close];
+    stats.longestStreak = longestStreak > 0 ? longestStreak : 1;
+    stats.averageSessionDuration = (sessionCount > 0) ? stats.totalReadingTime / (NSTimeInterval)sessionCount : 0;
+
+    FMResultSet *todayRs = [_database executeQuery:@"SELECT words_revealed, words_saved, reviews FROM daily_stats WHERE day = date('now', 'localtime')"];
+    if ([todayRs next]) {
+        stats.wordsRevealedToday = [todayRs intForColumnIndex:0];
+        stats.wordsSavedToday = [todayRs intForColumnIndex:1];
+        stats.reviewsToday = [todayRs intForColumnIndex:2];
+    }
+    [todayRs close];
 
-    NSInteger totalWordsLearned = 0;
     FMResultSet *countRs = [_database executeQuery:@"SELECT COUNT(*) FROM vocabulary WHERE status = 'learned'"];
     if ([countRs next]) {
-        totalWordsLearned = [countRs intForColumnIndex:0];
+        stats.totalWordsLearned = [countRs intForColumnIndex:0];
     }
     [countRs close];
 
-    NSMutableSet *uniqueDates = [NSMutableSet set];
-    for (NSDate *d in sessionDates) {
-        NSDateComponents *c = [cal components:NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay fromDate:d];
-        NSDate *dayStart = [cal dateFromComponents:c];
-        [uniqueDates addObject:dayStart];
-    }
-    NSArray *sortedDates = [[uniqueDates allObjects] sortedArrayUsingSelector:@selector(compare:)];
-    NSSet *dateSet = [NSSet setWithArray:sortedDates];
-    NSInteger currentStreak = 0;
-    if ([sortedDates count] > 0) {
-        NSDate *mostRecent = [sortedDates lastObject];
-        NSDate *d = mostRecent;
-        while ([dateSet containsObject:d]) {
-            currentStreak++;
-            d = [cal dateByAddingUnit:NSCalendarUnitDay value:-1 toDate:d options:0];
-        }
-    }
-
-    NSInteger longestStreak = 1;
-    if ([sortedDates count] > 0) {
-        NSInteger run = 1;
-        for (NSInteger i = 1; i < (NSInteger)[sortedDates count]; i++) {
-            NSDate *prev = [sortedDates objectAtIndex:i - 1];
-            NSDate *cur = [sortedDates objectAtIndex:i];
-            NSInteger diff = (NSInteger)([cur timeIntervalSinceDate:prev] / (24 * 3600));
-            if (diff == 1) {
-                run++;
-            } else {
-                run = 1;
-            }
-            if (run > longestStreak) longestStreak = run;
-        }
-    }
-
-    NSTimeInterval avgDuration = (sessionCount > 0) ? (NSTimeInterval)totalSeconds / (NSTimeInterval)sessionCount : 0;
-    XLReadingStats *stats = [[XLReadingStats alloc] init];
-    stats.totalBooksRead = [bookIds count];
-    stats.totalReadingTime = totalSeconds;
-    stats.totalWordsLearned = totalWordsLearned;
-    stats.currentStreak = currentStreak;
-    stats.longestStreak = longestStreak;
-    stats.averageSessionDuration = avgDuration;
-    stats.wordsRevealedToday = wordsRevealedToday;
-    stats.wordsSavedToday = wordsSavedToday;
     if ([delegate respondsToSelector:@selector(storageService:didGetReadingStats:withError:)]) {
         [delegate storageService:self didGetReadingStats:stats withError:nil];
     }
 }
 
 - (void)getWordsRevealedByDayWithLastDays:(NSInteger)lastDays delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getWordsRevealedByDay");
+    XL_STORAGE_LOCKED();
     _currentDelegate = delegate;
     if (!_database) {
         [self initializeDatabaseWithDelegate:delegate];
@@ -831,7 +1608,8 @@
         return;
     }
     NSMutableDictionary *byDate = [NSMutableDictionary dictionary];
-    FMResultSet *rs = [_database executeQuery:@"SELECT date(ended_at/1000, 'unixepoch', 'localtime') as d, SUM(words_revealed) as total FROM reading_sessions WHERE ended_at IS NOT NULL GROUP BY d"];
+    NSString *sinceModifier = [NSString stringWithFormat:@"-%ld days", (long)(lastDays > 0 ? lastDays - 1 : 0)];
+    FMResultSet *rs = [_database executeQuery:@"SELECT day, words_revealed FROM daily_stats WHERE day >= date('now', 'localtime', ?)", sinceModifier];
     while (rs && [rs next]) {
         NSString *dateStr = [rs stringForColumnIndex:0];
         NSInteger total = [rs intForColumnIndex:1];
@@ -865,6 +1643,454 @@
     }
 }
 
+- (void)getReviewForecastForDays:(NSInteger)days gradeWeights:(NSArray *)gradeWeights delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getReviewForecast");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getReviewForecastForDays:days gradeWeights:gradeWeights delegate:delegate]; }
+        return;
+    }
+    XLReviewForecastOptions options = XLReviewForecastDefaultOptions();
+    options.days = days > 0 ? (size_t)days : options.days;
+    if ([gradeWeights count] == 6) {
+        for (NSUInteger q = 0; q < 6; q++) options.gradeWeights[q] = [[gradeWeights objectAtIndex:q] doubleValue];
+    }
+
+    /* Only the scheduling columns are read, straight into arrays; learned cards never come due */
+    sqlite3 *db = (sqlite3 *)[_database sqliteHandle];
+    sqlite3_stmt *select = NULL;
+    size_t count = 0, capacity = 0;
+    double *easeFactor = NULL, *interval = NULL;
+    int64_t *reviewCount = NULL, *status = NULL;
+    int32_t *dueDay = NULL;
+    long long nowMs = (long long)([[NSDate date] timeIntervalSince1970] * 1000);
+    BOOL ok = sqlite3_prepare_v2(db, "SELECT COALESCE(ease_factor, 2.5), COALESCE(interval, 0), COALESCE(review_count, 0), status, last_reviewed_at "
+                                     "FROM vocabulary WHERE status != 'learned'", -1, &select, NULL) == SQLITE_OK;
+    int rc = SQLITE_DONE;
+    while (ok && (rc = sqlite3_step(select)) == SQLITE_ROW) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            double *e = realloc(easeFactor, capacity * sizeof(double));
+            if (e) easeFactor = e;
+            double *iv = realloc(interval, capacity * sizeof(double));
+            if (iv) interval = iv;
+            int64_t *c = realloc(reviewCount, capacity * sizeof(int64_t));
+            if (c) reviewCount = c;
+            int64_t *st = realloc(status, capacity * sizeof(int64_t));
+            if (st) status = st;
+            int32_t *d = realloc(dueDay, capacity * sizeof(int32_t));
+            if (d) dueDay = d;
+            if (!e || !iv || !c || !st || !d) {
+                ok = NO;
+                break;
+            }
+        }
+        easeFactor[count] = sqlite3_column_double(select, 0);
+        interval[count] = (double)sqlite3_column_int64(select, 1);
+        reviewCount[count] = sqlite3_column_int64(select, 2);
+        status[count] = XLSm2StatusForName((const char *)sqlite3_column_text(select, 3));
+        long long dueIn = 0;
+        if (sqlite3_column_type(select, 4) != SQLITE_NULL) {
+            dueIn = (sqlite3_column_int64(select, 4) + (long long)interval[count] * 86400000LL - nowMs) / 86400000LL;
+        }
+        dueDay[count] = (int32_t)MAX(0LL, MIN(dueIn, (long long)INT32_MAX));
+        count++;
+    }
+    ok = ok && rc == SQLITE_DONE;
+    sqlite3_finalize(select);
+
+    NSMutableArray *result = nil;
+    if (ok) {
+        double *due = malloc(options.days * sizeof(double));
+        double *learned = malloc(options.days * sizeof(double));
+        XLSm2Columns cards = { easeFactor, interval, reviewCount, status };
+        if (due && learned) {
+            XLReviewForecastRun(cards, dueDay, count, &options, due, learned);
+            NSCalendar *cal = [NSCalendar currentCalendar];
+            NSDateFormatter *dayFmt = [[NSDateFormatter alloc] init];
+            [dayFmt setDateFormat:@"EEE d"];
+            result = [NSMutableArray arrayWithCapacity:options.days];
+            for (size_t day = 0; day < options.days; day++) {
+                NSDate *date = [cal dateByAddingUnit:NSCalendarUnitDay value:(NSInteger)day toDate:[NSDate date] options:0];
+                [result addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                    [dayFmt stringFromDate:date], @"dayLabel",
+                    [NSNumber numberWithDouble:due[day]], @"due",
+                    [NSNumber numberWithDouble:learned[day]], @"learned",
+                    nil]];
+            }
+            [dayFmt release];
+        }
+        free(due);
+        free(learned);
+        ok = (result != nil);
+    }
+    free(easeFactor);
+    free(interval);
+    free(reviewCount);
+    free(status);
+    free(dueDay);
+
+    NSError *error = ok ? nil : [self databaseErrorWithDescription:@"Failed to forecast reviews"];
+    if ([delegate respondsToSelector:@selector(storageService:didGetReviewForecast:withError:)]) {
+        [delegate storageService:self didGetReviewForecast:result withError:error];
+    }
+}
+
+#pragma mark - Statistics rollups
+
+- (void)rebuildStatsRollupIfNeeded {
+    FMResultSet *rs = [_database executeQuery:@"SELECT COUNT(*) FROM stats_state"];
+    BOOL haveState = [rs next] && [rs intForColumnIndex:0] > 0;
+    [rs close];
+    if (haveState) return;
+
+    /* One-time backfill from existing reading_sessions (databases created before the rollups) */
+    [_database beginTransaction];
+    [_database executeUpdate:@"DELETE FROM daily_stats"];
+    [_database executeUpdate:@"DELETE FROM stats_books"];
+    [_database executeUpdate:@"INSERT INTO daily_stats (day, sessions, reading_seconds, words_revealed, words_saved) "
+        "SELECT date(ended_at/1000, 'unixepoch', 'localtime') AS d, COUNT(*), SUM((ended_at - started_at) / 1000), SUM(words_revealed), SUM(words_saved) "
+        "FROM reading_sessions WHERE ended_at IS NOT NULL GROUP BY d"];
+    [_database executeUpdate:@"INSERT OR IGNORE INTO stats_books (book_id) SELECT DISTINCT book_id FROM reading_sessions WHERE ended_at IS NOT NULL"];
+
+    long long totalSessions = 0, totalSeconds = 0, booksRead = 0;
+    FMResultSet *totalsRs = [_database executeQuery:@"SELECT COUNT(*), COALESCE(SUM((ended_at - started_at) / 1000), 0) FROM reading_sessions WHERE ended_at IS NOT NULL"];
+    if ([totalsRs next]) {
+        totalSessions = [totalsRs longLongIntForColumnIndex:0];
+        totalSeconds = [totalsRs longLongIntForColumnIndex:1];
+    }
+    [totalsRs close];
+    FMResultSet *booksRs = [_database executeQuery:@"SELECT COUNT(*) FROM stats_books"];
+    if ([booksRs next]) {
+        booksRead = [booksRs longLongIntForColumnIndex:0];
+    }
+    [booksRs close];
+
+    BOOL ok = [_database executeUpdate:@"INSERT INTO stats_state (id, total_sessions, total_seconds, books_read) VALUES (1, ?, ?, ?)",
+        [NSNumber numberWithLongLong:totalSessions],
+        [NSNumber numberWithLongLong:totalSeconds],
+        [NSNumber numberWithLongLong:booksRead]];
+    if (ok) {
+        [self recomputeStreakState];
+        [self commitTransactionWithError:NULL description:nil];
+    } else {
+        [_database rollback];
+    }
+}
+
+/// Rescan the days with sessions for last_day and both streaks; the incremental update only handles days being added
+- (void)recomputeStreakState {
+    long long lastDay = 0, run = 0, longest = 0;
+    FMResultSet *daysRs = [_database executeQuery:@"SELECT CAST(julianday(day) AS INTEGER) FROM daily_stats WHERE sessions > 0 ORDER BY day"];
+    while (daysRs && [daysRs next]) {
+        long long d = [daysRs longLongIntForColumnIndex:0];
+        run = (lastDay != 0 && d == lastDay + 1) ? run + 1 : 1;
+        if (run > longest) longest = run;
+        lastDay = d;
+    }
+    [daysRs close];
+    [_database executeUpdate:@"UPDATE stats_state SET last_day = ?, current_streak = ?, longest_streak = ? WHERE id = 1",
+        [NSNumber numberWithLongLong:lastDay],
+        [NSNumber numberWithLongLong:run],
+        [NSNumber numberWithLongLong:longest]];
+}
+
+- (NSString *)localDayForMs:(long long)ms {
+    NSString *day = nil;
+    FMResultSet *rs = [_database executeQuery:@"SELECT date(?/1000, 'unixepoch', 'localtime')", [NSNumber numberWithLongLong:ms]];
+    if ([rs next]) {
+        day = [rs stringForColumnIndex:0];
+    }
+    [rs close];
+    return day;
+}
+
+- (NSString *)rollUpSessionForBookId:(NSString *)bookId endedAtMs:(long long)endedMs seconds:(long long)seconds wordsRevealed:(NSInteger)wordsRevealed wordsSaved:(NSInteger)wordsSaved sign:(NSInteger)sign {
+    NSString *day = [self localDayForMs:endedMs];
+    if (!day) return nil;
+    [_database executeUpdate:@"INSERT OR IGNORE INTO daily_stats (day) VALUES (?)", day];
+    [_database executeUpdate:@"UPDATE daily_stats SET sessions = sessions + ?, reading_seconds = reading_seconds + ?, words_revealed = words_revealed + ?, words_saved = words_saved + ? WHERE day = ?",
+        [NSNumber numberWithInteger:sign],
+        [NSNumber numberWithLongLong:sign * seconds],
+        [NSNumber numberWithInteger:sign * wordsRevealed],
+        [NSNumber numberWithInteger:sign * wordsSaved],
+        day];
+    [_database executeUpdate:@"UPDATE stats_state SET total_sessions = total_sessions + ?, total_seconds = total_seconds + ? WHERE id = 1",
+        [NSNumber numberWithInteger:sign],
+        [NSNumber numberWithLongLong:sign * seconds]];
+    if (sign < 0) {
+        /* A day that loses its last session can break or shorten a streak */
+        FMResultSet *dayRs = [_database executeQuery:@"SELECT sessions FROM daily_stats WHERE day = ?", day];
+        BOOL dayEmptied = [dayRs next] && [dayRs longLongIntForColumnIndex:0] <= 0;
+        [dayRs close];
+        if (dayEmptied) {
+            [self recomputeStreakState];
+        }
+        /* The book stops counting as read once none of its ended sessions is left */
+        FMResultSet *left = [_database executeQuery:@"SELECT 1 FROM reading_sessions WHERE book_id = ? AND ended_at IS NOT NULL LIMIT 1", bookId];
+        BOOL remaining = [left next];
+        [left close];
+        if (!remaining && [_database executeUpdate:@"DELETE FROM stats_books WHERE book_id = ?", bookId] && [_database changes] > 0) {
+            [_database executeUpdate:@"UPDATE stats_state SET books_read = books_read - 1 WHERE id = 1"];
+        }
+        return day;
+    }
+
+    if ([_database executeUpdate:@"INSERT OR IGNORE INTO stats_books (book_id) VALUES (?)", bookId] && [_database changes] > 0) {
+        [_database executeUpdate:@"UPDATE stats_state SET books_read = books_read + 1 WHERE id = 1"];
+    }
+    /* Streak state: day numbers are local-date Julian days, so consecutive days differ by exactly 1 */
+    long long dayNumber = 0;
+    FMResultSet *rs = [_database executeQuery:@"SELECT CAST(julianday(?) AS INTEGER)", day];
+    if ([rs next]) {
+        dayNumber = [rs longLongIntForColumnIndex:0];
+    }
+    [rs close];
+    if (dayNumber <= 0) return day;
+    NSNumber *dayNum = [NSNumber numberWithLongLong:dayNumber];
+    [_database executeUpdate:@"UPDATE stats_state SET "
+        "current_streak = CASE WHEN last_day = 0 OR ? > last_day + 1 THEN 1 WHEN ? = last_day + 1 THEN current_streak + 1 ELSE current_streak END, "
+        "last_day = MAX(last_day, ?) WHERE id = 1", dayNum, dayNum, dayNum];
+    [_database executeUpdate:@"UPDATE stats_state SET longest_streak = MAX(longest_streak, current_streak) WHERE id = 1"];
+    return day;
+}
+
+- (NSString *)rollUpReviewAtMs:(long long)nowMs {
+    NSString *day = [self localDayForMs:nowMs];
+    if (!day) return nil;
+    [_database executeUpdate:@"INSERT OR IGNORE INTO daily_stats (day) VALUES (?)", day];
+    [_database executeUpdate:@"UPDATE daily_stats SET reviews = reviews + 1 WHERE day = ?", day];
+    return day;
+}
+
+#pragma mark - Processed chapters
+
+static NSNumber *XLDensityKey(double density) {
+    return [NSNumber numberWithLongLong:llround(density * 1000.0)];
+}
+
+/// foreign_words column: JSON array of [originalWord, foreignWord, startIndex, endIndex]
+static NSString *XLEncodeForeignWords(NSArray *foreignWords) {
+    NSMutableArray *rows = [NSMutableArray arrayWithCapacity:[foreignWords count]];
+    for (XLForeignWordData *word in foreignWords) {
+        [rows addObject:@[ word.originalWord ?: @"", word.foreignWord ?: @"",
+                           [NSNumber numberWithInteger:word.startIndex], [NSNumber numberWithInteger:word.endIndex] ]];
+    }
+    NSData *data = [NSJSONSerialization dataWithJSONObject:rows options:0 error:NULL];
+    return data ? [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease] : @"[]";
+}
+
+static NSArray *XLDecodeForeignWords(NSString *json, XLLanguagePair *pair) {
+    NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+    id rows = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+    if (![rows isKindOfClass:[NSArray class]]) return [NSArray array];
+    NSMutableArray *words = [NSMutableArray arrayWithCapacity:[rows count]];
+    for (id row in rows) {
+        if (![row isKindOfClass:[NSArray class]] || [row count] < 4) continue;
+        NSString *original = [row objectAtIndex:0];
+        NSString *foreign = [row objectAtIndex:1];
+        XLWordEntry *entry = [XLWordEntry entryWithSourceWord:original targetWord:foreign
+                                              sourceLanguage:pair.sourceLanguage targetLanguage:pair.targetLanguage];
+        [words addObject:[XLForeignWordData dataWithOriginalWord:original foreignWord:foreign
+                                                      startIndex:[[row objectAtIndex:2] integerValue]
+                                                        endIndex:[[row objectAtIndex:3] integerValue]
+                                                       wordEntry:entry]];
+    }
+    return words;
+}
+
+- (void)saveProcessedChapters:(NSArray *)chapters forBookId:(NSString *)bookId languagePair:(XLLanguagePair *)languagePair proficiency:(XLProficiencyLevel)proficiency density:(double)density delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.saveProcessedChapters");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self saveProcessedChapters:chapters forBookId:bookId languagePair:languagePair proficiency:proficiency density:density delegate:delegate]; }
+        return;
+    }
+    NSString *sourceLang = [XLLanguageInfo codeStringForLanguage:languagePair.sourceLanguage];
+    NSString *targetLang = [XLLanguageInfo codeStringForLanguage:languagePair.targetLanguage];
+    NSString *level = [XLLanguageInfo codeStringForProficiency:proficiency];
+    NSNumber *densityKey = XLDensityKey(density);
+    NSNumber *nowMs = [NSNumber numberWithLongLong:(long long)([[NSDate date] timeIntervalSince1970] * 1000)];
+    BOOL ok = [_database beginTransaction];
+    for (XLProcessedChapter *chapter in chapters) {
+        if (!ok) break;
+        ok = [_database executeUpdate:@"INSERT OR REPLACE INTO processed_chapters (book_id, chapter_index, source_lang, target_lang, proficiency, density_milli, chapter_id, title, word_count, processed_content, foreign_words, processed_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+            bookId,
+            [NSNumber numberWithInteger:chapter.index],
+            sourceLang,
+            targetLang,
+            level,
+            densityKey,
+            chapter.chapterId ?: [NSNull null],
+            chapter.title ?: [NSNull null],
+            [NSNumber numberWithInteger:chapter.wordCount],
+            chapter.processedContent ?: @"",
+            XLEncodeForeignWords(chapter.foreignWords),
+            nowMs];
+    }
+    NSError *error = ok ? nil : [self databaseErrorWithDescription:@"Failed to save processed chapters"];
+    if (ok) {
+        ok = [self commitTransactionWithError:&error description:@"Failed to commit processed chapters"];
+        if (ok) {
+            [self noteChange:XLStorageChangeUpdated ofId:bookId inTable:XLStorageTableProcessedChapters];
+        }
+    } else {
+        [_database rollback];
+    }
+    if ([delegate respondsToSelector:@selector(storageService:didSaveProcessedChaptersForBookId:withSuccess:error:)]) {
+        [delegate storageService:self didSaveProcessedChaptersForBookId:bookId withSuccess:ok error:error];
+    }
+}
+
+- (void)getProcessedChapterForBookId:(NSString *)bookId chapterIndex:(NSInteger)chapterIndex languagePair:(XLLanguagePair *)languagePair proficiency:(XLProficiencyLevel)proficiency density:(double)density delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_SPAN("sqlite.getProcessedChapter");
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getProcessedChapterForBookId:bookId chapterIndex:chapterIndex languagePair:languagePair proficiency:proficiency density:density delegate:delegate]; }
+        return;
+    }
+    FMResultSet *rs = [_database executeQuery:@"SELECT chapter_id, title, word_count, processed_content, foreign_words FROM processed_chapters "
+        "WHERE book_id = ? AND chapter_index = ? AND source_lang = ? AND target_lang = ? AND proficiency = ? AND density_milli = ?",
+        bookId,
+        [NSNumber numberWithInteger:chapterIndex],
+        [XLLanguageInfo codeStringForLanguage:languagePair.sourceLanguage],
+        [XLLanguageInfo codeStringForLanguage:languagePair.targetLanguage],
+        [XLLanguageInfo codeStringForProficiency:proficiency],
+        XLDensityKey(density)];
+    XLProcessedChapter *chapter = nil;
+    if ([rs next]) {
+        chapter = [[[XLProcessedChapter alloc] init] autorelease];
+        chapter.chapterId = [rs stringForColumnIndex:0];
+        chapter.title = [rs stringForColumnIndex:1];
+        chapter.index = chapterIndex;
+        chapter.wordCount = [rs intForColumnIndex:2];
+        NSData *processed = [rs dataForColumnIndex:3];  // the column's UTF-8 as stored, no UTF-16 round trip
+        if (processed) {
+            chapter.processedText = [[[XLChapterText alloc] initWithStorage:processed range:NSMakeRange(0, [processed length])] autorelease];
+        }
+        chapter.foreignWords = XLDecodeForeignWords([rs stringForColumnIndex:4], languagePair);
+    }
+    [rs close];
+    if ([delegate respondsToSelector:@selector(storageService:didGetProcessedChapter:withError:)]) {
+        [delegate storageService:self didGetProcessedChapter:chapter withError:rs ? nil : [self databaseErrorWithDescription:@"Failed to load processed chapter"]];
+    }
+}
+
+#pragma mark - Change feed
+
+- (BOOL)rowExistsWithId:(NSString *)rowId inTable:(NSString *)table {
+    if (!rowId) return NO;
+    NSString *sql = [NSString stringWithFormat:@"SELECT 1 FROM %@ WHERE id = ?", table];
+    FMResultSet *rs = [_database executeQuery:sql, rowId];
+    BOOL exists = [rs next];
+    [rs close];
+    return exists;
+}
+
+- (void)noteChange:(XLStorageChange)kind ofId:(NSString *)rowId inTable:(NSString *)table {
+    if (!rowId) return;
+    @synchronized (self) {
+        if (!_pendingChanges) _pendingChanges = [[XLStorageChangeSet alloc] init];
+        switch (kind) {
+            case XLStorageChangeInserted: [_pendingChanges recordInsertedId:rowId inTable:table]; break;
+            case XLStorageChangeUpdated: [_pendingChanges recordUpdatedId:rowId inTable:table]; break;
+            case XLStorageChangeDeleted: [_pendingChanges recordDeletedId:rowId inTable:table]; break;
+        }
+        if (!_changePostScheduled) {
+            _changePostScheduled = YES;
+            [self performSelectorOnMainThread:@selector(postPendingChanges) withObject:nil waitUntilDone:NO];
+        }
+    }
+}
+
+/// Runs on the next main run-loop turn after the first change, so a burst of writes
+/// (an import, a review session) reaches observers as a single coalesced change set.
+- (void)postPendingChanges {
+    XLStorageChangeSet *changes = nil;
+    @synchronized (self) {
+        changes = _pendingChanges;
+        _pendingChanges = nil;
+        _changePostScheduled = NO;
+    }
+    if (changes && ![changes isEmpty]) {
+        [[NSNotificationCenter defaultCenter] postNotificationName:XLStorageServiceDidChangeNotification
+                                                            object:self
+                                                          userInfo:[NSDictionary dictionaryWithObject:changes forKey:XLStorageChangeSetKey]];
+    }
+    [changes release];
+}
+
+#pragma mark - Fetch by id
+
+- (NSArray *)rowsWithIds:(NSArray *)rowIds table:(NSString *)table columns:(NSString *)columns isBook:(BOOL)isBook {
+    NSMutableArray *rows = [NSMutableArray arrayWithCapacity:[rowIds count]];
+    /* Stay well under SQLITE_MAX_VARIABLE_NUMBER (999 on older builds) */
+    NSUInteger chunk = 500;
+    for (NSUInteger start = 0; start < [rowIds count]; start += chunk) {
+        NSUInteger n = MIN(chunk, [rowIds count] - start);
+        NSArray *ids = [rowIds subarrayWithRange:NSMakeRange(start, n)];
+        NSMutableArray *marks = [NSMutableArray arrayWithCapacity:n];
+        for (NSUInteger i = 0; i < n; i++) [marks addObject:@"?"];
+        NSString *sql = [NSString stringWithFormat:@"SELECT %@ FROM %@ WHERE id IN (%@)", columns, table, [marks componentsJoinedByString:@", "]];
+        FMResultSet *rs = [_database executeQuery:sql withArgumentsInArray:ids];
+        while (rs && [rs next]) {
+            id row = isBook ? (id)[self bookFromResultSet:rs] : (id)[self vocabularyItemFromResultSet:rs];
+            if (row) [rows addObject:row];
+        }
+        [rs close];
+    }
+    return rows;
+}
+
+- (void)getBooksWithIds:(NSArray *)bookIds delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getBooksWithIds:bookIds delegate:delegate]; }
+        return;
+    }
+    NSArray *books = [self rowsWithIds:bookIds ?: [NSArray array] table:XLStorageTableBooks columns:kBookColumns isBook:YES];
+    if ([delegate respondsToSelector:@selector(storageService:didGetBooks:forIds:withError:)]) {
+        [delegate storageService:self didGetBooks:books forIds:bookIds withError:nil];
+    }
+}
+
+- (void)getVocabularyItemsWithIds:(NSArray *)itemIds delegate:(id<XLStorageServiceDelegate>)delegate {
+    XL_STORAGE_LOCKED();
+    _currentDelegate = delegate;
+    if (!_database) {
+        [self initializeDatabaseWithDelegate:delegate];
+        if (_database) { [self getVocabularyItemsWithIds:itemIds delegate:delegate]; }
+        return;
+    }
+    NSArray *items = [self rowsWithIds:itemIds ?: [NSArray array] table:XLStorageTableVocabulary columns:kVocabularyColumns isBook:NO];
+    if ([delegate respondsToSelector:@selector(storageService:didGetVocabularyItems:forIds:withError:)]) {
+        [delegate storageService:self didGetVocabularyItems:items forIds:itemIds withError:nil];
+    }
+}
+
+- (NSError *)databaseErrorWithDescription:(NSString *)fallback {
+    return [NSError errorWithDomain:@"XLStorageService" code:[_database lastErrorCode]
+        userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: fallback }];
+}
+
+/// COMMIT can fail (e.g. SQLITE_BUSY) and leave the transaction open; roll it back so the next call does not
+/// run inside it. The error is taken before the rollback, which would replace the connection's last error.
+- (BOOL)commitTransactionWithError:(NSError **)error description:(NSString *)description {
+    if ([_database commit]) return YES;
+    NSError *commitError = [self databaseErrorWithDescription:description ?: @"Failed to commit"];
+    [_database rollback];
+    if (error) *error = commitError;
+    return NO;
+}
+
 - (XLBook *)bookFromResultSet:(FMResultSet *)rs {
     XLBook *book = [[XLBook alloc] init];
     book.bookId = [rs stringForColumnIndex:0] ?: @"";
@@ -907,6 +2133,9 @@
     if (_fileSystem) {
         [_fileSystem release];
     }
+    [_pendingChanges release];
+    [_knownWordSets release];
+    [_databaseLock release];
     [super dealloc];
 }
 
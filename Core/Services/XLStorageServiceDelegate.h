@@ -9,6 +9,8 @@
 #import "../Models/Vocabulary.h"
 #import "../Models/Reader.h"
 
+@class XLStoragePage;
+
 @protocol XLStorageServiceDelegate <NSObject>
 
 @optional
@@ -18,6 +20,9 @@
 - (void)storageService:(id)service didGetBook:(XLBook *)book withError:(NSError *)error;
 - (void)storageService:(id)service didGetAllBooks:(NSArray *)books withError:(NSError *)error;
 - (void)storageService:(id)service didDeleteBookWithId:(NSString *)bookId withSuccess:(BOOL)success error:(NSError *)error;
+- (void)storageService:(id)service didGetBooksPage:(XLStoragePage *)page withError:(NSError *)error;
+- (void)storageService:(id)service didGetBookCount:(NSInteger)count withError:(NSError *)error;
+- (void)storageService:(id)service didGetBooks:(NSArray *)books forIds:(NSArray *)bookIds withError:(NSError *)error;
 
 // Vocabulary operation callbacks
 - (void)storageService:(id)service didSaveVocabularyItem:(XLVocabularyItem *)item withSuccess:(BOOL)success error:(NSError *)error;
@@ -25,8 +30,13 @@
 - (void)storageService:(id)service didGetAllVocabularyItems:(NSArray *)items withError:(NSError *)error;
 - (void)storageService:(id)service didDeleteVocabularyItemWithId:(NSString *)itemId withSuccess:(BOOL)success error:(NSError *)error;
 - (void)storageService:(id)service didSearchVocabulary:(NSArray *)items withError:(NSError *)error;
+- (void)storageService:(id)service didGetVocabularyPage:(XLStoragePage *)page withError:(NSError *)error;
+- (void)storageService:(id)service didGetVocabularyCount:(NSInteger)count withError:(NSError *)error;
+- (void)storageService:(id)service didGetVocabularyItems:(NSArray *)items forIds:(NSArray *)itemIds withError:(NSError *)error;
 - (void)storageService:(id)service didGetVocabularyDueForReview:(NSArray *)items withError:(NSError *)error;
 - (void)storageService:(id)service didRecordReviewForItemId:(NSString *)itemId withSuccess:(BOOL)success error:(NSError *)error;
+- (void)storageService:(id)service didRescheduleVocabularyItems:(NSUInteger)count withSuccess:(BOOL)success error:(NSError *)error;
+- (void)storageService:(id)service didMarkWordKnown:(NSString *)word withSuccess:(BOOL)success error:(NSError *)error;
 
 // Preferences (Phase 0)
 - (void)storageService:(id)service didGetPreferences:(XLUserPreferences *)prefs withError:(NSError *)error;
@@ -43,6 +53,12 @@
 // Statistics (Phase 0)
 - (void)storageService:(id)service didGetReadingStats:(XLReadingStats *)stats withError:(NSError *)error;
 - (void)storageService:(id)service didGetWordsRevealedByDay:(NSArray *)items withError:(NSError *)error;
+- (void)storageService:(id)service didGetReviewForecast:(NSArray *)days withError:(NSError *)error;
+
+// Processed chapters
+- (void)storageService:(id)service didSaveProcessedChaptersForBookId:(NSString *)bookId withSuccess:(BOOL)success error:(NSError *)error;
+/// chapter is nil (with a nil error) when that chapter has not been processed with those settings
+- (void)storageService:(id)service didGetProcessedChapter:(XLProcessedChapter *)chapter withError:(NSError *)error;
 
 // Database initialization callback
 - (void)storageService:(id)service didInitializeDatabaseWithSuccess:(BOOL)success error:(NSError *)error;
@@ -0,0 +1,55 @@
+//
+//  XLTranslationEndpointPool.h
+//  Xenolexia
+//
+//  Load-aware dispatch of LibreTranslate requests across several endpoints.
+//
+
+#import <Foundation/Foundation.h>
+
+@class XLCancellationToken;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Spreads translation requests over one or more LibreTranslate base URLs.
+/// - Each endpoint has an AIMD concurrency limit: +1/limit per success, halved on failure or timeout.
+///   Requests beyond every endpoint's limit wait in a FIFO queue instead of stampeding the servers.
+/// - A request still outstanding after the endpoint's p95 latency is hedged to another endpoint with
+///   spare capacity; the first answer wins and the loser is cancelled.
+/// - After kBreakerFailureThreshold consecutive failures an endpoint's breaker opens for a cool-down,
+///   then lets one trial request through (half-open) before rejoining the rotation.
+/// Thread-safe; all state lives on a private serial queue. Completions run on that queue.
+@interface XLTranslationEndpointPool : NSObject {
+    NSArray *_endpoints;            // XLTranslationEndpoint
+    NSMutableArray *_waiting;       // queued XLTranslationRequest, FIFO
+    dispatch_queue_t _queue;
+    NSTimeInterval _requestTimeout;
+    BOOL _drainScheduled;           // a timed drain is pending (nothing in flight to trigger one)
+}
+
+/// Whole-request deadline per attempt in seconds (default 10)
+@property (nonatomic, assign) NSTimeInterval requestTimeout;
+
+- (instancetype)initWithBaseURLs:(NSArray *)baseURLs;
+
+- (NSArray *)baseURLs;
+
+- (void)translateText:(NSString *)text
+         fromLanguage:(NSString *)sourceCode
+           toLanguage:(NSString *)targetCode
+           completion:(void(^)(NSString * _Nullable translatedText, NSError * _Nullable error))completion;
+
+/// Same; cancelling token drops the request from the queue or aborts its attempts, and completes it with
+/// an error (code 2). A request cancelled while still queued never reaches an endpoint.
+- (void)translateText:(NSString *)text
+         fromLanguage:(NSString *)sourceCode
+           toLanguage:(NSString *)targetCode
+    cancellationToken:(nullable XLCancellationToken *)token
+           completion:(void(^)(NSString * _Nullable translatedText, NSError * _Nullable error))completion;
+
+/// Per-endpoint snapshot for diagnostics: baseURL, limit, inFlight, p95Ms, breaker (closed/open/half-open)
+- (NSArray *)endpointStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
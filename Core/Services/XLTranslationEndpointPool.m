@@ -0,0 +1,437 @@
+//
+//  XLTranslationEndpointPool.m
+//  Xenolexia
+//
+
+#import "XLTranslationEndpointPool.h"
+#import "XLLibreTranslateClient.h"
+#import "XLCancellationToken.h"
+
+static const double kInitialLimit = 4.0;
+static const double kMinLimit = 1.0;
+static const double kMaxLimit = 32.0;
+#define kLatencySamples 64
+static const NSUInteger kMinSamplesForHedge = 10;
+static const NSTimeInterval kDefaultHedgeDelay = 1.0;
+static const NSInteger kBreakerFailureThreshold = 5;
+static const NSTimeInterval kBreakerCooldown = 30.0;
+
+typedef NS_ENUM(NSInteger, XLBreakerState) {
+    XLBreakerClosed = 0,
+    XLBreakerOpen,
+    XLBreakerHalfOpen
+};
+
+static NSTimeInterval XLNow(void) {
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+/// Per-endpoint limiter, latency window and breaker. Touched only on the pool queue.
+@interface XLTranslationEndpoint : NSObject {
+@public
+    NSString *_baseURL;
+    double _limit;
+    NSInteger _inFlight;
+    double _latencies[kLatencySamples];
+    NSUInteger _sampleCount;
+    NSUInteger _sampleNext;
+    XLBreakerState _breaker;
+    NSInteger _consecutiveFailures;
+    NSTimeInterval _openedAt;
+    BOOL _trialInFlight;
+}
+- (BOOL)canAcceptAt:(NSTimeInterval)now;
+- (BOOL)usableAt:(NSTimeInterval)now;
+- (NSTimeInterval)p95;
+- (void)recordSuccessWithLatency:(NSTimeInterval)latency;
+- (void)recordFailureAt:(NSTimeInterval)now;
+@end
+
+@implementation XLTranslationEndpoint
+
+- (void)dealloc {
+    [_baseURL release];
+    [super dealloc];
+}
+
+- (BOOL)usableAt:(NSTimeInterval)now {
+    return _breaker != XLBreakerOpen || now - _openedAt >= kBreakerCooldown;
+}
+
+- (BOOL)canAcceptAt:(NSTimeInterval)now {
+    if (_breaker == XLBreakerOpen) {
+        if (now - _openedAt < kBreakerCooldown) return NO;
+        _breaker = XLBreakerHalfOpen;
+        _trialInFlight = NO;
+    }
+    if (_breaker == XLBreakerHalfOpen) {
+        return !_trialInFlight;
+    }
+    return _inFlight < (NSInteger)_limit;
+}
+
+- (NSTimeInterval)p95 {
+    if (_sampleCount == 0) return kDefaultHedgeDelay;
+    double sorted[kLatencySamples];
+    memcpy(sorted, _latencies, sizeof(double) * _sampleCount);
+    for (NSUInteger i = 1; i < _sampleCount; i++) {
+        double v = sorted[i];
+        NSUInteger j = i;
+        while (j > 0 && sorted[j - 1] > v) { sorted[j] = sorted[j - 1]; j--; }
+        sorted[j] = v;
+    }
+    NSUInteger idx = (NSUInteger)ceil(0.95 * _sampleCount) - 1;
+    return sorted[idx];
+}
+
+- (void)recordSuccessWithLatency:(NSTimeInterval)latency {
+    _latencies[_sampleNext] = latency;
+    _sampleNext = (_sampleNext + 1) % kLatencySamples;
+    if (_sampleCount < kLatencySamples) _sampleCount++;
+    _limit = MIN(kMaxLimit, _limit + 1.0 / _limit);
+    _consecutiveFailures = 0;
+    _breaker = XLBreakerClosed;
+}
+
+- (void)recordFailureAt:(NSTimeInterval)now {
+    _limit = MAX(kMinLimit, _limit / 2.0);
+    _consecutiveFailures++;
+    if (_breaker == XLBreakerHalfOpen || _consecutiveFailures >= kBreakerFailureThreshold) {
+        _breaker = XLBreakerOpen;
+        _openedAt = now;
+    }
+}
+
+@end
+
+/// One logical translation; may run as several attempts (hedge, failover). Pool queue only.
+@interface XLTranslationRequest : NSObject {
+@public
+    NSString *_text;
+    NSString *_source;
+    NSString *_target;
+    void (^_completion)(NSString *, NSError *);
+    XLCancellationToken *_cancellation;     // the caller's, may be nil
+    id _cancellationRegistration;
+    NSMutableArray *_tried;      // endpoints already used
+    NSMutableArray *_tokens;     // one per outstanding attempt
+    NSInteger _outstanding;
+    BOOL _hedged;
+    BOOL _done;
+}
+@end
+
+@implementation XLTranslationRequest
+
+- (void)dealloc {
+    [_text release];
+    [_source release];
+    [_target release];
+    [_completion release];
+    [_cancellation release];
+    [_tried release];
+    [_tokens release];
+    [super dealloc];
+}
+
+@end
+
+@interface XLTranslationEndpointPool ()
+- (XLTranslationEndpoint *)pickEndpointExcluding:(NSArray *)excluded;
+- (void)dispatchRequest:(XLTranslationRequest *)request;
+- (void)startAttempt:(XLTranslationRequest *)request onEndpoint:(XLTranslationEndpoint *)endpoint;
+- (void)attemptForRequest:(XLTranslationRequest *)request
+                 endpoint:(XLTranslationEndpoint *)endpoint
+                  started:(NSTimeInterval)started
+                    trial:(BOOL)trial
+                     text:(NSString *)text
+                    error:(NSError *)error;
+- (void)completeRequest:(XLTranslationRequest *)request text:(NSString *)text error:(NSError *)error;
+- (void)cancelRequest:(XLTranslationRequest *)request;
+- (void)drainWaiting;
+- (void)scheduleDrainIfStalled;
+@end
+
+@implementation XLTranslationEndpointPool
+
+@synthesize requestTimeout = _requestTimeout;
+
+- (instancetype)initWithBaseURLs:(NSArray *)baseURLs {
+    self = [super init];
+    if (self) {
+        NSMutableArray *endpoints = [NSMutableArray array];
+        for (NSString *url in baseURLs) {
+            if ([url length] == 0) continue;
+            XLTranslationEndpoint *ep = [[XLTranslationEndpoint alloc] init];
+            ep->_baseURL = [url copy];
+            ep->_limit = kInitialLimit;
+            ep->_breaker = XLBreakerClosed;
+            [endpoints addObject:ep];
+            [ep release];
+        }
+        _endpoints = [endpoints copy];
+        _waiting = [[NSMutableArray alloc] init];
+        _queue = dispatch_queue_create("xenolexia.translate.pool", DISPATCH_QUEUE_SERIAL);
+        _requestTimeout = 10.0;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_endpoints release];
+    [_waiting release];
+    dispatch_release(_queue);
+    [super dealloc];
+}
+
+- (NSArray *)baseURLs {
+    NSMutableArray *urls = [NSMutableArray arrayWithCapacity:[_endpoints count]];
+    for (XLTranslationEndpoint *ep in _endpoints) {
+        [urls addObject:ep->_baseURL];
+    }
+    return urls;
+}
+
+- (void)translateText:(NSString *)text
+         fromLanguage:(NSString *)sourceCode
+           toLanguage:(NSString *)targetCode
+           completion:(void(^)(NSString *translatedText, NSError *error))completion {
+    [self translateText:text fromLanguage:sourceCode toLanguage:targetCode cancellationToken:nil completion:completion];
+}
+
+- (void)translateText:(NSString *)text
+         fromLanguage:(NSString *)sourceCode
+           toLanguage:(NSString *)targetCode
+    cancellationToken:(XLCancellationToken *)token
+           completion:(void(^)(NSString *translatedText, NSError *error))completion {
+    XLTranslationRequest *request = [[XLTranslationRequest alloc] init];
+    request->_text = [text copy];
+    request->_source = [sourceCode copy];
+    request->_target = [targetCode copy];
+    request->_completion = [completion copy];
+    request->_tried = [[NSMutableArray alloc] init];
+    request->_tokens = [[NSMutableArray alloc] init];
+    if (token) {
+        /* The registration retains the request until completeRequest unregisters it */
+        request->_cancellation = [token retain];
+        request->_cancellationRegistration = [token registerCancellationHandler:^{
+            dispatch_async(_queue, ^{
+                [self cancelRequest:request];
+            });
+        }];
+    }
+    dispatch_async(_queue, ^{
+        [self dispatchRequest:request];
+        [request release];
+    });
+}
+
+#pragma mark - Scheduling (pool queue)
+
+/// Least-loaded endpoint (inFlight / limit) that has capacity and a non-open breaker
+- (XLTranslationEndpoint *)pickEndpointExcluding:(NSArray *)excluded {
+    NSTimeInterval now = XLNow();
+    XLTranslationEndpoint *best = nil;
+    double bestLoad = 0;
+    for (XLTranslationEndpoint *ep in _endpoints) {
+        if ([excluded indexOfObjectIdenticalTo:ep] != NSNotFound) continue;
+        if (![ep canAcceptAt:now]) continue;
+        double load = (double)ep->_inFlight / ep->_limit;
+        if (!best || load < bestLoad) {
+            best = ep;
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+- (void)dispatchRequest:(XLTranslationRequest *)request {
+    if (request->_done) return;
+    if ([request->_cancellation isCancelled]) {
+        [self cancelRequest:request];
+        return;
+    }
+    XLTranslationEndpoint *ep = [self pickEndpointExcluding:request->_tried];
+    if (ep) {
+        [self startAttempt:request onEndpoint:ep];
+        return;
+    }
+    NSTimeInterval now = XLNow();
+    BOOL anyUsable = NO;
+    for (XLTranslationEndpoint *e in _endpoints) {
+        if ([e usableAt:now] && [request->_tried indexOfObjectIdenticalTo:e] == NSNotFound) anyUsable = YES;
+    }
+    if (!anyUsable) {
+        [self completeRequest:request text:nil error:[NSError errorWithDomain:@"XLTranslationEndpointPool" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"No translation endpoint available" }]];
+        return;
+    }
+    [_waiting addObject:request];
+    [self scheduleDrainIfStalled];
+}
+
+- (void)startAttempt:(XLTranslationRequest *)request onEndpoint:(XLTranslationEndpoint *)endpoint {
+    endpoint->_inFlight++;
+    BOOL trial = endpoint->_breaker == XLBreakerHalfOpen;
+    if (trial) {
+        endpoint->_trialInFlight = YES;
+    }
+    [request->_tried addObject:endpoint];
+    request->_outstanding++;
+    XLCancellationToken *token = [XLCancellationToken token];
+    [request->_tokens addObject:token];
+    NSTimeInterval started = XLNow();
+    [request retain];
+    [XLLibreTranslateClient translateText:request->_text
+                             fromLanguage:request->_source
+                               toLanguage:request->_target
+                                  baseURL:endpoint->_baseURL
+                                  timeout:_requestTimeout
+                        cancellationToken:token
+                               completion:^(NSString *translatedText, NSError *error) {
+        dispatch_async(_queue, ^{
+            [self attemptForRequest:request endpoint:endpoint started:started trial:trial text:translatedText error:error];
+            [request release];
+        });
+    }];
+
+    /* Hedge: if this attempt outlives the endpoint's p95, race a duplicate on another endpoint */
+    if (!request->_hedged && [_endpoints count] > 1) {
+        NSTimeInterval delay = endpoint->_sampleCount >= kMinSamplesForHedge ? [endpoint p95] : kDefaultHedgeDelay;
+        [request retain];
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+            if (!request->_done && !request->_hedged && request->_outstanding > 0) {
+                XLTranslationEndpoint *other = [self pickEndpointExcluding:request->_tried];
+                if (other) {
+                    request->_hedged = YES;
+                    [self startAttempt:request onEndpoint:other];
+                }
+            }
+            [request release];
+        });
+    }
+}
+
+- (void)attemptForRequest:(XLTranslationRequest *)request
+                 endpoint:(XLTranslationEndpoint *)endpoint
+                  started:(NSTimeInterval)started
+                    trial:(BOOL)trial
+                     text:(NSString *)text
+                    error:(NSError *)error {
+    endpoint->_inFlight--;
+    if (trial) {
+        /* Only the half-open trial frees the trial slot; other attempts may still be finishing */
+        endpoint->_trialInFlight = NO;
+    }
+    request->_outstanding--;
+    if (request->_done) {
+        /* Losing side of a hedge (cancelled or late): says nothing about the endpoint */
+        [self drainWaiting];
+        return;
+    }
+    NSInteger code = [error code];
+    BOOL clientError = error && [[error domain] isEqualToString:@"XLLibreTranslateClient"] && code >= 400 && code < 500 && code != 429;
+    if (!error) {
+        [endpoint recordSuccessWithLatency:XLNow() - started];
+        [self completeRequest:request text:text error:nil];
+    } else if (clientError) {
+        /* The request itself is bad (e.g. unsupported language); another endpoint will say the same */
+        [self completeRequest:request text:nil error:error];
+    } else {
+        [endpoint recordFailureAt:XLNow()];
+        if (request->_outstanding == 0) {
+            XLTranslationEndpoint *other = [self pickEndpointExcluding:request->_tried];
+            if (other) {
+                [self startAttempt:request onEndpoint:other];
+            } else {
+                [self completeRequest:request text:nil error:error];
+            }
+        }
+    }
+    [self drainWaiting];
+}
+
+- (void)completeRequest:(XLTranslationRequest *)request text:(NSString *)text error:(NSError *)error {
+    request->_done = YES;
+    for (XLCancellationToken *token in request->_tokens) {
+        [token cancel];
+    }
+    [request->_cancellation unregisterCancellationHandler:request->_cancellationRegistration];
+    request->_cancellationRegistration = nil;
+    if (request->_completion) {
+        request->_completion(text, error);
+    }
+}
+
+/// The caller gave up: leave the queue, abort attempts in flight (they come back as hedge losers)
+- (void)cancelRequest:(XLTranslationRequest *)request {
+    if (request->_done) return;
+    [request retain];
+    [_waiting removeObjectIdenticalTo:request];
+    [self completeRequest:request text:nil error:[NSError errorWithDomain:@"XLTranslationEndpointPool" code:2 userInfo:@{ NSLocalizedDescriptionKey: @"Translation cancelled" }]];
+    [request release];
+}
+
+- (void)drainWaiting {
+    while ([_waiting count] > 0) {
+        XLTranslationRequest *next = [_waiting objectAtIndex:0];
+        if ([next->_cancellation isCancelled]) {
+            [self cancelRequest:next];
+            continue;
+        }
+        XLTranslationEndpoint *ep = [self pickEndpointExcluding:next->_tried];
+        if (!ep) break;
+        [next retain];
+        [_waiting removeObjectAtIndex:0];
+        [self startAttempt:next onEndpoint:ep];
+        [next release];
+    }
+    [self scheduleDrainIfStalled];
+}
+
+/// With requests waiting and nothing in flight, no completion will drain the queue: wake up when the first
+/// open breaker's cool-down ends, or fail the waiting requests if no endpoint can ever take them.
+- (void)scheduleDrainIfStalled {
+    if ([_waiting count] == 0 || _drainScheduled) return;
+    NSTimeInterval now = XLNow();
+    NSInteger inFlight = 0;
+    NSTimeInterval wait = -1;
+    for (XLTranslationEndpoint *e in _endpoints) {
+        inFlight += e->_inFlight;
+        if (e->_breaker == XLBreakerOpen) {
+            NSTimeInterval remaining = MAX(0.0, e->_openedAt + kBreakerCooldown - now);
+            if (wait < 0 || remaining < wait) wait = remaining;
+        }
+    }
+    if (inFlight > 0) return;
+    if (wait < 0) {
+        /* Every endpoint is idle and closed: the head request has already tried all it could use */
+        XLTranslationRequest *stranded = [[[_waiting objectAtIndex:0] retain] autorelease];
+        [_waiting removeObjectAtIndex:0];
+        [self completeRequest:stranded text:nil error:[NSError errorWithDomain:@"XLTranslationEndpointPool" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"No translation endpoint available" }]];
+        [self drainWaiting];
+        return;
+    }
+    _drainScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(wait, 0.05) * NSEC_PER_SEC)), _queue, ^{
+        _drainScheduled = NO;
+        [self drainWaiting];
+    });
+}
+
+- (NSArray *)endpointStatistics {
+    __block NSMutableArray *stats = [NSMutableArray array];
+    dispatch_sync(_queue, ^{
+        NSTimeInterval now = XLNow();
+        for (XLTranslationEndpoint *ep in _endpoints) {
+            NSString *breaker = ep->_breaker == XLBreakerClosed ? @"closed" : ([ep usableAt:now] ? @"half-open" : @"open");
+            [stats addObject:@{ @"baseURL": ep->_baseURL,
+                                @"limit": @(ep->_limit),
+                                @"inFlight": @(ep->_inFlight),
+                                @"p95Ms": @([ep p95] * 1000.0),
+                                @"breaker": breaker }];
+        }
+    });
+    return stats;
+}
+
+@end
@@ -9,9 +9,18 @@
 #import "../Models/Reader.h"
 #import "../Models/Language.h"
 #import "../Models/Vocabulary.h"
+#import "XLTranslationService.h"
+#import "XLExecutor.h"
+#import "../Native/XLKnownWordSet.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+extern NSString *const XLTranslationEngineErrorDomain;
+
+typedef NS_ENUM(NSInteger, XLTranslationEngineError) {
+    XLTranslationEngineErrorCancelled = 1
+};
+
 /// Translation options
 @interface XLTranslationOptions : NSObject
 
@@ -19,6 +28,9 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic) XLProficiencyLevel proficiencyLevel;
 @property (nonatomic) double wordDensity; // 0.0 - 1.0
 @property (nonatomic, retain) NSArray *excludeWords;
+/// Learned and known words of the language pair (see -[XLStorageService knownWordSetForLanguagePair:]);
+/// never replaced, like excludeWords. Must not be added to while an engine uses it.
+@property (nonatomic, retain, nullable) XLKnownWordSet *knownWords;
 
 + (instancetype)optionsWithLanguagePair:(XLLanguagePair *)languagePair
                        proficiencyLevel:(XLProficiencyLevel)proficiencyLevel
@@ -31,6 +43,16 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (instancetype)initWithOptions:(XLTranslationOptions *)options;
 
+/// Where cache misses are translated; defaults to [XLTranslationService sharedService] (benchmarks inject a stub)
+@property (nonatomic, retain) id<XLTranslationService> translationService;
+
+/// Executor class for the replacement pass that runs once translations are in (default XLWorkPriorityVisible)
+@property (nonatomic) XLWorkPriority priority;
+
+/// Word-cache lookups served locally vs. sent to the translation service (for benchmarks/diagnostics)
+@property (nonatomic, readonly) NSUInteger cacheHits;
+@property (nonatomic, readonly) NSUInteger cacheMisses;
+
 /// Process chapter content and replace words based on proficiency level
 - (void)processChapter:(XLChapter *)chapter
         withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion;
@@ -39,6 +61,15 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)processContent:(NSString *)content
         withCompletion:(void(^)(NSString *processedContent, NSArray *foreignWords, NSError *error))completion;
 
+/// Same, abandoned once token is cancelled: tokenizing stops, translations not yet sent are never sent and
+/// those in flight are aborted, and completion gets XLTranslationEngineErrorCancelled instead of a result.
+- (void)processChapter:(XLChapter *)chapter
+     cancellationToken:(nullable XLCancellationToken *)token
+        withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion;
+- (void)processContent:(NSString *)content
+     cancellationToken:(nullable XLCancellationToken *)token
+        withCompletion:(void(^)(NSString * _Nullable processedContent, NSArray * _Nullable foreignWords, NSError * _Nullable error))completion;
+
 @end
 
 NS_ASSUME_NONNULL_END
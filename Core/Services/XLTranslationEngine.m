@@ -5,11 +5,27 @@
 
 #import "XLTranslationEngine.h"
 #import "XLTranslationService.h"
+#import "../Native/XLMetrics.h"
+#import "../Native/XLTrace.h"
+
+NSString *const XLTranslationEngineErrorDomain = @"XLTranslationEngine";
+
+/* Tokens and replacements handled between cancellation checks */
+static const NSUInteger kCancellationCheckInterval = 1024;
+
+static NSError *XLTranslationEngineCancelledError(void) {
+    XLMetricAdd(XL_COUNTER("translation.chapter.cancelled"), 1);
+    return [NSError errorWithDomain:XLTranslationEngineErrorDomain code:XLTranslationEngineErrorCancelled
+                           userInfo:@{ NSLocalizedDescriptionKey: @"Chapter processing cancelled" }];
+}
 
 @interface XLTranslationEngine ()
 
 @property (nonatomic, strong) XLTranslationOptions *options;
 @property (nonatomic, strong) NSMutableDictionary<NSString *, XLWordEntry *> *wordCache;
+@property (nonatomic, readwrite) NSUInteger cacheHits;
+@property (nonatomic, readwrite) NSUInteger cacheMisses;
+@property (nonatomic, retain) XLKnownWordSet *exclusions;
 
 @end
 
@@ -18,15 +34,30 @@
 - (instancetype)initWithOptions:(XLTranslationOptions *)options {
     self = [super init];
     if (self) {
-        _options = options;
+        _options = [options retain];
         _wordCache = [[NSMutableDictionary alloc] init];
+        _translationService = [[XLTranslationService sharedService] retain];
     }
     return self;
 }
 
+- (void)dealloc {
+    [_options release];
+    [_wordCache release];
+    [_translationService release];
+    [_exclusions release];
+    [super dealloc];
+}
+
+- (void)processChapter:(XLChapter *)chapter
+        withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion {
+    [self processChapter:chapter cancellationToken:nil withCompletion:completion];
+}
+
 - (void)processChapter:(XLChapter *)chapter
+     cancellationToken:(XLCancellationToken *)token
         withCompletion:(void(^)(XLProcessedChapter * _Nullable processedChapter, NSError * _Nullable error))completion {
-    [self processContent:chapter.content withCompletion:^(NSString * _Nullable processedContent, NSArray<XLForeignWordData *> * _Nullable foreignWords, NSError * _Nullable error) {
+    [self processContent:chapter.content cancellationToken:token withCompletion:^(NSString * _Nullable processedContent, NSArray<XLForeignWordData *> * _Nullable foreignWords, NSError * _Nullable error) {
         if (error) {
             if (completion) completion(nil, error);
             return;
@@ -36,81 +67,124 @@
         processedChapter.chapterId = chapter.chapterId;
         processedChapter.title = chapter.title;
         processedChapter.index = chapter.index;
-        processedChapter.content = chapter.content;
+        processedChapter.contentText = chapter.contentText;
         processedChapter.wordCount = chapter.wordCount;
         processedChapter.href = chapter.href;
         processedChapter.processedContent = processedContent ? processedContent : @"";
-        processedChapter.foreignWords = foreignWords ? foreignWords : [[NSArray alloc] init];
+        processedChapter.foreignWords = foreignWords ? foreignWords : [NSArray array];
+        // Build the lookup table here, off the main thread, so the reader can use it immediately
+        [processedChapter foreignWordSpans];
         
         if (completion) {
             completion(processedChapter, nil);
         }
+        [processedChapter release];
     }];
 }
 
 - (void)processContent:(NSString *)content
         withCompletion:(void(^)(NSString * _Nullable processedContent, NSArray<XLForeignWordData *> * _Nullable foreignWords, NSError * _Nullable error))completion {
+    [self processContent:content cancellationToken:nil withCompletion:completion];
+}
+
+- (void)processContent:(NSString *)content
+     cancellationToken:(XLCancellationToken *)token
+        withCompletion:(void(^)(NSString * _Nullable processedContent, NSArray<XLForeignWordData *> * _Nullable foreignWords, NSError * _Nullable error))completion {
+    uint64_t processStart = XLTraceNow();
     // Tokenize text
-    NSArray<NSString *> *words = [self tokenizeText:content];
+    NSArray<NSString *> *words = [self tokenizeText:content cancellationToken:token];
     
     // Select words to replace based on proficiency and density
-    NSArray<NSString *> *wordsToReplace = [self selectWordsToReplace:words];
+    NSArray<NSString *> *wordsToReplace = words ? [self selectWordsToReplace:words] : nil;
+    if (!wordsToReplace || [token isCancelled]) {
+        if (completion) completion(nil, nil, XLTranslationEngineCancelledError());
+        return;
+    }
     
-    // Process replacements
-    NSMutableString *processedContent = [content mutableCopy];
-    NSMutableArray<XLForeignWordData *> *foreignWords = [NSMutableArray array];
-    NSInteger offset = 0;
+    // Request each distinct word once; XLTranslationService bounds how many go out at a time
+    NSMutableArray<NSString *> *distinctWords = [NSMutableArray array];
+    NSMutableSet<NSString *> *seen = [NSMutableSet set];
+    for (NSString *word in wordsToReplace) {
+        if (![seen containsObject:word]) {
+            [seen addObject:word];
+            [distinctWords addObject:word];
+        }
+    }
     
+    NSMutableDictionary<NSString *, XLWordEntry *> *entries = [NSMutableDictionary dictionary];
+    uint64_t translateStart = XLTraceIsEnabled() ? XLTraceNow() : 0;
     dispatch_group_t group = dispatch_group_create();
-    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
     
-    NSEnumerator *wordEnumerator = [wordsToReplace objectEnumerator];
-    NSString *word;
-    while ((word = [wordEnumerator nextObject])) {
+    for (NSString *word in distinctWords) {
+        // Requests of a superseded chapter stop here; those already queued are dropped by the service
+        if ([token isCancelled]) break;
         dispatch_group_enter(group);
-        
-        [self getTranslationForWord:word completion:^(XLWordEntry * _Nullable entry, NSError * _Nullable error) {
+        [self getTranslationForWord:word cancellationToken:token completion:^(XLWordEntry * _Nullable entry, NSError * _Nullable error) {
             if (entry && !error) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    NSRange range = [processedContent rangeOfString:word
-                                                            options:NSCaseInsensitiveSearch
-                                                              range:NSMakeRange(offset, processedContent.length - offset)];
-                    if (range.location != NSNotFound) {
-                        // Replace word
-                        [processedContent replaceCharactersInRange:range withString:entry.targetWord];
-                        
-                        // Create foreign word data
-                        XLForeignWordData *data = [XLForeignWordData dataWithOriginalWord:word
-                                                                              foreignWord:entry.targetWord
-                                                                               startIndex:range.location
-                                                                                 endIndex:range.location + entry.targetWord.length
-                                                                                wordEntry:entry];
-                        [foreignWords addObject:data];
-                        
-                        offset = range.location + entry.targetWord.length;
-                    }
-                });
+                @synchronized (entries) {
+                    entries[word] = entry;
+                }
             }
             dispatch_group_leave(group);
         }];
     }
     
-    dispatch_group_notify(group, queue, ^{
+    // Replace in reading order once every answer is in, so offsets stay consistent
+    [[XLExecutor sharedExecutor] submitAfterDispatchGroup:group priority:self.priority group:nil block:^{
+        XLTraceRecordAsync("engine.translate", "engine", translateStart);
+        XL_TRACE_SCOPE("engine.replace", "engine");
+        if ([token isCancelled]) {
+            if (completion) completion(nil, nil, XLTranslationEngineCancelledError());
+            return;
+        }
+        NSMutableString *processedContent = [content mutableCopy];
+        NSMutableArray<XLForeignWordData *> *foreignWords = [NSMutableArray array];
+        NSUInteger offset = 0;
+        NSUInteger replaced = 0;
+        for (NSString *word in wordsToReplace) {
+            if (++replaced % kCancellationCheckInterval == 0 && [token isCancelled]) {
+                [processedContent release];
+                if (completion) completion(nil, nil, XLTranslationEngineCancelledError());
+                return;
+            }
+            XLWordEntry *entry = entries[word];
+            if (!entry) continue;
+            NSRange range = [processedContent rangeOfString:word
+                                                    options:NSCaseInsensitiveSearch
+                                                      range:NSMakeRange(offset, processedContent.length - offset)];
+            if (range.location == NSNotFound) continue;
+            [processedContent replaceCharactersInRange:range withString:entry.targetWord];
+            XLForeignWordData *data = [XLForeignWordData dataWithOriginalWord:word
+                                                                  foreignWord:entry.targetWord
+                                                                   startIndex:range.location
+                                                                     endIndex:range.location + entry.targetWord.length
+                                                                    wordEntry:entry];
+            [foreignWords addObject:data];
+            offset = range.location + entry.targetWord.length;
+        }
+        XLMetricRecordSince(XL_HISTOGRAM("translation.chapter"), processStart);
+        XLMetricAdd(XL_COUNTER("translation.words.replaced"), (int64_t)[foreignWords count]);
         if (completion) {
-            completion([processedContent copy], [foreignWords copy], nil);
+            completion([[processedContent copy] autorelease], [[foreignWords copy] autorelease], nil);
         }
-    });
+        [processedContent release];
+    }];
+    dispatch_release(group);
 }
 
 #pragma mark - Private Methods
 
-- (NSArray<NSString *> *)tokenizeText:(NSString *)text {
+/// nil once token is cancelled
+- (NSArray<NSString *> *)tokenizeText:(NSString *)text cancellationToken:(XLCancellationToken *)token {
+    XL_TRACE_SCOPE("engine.tokenize", "engine");
     // Simple tokenization - split by whitespace and punctuation
     NSCharacterSet *wordBoundarySet = [NSCharacterSet characterSetWithCharactersInString:@" \t\n\r.,!?;:()[]{}\"'-"];
     NSArray<NSString *> *components = [text componentsSeparatedByCharactersInSet:wordBoundarySet];
     
     NSMutableArray<NSString *> *words = [NSMutableArray array];
+    NSUInteger scanned = 0;
     for (NSString *component in components) {
+        if (++scanned % kCancellationCheckInterval == 0 && [token isCancelled]) return nil;
         NSString *trimmed = [component stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
         if ([trimmed length] > 0 && [trimmed length] >= 2 && [trimmed length] <= 25) {
             [words addObject:[trimmed lowercaseString]];
@@ -121,6 +195,7 @@
 }
 
 - (NSArray *)selectWordsToReplace:(NSArray *)words {
+    XL_TRACE_SCOPE("engine.select", "engine");
     // Filter by frequency rank based on proficiency level
     NSInteger minRank, maxRank;
     switch (self.options.proficiencyLevel) {
@@ -141,13 +216,14 @@
     // Select words based on density
     NSInteger targetCount = (NSInteger)([words count] * self.options.wordDensity);
     NSMutableArray<NSString *> *selected = [NSMutableArray array];
+    XLKnownWordSet *exclusions = [self exclusionSet];
     
     // Simple selection: take first N words that meet criteria
     for (NSString *word in words) {
         if (selected.count >= targetCount) break;
         
-        // Skip excluded words
-        if ([self.options.excludeWords containsObject:word]) {
+        // Skip known and excluded words
+        if ([exclusions containsWord:word]) {
             continue;
         }
         
@@ -158,7 +234,27 @@
     return selected;
 }
 
+/// Known words plus excludeWords in one set, built on first use (options are fixed by then)
+- (XLKnownWordSet *)exclusionSet {
+    @synchronized (self) {
+        if (!self.exclusions) {
+            NSArray *excludeWords = self.options.excludeWords;
+            XLKnownWordSet *known = self.options.knownWords;
+            if ([excludeWords count] == 0 && known) {
+                self.exclusions = known;
+            } else {
+                XLKnownWordSet *set = known ? [known copy] : [[XLKnownWordSet alloc] initWithCapacity:[excludeWords count]];
+                [set addWords:excludeWords];
+                self.exclusions = set;
+                [set release];
+            }
+        }
+        return self.exclusions;
+    }
+}
+
 - (void)getTranslationForWord:(NSString *)word
+             cancellationToken:(XLCancellationToken *)token
                     completion:(void(^)(XLWordEntry *entry, NSError *error))completion {
     // Check cache first
     NSString *cacheKey = [NSString stringWithFormat:@"%@_%ld_%ld",
@@ -166,18 +262,23 @@
                          (long)self.options.languagePair.sourceLanguage,
                          (long)self.options.languagePair.targetLanguage];
     
-    XLWordEntry *cached = [self.wordCache objectForKey:cacheKey];
+    XLWordEntry *cached = nil;
+    @synchronized (self.wordCache) {
+        cached = [self.wordCache objectForKey:cacheKey];
+        if (cached) {
+            _cacheHits++;
+        } else {
+            _cacheMisses++;
+        }
+    }
+    XLMetricAdd(cached ? XL_COUNTER("translation.cache.hit") : XL_COUNTER("translation.cache.miss"), 1);
     if (cached) {
         if (completion) completion(cached, nil);
         return;
     }
     
     // Get translation from service
-    XLTranslationService *translationService = [XLTranslationService sharedService];
-    [translationService translateWord:word
-                            fromLanguage:self.options.languagePair.sourceLanguage
-                              toLanguage:self.options.languagePair.targetLanguage
-                          withCompletion:^(NSString * _Nullable translatedWord, NSError * _Nullable error) {
+    void (^translated)(NSString *, NSError *) = ^(NSString * _Nullable translatedWord, NSError * _Nullable error) {
         if (error || !translatedWord) {
             if (completion) completion(nil, error);
             return;
@@ -191,10 +292,25 @@
         entry.proficiencyLevel = self.options.proficiencyLevel;
         
         // Cache it
-        self.wordCache[cacheKey] = entry;
+        @synchronized (self.wordCache) {
+            self.wordCache[cacheKey] = entry;
+        }
         
         if (completion) completion(entry, nil);
-    }];
+    };
+    id<XLTranslationService> service = self.translationService;
+    if (token && [service respondsToSelector:@selector(translateWord:fromLanguage:toLanguage:cancellationToken:withCompletion:)]) {
+        [service translateWord:word
+                  fromLanguage:self.options.languagePair.sourceLanguage
+                    toLanguage:self.options.languagePair.targetLanguage
+             cancellationToken:token
+                withCompletion:translated];
+    } else {
+        [service translateWord:word
+                  fromLanguage:self.options.languagePair.sourceLanguage
+                    toLanguage:self.options.languagePair.targetLanguage
+                withCompletion:translated];
+    }
 }
 
 @end
@@ -204,11 +320,10 @@
 + (instancetype)optionsWithLanguagePair:(XLLanguagePair *)languagePair
                        proficiencyLevel:(XLProficiencyLevel)proficiencyLevel
                            wordDensity:(double)wordDensity {
-    XLTranslationOptions *options = [[XLTranslationOptions alloc] init];
+    XLTranslationOptions *options = [[[XLTranslationOptions alloc] init] autorelease];
     options.languagePair = languagePair;
     options.proficiencyLevel = proficiencyLevel;
     options.wordDensity = wordDensity;
-        options.excludeWords = [[NSArray alloc] init];
     return options;
 }
 
@@ -218,9 +333,15 @@
         _languagePair = [XLLanguagePair pairWithSource:XLLanguageEnglish target:XLLanguageFrench];
         _proficiencyLevel = XLProficiencyLevelBeginner;
         _wordDensity = 0.3;
-        _excludeWords = @[];
+        _excludeWords = [[NSArray alloc] init];
     }
     return self;
 }
 
+- (void)dealloc {
+    [_excludeWords release];
+    [_knownWords release];
+    [super dealloc];
+}
+
 @end
@@ -7,6 +7,8 @@
 #import <Foundation/Foundation.h>
 #import "../Models/Language.h"
 
+@class XLCancellationToken;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /// Translation service protocol
@@ -28,6 +30,15 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)pronounceWord:(NSString *)word
             inLanguage:(XLLanguage)language;
 
+@optional
+
+/// Translate a single word; once token is cancelled the request is dropped (or aborted) and completes with an error
+- (void)translateWord:(NSString *)word
+         fromLanguage:(XLLanguage)sourceLanguage
+           toLanguage:(XLLanguage)targetLanguage
+    cancellationToken:(nullable XLCancellationToken *)token
+       withCompletion:(void(^)(NSString * _Nullable translatedWord, NSError * _Nullable error))completion;
+
 @end
 
 /// Backend for translation: Microsoft (legacy) or LibreTranslate (FOSS).
@@ -45,6 +56,9 @@ typedef NS_ENUM(NSInteger, XLTranslationBackend) {
 @property (nonatomic, assign) XLTranslationBackend translationBackend;
 /// Base URL for LibreTranslate (e.g. https://libretranslate.com). Used when translationBackend is LibreTranslate.
 @property (nonatomic, copy) NSString *libretranslateBaseURL;
+/// All LibreTranslate endpoints to spread requests over (load-aware, hedged, with circuit breakers).
+/// Defaults to just libretranslateBaseURL; setting libretranslateBaseURL resets it to that one URL.
+@property (nonatomic, copy) NSArray<NSString *> *libretranslateBaseURLs;
 
 @end
 
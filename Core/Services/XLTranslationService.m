@@ -4,16 +4,23 @@
 //
 
 #import "XLTranslationService.h"
-#import "XLLibreTranslateClient.h"
+#import "XLTranslationEndpointPool.h"
+#import "XLCancellationToken.h"
 #import "../../TranslationService.h" // Legacy Microsoft
 
+@interface XLTranslationService ()
+@property (nonatomic, retain) XLTranslationEndpointPool *endpointPool;
+- (XLTranslationEndpointPool *)currentEndpointPool;
+@end
+
 @implementation XLTranslationService
 
 + (instancetype)sharedService {
     static XLTranslationService *sharedService = nil;
-    if (sharedService == nil) {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
         sharedService = [[self alloc] init];
-    }
+    });
     return sharedService;
 }
 
@@ -26,20 +33,65 @@
     return self;
 }
 
+- (void)setLibretranslateBaseURL:(NSString *)libretranslateBaseURL {
+    @synchronized (self) {
+        if (_libretranslateBaseURL != libretranslateBaseURL) {
+            [_libretranslateBaseURL release];
+            _libretranslateBaseURL = [libretranslateBaseURL copy];
+        }
+        [_libretranslateBaseURLs release];
+        _libretranslateBaseURLs = nil;
+    }
+}
+
+- (NSArray<NSString *> *)libretranslateBaseURLs {
+    @synchronized (self) {
+        if ([_libretranslateBaseURLs count] > 0) {
+            return [[_libretranslateBaseURLs retain] autorelease];
+        }
+        return @[ _libretranslateBaseURL ?: @"https://libretranslate.com" ];
+    }
+}
+
+/// Pool for the configured endpoints; rebuilt only when the URL list changes so limits and latency history persist
+- (XLTranslationEndpointPool *)currentEndpointPool {
+    NSArray *urls = [self libretranslateBaseURLs];
+    @synchronized (self) {
+        if (!self.endpointPool || ![[self.endpointPool baseURLs] isEqualToArray:urls]) {
+            XLTranslationEndpointPool *pool = [[XLTranslationEndpointPool alloc] initWithBaseURLs:urls];
+            self.endpointPool = pool;
+            [pool release];
+        }
+        return [[self.endpointPool retain] autorelease];
+    }
+}
+
+- (void)translateWord:(NSString *)word
+         fromLanguage:(XLLanguage)sourceLanguage
+           toLanguage:(XLLanguage)targetLanguage
+       withCompletion:(void(^)(NSString *translatedWord, NSError *error))completion {
+    [self translateWord:word fromLanguage:sourceLanguage toLanguage:targetLanguage cancellationToken:nil withCompletion:completion];
+}
+
 - (void)translateWord:(NSString *)word
          fromLanguage:(XLLanguage)sourceLanguage
            toLanguage:(XLLanguage)targetLanguage
+    cancellationToken:(XLCancellationToken *)token
        withCompletion:(void(^)(NSString *translatedWord, NSError *error))completion {
     NSString *sourceCode = [XLLanguageInfo codeStringForLanguage:sourceLanguage];
     NSString *targetCode = [XLLanguageInfo codeStringForLanguage:targetLanguage];
     
     if (self.translationBackend == XLTranslationBackendLibreTranslate) {
-        NSString *base = self.libretranslateBaseURL ?: @"https://libretranslate.com";
-        [XLLibreTranslateClient translateText:word fromLanguage:sourceCode toLanguage:targetCode baseURL:base completion:^(NSString *translatedText, NSError *error) {
+        [[self currentEndpointPool] translateText:word fromLanguage:sourceCode toLanguage:targetCode cancellationToken:token completion:^(NSString *translatedText, NSError *error) {
             if (completion) completion(translatedText, error);
         }];
         return;
     }
+    // The legacy translator cannot abort a request, only avoid starting one
+    if ([token isCancelled]) {
+        if (completion) completion(nil, [NSError errorWithDomain:@"XLTranslationService" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"Translation cancelled" }]);
+        return;
+    }
     TranslationService *legacyService = [TranslationService sharedTranslator];
     [legacyService doTranslateWord:word from:sourceCode to:targetCode withCompletion:^(NSString *translatedText) {
         if (completion) completion(translatedText, nil);
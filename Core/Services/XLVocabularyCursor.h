@@ -0,0 +1,48 @@
+//
+//  XLVocabularyCursor.h
+//  Xenolexia
+//
+//  Forward-only cursor over vocabulary rows on its own SQLite connection
+
+#import <Foundation/Foundation.h>
+
+@class XLStorageService;
+@class FMDatabase;
+@class FMResultSet;
+
+/// Enumerates XLVocabularyItem rows one at a time (added_at DESC, id DESC) without materialising the result.
+/// The connection is opened lazily on first use, so a cursor can be created on one thread and drained on another;
+/// it must then stay on that thread. Count and rows come from the same read transaction.
+@interface XLVocabularyCursor : NSEnumerator {
+    XLStorageService *_storage;
+    NSString *_databasePath;
+    NSString *_whereClause;
+    NSArray *_arguments;
+    FMDatabase *_database;
+    FMResultSet *_resultSet;
+    NSUInteger _count;
+    NSUInteger _position;
+    BOOL _opened;
+    BOOL _closed;
+}
+
+- (instancetype)initWithStorage:(XLStorageService *)storage
+                   databasePath:(NSString *)databasePath
+                    whereClause:(NSString *)whereClause
+                      arguments:(NSArray *)arguments;
+
+/// Open the connection and run COUNT + SELECT. Called implicitly by -count and -nextObject.
+- (BOOL)open:(NSError **)error;
+
+/// Number of matching rows when the cursor was opened (for progress)
+- (NSUInteger)count;
+/// Rows returned so far
+- (NSUInteger)position;
+
+/// Next XLVocabularyItem (autoreleased), or nil when exhausted or on error
+- (id)nextObject;
+
+/// End the read transaction and close the connection. Safe to call more than once.
+- (void)close;
+
+@end
@@ -0,0 +1,117 @@
+//
+//  XLVocabularyCursor.m
+//  Xenolexia
+//
+
+#import <sqlite3.h>
+#import "XLVocabularyCursor.h"
+#import "XLStorageService.h"
+#import "FMDatabase.h"
+#import "FMResultSet.h"
+
+/* Row mapping shared with XLStorageService so cursor rows match paged rows */
+@interface XLStorageService (XLVocabularyCursorRows)
+- (XLVocabularyItem *)vocabularyItemFromResultSet:(FMResultSet *)rs;
+@end
+
+@implementation XLVocabularyCursor
+
+- (instancetype)initWithStorage:(XLStorageService *)storage
+                   databasePath:(NSString *)databasePath
+                    whereClause:(NSString *)whereClause
+                      arguments:(NSArray *)arguments {
+    self = [super init];
+    if (self) {
+        _storage = [storage retain];
+        _databasePath = [databasePath copy];
+        _whereClause = [whereClause copy];
+        _arguments = [arguments copy];
+        _database = nil;
+        _resultSet = nil;
+        _count = 0;
+        _position = 0;
+        _opened = NO;
+        _closed = NO;
+    }
+    return self;
+}
+
+- (BOOL)open:(NSError **)error {
+    if (_opened) return !_closed;
+    _opened = YES;
+    _database = [[FMDatabase alloc] initWithPath:_databasePath];
+    if (![_database openWithFlags:SQLITE_OPEN_READONLY]) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"XLStorageService" code:[_database lastErrorCode]
+                                     userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: @"Failed to open database" }];
+        }
+        [self close];
+        return NO;
+    }
+    [_database setMaxBusyRetryTimeInterval:2.0];
+    /* One snapshot for both statements; WAL keeps the main connection writable meanwhile */
+    [_database beginDeferredTransaction];
+    NSString *where = [_whereClause length] > 0 ? [NSString stringWithFormat:@" WHERE %@", _whereClause] : @"";
+    FMResultSet *countRs = [_database executeQuery:[NSString stringWithFormat:@"SELECT COUNT(*) FROM vocabulary%@", where] withArgumentsInArray:_arguments];
+    if ([countRs next]) {
+        _count = (NSUInteger)[countRs longLongIntForColumnIndex:0];
+    }
+    [countRs close];
+    NSString *sql = [NSString stringWithFormat:@"SELECT id, source_word, target_word, source_lang, target_lang, context_sentence, book_id, book_title, added_at, last_reviewed_at, review_count, ease_factor, interval, status FROM vocabulary%@ ORDER BY added_at DESC, id DESC", where];
+    _resultSet = [[_database executeQuery:sql withArgumentsInArray:_arguments] retain];
+    if (!_resultSet) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"XLStorageService" code:[_database lastErrorCode]
+                                     userInfo:@{ NSLocalizedDescriptionKey: [_database lastErrorMessage] ?: @"Query failed" }];
+        }
+        [self close];
+        return NO;
+    }
+    return YES;
+}
+
+- (NSUInteger)count {
+    [self open:NULL];
+    return _count;
+}
+
+- (NSUInteger)position {
+    return _position;
+}
+
+- (id)nextObject {
+    if (![self open:NULL] || !_resultSet) return nil;
+    if (![_resultSet next]) {
+        [self close];
+        return nil;
+    }
+    _position++;
+    return [[_storage vocabularyItemFromResultSet:_resultSet] autorelease];
+}
+
+- (void)close {
+    if (_closed) return;
+    _closed = YES;
+    [_resultSet close];
+    [_resultSet release];
+    _resultSet = nil;
+    if (_database) {
+        if ([_database inTransaction]) {
+            [_database commit];
+        }
+        [_database close];
+        [_database release];
+        _database = nil;
+    }
+}
+
+- (void)dealloc {
+    [self close];
+    [_storage release];
+    [_databasePath release];
+    [_whereClause release];
+    [_arguments release];
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,32 @@
+//
+//  XLManagerStub.m
+//  Xenolexia Core Tests
+//
+//  Link-time stand-in for XLManager, which XLDownloadManager hands finished downloads to. Records the
+//  imported paths instead of parsing, so the download test can check that a completed item was imported.
+//
+
+#import "XLManager.h"
+
+NSMutableArray *XLManagerStubImportedPaths = nil;
+
+@implementation XLManager
+
++ (instancetype)sharedManager {
+    static XLManager *sharedManager = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedManager = [[self alloc] init];
+        XLManagerStubImportedPaths = [[NSMutableArray alloc] init];
+    });
+    return sharedManager;
+}
+
+- (void)importBookAtPath:(NSString *)filePath withCompletion:(void(^)(XLBook *book, NSError *error))completion {
+    @synchronized (XLManagerStubImportedPaths) {
+        [XLManagerStubImportedPaths addObject:filePath];
+    }
+    if (completion) completion(nil, nil);
+}
+
+@end
@@ -2,13 +2,33 @@
 //  main.m
 //  Xenolexia Core Tests
 //
-//  Tests native ObjC SM-2 (XLSm2). No xenolexia-shared-c required.
+//  Tests native ObjC SM-2 (XLSm2, XLSm2Batch, XLReviewForecast), the reader's span table, chapter text and the extracted-text file, known-word set, SHA-256, the reading-streak rollup and the download-to-import
+//  path (against a local HTTP server, with XLManagerStub standing in for the import pipeline). No xenolexia-shared-c required.
 //
 
 #import <Foundation/Foundation.h>
 #import "../Native/XLSm2.h"
+#import "../Native/XLSm2Batch.h"
+#import "../Native/XLReviewForecast.h"
+#import "../Native/XLSpanTable.h"
+#import "../Native/XLChapterText.h"
+#import "../Native/XLKnownWordSet.h"
+#import "../Native/XLSha256.h"
+#import "../Models/Book.h"
+#import "../Services/XLBookTextFile.h"
+#import "../Services/XLStorageService.h"
+#import "../Services/XLManager.h"
+#import "DownloadService.h"
+#import <sqlite3.h>
+#import <pthread.h>
+#import <poll.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <sys/socket.h>
 #import <stdio.h>
 #import <stdlib.h>
+#import <string.h>
+#import <unistd.h>
 
 static int test_sm2_step(void) {
     XLSm2State *state = [[[XLSm2State alloc] init] autorelease];
@@ -36,16 +56,417 @@ static int test_sm2_step(void) {
     return 0;
 }
 
+/// The batch kernel must match XLSm2Step exactly, including rows it is told to skip
+static int test_sm2_batch(void) {
+    enum { kRows = 64, kRounds = 8 };
+    double easeFactor[kRows], interval[kRows];
+    int64_t reviewCount[kRows], status[kRows];
+    int32_t quality[kRows];
+    NSMutableArray *states = [NSMutableArray arrayWithCapacity:kRows];
+    for (NSInteger i = 0; i < kRows; i++) {
+        XLSm2State *state = [[[XLSm2State alloc] init] autorelease];
+        state.easeFactor = 1.3 + (i % 13) * 0.1;
+        state.interval = (i % 5 == 0) ? i % 2 : i * 3;
+        state.reviewCount = i % 7;
+        state.status = (XLSm2Status)(i % 4);
+        [states addObject:state];
+        easeFactor[i] = state.easeFactor;
+        interval[i] = (double)state.interval;
+        reviewCount[i] = state.reviewCount;
+        status[i] = state.status;
+    }
+    for (NSInteger round = 0; round < kRounds; round++) {
+        for (NSInteger i = 0; i < kRows; i++) {
+            quality[i] = (int32_t)((i * 7 + round * 3) % 7) - 1;
+        }
+        XLSm2Columns columns = { easeFactor, interval, reviewCount, status };
+        XLSm2StepBatch(quality, columns, kRows);
+        for (NSInteger i = 0; i < kRows; i++) {
+            XLSm2State *state = [states objectAtIndex:i];
+            if (quality[i] >= 0) XLSm2Step(quality[i], state);
+            if (easeFactor[i] != state.easeFactor || interval[i] != (double)state.interval
+                || reviewCount[i] != state.reviewCount || status[i] != state.status) {
+                fprintf(stderr, "SM-2 batch row %ld round %ld differs: ease %.17g/%.17g interval %.0f/%ld\n",
+                        (long)i, (long)round, easeFactor[i], state.easeFactor, interval[i], (long)state.interval);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/// A new card always graded 5 is reviewed on days 0, 1, 7, 23 and 68 and becomes learned at the fifth review
+static int test_review_forecast(void) {
+    double easeFactor = 2.5, interval = 0;
+    int64_t reviewCount = 0, status = XLSm2StatusNew;
+    int32_t dueDay = 0;
+    XLSm2Columns cards = { &easeFactor, &interval, &reviewCount, &status };
+    XLReviewForecastOptions options = XLReviewForecastDefaultOptions();
+    options.days = 90;
+    for (int q = 0; q < 6; q++) options.gradeWeights[q] = q == 5 ? 1 : 0;
+    double due[90], learned[90];
+    XLReviewForecastRun(cards, &dueDay, 1, &options, due, learned);
+    double totalDue = 0, totalLearned = 0;
+    for (int day = 0; day < 90; day++) {
+        totalDue += due[day];
+        totalLearned += learned[day];
+    }
+    if (due[0] != 1 || due[1] != 1 || due[7] != 1 || due[23] != 1 || due[68] != 1 || totalDue != 5
+        || learned[68] != 1 || totalLearned != 1 || interval != 0 || reviewCount != 0) {
+        fprintf(stderr, "Review forecast failed: %.0f due, %.0f learned\n", totalDue, totalLearned);
+        return 1;
+    }
+    return 0;
+}
+
+static int test_span_table(void) {
+    XLSpanTable *table = [[[XLSpanTable alloc] initWithCapacity:2] autorelease];
+    /* Added out of order, one overlap and one empty span: both must be dropped */
+    [table addSpanFrom:20 to:25 entryIndex:2];
+    [table addSpanFrom:0 to:5 entryIndex:0];
+    [table addSpanFrom:5 to:9 entryIndex:1];
+    [table addSpanFrom:22 to:30 entryIndex:3];
+    [table addSpanFrom:40 to:40 entryIndex:4];
+    [table sort];
+    if ([[XLSpanTable alloc] initWithCapacity:NSUIntegerMax / sizeof(XLSpan)] != nil) {
+        fprintf(stderr, "Span table allocation failure not reported\n");
+        return 1;
+    }
+    if ([table count] != 3) {
+        fprintf(stderr, "Span table count failed: %lu\n", (unsigned long)[table count]);
+        return 1;
+    }
+    if ([table indexOfSpanContainingLocation:6] != 1 || [table spanAtIndex:1].entryIndex != 1
+        || [table indexOfSpanContainingLocation:9] != NSNotFound || [table indexOfSpanContainingLocation:24] != 2
+        || [table indexOfSpanContainingLocation:100] != NSNotFound) {
+        fprintf(stderr, "Span table lookup failed\n");
+        return 1;
+    }
+    NSRange inside = [table spanIndexesInRange:NSMakeRange(3, 20)];
+    if (inside.location != 1 || inside.length != 1) {
+        fprintf(stderr, "Span table range failed: %lu+%lu\n", (unsigned long)inside.location, (unsigned long)inside.length);
+        return 1;
+    }
+    __block NSUInteger runs = 0;
+    __block NSRange firstRun = NSMakeRange(NSNotFound, 0);
+    [table enumerateRunsInRange:NSMakeRange(0, 30) usingBlock:^(NSRange run) {
+        if (runs++ == 0) firstRun = run;
+    }];
+    if (runs != 2 || firstRun.location != 0 || firstRun.length != 9) {
+        fprintf(stderr, "Span table runs failed: %lu runs\n", (unsigned long)runs);
+        return 1;
+    }
+    return 0;
+}
+
+static int test_chapter_text(void) {
+    NSString *source = @"Chapitre un \u00e9t\u00e9";
+    XLChapterText *text = [XLChapterText textWithString:source];
+    if ([text UTF8Length] != strlen([source UTF8String]) || ![[text string] isEqualToString:source]) {
+        fprintf(stderr, "Chapter text round trip failed\n");
+        return 1;
+    }
+    /* A slice of shared storage, as chapters mapped from a book's text file are */
+    NSData *storage = [@"titleBody \u00e9" dataUsingEncoding:NSUTF8StringEncoding];
+    XLChapterText *slice = [[[XLChapterText alloc] initWithStorage:storage range:NSMakeRange(5, [storage length] - 5)] autorelease];
+    XLChapterText *outside = [[[XLChapterText alloc] initWithStorage:storage range:NSMakeRange(5, 100)] autorelease];
+    if (![[slice string] isEqualToString:@"Body \u00e9"] || ![outside isEmpty] || ![[XLChapterText textWithString:nil] isEmpty]) {
+        fprintf(stderr, "Chapter text slice failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int test_known_word_set(void) {
+    XLKnownWordSet *set = [[[XLKnownWordSet alloc] init] autorelease];
+    [set addWord:@"Maison"];
+    [set addWord:@"maison"];
+    [set addWord:@""];
+    /* Past the initial capacity, so the table and filter are rebuilt */
+    for (int i = 0; i < 1000; i++) {
+        [set addWord:[NSString stringWithFormat:@"word%d", i]];
+    }
+    if ([set count] != 1001 || ![set containsWord:@"maison"] || ![set containsWord:@"word999"]
+        || [set containsWord:@"word1000"] || [set containsWord:@"mais"]) {
+        fprintf(stderr, "Known-word set membership failed: %lu words\n", (unsigned long)[set count]);
+        return 1;
+    }
+    XLKnownWordSet *copy = [[set copy] autorelease];
+    [copy addWord:@"copied"];
+    if ([set containsWord:@"copied"] || ![copy containsWord:@"copied"] || ![copy containsWord:@"word0"]) {
+        fprintf(stderr, "Known-word set copy failed\n");
+        return 1;
+    }
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"xenolexia-coretests.xlkw"];
+    int64_t stamp = 0;
+    XLKnownWordSet *loaded = [set writeToFile:path stamp:42 error:NULL]
+        ? [XLKnownWordSet setWithContentsOfFile:path stamp:&stamp error:NULL] : nil;
+    if (!loaded || stamp != 42 || [loaded count] != [set count] || ![loaded containsWord:@"word500"] || [loaded containsWord:@"copied"]) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        fprintf(stderr, "Known-word set snapshot failed\n");
+        return 1;
+    }
+    /* Extending the snapshot in place; the copy is a word ahead of the file, so it must not append */
+    BOOL mismatched = [copy addWord:@"other" appendingToFile:path stamp:44 error:NULL];
+    BOOL appended = [set addWord:@"Appended" appendingToFile:path stamp:43 error:NULL];
+    XLKnownWordSet *extended = [XLKnownWordSet setWithContentsOfFile:path stamp:&stamp error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    if (!appended || mismatched || !extended || stamp != 43 || [extended count] != [set count] || ![extended containsWord:@"appended"]) {
+        fprintf(stderr, "Known-word snapshot append failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int test_book_text_file(void) {
+    XLChapter *first = [XLChapter chapterWithId:@"c1" title:@"Chapitre \u00e9t\u00e9" index:0 content:@"<p>Bonjour le monde</p>"];
+    first.href = @"text/c1.xhtml";
+    first.wordCount = 3;
+    XLChapter *empty = [XLChapter chapterWithId:@"c2" title:@"" index:1 content:@""];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"xenolexia-coretests.xltext"];
+    NSError *error = nil;
+    NSArray *loaded = [XLBookTextFile writeChapters:@[ first, empty ] toPath:path error:&error]
+        ? [XLBookTextFile chaptersWithContentsOfFile:path error:&error] : nil;
+    XLChapter *read = [loaded count] == 2 ? [loaded objectAtIndex:0] : nil;
+    XLChapter *readEmpty = [loaded count] == 2 ? [loaded objectAtIndex:1] : nil;
+    if (!read || ![read.title isEqualToString:first.title] || ![read.href isEqualToString:@"text/c1.xhtml"] || read.wordCount != 3
+        || ![read.content isEqualToString:@"<p>Bonjour le monde</p>"] || readEmpty.href != nil || [readEmpty.content length] != 0) {
+        fprintf(stderr, "Extracted-text round trip failed: %s\n", [[error localizedDescription] UTF8String]);
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        return 1;
+    }
+    /* Drop the end of the text: the file must be rejected, not read past its end */
+    unsigned long long size = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileSize];
+    BOOL cut = size > 4 && truncate([path fileSystemRepresentation], (off_t)(size - 4)) == 0;
+    error = nil;
+    NSArray *truncated = cut ? [XLBookTextFile chaptersWithContentsOfFile:path error:&error] : nil;
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    if (!cut || truncated || [error code] != 3) {
+        fprintf(stderr, "Truncated extracted-text file was not rejected\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// Records the storage callbacks the streak test waits on (storage calls return after calling back)
+@interface XLTestStorageDelegate : NSObject <XLStorageServiceDelegate> {
+@public
+    NSString *_sessionId;
+    XLReadingStats *_stats;
+    BOOL _ok;
+}
+@end
+
+@implementation XLTestStorageDelegate
+
+- (void)dealloc {
+    [_sessionId release];
+    [_stats release];
+    [super dealloc];
+}
+
+- (void)storageService:(id)service didSaveBook:(XLBook *)book withSuccess:(BOOL)success error:(NSError *)error {
+    _ok = success;
+}
+
+- (void)storageService:(id)service didDeleteBookWithId:(NSString *)bookId withSuccess:(BOOL)success error:(NSError *)error {
+    _ok = success;
+}
+
+- (void)storageService:(id)service didStartReadingSessionWithId:(NSString *)sessionId error:(NSError *)error {
+    [_sessionId release];
+    _sessionId = [sessionId copy];
+}
+
+- (void)storageService:(id)service didEndReadingSessionWithSuccess:(BOOL)success error:(NSError *)error {
+    _ok = success;
+}
+
+- (void)storageService:(id)service didGetReadingStats:(XLReadingStats *)stats withError:(NSError *)error {
+    [_stats release];
+    _stats = [stats retain];
+}
+
+@end
+
+static BOOL readBookInStorage(XLStorageService *storage, XLTestStorageDelegate *delegate, NSString *bookId) {
+    XLBook *book = [[[XLBook alloc] init] autorelease];
+    book.bookId = bookId;
+    book.title = bookId;
+    book.filePath = [@"/tmp" stringByAppendingPathComponent:bookId];
+    book.addedAt = [NSDate date];
+    book.languagePair = [XLLanguagePair pairWithSource:XLLanguageEnglish target:XLLanguageFrench];
+    delegate->_ok = NO;
+    [storage saveBook:book delegate:delegate];
+    if (!delegate->_ok) return NO;
+    [storage startReadingSessionForBookId:bookId delegate:delegate];
+    delegate->_ok = NO;
+    if (delegate->_sessionId) [storage endReadingSessionWithId:delegate->_sessionId wordsRevealed:1 wordsSaved:0 delegate:delegate];
+    return delegate->_ok;
+}
+
+static int test_streak_after_delete(void) {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"xenolexia-coretests-streak.db"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    XLTestStorageDelegate *delegate = [[[XLTestStorageDelegate alloc] init] autorelease];
+    XLStorageService *first = [[[XLStorageService alloc] initWithDatabasePath:path] autorelease];
+    BOOL ok = readBookInStorage(first, delegate, @"yesterday-book");
+
+    /* Move that session to yesterday and drop the rollup state, so the next open rebuilds it from the sessions */
+    sqlite3 *db = NULL;
+    ok = ok && sqlite3_open([path fileSystemRepresentation], &db) == SQLITE_OK
+        && sqlite3_exec(db, "UPDATE reading_sessions SET started_at = started_at - 86400000, ended_at = ended_at - 86400000;"
+                            "DELETE FROM stats_state", NULL, NULL, NULL) == SQLITE_OK;
+    if (db) sqlite3_close(db);
+
+    XLStorageService *storage = [[[XLStorageService alloc] initWithDatabasePath:path] autorelease];
+    ok = ok && readBookInStorage(storage, delegate, @"today-book");
+    [storage getReadingStatsWithDelegate:delegate];
+    NSInteger streakBefore = delegate->_stats.currentStreak;
+
+    /* Today's only book goes, so today no longer counts and the streak falls back to yesterday's */
+    delegate->_ok = NO;
+    [storage deleteBookWithId:@"today-book" delegate:delegate];
+    ok = ok && delegate->_ok;
+    [storage getReadingStatsWithDelegate:delegate];
+    NSInteger streakAfter = delegate->_stats.currentStreak;
+    NSInteger longestAfter = delegate->_stats.longestStreak;
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    if (!ok || streakBefore != 2 || streakAfter != 1 || longestAfter != 1) {
+        fprintf(stderr, "Streak after delete failed: ok=%d before=%ld after=%ld longest=%ld\n",
+                ok, (long)streakBefore, (long)streakAfter, (long)longestAfter);
+        return 1;
+    }
+    return 0;
+}
+
+extern NSMutableArray *XLManagerStubImportedPaths;
+
+static const char kServedBook[] = "The quick brown fox jumps over the lazy dog.";
+static volatile int gServerStop;
+
+/// Minimal HTTP/1.1 server: every request, HEAD or GET, gets kServedBook with Connection: close
+static void *serveBook(void *arg) {
+    int listener = *(int *)arg;
+    while (!gServerStop) {
+        struct pollfd pfd = { listener, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0) continue;
+        char request[2048];
+        size_t got = 0;
+        ssize_t n;
+        while (got < sizeof(request) - 1 && (n = read(conn, request + got, sizeof(request) - 1 - got)) > 0) {
+            got += (size_t)n;
+            request[got] = '\0';
+            if (strstr(request, "\r\n\r\n")) break;
+        }
+        char header[128];
+        int headerLength = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", strlen(kServedBook));
+        if (write(conn, header, (size_t)headerLength) == headerLength && strncmp(request, "HEAD", 4) != 0) {
+            (void)write(conn, kServedBook, strlen(kServedBook));
+        }
+        close(conn);
+    }
+    return NULL;
+}
+
+static int test_download_imports(void) {
+    [XLManager sharedManager];
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addrLength = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    pthread_t server;
+    gServerStop = 0;
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 8) != 0
+        || getsockname(listener, (struct sockaddr *)&addr, &addrLength) != 0 || pthread_create(&server, NULL, serveBook, &listener) != 0) {
+        fprintf(stderr, "Download test could not start its HTTP server\n");
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+
+    /* The app's download path: XLManager downloadFile: -> DownloadService -> XLDownloadManager */
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"xenolexia-coretests-downloads"];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+    NSString *expected = [directory stringByAppendingPathComponent:@"fox.txt"];
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%d/fox.txt", (int)ntohs(addr.sin_port)]];
+    DownloadService *service = [[[DownloadService alloc] init] autorelease];
+    [service downloadFrom:url toDirectory:directory];
+
+    BOOL imported = NO;
+    for (int waited = 0; waited < 200 && !imported; waited++) {
+        usleep(50 * 1000);
+        @synchronized (XLManagerStubImportedPaths) {
+            imported = [XLManagerStubImportedPaths containsObject:expected];
+        }
+    }
+    NSString *saved = [NSString stringWithContentsOfFile:expected encoding:NSUTF8StringEncoding error:NULL];
+    gServerStop = 1;
+    pthread_join(server, NULL);
+    close(listener);
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+    if (!imported || ![saved isEqualToString:[NSString stringWithUTF8String:kServedBook]]) {
+        fprintf(stderr, "Completed download was not imported: imported=%d saved=%s\n", imported, [saved UTF8String]);
+        return 1;
+    }
+    return 0;
+}
+
+static NSString *sha256Hex(const char *bytes, size_t length, size_t chunk) {
+    XLSha256Context ctx;
+    uint8_t digest[32];
+    char hex[65];
+    XLSha256Init(&ctx);
+    for (size_t offset = 0; offset < length; offset += chunk) {
+        XLSha256Update(&ctx, bytes + offset, MIN(chunk, length - offset));
+    }
+    XLSha256Final(&ctx, digest);
+    for (int i = 0; i < 32; i++) snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    return [NSString stringWithUTF8String:hex];
+}
+
+static int test_sha256(void) {
+    /* FIPS 180-4 example vectors; odd chunk sizes cross the 64-byte block boundary */
+    const char *twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    if (![sha256Hex("", 0, 1) isEqualToString:@"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"]
+        || ![sha256Hex("abc", 3, 3) isEqualToString:@"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"]
+        || ![sha256Hex(twoBlocks, strlen(twoBlocks), 7) isEqualToString:@"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"]) {
+        fprintf(stderr, "SHA-256 short vectors failed\n");
+        return 1;
+    }
+    char *million = malloc(1000000);
+    if (!million) return 1;
+    memset(million, 'a', 1000000);
+    NSString *digest = sha256Hex(million, 1000000, 999);
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"xenolexia-coretests.sha"];
+    BOOL written = [[NSData dataWithBytesNoCopy:million length:1000000 freeWhenDone:YES] writeToFile:path atomically:NO];
+    NSString *fileDigest = written ? XLSha256HexOfFile(path, NULL, NULL) : nil;
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    NSString *expected = @"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+    if (![digest isEqualToString:expected] || ![fileDigest isEqualToString:expected]) {
+        fprintf(stderr, "SHA-256 million-a vector failed: %s / %s\n", [digest UTF8String], [fileDigest UTF8String]);
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, const char * argv[]) {
     (void)argc;
     (void)argv;
     NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
-    if (test_sm2_step() != 0) {
+    if (test_sm2_step() != 0 || test_sm2_batch() != 0 || test_review_forecast() != 0 || test_span_table() != 0
+        || test_chapter_text() != 0 || test_known_word_set() != 0 || test_sha256() != 0
+        || test_book_text_file() != 0 || test_streak_after_delete() != 0
+        || test_download_imports() != 0) {
         fprintf(stderr, "CoreTests FAILED\n");
         [pool drain];
         return 1;
     }
-    fprintf(stdout, "CoreTests PASSED (XLSm2 native ObjC)\n");
+    fprintf(stdout, "CoreTests PASSED (XLSm2, XLSm2Batch, XLReviewForecast, XLSpanTable, XLChapterText, XLKnownWordSet, XLSha256, XLBookTextFile native ObjC, reading streak rollup, download import)\n");
     [pool drain];
     return 0;
 }
@@ -17,6 +17,7 @@
 //- (void)fakeManager;
 // manager not needed - expose the services
 - (void)listFilesInDirectory:(NSString*)documentsDirectory;
+/// Queues the file on XLDownloadManager; once verified it is imported into the library
 - (void)downloadFrom:(NSURL*)fileURL toDirectory:(NSString*)documentsDirectory;
 
 @end
@@ -0,0 +1,26 @@
+//
+//  XLDiagnosticsWindowController.h
+//  Xenolexia
+//
+//  Diagnostics window: live counters, gauges and latency percentiles from XLMetrics, with copy/save/reset
+
+#import <AppKit/AppKit.h>
+
+@protocol XLDiagnosticsWindowDelegate <NSObject>
+- (void)diagnosticsWindowDidClose;
+@end
+
+@interface XLDiagnosticsWindowController : NSWindowController {
+    id<XLDiagnosticsWindowDelegate> _delegate;
+    NSTextView *_reportView;
+    NSButton *_copyButton;
+    NSButton *_saveButton;
+    NSButton *_resetButton;
+    NSTimer *_refreshTimer;
+}
+
+@property (nonatomic, assign) id<XLDiagnosticsWindowDelegate> delegate;
+
+- (void)refreshReport;
+
+@end
@@ -0,0 +1,133 @@
+//
+//  XLDiagnosticsWindowController.m
+//  Xenolexia
+//
+//  Diagnostics window: XLMetrics text report, refreshed once a second while open
+
+#import "XLDiagnosticsWindowController.h"
+#import "../../../../Core/Native/XLMetrics.h"
+
+static const NSTimeInterval kRefreshInterval = 1.0;
+
+@interface XLDiagnosticsWindowController ()
+- (NSButton *)buttonWithTitle:(NSString *)title frame:(NSRect)frame action:(SEL)action;
+- (void)refreshTimerFired:(NSTimer *)timer;
+@end
+
+@implementation XLDiagnosticsWindowController
+
+@synthesize delegate = _delegate;
+
+- (instancetype)init {
+    self = [super initWithWindowNibName:nil];
+    if (self) {
+        _delegate = nil;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_refreshTimer invalidate];
+    [_refreshTimer release];
+    [_reportView release];
+    [_copyButton release];
+    [_saveButton release];
+    [_resetButton release];
+    [super dealloc];
+}
+
+- (void)windowDidLoad {
+    [super windowDidLoad];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(windowWillClose:) name:NSWindowWillCloseNotification object:self.window];
+    NSView *contentView = [self.window contentView];
+    [self.window setTitle:@"Xenolexia - Diagnostics"];
+    [self.window setContentSize:NSMakeSize(760, 480)];
+    [self.window setMinSize:NSMakeSize(480, 240)];
+    NSRect bounds = [contentView bounds];
+
+    NSScrollView *scrollView = [[NSScrollView alloc] initWithFrame:NSMakeRect(12, 40, bounds.size.width - 24, bounds.size.height - 52)];
+    [scrollView setAutoresizingMask:NSViewWidthSizable | NSViewHeightSizable];
+    [scrollView setHasVerticalScroller:YES];
+    [scrollView setBorderType:NSBezelBorder];
+    _reportView = [[NSTextView alloc] initWithFrame:[[scrollView contentView] bounds]];
+    [_reportView setAutoresizingMask:NSViewWidthSizable];
+    [_reportView setEditable:NO];
+    [_reportView setFont:[NSFont userFixedPitchFontOfSize:11]];
+    [scrollView setDocumentView:_reportView];
+    [contentView addSubview:scrollView];
+    [scrollView release];
+
+    _copyButton = [[self buttonWithTitle:@"Copy" frame:NSMakeRect(12, 8, 100, 24) action:@selector(copyClicked:)] retain];
+    _saveButton = [[self buttonWithTitle:@"Save..." frame:NSMakeRect(120, 8, 100, 24) action:@selector(saveClicked:)] retain];
+    _resetButton = [[self buttonWithTitle:@"Reset" frame:NSMakeRect(228, 8, 100, 24) action:@selector(resetClicked:)] retain];
+    [contentView addSubview:_copyButton];
+    [contentView addSubview:_saveButton];
+    [contentView addSubview:_resetButton];
+
+    [self refreshReport];
+    _refreshTimer = [[NSTimer scheduledTimerWithTimeInterval:kRefreshInterval
+                                                      target:self
+                                                    selector:@selector(refreshTimerFired:)
+                                                    userInfo:nil
+                                                     repeats:YES] retain];
+}
+
+- (NSButton *)buttonWithTitle:(NSString *)title frame:(NSRect)frame action:(SEL)action {
+    NSButton *button = [[NSButton alloc] initWithFrame:frame];
+    [button setTitle:title];
+    [button setTarget:self];
+    [button setAction:action];
+    return [button autorelease];
+}
+
+- (void)refreshReport {
+    [_reportView setString:XLMetricsTextReport()];
+}
+
+- (void)refreshTimerFired:(NSTimer *)timer {
+    (void)timer;
+    [self refreshReport];
+}
+
+- (IBAction)copyClicked:(id)sender {
+    (void)sender;
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    [pasteboard declareTypes:[NSArray arrayWithObject:NSStringPboardType] owner:nil];
+    [pasteboard setString:XLMetricsTextReport() forType:NSStringPboardType];
+}
+
+- (IBAction)saveClicked:(id)sender {
+    (void)sender;
+    NSSavePanel *panel = [NSSavePanel savePanel];
+    [panel setAllowedFileTypes:[NSArray arrayWithObjects:@"json", @"txt", nil]];
+    [panel setCanCreateDirectories:YES];
+    if ([panel runModal] != NSFileHandlingPanelOKButton) return;
+    NSString *path = [panel URL] ? [[panel URL] path] : nil;
+    if (!path) return;
+    NSError *error = nil;
+    if (!XLMetricsWriteReport(path, &error)) {
+        NSAlert *alert = [[[NSAlert alloc] init] autorelease];
+        [alert setMessageText:@"Could not save diagnostics"];
+        [alert setInformativeText:[error localizedDescription] ?: path];
+        [alert runModal];
+    }
+}
+
+- (IBAction)resetClicked:(id)sender {
+    (void)sender;
+    XLMetricsReset();
+    [self refreshReport];
+}
+
+- (void)windowWillClose:(NSNotification *)notification {
+    (void)notification;
+    [_refreshTimer invalidate];
+    [_refreshTimer release];
+    _refreshTimer = nil;
+    if (_delegate && [_delegate respondsToSelector:@selector(diagnosticsWindowDidClose)]) {
+        [_delegate diagnosticsWindowDidClose];
+    }
+}
+
+@end
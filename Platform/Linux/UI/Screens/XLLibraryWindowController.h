@@ -44,6 +44,11 @@
     XLStorageService *_storageService;
     NSString *_currentSortBy;
     NSString *_currentSortOrder;
+    NSMutableDictionary *_gridCardsByBookId;  // cards currently laid out, by book id
+    NSMutableArray *_reusableGridCards;       // hidden cards waiting to be reused
+    NSString *_appliedSearchQuery;            // folded query _filteredBooks was built from
+    NSUInteger _filterGeneration;             // bumped per filter so stale background results are dropped
+    dispatch_queue_t _filterQueue;
 }
 
 - (void)refreshBooks;
@@ -6,6 +6,8 @@
 #import "XLLibraryWindowController.h"
 #import "../../../../Core/Services/XLStorageService.h"
 #import "../../../../Core/Services/XLManager.h"
+#import "../../../../Core/Models/SearchKey.h"
+#import "../XLCoverImageCache.h"
 #import "SSFileSystem.h"
 #import <objc/runtime.h>
 
@@ -13,6 +15,20 @@ static const CGFloat kCardWidth = 160;
 static const CGFloat kCardHeight = 220;
 static const CGFloat kCardSpacing = 16;
 static const NSInteger kGridColumns = 4;
+/* Rows laid out above and below the visible rect so short scrolls don't expose empty space */
+static const NSInteger kGridOverscanRows = 2;
+/* Keystrokes closer together than this are filtered once */
+static const NSTimeInterval kSearchDebounceInterval = 0.12;
+
+/* Subview tags inside a grid card, so a card can be refreshed in place */
+enum {
+    kCardCoverTag = 1,
+    kCardPlaceholderTag,
+    kCardTitleTag,
+    kCardAuthorTag,
+    kCardProgressTag,
+    kCardButtonTag
+};
 
 static NSString *libraryWindowStatePath(void) {
     SSFileSystem *fs = [SSFileSystem sharedFileSystem];
@@ -24,8 +40,35 @@ static NSString *libraryWindowStatePath(void) {
     return [dir stringByAppendingPathComponent:@"window_state.plist"];
 }
 
+/// Books whose precomputed search key contains foldedQuery, in order; books itself for an empty query
+static NSArray *booksMatchingQuery(NSArray *books, NSString *foldedQuery) {
+    if ([foldedQuery length] == 0) return books;
+    NSMutableArray *matches = [NSMutableArray array];
+    for (XLBook *book in books) {
+        if (XLSearchKeyMatches(book.searchKey, foldedQuery)) {
+            [matches addObject:book];
+        }
+    }
+    return matches;
+}
+
 @interface XLLibraryWindowController ()
 - (void)rebuildGrid;
+- (void)layoutVisibleGridCards;
+- (NSRange)gridIndexRangeForVisibleRect;
+- (NSRect)gridCardFrameAtIndex:(NSUInteger)index;
+- (NSBox *)dequeueGridCard;
+- (void)recycleGridCard:(NSBox *)card;
+- (void)gridBoundsDidChange:(NSNotification *)notification;
+- (NSBox *)newGridCardWithFrame:(NSRect)frame;
+- (void)configureGridCard:(NSBox *)card withBook:(XLBook *)book;
+- (NSArray *)sortedBooks:(NSArray *)books;
+- (void)applyBooks:(NSArray *)books;
+- (void)updateStatusLabel;
+- (void)scheduleSearchFilter;
+- (void)runSearchFilter;
+- (void)applyFilteredBooks:(NSArray *)filtered query:(NSString *)query;
+- (void)storageDidChange:(NSNotification *)notification;
 - (void)switchToTableView;
 - (void)switchToGridView;
 - (void)gridCardDoubleClicked:(id)sender;
@@ -43,12 +86,29 @@ static NSString *libraryWindowStatePath(void) {
         _storageService = [XLStorageService sharedService];
         _currentSortBy = @"lastReadAt";
         _currentSortOrder = @"DESC";
+        _gridCardsByBookId = [[NSMutableDictionary alloc] init];
+        _reusableGridCards = [[NSMutableArray alloc] init];
+        _appliedSearchQuery = @"";
+        _filterQueue = dispatch_queue_create("com.xenolexia.library.filter", DISPATCH_QUEUE_SERIAL);
     }
     return self;
 }
 
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self name:NSWindowWillCloseNotification object:self.window];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:XLStorageServiceDidChangeNotification object:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSViewBoundsDidChangeNotification object:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSViewFrameDidChangeNotification object:nil];
+    XLCoverImageCache *covers = [XLCoverImageCache sharedCache];
+    for (NSBox *card in [_gridCardsByBookId allValues]) {
+        [covers cancelLoadsForOwner:card];
+    }
+    [_books release];
+    [_filteredBooks release];
+    [_gridCardsByBookId release];
+    [_reusableGridCards release];
+    [_appliedSearchQuery release];
+    dispatch_release(_filterQueue);
     [super dealloc];
 }
 
@@ -173,8 +233,14 @@ static NSString *libraryWindowStatePath(void) {
     [_gridScrollView setDocumentView:_gridContentView];
     [_gridScrollView setHidden:YES];
     [contentView addSubview:_gridScrollView];
+    /* Scrolling moves the clip view's bounds, resizing changes its frame; both change what is visible */
+    [[_gridScrollView contentView] setPostsBoundsChangedNotifications:YES];
+    [[_gridScrollView contentView] setPostsFrameChangedNotifications:YES];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(gridBoundsDidChange:) name:NSViewBoundsDidChangeNotification object:[_gridScrollView contentView]];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(gridBoundsDidChange:) name:NSViewFrameDidChangeNotification object:[_gridScrollView contentView]];
     
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(libraryWindowWillClose:) name:NSWindowWillCloseNotification object:self.window];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(storageDidChange:) name:XLStorageServiceDidChangeNotification object:nil];
     [self restoreWindowState];
     [self refreshBooks];
     [_storageService getLibraryViewModeWithDelegate:self];
@@ -224,19 +290,120 @@ static NSString *libraryWindowStatePath(void) {
             [_statusLabel setStringValue:@"Error loading books"];
         }
     } else {
-    _books = books ? books : [[NSArray alloc] init];
+    [_books release];
+    _books = books ? [books copy] : [[NSArray alloc] init];
     [self filterBooks];
     [self reloadData];
-    
+    [self updateStatusLabel];
+    }
+}
+
+- (void)updateStatusLabel {
     if (_statusLabel) {
-        NSString *countText = [NSString stringWithFormat:@"%lu book%@", 
+        NSString *countText = [NSString stringWithFormat:@"%lu book%@",
                              (unsigned long)[_filteredBooks count],
                              [_filteredBooks count] == 1 ? @"" : @"s"];
         [_statusLabel setStringValue:countText];
     }
+}
+
+#pragma mark - Change feed
+
+- (void)storageDidChange:(NSNotification *)notification {
+    XLStorageChangeSet *changes = [[notification userInfo] objectForKey:XLStorageChangeSetKey];
+    if (![changes touchesTable:XLStorageTableBooks]) return;
+    NSSet *deleted = [changes deletedIdsForTable:XLStorageTableBooks];
+    NSMutableSet *changed = [NSMutableSet setWithSet:[changes insertedIdsForTable:XLStorageTableBooks]];
+    [changed unionSet:[changes updatedIdsForTable:XLStorageTableBooks]];
+
+    if ([deleted count] > 0) {
+        NSMutableArray *books = [NSMutableArray arrayWithCapacity:[_books count]];
+        for (XLBook *book in _books) {
+            if (![deleted containsObject:book.bookId]) {
+                [books addObject:book];
+            }
+        }
+        [self applyBooks:books];
+    }
+    if ([changed count] > 0) {
+        [_storageService getBooksWithIds:[changed allObjects] delegate:self];
     }
 }
 
+- (void)storageService:(id)service didGetBooks:(NSArray *)books forIds:(NSArray *)bookIds withError:(NSError *)error {
+    if (error) {
+        [self refreshBooks];
+        return;
+    }
+    /* Ids that came back empty were deleted in the meantime */
+    NSSet *replaced = [NSSet setWithArray:bookIds];
+    NSMutableArray *merged = [NSMutableArray arrayWithCapacity:[_books count] + [books count]];
+    for (XLBook *book in _books) {
+        if (![replaced containsObject:book.bookId]) {
+            [merged addObject:book];
+        }
+    }
+    [merged addObjectsFromArray:books];
+    [self applyBooks:merged];
+}
+
+/// Replace the book list and refresh only what changed: when the visible order is unchanged,
+/// just the rows/cards whose book object was replaced are redrawn; otherwise the views reload.
+- (void)applyBooks:(NSArray *)books {
+    NSArray *oldVisible = [[_filteredBooks retain] autorelease];
+    [_books release];
+    _books = [[self sortedBooks:books] copy];
+    [self filterBooks];
+
+    if (![[oldVisible valueForKey:@"bookId"] isEqualToArray:[_filteredBooks valueForKey:@"bookId"]]) {
+        [self reloadData];
+    } else {
+        NSMutableIndexSet *rows = [NSMutableIndexSet indexSet];
+        for (NSUInteger i = 0; i < [_filteredBooks count]; i++) {
+            XLBook *book = [_filteredBooks objectAtIndex:i];
+            if (book == [oldVisible objectAtIndex:i]) continue;
+            [rows addIndex:i];
+            NSBox *card = [_gridCardsByBookId objectForKey:book.bookId];
+            if (card) {
+                [self configureGridCard:card withBook:book];
+            }
+        }
+        if ([rows count] > 0) {
+            [_tableView reloadDataForRowIndexes:rows columnIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [[_tableView tableColumns] count])]];
+        }
+    }
+    [self updateStatusLabel];
+}
+
+/// In-memory equivalent of getAllBooksWithSortBy:order: (sort key, then id) for merging changed rows
+- (NSArray *)sortedBooks:(NSArray *)books {
+    NSString *sortBy = _currentSortBy;
+    BOOL ascending = [[_currentSortOrder uppercaseString] isEqualToString:@"ASC"];
+    return [books sortedArrayUsingComparator:^NSComparisonResult(XLBook *a, XLBook *b) {
+        NSComparisonResult r = NSOrderedSame;
+        if ([sortBy isEqualToString:@"title"]) {
+            r = [a.title ?: @"" compare:b.title ?: @""];
+        } else if ([sortBy isEqualToString:@"author"]) {
+            r = [a.author ?: @"" compare:b.author ?: @""];
+        } else if ([sortBy isEqualToString:@"addedAt"]) {
+            r = [a.addedAt compare:b.addedAt];
+        } else if ([sortBy isEqualToString:@"progress"]) {
+            r = (a.progress < b.progress) ? NSOrderedAscending : (a.progress > b.progress) ? NSOrderedDescending : NSOrderedSame;
+        } else {
+            NSTimeInterval ta = a.lastReadAt ? [a.lastReadAt timeIntervalSince1970] : 0;
+            NSTimeInterval tb = b.lastReadAt ? [b.lastReadAt timeIntervalSince1970] : 0;
+            r = (ta < tb) ? NSOrderedAscending : (ta > tb) ? NSOrderedDescending : NSOrderedSame;
+        }
+        if (r == NSOrderedSame) {
+            r = [a.bookId compare:b.bookId];
+        }
+        if (!ascending) {
+            r = (r == NSOrderedAscending) ? NSOrderedDescending : (r == NSOrderedDescending) ? NSOrderedAscending : NSOrderedSame;
+        }
+        return r;
+    }];
+}
+
 - (void)storageService:(id)service didDeleteBookWithId:(NSString *)bookId withSuccess:(BOOL)success error:(NSError *)error {
     if (error) {
         NSAlert *errorAlert = [[NSAlert alloc] init];
@@ -244,9 +411,8 @@ static NSString *libraryWindowStatePath(void) {
         [errorAlert setInformativeText:[error localizedDescription]];
         [errorAlert addButtonWithTitle:@"OK"];
         [errorAlert runModal];
-    } else {
-        [self refreshBooks];
     }
+    /* On success the change feed removes the row */
 }
 
 - (void)storageService:(id)service didGetLibraryViewMode:(BOOL)grid error:(NSError *)error {
@@ -270,27 +436,57 @@ static NSString *libraryWindowStatePath(void) {
     (void)error;
 }
 
+/// Synchronous filter for data and sort changes; keystrokes go through scheduleSearchFilter instead
 - (void)filterBooks {
-    NSString *searchText = _searchField ? [_searchField stringValue] : @"";
-    
-    if ([searchText length] == 0) {
-        _filteredBooks = _books;
-    } else {
-        NSMutableArray *filtered = [NSMutableArray array];
-        NSString *lowerSearch = [searchText lowercaseString];
-        
-        for (XLBook *book in _books) {
-            NSString *bookTitle = [book title] ? [[book title] lowercaseString] : @"";
-            NSString *bookAuthor = [book author] ? [[book author] lowercaseString] : @"";
-            NSRange titleRange = [bookTitle rangeOfString:lowerSearch];
-            NSRange authorRange = [bookAuthor rangeOfString:lowerSearch];
-            if (titleRange.location != NSNotFound || authorRange.location != NSNotFound) {
-                [filtered addObject:book];
+    NSString *query = XLFoldedSearchKey(_searchField ? [_searchField stringValue] : @"");
+    /* Anything a keystroke filter is still computing was based on the old list */
+    _filterGeneration++;
+    NSArray *filtered = booksMatchingQuery(_books, query);
+    [_filteredBooks release];
+    _filteredBooks = [filtered copy];
+    [_appliedSearchQuery release];
+    _appliedSearchQuery = [query copy];
+}
+
+- (void)scheduleSearchFilter {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(runSearchFilter) object:nil];
+    [self performSelector:@selector(runSearchFilter) withObject:nil afterDelay:kSearchDebounceInterval];
+}
+
+/// Filter on _filterQueue. A query that contains the applied one can only match a subset of its
+/// results, so typing more characters narrows _filteredBooks instead of rescanning the library.
+- (void)runSearchFilter {
+    NSString *query = XLFoldedSearchKey([_searchField stringValue]);
+    if ([query isEqualToString:_appliedSearchQuery]) return;
+    BOOL narrowing = [_appliedSearchQuery length] > 0
+        && [query rangeOfString:_appliedSearchQuery options:NSLiteralSearch].location != NSNotFound;
+    NSArray *books = _books;
+    NSArray *base = narrowing ? _filteredBooks : books;
+    NSUInteger generation = ++_filterGeneration;
+    dispatch_async(_filterQueue, ^{
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSArray *filtered = [booksMatchingQuery(base, query) copy];
+        [pool drain];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (generation == _filterGeneration && books == _books) {
+                [self applyFilteredBooks:filtered query:query];
             }
-        }
-        
-        _filteredBooks = filtered;
+            [filtered release];
+        });
+    });
+}
+
+/// Apply a keystroke result as a diff: nothing happens when the visible list is unchanged; otherwise the
+/// table reloads (it only asks for visible rows) and the grid keeps the cards of books still on screen
+- (void)applyFilteredBooks:(NSArray *)filtered query:(NSString *)query {
+    [_appliedSearchQuery release];
+    _appliedSearchQuery = [query copy];
+    if (![filtered isEqualToArray:_filteredBooks]) {
+        [_filteredBooks release];
+        _filteredBooks = [filtered retain];
+        [self reloadData];
     }
+    [self updateStatusLabel];
 }
 
 - (void)reloadData {
@@ -327,99 +523,203 @@ static NSString *libraryWindowStatePath(void) {
     [self rebuildGrid];
 }
 
+/// Size the content view for the current book list and lay out cards for the visible rows only.
+/// Cards of books that stay visible are moved rather than rebuilt, so filtering never creates or destroys views.
 - (void)rebuildGrid {
-    [[_gridContentView subviews] makeObjectsPerformSelector:@selector(removeFromSuperview)];
-    NSArray *books = _filteredBooks;
-    if (!books || [books count] == 0) {
+    NSInteger count = [_filteredBooks count];
+    if (count == 0) {
+        for (NSBox *card in [_gridCardsByBookId allValues]) {
+            [self recycleGridCard:card];
+        }
+        [_gridCardsByBookId removeAllObjects];
         [_gridContentView setFrameSize:NSMakeSize(780, 500)];
         return;
     }
-    NSInteger count = [books count];
     NSInteger rows = (count + kGridColumns - 1) / kGridColumns;
     CGFloat contentWidth = kGridColumns * kCardWidth + (kGridColumns + 1) * kCardSpacing;
     CGFloat contentHeight = rows * kCardHeight + (rows + 1) * kCardSpacing;
     [_gridContentView setFrameSize:NSMakeSize(contentWidth, contentHeight)];
-    for (NSInteger i = 0; i < count; i++) {
-        XLBook *book = [books objectAtIndex:i];
-        NSInteger col = i % kGridColumns;
-        NSInteger row = i / kGridColumns;
-        CGFloat x = kCardSpacing + col * (kCardWidth + kCardSpacing);
-        CGFloat y = contentHeight - (row + 1) * (kCardHeight + kCardSpacing) - kCardSpacing;
-        NSBox *card = [[NSBox alloc] initWithFrame:NSMakeRect(x, y, kCardWidth, kCardHeight)];
-        [card setBoxType:NSBoxPrimary];
-        [card setBorderType:NSLineBorder];
-        [card setTitlePosition:NSNoTitle];
-        [card setContentViewMargins:NSMakeSize(0, 0)];
-        CGFloat top = kCardHeight - 8;
-        NSImageView *coverView = [[NSImageView alloc] initWithFrame:NSMakeRect(20, top - 160, 120, 160)];
-        [coverView setImageScaling:NSImageScaleProportionallyDown];
-        if (book.coverPath && [[SSFileSystem sharedFileSystem] fileExistsAtPath:book.coverPath]) {
-            NSImage *img = [[NSImage alloc] initWithContentsOfFile:book.coverPath];
-            if (img) {
-                [coverView setImage:img];
-                [img release];
-            } else {
-                [coverView setImage:nil];
-            }
+    [self layoutVisibleGridCards];
+}
+
+- (NSRect)gridCardFrameAtIndex:(NSUInteger)index {
+    CGFloat contentHeight = NSHeight([_gridContentView frame]);
+    NSInteger col = index % kGridColumns;
+    NSInteger row = index / kGridColumns;
+    CGFloat x = kCardSpacing + col * (kCardWidth + kCardSpacing);
+    CGFloat y = contentHeight - (row + 1) * (kCardHeight + kCardSpacing) - kCardSpacing;
+    return NSMakeRect(x, y, kCardWidth, kCardHeight);
+}
+
+/// Book indexes whose rows intersect the visible rect, widened by kGridOverscanRows on each side
+- (NSRange)gridIndexRangeForVisibleRect {
+    NSUInteger count = [_filteredBooks count];
+    if (count == 0) return NSMakeRange(0, 0);
+    NSRect visible = [[_gridScrollView contentView] documentVisibleRect];
+    CGFloat contentHeight = NSHeight([_gridContentView frame]);
+    CGFloat rowHeight = kCardHeight + kCardSpacing;
+    NSInteger rows = (count + kGridColumns - 1) / kGridColumns;
+    /* Rows run top-down while the (unflipped) content view's y runs bottom-up */
+    NSInteger firstRow = (NSInteger)floor((contentHeight - NSMaxY(visible)) / rowHeight) - kGridOverscanRows;
+    NSInteger lastRow = (NSInteger)floor((contentHeight - NSMinY(visible)) / rowHeight) + kGridOverscanRows;
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow > rows - 1) lastRow = rows - 1;
+    if (lastRow < firstRow) return NSMakeRange(0, 0);
+    NSUInteger start = (NSUInteger)firstRow * kGridColumns;
+    NSUInteger end = MIN(count, (NSUInteger)(lastRow + 1) * kGridColumns);
+    return NSMakeRange(start, end - start);
+}
+
+/// Diff the laid-out cards against the overscanned visible range: cards whose book left it are recycled,
+/// cards whose book is still in it are moved (and refreshed if the book object changed), gaps are filled
+- (void)layoutVisibleGridCards {
+    if (!_showingGrid || !_gridContentView) return;
+    NSRange range = [self gridIndexRangeForVisibleRect];
+    NSMutableSet *visibleIds = [NSMutableSet setWithCapacity:range.length];
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        [visibleIds addObject:[[_filteredBooks objectAtIndex:i] bookId]];
+    }
+    for (NSString *bookId in [_gridCardsByBookId allKeys]) {
+        if (![visibleIds containsObject:bookId]) {
+            [self recycleGridCard:[_gridCardsByBookId objectForKey:bookId]];
+            [_gridCardsByBookId removeObjectForKey:bookId];
         }
-        if (![coverView image]) {
-            NSTextField *placeholder = [[NSTextField alloc] initWithFrame:NSMakeRect(30, top - 140, 100, 24)];
-            [placeholder setStringValue:@"No cover"];
-            [placeholder setEditable:NO];
-            [placeholder setBordered:NO];
-            [placeholder setBackgroundColor:[NSColor clearColor]];
-            [placeholder setFont:[NSFont systemFontOfSize:11]];
-            [placeholder setTextColor:[NSColor grayColor]];
-            [card addSubview:placeholder];
-            [placeholder release];
+    }
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        XLBook *book = [_filteredBooks objectAtIndex:i];
+        NSRect frame = [self gridCardFrameAtIndex:i];
+        NSBox *card = [_gridCardsByBookId objectForKey:book.bookId];
+        if (card) {
+            if (!NSEqualRects([card frame], frame)) [card setFrame:frame];
+            if (objc_getAssociatedObject(card, "book") != book) [self configureGridCard:card withBook:book];
+            continue;
         }
-        [card addSubview:coverView];
-        [coverView release];
-        top -= 168;
-        NSTextField *titleLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 36)];
-        [titleLabel setStringValue:book.title ?: @"Untitled"];
-        [titleLabel setEditable:NO];
-        [titleLabel setBordered:NO];
-        [titleLabel setBackgroundColor:[NSColor clearColor]];
-        [titleLabel setFont:[NSFont boldSystemFontOfSize:12]];
-        [titleLabel setLineBreakMode:NSLineBreakByTruncatingTail];
-        [titleLabel setAlignment:NSCenterTextAlignment];
-        [card addSubview:titleLabel];
-        [titleLabel release];
-        top -= 24;
-        NSTextField *authorLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 20)];
-        [authorLabel setStringValue:book.author ?: @"—"];
-        [authorLabel setEditable:NO];
-        [authorLabel setBordered:NO];
-        [authorLabel setBackgroundColor:[NSColor clearColor]];
-        [authorLabel setFont:[NSFont systemFontOfSize:10]];
-        [authorLabel setLineBreakMode:NSLineBreakByTruncatingTail];
-        [authorLabel setAlignment:NSCenterTextAlignment];
-        [card addSubview:authorLabel];
-        [authorLabel release];
-        top -= 22;
-        NSTextField *progressLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 18)];
-        [progressLabel setStringValue:[NSString stringWithFormat:@"%.0f%%", book.progress]];
-        [progressLabel setEditable:NO];
-        [progressLabel setBordered:NO];
-        [progressLabel setBackgroundColor:[NSColor clearColor]];
-        [progressLabel setFont:[NSFont systemFontOfSize:11]];
-        [progressLabel setAlignment:NSCenterTextAlignment];
-        [card addSubview:progressLabel];
-        [progressLabel release];
-        objc_setAssociatedObject(card, "book", book, OBJC_ASSOCIATION_ASSIGN);
-        NSButton *btn = [[NSButton alloc] initWithFrame:NSMakeRect(0, 0, kCardWidth, kCardHeight)];
-        [btn setTitle:@""];
-        [btn setBordered:NO];
-        [btn setTransparent:YES];
-        [btn setTarget:self];
-        [btn setAction:@selector(gridCardDoubleClicked:)];
-        objc_setAssociatedObject(btn, "book", book, OBJC_ASSOCIATION_ASSIGN);
-        [card addSubview:btn positioned:NSWindowAbove relativeTo:nil];
-        [btn release];
-        [_gridContentView addSubview:card];
-        [card release];
+        card = [self dequeueGridCard];
+        [card setFrame:frame];
+        [self configureGridCard:card withBook:book];
+        [card setHidden:NO];
+        [_gridCardsByBookId setObject:card forKey:book.bookId];
+    }
+}
+
+- (void)gridBoundsDidChange:(NSNotification *)notification {
+    [self layoutVisibleGridCards];
+}
+
+/// A hidden card from the pool, or a new one added to the content view
+- (NSBox *)dequeueGridCard {
+    NSBox *card = [_reusableGridCards lastObject];
+    if (card) {
+        [[card retain] autorelease];
+        [_reusableGridCards removeLastObject];
+        return card;
     }
+    card = [self newGridCardWithFrame:NSMakeRect(0, 0, kCardWidth, kCardHeight)];
+    [_gridContentView addSubview:card];
+    return [card autorelease];
+}
+
+/// Cards stay in the view hierarchy while pooled; hiding is far cheaper than re-adding subviews
+- (void)recycleGridCard:(NSBox *)card {
+    [[XLCoverImageCache sharedCache] cancelLoadsForOwner:card];
+    [card setHidden:YES];
+    [(NSImageView *)[card viewWithTag:kCardCoverTag] setImage:nil];
+    objc_setAssociatedObject(card, "book", nil, OBJC_ASSOCIATION_ASSIGN);
+    objc_setAssociatedObject(card, "coverPath", nil, OBJC_ASSOCIATION_RETAIN);
+    objc_setAssociatedObject([card viewWithTag:kCardButtonTag], "book", nil, OBJC_ASSOCIATION_ASSIGN);
+    [_reusableGridCards addObject:card];
+}
+
+- (NSBox *)newGridCardWithFrame:(NSRect)frame {
+    NSBox *card = [[NSBox alloc] initWithFrame:frame];
+    [card setBoxType:NSBoxPrimary];
+    [card setBorderType:NSLineBorder];
+    [card setTitlePosition:NSNoTitle];
+    [card setContentViewMargins:NSMakeSize(0, 0)];
+    CGFloat top = kCardHeight - 8;
+    NSImageView *coverView = [[NSImageView alloc] initWithFrame:NSMakeRect(20, top - 160, 120, 160)];
+    [coverView setImageScaling:NSImageScaleProportionallyDown];
+    [coverView setTag:kCardCoverTag];
+    NSTextField *placeholder = [[NSTextField alloc] initWithFrame:NSMakeRect(30, top - 140, 100, 24)];
+    [placeholder setStringValue:@"No cover"];
+    [placeholder setEditable:NO];
+    [placeholder setBordered:NO];
+    [placeholder setBackgroundColor:[NSColor clearColor]];
+    [placeholder setFont:[NSFont systemFontOfSize:11]];
+    [placeholder setTextColor:[NSColor grayColor]];
+    [placeholder setTag:kCardPlaceholderTag];
+    [card addSubview:placeholder];
+    [placeholder release];
+    [card addSubview:coverView];
+    [coverView release];
+    top -= 168;
+    NSTextField *titleLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 36)];
+    [titleLabel setEditable:NO];
+    [titleLabel setBordered:NO];
+    [titleLabel setBackgroundColor:[NSColor clearColor]];
+    [titleLabel setFont:[NSFont boldSystemFontOfSize:12]];
+    [titleLabel setLineBreakMode:NSLineBreakByTruncatingTail];
+    [titleLabel setAlignment:NSCenterTextAlignment];
+    [titleLabel setTag:kCardTitleTag];
+    [card addSubview:titleLabel];
+    [titleLabel release];
+    top -= 24;
+    NSTextField *authorLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 20)];
+    [authorLabel setEditable:NO];
+    [authorLabel setBordered:NO];
+    [authorLabel setBackgroundColor:[NSColor clearColor]];
+    [authorLabel setFont:[NSFont systemFontOfSize:10]];
+    [authorLabel setLineBreakMode:NSLineBreakByTruncatingTail];
+    [authorLabel setAlignment:NSCenterTextAlignment];
+    [authorLabel setTag:kCardAuthorTag];
+    [card addSubview:authorLabel];
+    [authorLabel release];
+    top -= 22;
+    NSTextField *progressLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(8, top, kCardWidth - 16, 18)];
+    [progressLabel setEditable:NO];
+    [progressLabel setBordered:NO];
+    [progressLabel setBackgroundColor:[NSColor clearColor]];
+    [progressLabel setFont:[NSFont systemFontOfSize:11]];
+    [progressLabel setAlignment:NSCenterTextAlignment];
+    [progressLabel setTag:kCardProgressTag];
+    [card addSubview:progressLabel];
+    [progressLabel release];
+    NSButton *btn = [[NSButton alloc] initWithFrame:NSMakeRect(0, 0, kCardWidth, kCardHeight)];
+    [btn setTitle:@""];
+    [btn setBordered:NO];
+    [btn setTransparent:YES];
+    [btn setTarget:self];
+    [btn setAction:@selector(gridCardDoubleClicked:)];
+    [btn setTag:kCardButtonTag];
+    [card addSubview:btn positioned:NSWindowAbove relativeTo:nil];
+    [btn release];
+    return card;
+}
+
+/// Covers come from XLCoverImageCache; on a miss the placeholder stays hidden until the decode
+/// lands, and the result is dropped if the card has been reused for another book by then.
+- (void)configureGridCard:(NSBox *)card withBook:(XLBook *)book {
+    NSImageView *coverView = [card viewWithTag:kCardCoverTag];
+    NSView *placeholder = [card viewWithTag:kCardPlaceholderTag];
+    XLCoverImageCache *covers = [XLCoverImageCache sharedCache];
+    NSString *coverPath = book.coverPath;
+    NSImage *img = [covers cachedImageForPath:coverPath];
+    [covers cancelLoadsForOwner:card];
+    objc_setAssociatedObject(card, "coverPath", coverPath, OBJC_ASSOCIATION_RETAIN);
+    [coverView setImage:img];
+    [placeholder setHidden:(img != nil || coverPath != nil)];
+    if (!img && coverPath) {
+        [covers loadImageForPath:coverPath owner:card completion:^(NSImage *image) {
+            if (![objc_getAssociatedObject(card, "coverPath") isEqualToString:coverPath]) return;
+            [coverView setImage:image];
+            [placeholder setHidden:(image != nil)];
+        }];
+    }
+    [[card viewWithTag:kCardTitleTag] setStringValue:book.title ?: @"Untitled"];
+    [[card viewWithTag:kCardAuthorTag] setStringValue:book.author ?: @"—"];
+    [[card viewWithTag:kCardProgressTag] setStringValue:[NSString stringWithFormat:@"%.0f%%", book.progress]];
+    objc_setAssociatedObject(card, "book", book, OBJC_ASSOCIATION_ASSIGN);
+    objc_setAssociatedObject([card viewWithTag:kCardButtonTag], "book", book, OBJC_ASSOCIATION_ASSIGN);
 }
 
 - (void)gridCardDoubleClicked:(id)sender {
@@ -619,15 +919,13 @@ static NSString *libraryWindowStatePath(void) {
 }
 
 - (IBAction)searchFieldChanged:(id)sender {
-    [self filterBooks];
-    [self reloadData];
+    [self scheduleSearchFilter];
 }
 
 #pragma mark - NSControlTextEditingDelegate
 
 - (void)controlTextDidChange:(NSNotification *)notification {
-    [self filterBooks];
-    [self reloadData];
+    [self scheduleSearchFilter];
 }
 
 #pragma mark - XLManagerDelegate
@@ -648,8 +946,7 @@ static NSString *libraryWindowStatePath(void) {
         if (_statusLabel) {
             [_statusLabel setStringValue:@"Book imported successfully"];
         }
-        // Refresh the book list
-        [self refreshBooks];
+        /* The change feed inserts the new row */
     }
 }
 
@@ -9,6 +9,7 @@
 #import "../../../Core/Models/Reader.h"
 #import "../../../Core/Models/Language.h"
 #import "../../../Core/Services/XLManager.h"
+#import "../../../Core/Native/XLSpanTable.h"
 
 @protocol XLReaderWindowDelegate <NSObject>
 - (void)readerDidClose;
@@ -23,6 +24,7 @@
     XLProcessedChapter *_currentChapter;
     NSInteger _currentChapterIndex;
     NSArray *_chapters;
+    XLCancellationToken *_chapterProcessing;    // the in-flight processBook: run; cancelled when superseded
     
     // UI Elements
     NSScrollView *_scrollView;
@@ -37,9 +39,18 @@
     // Reader settings
     XLReaderSettings *_settings;
     
-    // Foreign word tracking
-    NSMutableArray *_foreignWordRanges;
-    NSMutableDictionary *_foreignWordDataMap;
+    // Foreign word tracking: spans are chapter offsets, entryIndex indexes _foreignWords
+    NSArray *_foreignWords;
+    XLSpanTable *_foreignWordSpans;
+    NSDictionary *_foreignWordAttributes;
+    
+    // Virtualized layout: the text storage holds only [_windowStart, _windowEnd) of the chapter
+    NSString *_chapterText;
+    NSUInteger _windowStart;
+    NSUInteger _windowEnd;
+    NSUInteger _anchorOffset;       // chapter offset to scroll to when the next chapter is displayed
+    BOOL _adjustingWindow;
+    NSDictionary *_baseAttributes;
     
     // Reading session (Phase 1)
     NSString *_sessionId;
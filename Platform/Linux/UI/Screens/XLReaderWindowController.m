@@ -9,6 +9,17 @@
 #import "../../../../Core/Services/XLBookParserService.h"
 #import "../../../../Core/Services/XLStorageService.h"
 #import "../../../../Core/Services/XLStorageServiceDelegate.h"
+#import "../../../../Core/Services/XLExecutor.h"
+#import "../../../../Core/Native/XLChapterText.h"
+
+/* Text is laid out a page at a time; layout cost no longer grows with chapter size */
+static const NSUInteger kReaderPageLength = 16384;
+/* Load the next page once the viewport comes within this many characters of a window edge */
+static const NSUInteger kReaderEdgeMargin = 4096;
+/* Pages kept in the text storage before the far end is trimmed */
+static const NSUInteger kReaderMaxWindowPages = 5;
+/* How far past a page break to look for a line or word boundary */
+static const NSUInteger kReaderBoundarySearch = 512;
 
 // Custom text view for foreign word click detection
 @interface XLReaderTextView : NSTextView {
@@ -40,6 +51,16 @@
     [super mouseDown:event];
 }
 
+- (void)mouseMoved:(NSEvent *)event {
+    [super mouseMoved:event];
+    NSPoint textViewLocation = [[self superview] convertPoint:[event locationInWindow] fromView:nil];
+    NSUInteger charIndex = [self characterIndexForPoint:textViewLocation];
+    if (charIndex != NSNotFound && [_readerController respondsToSelector:@selector(isForeignWordAtCharacterIndex:)]
+        && [_readerController isForeignWordAtCharacterIndex:charIndex]) {
+        [[NSCursor pointingHandCursor] set];
+    }
+}
+
 @end
 
 @implementation XLReaderWindowController
@@ -51,11 +72,20 @@
         _currentChapterIndex = book.currentChapter >= 0 ? book.currentChapter : 0;
         _chapters = nil;
         _currentChapter = nil;
-        _foreignWordRanges = [[NSMutableArray alloc] init];
-        _foreignWordDataMap = [[NSMutableDictionary alloc] init];
+        _foreignWords = nil;
+        _foreignWordSpans = nil;
+        _foreignWordAttributes = [[NSDictionary alloc] initWithObjectsAndKeys:
+                                  [NSColor colorWithCalibratedRed:0.2 green:0.4 blue:0.8 alpha:1.0], NSForegroundColorAttributeName,
+                                  [NSNumber numberWithInt:NSUnderlineStyleSingle], NSUnderlineStyleAttributeName,
+                                  nil];
         _settings = [[XLReaderSettings defaultSettings] retain];
         _userPrefs = nil;
         _isInitialPrefsLoad = YES;
+        /* currentLocation is "chapter:offset" (older rows store just the chapter index) */
+        NSArray *location = [book.currentLocation componentsSeparatedByString:@":"];
+        if ([location count] == 2 && [[location objectAtIndex:0] integerValue] == _currentChapterIndex) {
+            _anchorOffset = (NSUInteger)MAX([[location objectAtIndex:1] longLongValue], 0LL);
+        }
     }
     return self;
 }
@@ -65,11 +95,17 @@
 }
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_chapterText release];
+    [_baseAttributes release];
     [_book release];
     [_currentChapter release];
     [_chapters release];
-    [_foreignWordRanges release];
-    [_foreignWordDataMap release];
+    [_chapterProcessing cancel];
+    [_chapterProcessing release];
+    [_foreignWords release];
+    [_foreignWordSpans release];
+    [_foreignWordAttributes release];
     [_settings release];
     [_sessionId release];
     [_userPrefs release];
@@ -159,6 +195,14 @@
     
     [_scrollView setDocumentView:_textView];
     [contentView addSubview:_scrollView];
+    [self.window setAcceptsMouseMovedEvents:YES];
+    
+    // Grow or shift the laid-out window as the user scrolls
+    [[_scrollView contentView] setPostsBoundsChangedNotifications:YES];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(scrollViewDidScroll:)
+                                                 name:NSViewBoundsDidChangeNotification
+                                               object:[_scrollView contentView]];
     
     // Load preferences first (Phase 1.3), then chapters; session starts after chapters load (Phase 1.2)
     XLStorageService *storage = [XLStorageService sharedService];
@@ -168,27 +212,37 @@
 - (void)loadBookChapters {
     // Get all chapters from the book
     XLBookParserService *parser = [XLBookParserService sharedService];
-    
-    // Use block-based method internally (will be bridged to delegate)
-    [parser parseBookAtPath:_book.filePath withCompletion:^(XLParsedBook *parsedBook, NSError *error) {
-        if (error) {
-            NSLog(@"Error loading book chapters: %@", error);
-            NSAlert *alert = [[NSAlert alloc] init];
-            [alert setMessageText:@"Error loading book"];
-            [alert setInformativeText:[error localizedDescription]];
-            [alert addButtonWithTitle:@"OK"];
-            [alert runModal];
-            return;
-        }
-        
-        _chapters = [parsedBook.chapters retain];
-        [self updateChapterMenu];
-        /* Start reading session (Phase 1.5) before loading first chapter */
-        [[XLStorageService sharedService] startReadingSessionForBookId:_book.bookId delegate:self];
-        [self loadCurrentChapter];
+    NSString *filePath = [[_book.filePath copy] autorelease];
+    
+    // Parse on an executor worker (ahead of any imports), then show the result on the main thread
+    [[XLExecutor sharedExecutor] submitWithPriority:XLWorkPriorityVisible block:^{
+        [parser parseBookAtPath:filePath withCompletion:^(XLParsedBook *parsedBook, NSError *error) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self didParseBook:parsedBook error:error];
+            });
+        }];
     }];
 }
 
+- (void)didParseBook:(XLParsedBook *)parsedBook error:(NSError *)error {
+    if (error) {
+        NSLog(@"Error loading book chapters: %@", error);
+        NSAlert *alert = [[NSAlert alloc] init];
+        [alert setMessageText:@"Error loading book"];
+        [alert setInformativeText:[error localizedDescription]];
+        [alert addButtonWithTitle:@"OK"];
+        [alert runModal];
+        return;
+    }
+    
+    [_chapters release];
+    _chapters = [parsedBook.chapters retain];
+    [self updateChapterMenu];
+    /* Start reading session (Phase 1.5) before loading first chapter */
+    [[XLStorageService sharedService] startReadingSessionForBookId:_book.bookId delegate:self];
+    [self loadCurrentChapter];
+}
+
 - (void)updateChapterMenu {
     [_chapterMenu removeAllItems];
     
@@ -226,9 +280,11 @@
         _book.wordDensity = _userPrefs.defaultWordDensity;
     }
     
-    // Process the chapter with translation engine
+    // Process the chapter with translation engine; a chapter still in flight is no longer wanted
     XLManager *manager = [XLManager sharedManager];
-    [manager processBook:_book delegate:self];
+    [_chapterProcessing cancel];
+    [_chapterProcessing release];
+    _chapterProcessing = [[manager processBook:_book delegate:self] retain];
 }
 
 - (void)displayChapter:(XLProcessedChapter *)chapter {
@@ -236,46 +292,51 @@
         return;
     }
     
+    [_currentChapter release];
     _currentChapter = [chapter retain];
     
-    // Clear previous foreign word tracking
-    [_foreignWordRanges removeAllObjects];
-    [_foreignWordDataMap removeAllObjects];
-    
-    // Create attributed string from processed content
-    NSString *content = chapter.processedContent ? chapter.processedContent : chapter.content;
-    NSMutableAttributedString *attributedContent = [[NSMutableAttributedString alloc] initWithString:content];
+    // The only materialized copy of the book's text: chapters hold UTF-8 (mapped from the extracted-text file)
+    NSString *content = [chapter.processedText isEmpty] ? chapter.content : chapter.processedContent;
+    [_chapterText release];
+    _chapterText = [(content ? content : @"") copy];
+    NSUInteger length = [_chapterText length];
+    
+    // Sorted span table (built by the engine); pages style the words they contain as they load
+    [_foreignWords release];
+    _foreignWords = [chapter.foreignWords retain];
+    [_foreignWordSpans release];
+    _foreignWordSpans = [chapter.foreignWordSpans retain];
+    
+    [self rebuildBaseAttributes];
+    
+    // Lay out a page either side of the saved position, not the whole chapter
+    NSUInteger anchor = MIN(_anchorOffset, length);
+    _anchorOffset = 0;
+    NSUInteger start = anchor > kReaderPageLength ? [self pageBoundaryNear:anchor - kReaderPageLength] : 0;
+    NSUInteger end = [self pageBoundaryNear:MIN(length, anchor + 2 * kReaderPageLength)];
+    _adjustingWindow = YES;
+    _windowStart = start;
+    _windowEnd = MAX(start, end);
+    [[_textView textStorage] setAttributedString:[self styledTextForRange:NSMakeRange(_windowStart, _windowEnd - _windowStart)]];
+    if (anchor == 0) {
+        [_textView scrollToBeginningOfDocument:nil];
+    } else {
+        [self scrollToChapterOffset:anchor delta:0.0];
+    }
+    _adjustingWindow = NO;
     
-    // Apply base font and styling
+    // Update progress
+    [self updateProgress];
+}
+
+#pragma mark - Virtualized layout
+
+- (void)rebuildBaseAttributes {
     NSFont *baseFont = [NSFont fontWithName:_settings.fontFamily size:_settings.fontSize];
     if (!baseFont) {
         baseFont = [NSFont systemFontOfSize:_settings.fontSize];
     }
     
-    NSDictionary *baseAttributes = [NSDictionary dictionaryWithObjectsAndKeys:
-                                    baseFont, NSFontAttributeName,
-                                    [self textColorForTheme], NSForegroundColorAttributeName,
-                                    nil];
-    [attributedContent addAttributes:baseAttributes range:NSMakeRange(0, [attributedContent length])];
-    
-    // Style foreign words
-    if (chapter.foreignWords && [chapter.foreignWords count] > 0) {
-        for (XLForeignWordData *wordData in chapter.foreignWords) {
-            NSRange wordRange = NSMakeRange(wordData.startIndex, wordData.endIndex - wordData.startIndex);
-            if (wordRange.location + wordRange.length <= [attributedContent length]) {
-                // Style foreign word with underline and color
-                NSColor *foreignWordColor = [NSColor colorWithCalibratedRed:0.2 green:0.4 blue:0.8 alpha:1.0];
-                [attributedContent addAttribute:NSForegroundColorAttributeName value:foreignWordColor range:wordRange];
-                [attributedContent addAttribute:NSUnderlineStyleAttributeName value:[NSNumber numberWithInt:NSUnderlineStyleSingle] range:wordRange];
-                
-                // Store range and data for click detection
-                NSValue *rangeValue = [NSValue valueWithRange:wordRange];
-                [_foreignWordRanges addObject:rangeValue];
-                [_foreignWordDataMap setObject:wordData forKey:rangeValue];
-            }
-        }
-    }
-    
     // Set paragraph style for line spacing
     NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
     [paragraphStyle setLineSpacing:(_settings.lineHeight - 1.0) * _settings.fontSize];
@@ -288,18 +349,131 @@
     [paragraphStyle setFirstLineHeadIndent:20.0];
     [paragraphStyle setTailIndent:-20.0];
     
-    [attributedContent addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:NSMakeRange(0, [attributedContent length])];
+    [_baseAttributes release];
+    _baseAttributes = [[NSDictionary alloc] initWithObjectsAndKeys:
+                       baseFont, NSFontAttributeName,
+                       [self textColorForTheme], NSForegroundColorAttributeName,
+                       paragraphStyle, NSParagraphStyleAttributeName,
+                       nil];
     [paragraphStyle release];
-    
-    // Set text in text view
-    [[_textView textStorage] setAttributedString:attributedContent];
-    [attributedContent release];
-    
-    // Scroll to top
-    [_textView scrollToBeginningOfDocument:nil];
-    
-    // Update progress
-    [self updateProgress];
+}
+
+/// First line (or else word) boundary at or after offset, so pages never split a word or a composed character
+- (NSUInteger)pageBoundaryNear:(NSUInteger)offset {
+    NSUInteger length = [_chapterText length];
+    if (offset == 0 || offset >= length) {
+        return MIN(offset, length);
+    }
+    NSRange search = NSMakeRange(offset, MIN(length - offset, kReaderBoundarySearch));
+    NSRange boundary = [_chapterText rangeOfCharacterFromSet:[NSCharacterSet newlineCharacterSet] options:0 range:search];
+    if (boundary.location == NSNotFound) {
+        boundary = [_chapterText rangeOfCharacterFromSet:[NSCharacterSet whitespaceCharacterSet] options:0 range:search];
+    }
+    if (boundary.location != NSNotFound) {
+        return NSMaxRange(boundary);
+    }
+    return [_chapterText rangeOfComposedCharacterSequenceAtIndex:offset].location;
+}
+
+/// Styled slice of the chapter; only foreign words inside the slice are touched (O(log n) to find them)
+- (NSAttributedString *)styledTextForRange:(NSRange)range {
+    NSMutableAttributedString *text = [[NSMutableAttributedString alloc] initWithString:[_chapterText substringWithRange:range]
+                                                                           attributes:_baseAttributes];
+    // One attribute pass per run of adjacent words, inside a single editing transaction
+    [text beginEditing];
+    [_foreignWordSpans enumerateRunsInRange:range usingBlock:^(NSRange run) {
+        [text addAttributes:_foreignWordAttributes range:NSMakeRange(run.location - range.location, run.length)];
+    }];
+    [text endEditing];
+    return [text autorelease];
+}
+
+/// Chapter offsets of the characters currently in the viewport
+- (NSRange)visibleChapterRange {
+    NSLayoutManager *layoutManager = [_textView layoutManager];
+    NSRect visible = [_scrollView documentVisibleRect];
+    NSPoint origin = [_textView textContainerOrigin];
+    visible.origin.x -= origin.x;
+    visible.origin.y -= origin.y;
+    NSRange glyphs = [layoutManager glyphRangeForBoundingRect:visible inTextContainer:[_textView textContainer]];
+    NSRange chars = [layoutManager characterRangeForGlyphRange:glyphs actualGlyphRange:NULL];
+    return NSMakeRange(_windowStart + chars.location, chars.length);
+}
+
+/// Vertical position of the line holding a chapter offset that is inside the window
+- (CGFloat)lineOriginForChapterOffset:(NSUInteger)offset {
+    NSLayoutManager *layoutManager = [_textView layoutManager];
+    NSUInteger local = MIN(offset - _windowStart, [[_textView textStorage] length]);
+    if (local >= [[_textView textStorage] length]) {
+        return NSMaxY([layoutManager usedRectForTextContainer:[_textView textContainer]]);
+    }
+    NSUInteger glyph = [layoutManager glyphIndexForCharacterAtIndex:local];
+    NSRect line = [layoutManager lineFragmentRectForGlyphAtIndex:glyph effectiveRange:NULL];
+    return line.origin.y + [_textView textContainerOrigin].y;
+}
+
+/// Scroll so the line holding offset sits delta points below the top of the viewport
+- (void)scrollToChapterOffset:(NSUInteger)offset delta:(CGFloat)delta {
+    if (offset < _windowStart || offset > _windowEnd) {
+        return;
+    }
+    CGFloat y = [self lineOriginForChapterOffset:offset] - delta;
+    [_textView scrollPoint:NSMakePoint(0, MAX(y, 0.0))];
+}
+
+- (void)scrollViewDidScroll:(NSNotification *)notification {
+    if (_adjustingWindow || !_chapterText) {
+        return;
+    }
+    NSRange visible = [self visibleChapterRange];
+    NSUInteger length = [_chapterText length];
+    if (NSMaxRange(visible) + kReaderEdgeMargin >= _windowEnd && _windowEnd < length) {
+        [self extendWindowForwardKeeping:visible];
+    } else if (visible.location < _windowStart + kReaderEdgeMargin && _windowStart > 0) {
+        [self extendWindowBackwardKeeping:visible];
+    }
+}
+
+/// Append the next page; drop leading pages past the cap, keeping the first visible line where it is
+- (void)extendWindowForwardKeeping:(NSRange)visible {
+    _adjustingWindow = YES;
+    NSUInteger newEnd = [self pageBoundaryNear:MIN([_chapterText length], _windowEnd + kReaderPageLength)];
+    if (newEnd > _windowEnd) {
+        [[_textView textStorage] appendAttributedString:[self styledTextForRange:NSMakeRange(_windowEnd, newEnd - _windowEnd)]];
+        _windowEnd = newEnd;
+    }
+    if (_windowEnd - _windowStart > kReaderMaxWindowPages * kReaderPageLength) {
+        NSUInteger cut = [self pageBoundaryNear:_windowStart + kReaderPageLength];
+        if (cut + kReaderEdgeMargin < visible.location) {
+            CGFloat delta = [self lineOriginForChapterOffset:visible.location] - NSMinY([_scrollView documentVisibleRect]);
+            [[_textView textStorage] deleteCharactersInRange:NSMakeRange(0, cut - _windowStart)];
+            _windowStart = cut;
+            [self scrollToChapterOffset:visible.location delta:delta];
+        }
+    }
+    _adjustingWindow = NO;
+}
+
+/// Prepend the previous page without moving the text under the viewport; drop trailing pages past the cap
+- (void)extendWindowBackwardKeeping:(NSRange)visible {
+    _adjustingWindow = YES;
+    CGFloat delta = [self lineOriginForChapterOffset:visible.location] - NSMinY([_scrollView documentVisibleRect]);
+    NSUInteger newStart = _windowStart > kReaderPageLength ? [self pageBoundaryNear:_windowStart - kReaderPageLength] : 0;
+    if (newStart >= _windowStart) {
+        newStart = 0;
+    }
+    [[_textView textStorage] insertAttributedString:[self styledTextForRange:NSMakeRange(newStart, _windowStart - newStart)] atIndex:0];
+    _windowStart = newStart;
+    if (_windowEnd - _windowStart > kReaderMaxWindowPages * kReaderPageLength) {
+        NSUInteger cut = [self pageBoundaryNear:_windowEnd - kReaderPageLength];
+        if (cut > NSMaxRange(visible) + kReaderEdgeMargin && cut < _windowEnd) {
+            NSUInteger localCut = cut - _windowStart;
+            [[_textView textStorage] deleteCharactersInRange:NSMakeRange(localCut, [[_textView textStorage] length] - localCut)];
+            _windowEnd = cut;
+        }
+    }
+    [self scrollToChapterOffset:visible.location delta:delta];
+    _adjustingWindow = NO;
 }
 
 - (NSColor *)textColorForTheme {
@@ -336,14 +510,21 @@
     if (!_chapters || [_chapters count] == 0) {
         return;
     }
-    double progress = ((double)_currentChapterIndex / (double)[_chapters count]) * 100.0;
+    // Position within the chapter counts too, so reopening lands on the same line
+    NSUInteger offset = 0;
+    double within = 0.0;
+    if (_chapterText && [_chapterText length] > 0 && [[_textView textStorage] length] > 0) {
+        offset = [self visibleChapterRange].location;
+        within = (double)offset / (double)[_chapterText length];
+    }
+    double progress = (((double)_currentChapterIndex + within) / (double)[_chapters count]) * 100.0;
     [_progressIndicator setDoubleValue:progress];
     [_progressLabel setStringValue:[NSString stringWithFormat:@"%.0f%%", progress]];
     _book.progress = progress;
     _book.currentChapter = _currentChapterIndex;
     _book.totalChapters = [_chapters count];
     _book.lastReadAt = [NSDate date];
-    _book.currentLocation = [NSString stringWithFormat:@"%ld", (long)_currentChapterIndex];
+    _book.currentLocation = [NSString stringWithFormat:@"%ld:%lu", (long)_currentChapterIndex, (unsigned long)offset];
     [[XLStorageService sharedService] saveBook:_book delegate:self];
 }
 
@@ -385,24 +566,33 @@
 
 // Handle clicks on foreign words (called from custom text view)
 - (void)handleClickAtCharacterIndex:(NSUInteger)charIndex {
-    // Check if click is on a foreign word
-    for (NSValue *rangeValue in _foreignWordRanges) {
-        NSRange wordRange = [rangeValue rangeValue];
-        if (NSLocationInRange(charIndex, wordRange)) {
-            XLForeignWordData *wordData = [_foreignWordDataMap objectForKey:rangeValue];
-            if (wordData) {
-                [self showTranslationPopupForWord:wordData atLocation:charIndex];
-                return;
-            }
-        }
+    // Text storage indices are relative to the laid-out window
+    charIndex += _windowStart;
+    XLForeignWordData *wordData = [self foreignWordAtChapterOffset:charIndex];
+    if (wordData) {
+        [self showTranslationPopupForWord:wordData atLocation:charIndex];
     }
 }
 
-- (NSString *)extractContextAroundWord:(XLForeignWordData *)wordData {
-    if (!_currentChapter || !_currentChapter.content || wordData.startIndex < 0 || wordData.endIndex > (NSInteger)[_currentChapter.content length]) {
+- (XLForeignWordData *)foreignWordAtChapterOffset:(NSUInteger)offset {
+    NSUInteger index = [_foreignWordSpans indexOfSpanContainingLocation:offset];
+    if (index == NSNotFound) {
         return nil;
     }
+    NSUInteger entry = [_foreignWordSpans spanAtIndex:index].entryIndex;
+    return entry < [_foreignWords count] ? [_foreignWords objectAtIndex:entry] : nil;
+}
+
+/// Hover feedback: pointing hand over foreign words (called from custom text view)
+- (BOOL)isForeignWordAtCharacterIndex:(NSUInteger)charIndex {
+    return [self foreignWordAtChapterOffset:charIndex + _windowStart] != nil;
+}
+
+- (NSString *)extractContextAroundWord:(XLForeignWordData *)wordData {
     NSString *content = _currentChapter.content;
+    if (!content || wordData.startIndex < 0 || wordData.endIndex > (NSInteger)[content length]) {
+        return nil;
+    }
     NSInteger start = wordData.startIndex;
     NSInteger end = wordData.endIndex;
     NSInteger contextLen = 80;
@@ -445,13 +635,18 @@
             [self.delegate readerDidRequestSaveWord:wordData];
         }
     } else if (result == NSAlertSecondButtonReturn) {
-        /* Mark as known - no backend change for now */
+        /* Never replaced again in this language pair (takes effect from the next chapter processed) */
+        if (wordData.originalWord) {
+            [[XLStorageService sharedService] markWordKnown:wordData.originalWord languagePair:_book.languagePair delegate:self];
+        }
     }
 }
 
 #pragma mark - XLManagerDelegate
 
 - (void)manager:(id)manager didProcessChapter:(XLProcessedChapter *)chapter withError:(NSError *)error {
+    [_chapterProcessing release];
+    _chapterProcessing = nil;
     if (error) {
         NSLog(@"Error processing chapter: %@", error);
         NSAlert *alert = [[NSAlert alloc] init];
@@ -465,6 +660,7 @@
 }
 
 - (void)windowWillClose:(NSNotification *)notification {
+    [_chapterProcessing cancel];
     [self updateProgress];
     if (_sessionId) {
         [[XLStorageService sharedService] endReadingSessionWithId:_sessionId wordsRevealed:_wordsRevealed wordsSaved:_wordsSaved delegate:self];
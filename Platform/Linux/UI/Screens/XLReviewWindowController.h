@@ -19,6 +19,9 @@
     NSInteger _dueCount;
     NSInteger _reviewedCount;
     NSInteger _currentIndex;
+    NSMutableDictionary *_inFlightItems;   // graded items awaiting their write, by id
+    BOOL _prefetching;
+    BOOL _refillExhausted;                 // the last refill found nothing new; wait for an empty queue
     BOOL _showingBack;
     NSTextField *_dueLabel;
     NSTextField *_reviewedLabel;
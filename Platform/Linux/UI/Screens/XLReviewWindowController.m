@@ -6,16 +6,46 @@
 
 #import "XLReviewWindowController.h"
 #import "../../../../Core/Services/XLStorageService.h"
+#import "../../../../Core/Services/XLExecutor.h"
 
 static const NSInteger kReviewBatchSize = 20;
+/// Refill the queue once this few cards remain so the next card is always in memory
+static const NSInteger kReviewPrefetchThreshold = 5;
+
+/// Collects a due-cards query run on a worker, for delivery on the main thread
+@interface XLDueItemsReceiver : NSObject <XLStorageServiceDelegate> {
+@public
+    NSArray *_items;
+    NSError *_error;
+}
+@end
+
+@implementation XLDueItemsReceiver
+
+- (void)dealloc {
+    [_items release];
+    [_error release];
+    [super dealloc];
+}
+
+- (void)storageService:(id)service didGetVocabularyDueForReview:(NSArray *)items withError:(NSError *)error {
+    (void)service;
+    _items = [items retain];
+    _error = [error retain];
+}
+
+@end
 
 @interface XLReviewWindowController ()
 - (void)showCurrentCard;
 - (void)showFront;
 - (void)showBack;
 - (void)gradeAndAdvance:(NSInteger)quality;
+- (void)prefetchIfNeeded;
+- (void)didPrefetchDueItems:(NSArray *)items;
 - (void)setGradeButtonsHidden:(BOOL)hidden;
 - (void)setCardAreaHidden:(BOOL)hidden;
+- (void)storageDidChange:(NSNotification *)notification;
 @end
 
 @implementation XLReviewWindowController
@@ -27,6 +57,9 @@ static const NSInteger kReviewBatchSize = 20;
         _dueCount = 0;
         _reviewedCount = 0;
         _currentIndex = 0;
+        _inFlightItems = [[NSMutableDictionary alloc] init];
+        _prefetching = NO;
+        _refillExhausted = NO;
         _showingBack = NO;
         _storageService = [XLStorageService sharedService];
     }
@@ -34,7 +67,9 @@ static const NSInteger kReviewBatchSize = 20;
 }
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:XLStorageServiceDidChangeNotification object:nil];
     [_dueItems release];
+    [_inFlightItems release];
     [super dealloc];
 }
 
@@ -128,6 +163,7 @@ static const NSInteger kReviewBatchSize = 20;
     [self setCardAreaHidden:YES];
     [self setGradeButtonsHidden:YES];
     [_noCardsLabel setHidden:YES];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(storageDidChange:) name:XLStorageServiceDidChangeNotification object:nil];
     [self loadDueItems];
 }
 
@@ -139,6 +175,7 @@ static const NSInteger kReviewBatchSize = 20;
 #pragma mark - XLStorageServiceDelegate
 
 - (void)storageService:(id)service didGetVocabularyDueForReview:(NSArray *)items withError:(NSError *)error {
+    _refillExhausted = NO;
     if (error) {
         [_dueLabel setStringValue:@"Error loading"];
         [_noCardsLabel setHidden:NO];
@@ -167,21 +204,121 @@ static const NSInteger kReviewBatchSize = 20;
 }
 
 - (void)storageService:(id)service didRecordReviewForItemId:(NSString *)itemId withSuccess:(BOOL)success error:(NSError *)error {
-    if (!success) return;
-    _reviewedCount++;
-    [_reviewedLabel setStringValue:[NSString stringWithFormat:@"Reviewed: %ld", (long)_reviewedCount]];
-    if (_currentIndex < [_dueItems count]) {
-        [_dueItems removeObjectAtIndex:_currentIndex];
+    XLVocabularyItem *item = [[[_inFlightItems objectForKey:itemId] retain] autorelease];
+    [_inFlightItems removeObjectForKey:itemId];
+    if (success) {
+        _reviewedCount++;
+        [_reviewedLabel setStringValue:[NSString stringWithFormat:@"Reviewed: %ld", (long)_reviewedCount]];
+        return;
+    }
+    if (!item) return;
+    /* The card already advanced; put the failed one back in front so it can be graded again */
+    if (_currentIndex < 0 || _currentIndex > (NSInteger)[_dueItems count]) {
+        _currentIndex = [_dueItems count];
+    }
+    [_dueItems insertObject:item atIndex:_currentIndex];
+    [_noCardsLabel setHidden:YES];
+    [self setCardAreaHidden:NO];
+    [self showCurrentCard];
+}
+
+/// Top up the queue on a worker while the reader grades, so advancing never waits on a query. Once a refill
+/// finds nothing new, the next one waits until the queue is empty.
+- (void)prefetchIfNeeded {
+    NSInteger queued = (NSInteger)[_dueItems count];
+    if (_prefetching || queued > kReviewPrefetchThreshold || (_refillExhausted && queued > 0)) return;
+    _prefetching = YES;
+    /* Queued and in-flight cards are still due until their writes land; ask for enough to get past them */
+    NSInteger limit = queued + (NSInteger)[_inFlightItems count] + kReviewBatchSize;
+    XLStorageService *storage = _storageService;
+    [[XLExecutor sharedExecutor] submitWithPriority:XLWorkPriorityVisible block:^{
+        XLDueItemsReceiver *receiver = [[XLDueItemsReceiver alloc] init];
+        [storage getVocabularyDueForReviewWithLimit:limit delegate:receiver];
+        NSArray *items = [[receiver->_items retain] autorelease];
+        [receiver release];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self didPrefetchDueItems:items];
+        });
+    }];
+}
+
+- (void)didPrefetchDueItems:(NSArray *)items {
+    _prefetching = NO;
+    BOOL wasEmpty = ([_dueItems count] == 0);
+    NSMutableSet *known = [NSMutableSet setWithArray:[_dueItems valueForKey:@"vocabularyId"]];
+    [known addObjectsFromArray:[_inFlightItems allKeys]];
+    NSInteger added = 0;
+    for (XLVocabularyItem *item in items) {
+        if ([known containsObject:item.vocabularyId]) continue;
+        [known addObject:item.vocabularyId];
+        [_dueItems addObject:item];
+        added++;
+    }
+    _refillExhausted = (added == 0);
+    _dueCount += added;
+    [_dueLabel setStringValue:[NSString stringWithFormat:@"Due today: %ld", (long)_dueCount]];
+    if (wasEmpty && added > 0) {
+        _currentIndex = 0;
+        [_noCardsLabel setHidden:YES];
+        [self setCardAreaHidden:NO];
+        [self showCurrentCard];
+    } else if (wasEmpty) {
+        [_noCardsLabel setStringValue:@"No cards due right now."];
+    }
+}
+
+#pragma mark - Change feed
+
+/// Keep the in-memory queue in step with edits made elsewhere (vocabulary window, reader)
+- (void)storageDidChange:(NSNotification *)notification {
+    XLStorageChangeSet *changes = [[notification userInfo] objectForKey:XLStorageChangeSetKey];
+    if (![changes touchesTable:XLStorageTableVocabulary]) return;
+    if ([_dueItems count] == 0) {
+        if ([[changes insertedIdsForTable:XLStorageTableVocabulary] count] > 0) {
+            [self loadDueItems];
+        }
+        return;
+    }
+    NSSet *deleted = [changes deletedIdsForTable:XLStorageTableVocabulary];
+    NSSet *updated = [changes updatedIdsForTable:XLStorageTableVocabulary];
+    NSString *currentId = [[_dueItems objectAtIndex:_currentIndex] vocabularyId];
+    NSMutableArray *queuedUpdates = [NSMutableArray array];
+    for (NSInteger i = (NSInteger)[_dueItems count] - 1; i >= 0; i--) {
+        NSString *itemId = [[_dueItems objectAtIndex:i] vocabularyId];
+        if ([deleted containsObject:itemId]) {
+            [_dueItems removeObjectAtIndex:i];
+            if (i < _currentIndex) _currentIndex--;
+        } else if ([updated containsObject:itemId]) {
+            [queuedUpdates addObject:itemId];
+        }
+    }
+    if ([queuedUpdates count] > 0) {
+        [_storageService getVocabularyItemsWithIds:queuedUpdates delegate:self];
     }
     if ([_dueItems count] == 0) {
-        [_storageService getVocabularyDueForReviewWithLimit:kReviewBatchSize delegate:self];
+        [self loadDueItems];
         return;
     }
-    if (_currentIndex >= [_dueItems count]) {
+    if (_currentIndex >= (NSInteger)[_dueItems count]) {
         _currentIndex = [_dueItems count] - 1;
     }
-    _showingBack = NO;
-    [self showCurrentCard];
+    if (![[[_dueItems objectAtIndex:_currentIndex] vocabularyId] isEqualToString:currentId]) {
+        [self showCurrentCard];
+    }
+}
+
+- (void)storageService:(id)service didGetVocabularyItems:(NSArray *)items forIds:(NSArray *)itemIds withError:(NSError *)error {
+    if (error) return;
+    for (XLVocabularyItem *item in items) {
+        for (NSUInteger i = 0; i < [_dueItems count]; i++) {
+            if (![[[_dueItems objectAtIndex:i] vocabularyId] isEqualToString:item.vocabularyId]) continue;
+            [_dueItems replaceObjectAtIndex:i withObject:item];
+            if ((NSInteger)i == _currentIndex) {
+                if (_showingBack) [self showBack]; else [self showFront];
+            }
+            break;
+        }
+    }
 }
 
 #pragma mark - Card display
@@ -238,7 +375,17 @@ static const NSInteger kReviewBatchSize = 20;
 - (void)gradeAndAdvance:(NSInteger)quality {
     if (_currentIndex < 0 || _currentIndex >= [_dueItems count]) return;
     XLVocabularyItem *item = [_dueItems objectAtIndex:_currentIndex];
-    [_storageService recordReviewForItemId:item.vocabularyId quality:quality delegate:self];
+    NSString *itemId = [[item.vocabularyId copy] autorelease];
+    [_inFlightItems setObject:item forKey:itemId];
+    /* Advance first; the write and any refill happen behind the next card */
+    [_dueItems removeObjectAtIndex:_currentIndex];
+    if (_currentIndex >= (NSInteger)[_dueItems count] && [_dueItems count] > 0) {
+        _currentIndex = [_dueItems count] - 1;
+    }
+    _showingBack = NO;
+    [self showCurrentCard];
+    [self prefetchIfNeeded];
+    [_storageService recordReviewForItemId:itemId quality:quality delegate:self];
 }
 
 - (void)gradeAgain:(id)sender { [self gradeAndAdvance:0]; }
@@ -2,11 +2,12 @@
 //  XLStatisticsWindowController.h
 //  Xenolexia
 //
-//  Statistics window (Phase 5): reading stats and "reading over time" 7-day chart
+//  Statistics window (Phase 5): reading stats, "reading over time" 7-day chart and review forecast chart
 
 #import <AppKit/AppKit.h>
 #import "../../../Core/Models/Reader.h"
 #import "../../../Core/Services/XLStorageServiceDelegate.h"
+#import "XLDiagnosticsWindowController.h"
 
 @class XLStorageService;
 
@@ -14,12 +15,14 @@
 - (void)statisticsWindowDidClose;
 @end
 
-/// Simple view that draws a 7-day bar chart (words revealed per day)
+/// Simple view that draws a per-day bar chart (words revealed per day, or reviews due per day)
 @interface XLWordsRevealedChartView : NSView
-@property (nonatomic, copy) NSArray *wordsRevealedByDay; // NSDictionary with @"dayLabel", @"wordsRevealed"
+@property (nonatomic, copy) NSArray *wordsRevealedByDay; // NSDictionary with @"dayLabel" and the value key
+/// Key of the bar value in each item; default @"wordsRevealed"
+@property (nonatomic, copy) NSString *valueKey;
 @end
 
-@interface XLStatisticsWindowController : NSWindowController <XLStorageServiceDelegate> {
+@interface XLStatisticsWindowController : NSWindowController <XLStorageServiceDelegate, XLDiagnosticsWindowDelegate> {
     XLStorageService *_storageService;
     XLReadingStats *_stats;
     NSArray *_wordsRevealedByDay;
@@ -33,7 +36,13 @@
     NSTextField *_averageSessionLabel;
     NSTextField *_chartTitleLabel;
     XLWordsRevealedChartView *_chartView;
+    NSTextField *_forecastTitleLabel;
+    NSPopUpButton *_forecastDaysPopUp;
+    XLWordsRevealedChartView *_forecastChartView;
+    NSUInteger _forecastGeneration;     // only the latest forecast request is shown
     NSButton *_refreshButton;
+    NSButton *_diagnosticsButton;
+    XLDiagnosticsWindowController *_diagnosticsController;
     NSProgressIndicator *_progressIndicator;
 }
 
@@ -2,19 +2,62 @@
 //  XLStatisticsWindowController.m
 //  Xenolexia
 //
-//  Statistics window implementation (Phase 5): stats + 7-day reading over time chart
+//  Statistics window implementation (Phase 5): stats + 7-day reading over time chart + review forecast
 
 #import "XLStatisticsWindowController.h"
 #import "../../../../Core/Services/XLStorageService.h"
+#import "../../../../Core/Services/XLExecutor.h"
 
-#define ROW(y) (520 - (y) * 36)
+#define ROW(y) (740 - (y) * 36)
 #define LABEL_X 24
 #define VALUE_X 280
 #define W 200
 static const NSInteger kChartLastDays = 7;
+/// Forecast horizons offered in the pop-up, in days
+static const NSInteger kForecastDays[] = { 7, 30, 90, 365 };
+static const NSInteger kDefaultForecastIndex = 1;
+/// Vocabulary edits come in bursts (a review session); recompute the forecast once they settle
+static const NSTimeInterval kForecastRefreshDelay = 2.0;
+
+/// Collects a forecast computed on a worker, for delivery on the main thread
+@interface XLForecastReceiver : NSObject <XLStorageServiceDelegate> {
+@public
+    NSArray *_days;
+    NSError *_error;
+}
+@end
+
+@implementation XLForecastReceiver
+
+- (void)dealloc {
+    [_days release];
+    [_error release];
+    [super dealloc];
+}
+
+- (void)storageService:(id)service didGetReviewForecast:(NSArray *)days withError:(NSError *)error {
+    (void)service;
+    _days = [days retain];
+    _error = [error retain];
+}
+
+@end
 
 @implementation XLWordsRevealedChartView {
     NSArray *_wordsRevealedByDay;
+    NSString *_valueKey;
+}
+
+- (NSString *)valueKey {
+    return _valueKey ?: @"wordsRevealed";
+}
+
+- (void)setValueKey:(NSString *)valueKey {
+    if (_valueKey != valueKey) {
+        [_valueKey release];
+        _valueKey = [valueKey copy];
+    }
+    [self setNeedsDisplay:YES];
 }
 
 - (NSArray *)wordsRevealedByDay {
@@ -31,6 +74,7 @@ static const NSInteger kChartLastDays = 7;
 
 - (void)dealloc {
     [_wordsRevealedByDay release];
+    [_valueKey release];
     [super dealloc];
 }
 
@@ -38,14 +82,17 @@ static const NSInteger kChartLastDays = 7;
     (void)dirtyRect;
     NSArray *items = _wordsRevealedByDay;
     if (!items || [items count] == 0) return;
+    NSString *valueKey = [self valueKey];
     NSUInteger n = [items count];
-    NSInteger maxVal = 1;
+    double maxVal = 1;
     for (NSUInteger i = 0; i < n; i++) {
         NSDictionary *d = [items objectAtIndex:i];
-        NSNumber *wr = [d objectForKey:@"wordsRevealed"];
-        if (wr && [wr integerValue] > maxVal) maxVal = [wr integerValue];
+        NSNumber *wr = [d objectForKey:valueKey];
+        if (wr && [wr doubleValue] > maxVal) maxVal = [wr doubleValue];
     }
-    CGFloat barGap = 4.0;
+    /* Long ranges (a year of forecast) get hairline gaps and a label every few bars */
+    CGFloat barGap = MIN(4.0, [self bounds].size.width / (CGFloat)n * 0.2);
+    NSUInteger labelEvery = MAX((NSUInteger)1, (NSUInteger)ceil(n * 48.0 / [self bounds].size.width));
     CGFloat labelH = 20.0;
     CGFloat chartTop = [self bounds].size.height - labelH - 4.0;
     CGFloat chartH = chartTop - 8.0;
@@ -55,15 +102,15 @@ static const NSInteger kChartLastDays = 7;
     NSDictionary *labelAttrs = [NSDictionary dictionaryWithObjectsAndKeys:labelFont, NSFontAttributeName, [NSColor controlTextColor], NSForegroundColorAttributeName, nil];
     for (NSUInteger i = 0; i < n; i++) {
         NSDictionary *d = [items objectAtIndex:i];
-        NSNumber *wr = [d objectForKey:@"wordsRevealed"];
+        NSNumber *wr = [d objectForKey:valueKey];
         NSString *dayLabel = [d objectForKey:@"dayLabel"];
-        NSInteger val = wr ? [wr integerValue] : 0;
-        CGFloat barHeight = (maxVal > 0) ? (CGFloat)val / (CGFloat)maxVal * chartH : 0;
+        double val = wr ? [wr doubleValue] : 0;
+        CGFloat barHeight = (maxVal > 0) ? (CGFloat)(val / maxVal) * chartH : 0;
         CGFloat x = 8.0 + (CGFloat)i * (barW + barGap) + barGap;
         NSRect barRect = NSMakeRect(x, 8.0, barW, barHeight);
         [[NSColor colorWithCalibratedRed:0.3 green:0.5 blue:0.9 alpha:1.0] set];
         NSRectFill(barRect);
-        if (dayLabel && [dayLabel length] > 0) {
+        if (dayLabel && [dayLabel length] > 0 && i % labelEvery == 0) {
             CGFloat labelY = [self bounds].size.height - labelH;
             [dayLabel drawAtPoint:NSMakePoint(x, labelY) withAttributes:labelAttrs];
         }
@@ -75,8 +122,11 @@ static const NSInteger kChartLastDays = 7;
 @interface XLStatisticsWindowController ()
 - (void)updateDisplay;
 - (void)updateChart;
+- (void)loadForecast;
+- (void)didLoadForecast:(NSArray *)days error:(NSError *)error generation:(NSUInteger)generation;
 - (NSTextField *)labelWithTitle:(NSString *)title atY:(CGFloat)y;
 - (NSTextField *)valueLabelAtY:(CGFloat)y;
+- (void)storageDidChange:(NSNotification *)notification;
 @end
 
 @implementation XLStatisticsWindowController
@@ -92,6 +142,9 @@ static const NSInteger kChartLastDays = 7;
 }
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:XLStorageServiceDidChangeNotification object:nil];
+    [_diagnosticsController setDelegate:nil];
+    [_diagnosticsController release];
     [_stats release];
     [_wordsRevealedByDay release];
     [super dealloc];
@@ -101,16 +154,16 @@ static const NSInteger kChartLastDays = 7;
     [super windowDidLoad];
     NSView *contentView = [self.window contentView];
     [self.window setTitle:@"Xenolexia - Statistics"];
-    [self.window setContentSize:NSMakeSize(520, 560)];
-    [self.window setMinSize:NSMakeSize(400, 480)];
+    [self.window setContentSize:NSMakeSize(520, 780)];
+    [self.window setMinSize:NSMakeSize(400, 700)];
 
-    _progressIndicator = [[NSProgressIndicator alloc] initWithFrame:NSMakeRect(220, 260, 80, 80)];
+    _progressIndicator = [[NSProgressIndicator alloc] initWithFrame:NSMakeRect(220, 370, 80, 80)];
     [_progressIndicator setStyle:NSProgressIndicatorSpinningStyle];
     [_progressIndicator setIndeterminate:YES];
     [_progressIndicator setDisplayedWhenStopped:NO];
     [contentView addSubview:_progressIndicator];
 
-    _chartTitleLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(LABEL_X, 218, 400, 20)];
+    _chartTitleLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(LABEL_X, 438, 400, 20)];
     [_chartTitleLabel setStringValue:@"Reading over time (last 7 days)"];
     [_chartTitleLabel setEditable:NO];
     [_chartTitleLabel setBordered:NO];
@@ -118,10 +171,32 @@ static const NSInteger kChartLastDays = 7;
     [_chartTitleLabel setFont:[NSFont systemFontOfSize:13]];
     [contentView addSubview:_chartTitleLabel];
 
-    _chartView = [[XLWordsRevealedChartView alloc] initWithFrame:NSMakeRect(LABEL_X, 24, 472, 190)];
+    _chartView = [[XLWordsRevealedChartView alloc] initWithFrame:NSMakeRect(LABEL_X, 244, 472, 190)];
     [_chartView setAutoresizingMask:NSViewMinYMargin];
     [contentView addSubview:_chartView];
 
+    _forecastTitleLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(LABEL_X, 218, 300, 20)];
+    [_forecastTitleLabel setStringValue:@"Reviews due (forecast)"];
+    [_forecastTitleLabel setEditable:NO];
+    [_forecastTitleLabel setBordered:NO];
+    [_forecastTitleLabel setBackgroundColor:[NSColor controlBackgroundColor]];
+    [_forecastTitleLabel setFont:[NSFont systemFontOfSize:13]];
+    [contentView addSubview:_forecastTitleLabel];
+
+    _forecastDaysPopUp = [[NSPopUpButton alloc] initWithFrame:NSMakeRect(356, 214, 140, 24) pullsDown:NO];
+    for (NSUInteger i = 0; i < sizeof(kForecastDays) / sizeof(kForecastDays[0]); i++) {
+        [_forecastDaysPopUp addItemWithTitle:[NSString stringWithFormat:@"Next %ld days", (long)kForecastDays[i]]];
+    }
+    [_forecastDaysPopUp selectItemAtIndex:kDefaultForecastIndex];
+    [_forecastDaysPopUp setTarget:self];
+    [_forecastDaysPopUp setAction:@selector(forecastDaysChanged:)];
+    [contentView addSubview:_forecastDaysPopUp];
+
+    _forecastChartView = [[XLWordsRevealedChartView alloc] initWithFrame:NSMakeRect(LABEL_X, 32, 472, 180)];
+    [_forecastChartView setValueKey:@"due"];
+    [_forecastChartView setAutoresizingMask:NSViewMinYMargin];
+    [contentView addSubview:_forecastChartView];
+
     NSInteger y = 0;
     _totalBooksReadLabel = [self valueLabelAtY:ROW(y)];
     [contentView addSubview:[self labelWithTitle:@"Total books read" atY:ROW(y)]];
@@ -163,13 +238,20 @@ static const NSInteger kChartLastDays = 7;
     [contentView addSubview:_averageSessionLabel];
     y++;
 
-    _refreshButton = [[NSButton alloc] initWithFrame:NSMakeRect(200, 4, 120, 24)];
+    _refreshButton = [[NSButton alloc] initWithFrame:NSMakeRect(130, 4, 120, 24)];
     [_refreshButton setTitle:@"Refresh"];
     [_refreshButton setTarget:self];
     [_refreshButton setAction:@selector(refreshClicked:)];
     [contentView addSubview:_refreshButton];
 
+    _diagnosticsButton = [[NSButton alloc] initWithFrame:NSMakeRect(270, 4, 120, 24)];
+    [_diagnosticsButton setTitle:@"Diagnostics..."];
+    [_diagnosticsButton setTarget:self];
+    [_diagnosticsButton setAction:@selector(diagnosticsClicked:)];
+    [contentView addSubview:_diagnosticsButton];
+
     [self updateDisplay];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(storageDidChange:) name:XLStorageServiceDidChangeNotification object:nil];
     [self loadStats];
 }
 
@@ -198,6 +280,52 @@ static const NSInteger kChartLastDays = 7;
     [_progressIndicator startAnimation:nil];
     [_storageService getReadingStatsWithDelegate:self];
     [_storageService getWordsRevealedByDayWithLastDays:kChartLastDays delegate:self];
+    [self loadForecast];
+}
+
+/// The forecast simulates every unlearned card over the horizon: run it on a maintenance worker, not the main thread
+- (void)loadForecast {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(loadForecast) object:nil];
+    NSInteger index = _forecastDaysPopUp ? [_forecastDaysPopUp indexOfSelectedItem] : kDefaultForecastIndex;
+    if (index < 0) index = kDefaultForecastIndex;
+    NSInteger days = kForecastDays[index];
+    NSUInteger generation = ++_forecastGeneration;
+    XLStorageService *storage = _storageService;
+    [[XLExecutor sharedExecutor] submitWithPriority:XLWorkPriorityMaintenance block:^{
+        XLForecastReceiver *receiver = [[XLForecastReceiver alloc] init];
+        [storage getReviewForecastForDays:days gradeWeights:nil delegate:receiver];
+        NSArray *result = [[receiver->_days retain] autorelease];
+        NSError *error = [[receiver->_error retain] autorelease];
+        [receiver release];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self didLoadForecast:result error:error generation:generation];
+        });
+    }];
+}
+
+- (void)didLoadForecast:(NSArray *)days error:(NSError *)error generation:(NSUInteger)generation {
+    if (generation != _forecastGeneration) return;
+    [_forecastChartView setWordsRevealedByDay:(error || !days) ? [NSArray array] : days];
+}
+
+- (IBAction)forecastDaysChanged:(id)sender {
+    (void)sender;
+    [self loadForecast];
+}
+
+/// The figures and the 7-day chart read the daily_stats/stats_state rollups and are re-read at once; the
+/// forecast scans the vocabulary, so it is recomputed only after vocabulary changes settle
+- (void)storageDidChange:(NSNotification *)notification {
+    XLStorageChangeSet *changes = [[notification userInfo] objectForKey:XLStorageChangeSetKey];
+    BOOL vocabulary = [changes touchesTable:XLStorageTableVocabulary];
+    if (vocabulary || [changes touchesTable:XLStorageTableDailyStats] || [changes touchesTable:XLStorageTableReadingSessions]) {
+        [_storageService getReadingStatsWithDelegate:self];
+        [_storageService getWordsRevealedByDayWithLastDays:kChartLastDays delegate:self];
+    }
+    if (vocabulary) {
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(loadForecast) object:nil];
+        [self performSelector:@selector(loadForecast) withObject:nil afterDelay:kForecastRefreshDelay];
+    }
 }
 
 #pragma mark - XLStorageServiceDelegate
@@ -256,9 +384,25 @@ static const NSInteger kChartLastDays = 7;
     [_progressIndicator startAnimation:nil];
     [_storageService getReadingStatsWithDelegate:self];
     [_storageService getWordsRevealedByDayWithLastDays:kChartLastDays delegate:self];
+    [self loadForecast];
+}
+
+- (IBAction)diagnosticsClicked:(id)sender {
+    (void)sender;
+    if (!_diagnosticsController) {
+        _diagnosticsController = [[XLDiagnosticsWindowController alloc] init];
+        [_diagnosticsController setDelegate:self];
+    }
+    [_diagnosticsController showWindow:nil];
+}
+
+- (void)diagnosticsWindowDidClose {
+    [_diagnosticsController autorelease];
+    _diagnosticsController = nil;
 }
 
 - (void)windowWillClose:(NSNotification *)notification {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(loadForecast) object:nil];
     if (_delegate && [_delegate respondsToSelector:@selector(statisticsWindowDidClose)]) {
         [_delegate statisticsWindowDidClose];
     }
@@ -16,9 +16,14 @@
 @end
 
 @interface XLVocabularyWindowController : NSWindowController <NSTableViewDataSource, NSTableViewDelegate, XLStorageServiceDelegate> {
-    NSArray *_items;
-    NSArray *_filteredItems;
+    NSMutableArray *_items;          // rows loaded so far (keyset pages, display order)
+    NSString *_nextPageToken;        // continuation token for the next page
+    BOOL _hasMorePages;
+    NSInteger _totalCount;           // COUNT(*) for the current query/status filter
+    NSString *_appliedSearchQuery;   // folded query _items was loaded or narrowed with
     NSInteger _dueCount;
+    BOOL _exporting;
+    volatile BOOL _exportCancelled;  // set on main, read by the export thread
     NSTableView *_tableView;
     NSSearchField *_searchField;
     NSPopUpButton *_statusFilterPopUp;
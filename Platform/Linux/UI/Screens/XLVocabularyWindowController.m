@@ -9,10 +9,21 @@
 #import "../../../../Core/Services/XLStorageService.h"
 #import "../../../../Core/Services/XLExportService.h"
 #import "../../../../Core/Models/Language.h"
+#import "../../../../Core/Models/SearchKey.h"
+
+/// Rows fetched per keyset page; the table only pulls pages as rows scroll into view
+static const NSInteger kVocabularyPageSize = 100;
+/* Keystrokes closer together than this trigger one query */
+static const NSTimeInterval kSearchDebounceInterval = 0.12;
 
 @interface XLVocabularyWindowController ()
-- (void)filterItems;
+- (NSString *)selectedStatusCode;
+- (void)loadPagesThroughRow:(NSInteger)row;
+- (XLVocabularyItem *)itemAtRow:(NSInteger)row;
 - (void)reloadTable;
+- (void)applySearchQuery;
+- (BOOL)itemMatchesFilter:(XLVocabularyItem *)item;
+- (void)storageDidChange:(NSNotification *)notification;
 - (void)showEditSheetForItem:(XLVocabularyItem *)item;
 - (void)performExportWithFormat:(XLExportFormat)format;
 @end
@@ -22,17 +33,24 @@
 - (instancetype)init {
     self = [super initWithWindowNibName:nil];
     if (self) {
-        _items = [[NSArray alloc] init];
-        _filteredItems = [[NSArray alloc] init];
+        _items = [[NSMutableArray alloc] init];
+        _nextPageToken = nil;
+        _hasMorePages = NO;
+        _totalCount = 0;
         _dueCount = 0;
+        _exporting = NO;
+        _exportCancelled = NO;
+        _appliedSearchQuery = @"";
         _storageService = [XLStorageService sharedService];
     }
     return self;
 }
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:XLStorageServiceDidChangeNotification object:nil];
     [_items release];
-    [_filteredItems release];
+    [_nextPageToken release];
+    [_appliedSearchQuery release];
     [super dealloc];
 }
 
@@ -118,71 +136,171 @@
     [contentView addSubview:scrollView];
     [scrollView release];
 
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(storageDidChange:) name:XLStorageServiceDidChangeNotification object:nil];
     [self refreshVocabulary];
     [self refreshDueCount];
 }
 
 - (void)refreshVocabulary {
+    [_items removeAllObjects];
+    [_nextPageToken release];
+    _nextPageToken = nil;
+    _hasMorePages = YES;
     NSString *query = [_searchField stringValue];
-    if (query && [query length] > 0) {
-        [_storageService searchVocabularyWithQuery:query delegate:self];
-    } else {
-        [_storageService getAllVocabularyItemsWithDelegate:self];
-    }
+    NSString *status = [self selectedStatusCode];
+    [_appliedSearchQuery release];
+    _appliedSearchQuery = [XLFoldedSearchKey(query) copy];
+    [_storageService getVocabularyCountWithQuery:query status:status delegate:self];
+    [self loadPagesThroughRow:kVocabularyPageSize - 1];
+    [self reloadTable];
 }
 
 - (void)refreshDueCount {
     [_storageService getVocabularyDueForReviewWithLimit:1000 delegate:self];
 }
 
-#pragma mark - Filter / Reload
+#pragma mark - Paging / Reload
 
-- (void)filterItems {
-    NSInteger idx = [_statusFilterPopUp indexOfSelectedItem];
-    if (idx <= 0) {
-        _filteredItems = _items;
-    } else {
-        XLVocabularyStatus want = XLVocabularyStatusNew;
-        switch (idx) {
-            case 1: want = XLVocabularyStatusNew; break;
-            case 2: want = XLVocabularyStatusLearning; break;
-            case 3: want = XLVocabularyStatusReview; break;
-            case 4: want = XLVocabularyStatusLearned; break;
-            default: want = XLVocabularyStatusNew; break;
-        }
-        NSMutableArray *a = [NSMutableArray array];
-        for (XLVocabularyItem *item in _items) {
-            if (item.status == want) [a addObject:item];
-        }
-        _filteredItems = a;
+- (NSString *)selectedStatusCode {
+    switch ([_statusFilterPopUp indexOfSelectedItem]) {
+        case 1: return [XLVocabularyItem codeStringForStatus:XLVocabularyStatusNew];
+        case 2: return [XLVocabularyItem codeStringForStatus:XLVocabularyStatusLearning];
+        case 3: return [XLVocabularyItem codeStringForStatus:XLVocabularyStatusReview];
+        case 4: return [XLVocabularyItem codeStringForStatus:XLVocabularyStatusLearned];
+        default: return nil;
+    }
+}
+
+- (void)loadPagesThroughRow:(NSInteger)row {
+    NSString *query = _appliedSearchQuery;
+    NSString *status = [self selectedStatusCode];
+    while (_hasMorePages && row >= (NSInteger)[_items count]) {
+        NSUInteger before = [_items count];
+        [_storageService getVocabularyPageWithQuery:query status:status afterToken:_nextPageToken limit:kVocabularyPageSize delegate:self];
+        if ([_items count] == before) break;
     }
+}
+
+- (XLVocabularyItem *)itemAtRow:(NSInteger)row {
+    if (row < 0) return nil;
+    [self loadPagesThroughRow:row];
+    if (row >= (NSInteger)[_items count]) return nil;
+    return [_items objectAtIndex:row];
+}
+
+/// Debounced search. Once every row for the applied query is loaded, a query that contains it can
+/// only match a subset of those rows, so the list is narrowed in memory instead of re-queried.
+- (void)applySearchQuery {
+    NSString *query = XLFoldedSearchKey([_searchField stringValue]);
+    if ([query isEqualToString:_appliedSearchQuery]) return;
+    BOOL narrowing = !_hasMorePages && [query rangeOfString:_appliedSearchQuery options:NSLiteralSearch].location != NSNotFound;
+    if (!narrowing) {
+        [self refreshVocabulary];
+        return;
+    }
+    NSMutableIndexSet *misses = [NSMutableIndexSet indexSet];
+    for (NSUInteger i = 0; i < [_items count]; i++) {
+        if (!XLSearchKeyMatches([[_items objectAtIndex:i] searchKey], query)) [misses addIndex:i];
+    }
+    [_items removeObjectsAtIndexes:misses];
+    _totalCount = [_items count];
+    [_appliedSearchQuery release];
+    _appliedSearchQuery = [query copy];
     [self reloadTable];
 }
 
 - (void)reloadTable {
     [_tableView reloadData];
-    NSUInteger n = [_filteredItems count];
-    [_statusLabel setStringValue:[NSString stringWithFormat:@"%lu word%@", (unsigned long)n, n == 1 ? @"" : @"s"]];
+    NSInteger n = _hasMorePages ? _totalCount : (NSInteger)[_items count];
+    [_statusLabel setStringValue:[NSString stringWithFormat:@"%ld word%@", (long)n, n == 1 ? @"" : @"s"]];
 }
 
-#pragma mark - XLStorageServiceDelegate
+#pragma mark - Change feed
+
+- (BOOL)itemMatchesFilter:(XLVocabularyItem *)item {
+    NSString *status = [self selectedStatusCode];
+    if (status && ![status isEqualToString:[XLVocabularyItem codeStringForStatus:item.status]]) return NO;
+    return XLSearchKeyMatches(item.searchKey, _appliedSearchQuery);
+}
 
-- (void)storageService:(id)service didGetAllVocabularyItems:(NSArray *)items withError:(NSError *)error {
+- (void)storageDidChange:(NSNotification *)notification {
+    XLStorageChangeSet *changes = [[notification userInfo] objectForKey:XLStorageChangeSetKey];
+    if (![changes touchesTable:XLStorageTableVocabulary]) return;
+    NSSet *deleted = [changes deletedIdsForTable:XLStorageTableVocabulary];
+    NSMutableSet *changed = [NSMutableSet setWithSet:[changes insertedIdsForTable:XLStorageTableVocabulary]];
+    [changed unionSet:[changes updatedIdsForTable:XLStorageTableVocabulary]];
+
+    NSUInteger before = [_items count];
+    for (NSInteger i = (NSInteger)[_items count] - 1; i >= 0; i--) {
+        if ([deleted containsObject:[[_items objectAtIndex:i] vocabularyId]]) {
+            [_items removeObjectAtIndex:i];
+        }
+    }
+    _totalCount -= (NSInteger)(before - [_items count]);
+    if ([changed count] > 0) {
+        [_storageService getVocabularyItemsWithIds:[changed allObjects] delegate:self];
+    } else {
+        [self reloadTable];
+    }
+    [self refreshDueCount];
+}
+
+- (void)storageService:(id)service didGetVocabularyItems:(NSArray *)items forIds:(NSArray *)itemIds withError:(NSError *)error {
     if (error) {
-        [_statusLabel setStringValue:@"Error loading vocabulary"];
+        [self refreshVocabulary];
         return;
     }
-    _items = items ? [items copy] : [[NSArray alloc] init];
-    [self filterItems];
+    NSSet *ids = [NSSet setWithArray:itemIds];
+    for (NSInteger i = (NSInteger)[_items count] - 1; i >= 0; i--) {
+        if ([ids containsObject:[[_items objectAtIndex:i] vocabularyId]]) {
+            [_items removeObjectAtIndex:i];
+        }
+    }
+    for (XLVocabularyItem *item in items) {
+        if (![self itemMatchesFilter:item]) continue;
+        /* Same order as the page query: added_at DESC, id DESC */
+        NSUInteger lo = 0, hi = [_items count];
+        while (lo < hi) {
+            NSUInteger mid = (lo + hi) / 2;
+            XLVocabularyItem *other = [_items objectAtIndex:mid];
+            NSComparisonResult r = [other.addedAt compare:item.addedAt];
+            if (r == NSOrderedSame) r = [other.vocabularyId compare:item.vocabularyId];
+            if (r == NSOrderedDescending) lo = mid + 1; else hi = mid;
+        }
+        /* Rows past the loaded range arrive with later pages */
+        if (lo < [_items count] || !_hasMorePages) {
+            [_items insertObject:item atIndex:lo];
+        }
+    }
+    if (_hasMorePages) {
+        [_storageService getVocabularyCountWithQuery:_appliedSearchQuery status:[self selectedStatusCode] delegate:self];
+    } else {
+        _totalCount = [_items count];
+    }
+    [self reloadTable];
 }
 
-- (void)storageService:(id)service didSearchVocabulary:(NSArray *)items withError:(NSError *)error {
-    if (error) {
-        [_statusLabel setStringValue:@"Error searching"];
+#pragma mark - XLStorageServiceDelegate
+
+- (void)storageService:(id)service didGetVocabularyCount:(NSInteger)count withError:(NSError *)error {
+    _totalCount = error ? 0 : count;
+}
+
+- (void)storageService:(id)service didGetVocabularyPage:(XLStoragePage *)page withError:(NSError *)error {
+    if (error || !page) {
+        _hasMorePages = NO;
+        [_statusLabel setStringValue:@"Error loading vocabulary"];
         return;
     }
-    _items = items ? [items copy] : [[NSArray alloc] init];
-    [self filterItems];
+    [_items addObjectsFromArray:page.items];
+    [_nextPageToken release];
+    _nextPageToken = [page.continuationToken copy];
+    _hasMorePages = [page hasMore];
+    if (!_hasMorePages && (NSInteger)[_items count] != _totalCount) {
+        /* Rows changed since the count was taken; settle the row count after this table pass */
+        _totalCount = [_items count];
+        [_tableView performSelector:@selector(noteNumberOfRowsChanged) withObject:nil afterDelay:0];
+    }
 }
 
 - (void)storageService:(id)service didGetVocabularyDueForReview:(NSArray *)items withError:(NSError *)error {
@@ -199,28 +317,19 @@
     }
 }
 
-- (void)storageService:(id)service didSaveVocabularyItem:(XLVocabularyItem *)item withSuccess:(BOOL)success error:(NSError *)error {
-    if (success) {
-        [self refreshVocabulary];
-    }
-}
-
-- (void)storageService:(id)service didDeleteVocabularyItemWithId:(NSString *)itemId withSuccess:(BOOL)success error:(NSError *)error {
-    if (success) {
-        [self refreshVocabulary];
-        [self refreshDueCount];
-    }
-}
+/* Successful saves and deletes reach the table through storageDidChange: */
 
 #pragma mark - NSTableViewDataSource
 
 - (NSInteger)numberOfRowsInTableView:(NSTableView *)tableView {
-    return [_filteredItems count];
+    NSInteger loaded = (NSInteger)[_items count];
+    if (!_hasMorePages) return loaded;
+    return _totalCount > loaded ? _totalCount : loaded;
 }
 
 - (id)tableView:(NSTableView *)tableView objectValueForTableColumn:(NSTableColumn *)tableColumn row:(NSInteger)row {
-    if (row < 0 || row >= [_filteredItems count]) return nil;
-    XLVocabularyItem *item = [_filteredItems objectAtIndex:row];
+    XLVocabularyItem *item = [self itemAtRow:row];
+    if (!item) return nil;
     NSString *colId = [tableColumn identifier];
     if ([colId isEqualToString:@"source"]) return item.sourceWord ?: @"";
     if ([colId isEqualToString:@"target"]) return item.targetWord ?: @"";
@@ -242,31 +351,30 @@
 #pragma mark - Actions
 
 - (IBAction)searchFieldChanged:(id)sender {
-    [self refreshVocabulary];
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(applySearchQuery) object:nil];
+    [self performSelector:@selector(applySearchQuery) withObject:nil afterDelay:kSearchDebounceInterval];
 }
 
 - (IBAction)filterPopUpChanged:(id)sender {
-    [self filterItems];
+    [self refreshVocabulary];
 }
 
 - (void)tableViewDoubleClick:(id)sender {
-    NSInteger row = [_tableView clickedRow];
-    if (row >= 0 && row < [_filteredItems count]) {
-        XLVocabularyItem *item = [_filteredItems objectAtIndex:row];
+    XLVocabularyItem *item = [self itemAtRow:[_tableView clickedRow]];
+    if (item) {
         [self showEditSheetForItem:item];
     }
 }
 
 - (IBAction)editButtonClicked:(id)sender {
-    NSInteger row = [_tableView selectedRow];
-    if (row < 0 || row >= [_filteredItems count]) {
+    XLVocabularyItem *item = [self itemAtRow:[_tableView selectedRow]];
+    if (!item) {
         NSAlert *a = [[NSAlert alloc] init];
         [a setMessageText:@"Select a word to edit."];
         [a addButtonWithTitle:@"OK"];
         [a runModal];
         return;
     }
-    XLVocabularyItem *item = [_filteredItems objectAtIndex:row];
     [self showEditSheetForItem:item];
 }
 
@@ -346,15 +454,14 @@
 }
 
 - (IBAction)deleteButtonClicked:(id)sender {
-    NSInteger row = [_tableView selectedRow];
-    if (row < 0 || row >= [_filteredItems count]) {
+    XLVocabularyItem *item = [self itemAtRow:[_tableView selectedRow]];
+    if (!item) {
         NSAlert *a = [[NSAlert alloc] init];
         [a setMessageText:@"Select a word to delete."];
         [a addButtonWithTitle:@"OK"];
         [a runModal];
         return;
     }
-    XLVocabularyItem *item = [_filteredItems objectAtIndex:row];
     NSAlert *a = [[NSAlert alloc] init];
     [a setMessageText:@"Delete word"];
     [a setInformativeText:[NSString stringWithFormat:@"Delete \"%@\" from vocabulary?", item.sourceWord ?: @"this word"]];
@@ -367,6 +474,10 @@
 }
 
 - (IBAction)exportButtonClicked:(id)sender {
+    if (_exporting) {
+        _exportCancelled = YES;
+        return;
+    }
     NSMenu *menu = [[NSMenu alloc] init];
     NSMenuItem *csvItem = [[NSMenuItem alloc] initWithTitle:@"Export as CSV" action:@selector(exportCSV:) keyEquivalent:@""];
     [csvItem setTarget:self];
@@ -396,21 +507,40 @@
     NSSavePanel *panel = [NSSavePanel savePanel];
     [panel setAllowedFileTypes:[NSArray arrayWithObject:ext]];
     [panel setCanCreateDirectories:YES];
-    if ([panel runModal] == NSFileHandlingPanelOKButton) {
-        NSURL *url = [panel URL];
-        NSString *path = url ? [url path] : nil;
-        if (path && [_filteredItems count] > 0) {
-            XLExportService *ex = [[XLExportService alloc] init];
-            [ex exportVocabularyItems:_filteredItems format:format toFilePath:path withCompletion:^(BOOL success, NSError *err) {
+    if ([panel runModal] != NSFileHandlingPanelOKButton) return;
+    NSString *path = [panel URL] ? [[panel URL] path] : nil;
+    if (!path) return;
+
+    /* Export covers the whole filtered list; rows stream from a cursor on a background thread */
+    XLVocabularyCursor *cursor = [_storageService vocabularyCursorWithQuery:_appliedSearchQuery status:[self selectedStatusCode]];
+    _exporting = YES;
+    _exportCancelled = NO;
+    [_exportButton setTitle:@"Cancel"];
+    [_statusLabel setStringValue:@"Exporting..."];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XLExportService *ex = [[XLExportService alloc] init];
+        [ex exportVocabularyFromCursor:cursor format:format toFilePath:path progress:^(NSUInteger written, NSUInteger total, BOOL *stop) {
+            *stop = _exportCancelled;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (_exporting) {
+                    [_statusLabel setStringValue:[NSString stringWithFormat:@"Exporting... %lu of %lu", (unsigned long)written, (unsigned long)total]];
+                }
+            });
+        } withCompletion:^(BOOL success, NSError *err) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                _exporting = NO;
+                [_exportButton setTitle:@"Export"];
                 if (success) {
                     [_statusLabel setStringValue:[NSString stringWithFormat:@"Exported to %@", path]];
+                } else if ([err code] == XLExportErrorCancelled) {
+                    [_statusLabel setStringValue:@"Export cancelled"];
                 } else {
                     [_statusLabel setStringValue:[NSString stringWithFormat:@"Export failed: %@", err ? [err localizedDescription] : @"unknown"]];
                 }
-            }];
-            [ex release];
-        }
-    }
+            });
+        }];
+        [ex release];
+    });
 }
 
 - (void)windowWillClose:(NSNotification *)notification {
@@ -418,7 +548,5 @@
         [_delegate vocabularyWindowDidClose];
     }
 }
-</think>
-Adding `#import <objc/runtime.h>` and fixing the edit sheet (avoid `beginSheet` completionHandler capturing; use associated objects or a modal).
-<｜tool▁calls▁begin｜><｜tool▁call▁begin｜>
-StrReplace
\ No newline at end of file
+
+@end
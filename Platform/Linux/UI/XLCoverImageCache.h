@@ -0,0 +1,48 @@
+//
+//  XLCoverImageCache.h
+//  Xenolexia
+//
+//  Bounded LRU cache of decoded book covers, filled off the main thread.
+//
+
+#import <AppKit/AppKit.h>
+
+@class XLCoverCacheEntry;
+
+typedef void (^XLCoverImageCompletion)(NSImage *image);
+
+/// Main-thread API. Covers are read and decoded on a background queue and delivered on the main queue;
+/// concurrent requests for the same path share one decode. The cache evicts least-recently-used covers
+/// once either the count or the decoded byte cost (width * height * 4) exceeds its limit.
+@interface XLCoverImageCache : NSObject {
+    NSMutableDictionary *_entries;      // path -> XLCoverCacheEntry
+    XLCoverCacheEntry *_head;           // most recently used
+    XLCoverCacheEntry *_tail;           // next to evict
+    NSUInteger _countLimit;
+    NSUInteger _costLimit;
+    NSUInteger _totalCost;
+    NSMutableDictionary *_loads;        // path -> XLCoverLoad in flight
+    dispatch_queue_t _decodeQueue;
+}
+
++ (instancetype)sharedCache;
+
+/// Default 256 covers
+@property (nonatomic, assign) NSUInteger countLimit;
+/// Default 64 MB of decoded pixels
+@property (nonatomic, assign) NSUInteger costLimit;
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+/// Cached cover for path, marking it most recently used; nil on a miss
+- (NSImage *)cachedImageForPath:(NSString *)path;
+
+/// Deliver the cover for path on the main queue (nil if missing or undecodable). Cached covers are
+/// delivered synchronously. owner is not retained; it only identifies the request for cancellation.
+- (void)loadImageForPath:(NSString *)path owner:(id)owner completion:(XLCoverImageCompletion)completion;
+
+/// Drop owner's pending completions; a decode nobody waits for any more is skipped
+- (void)cancelLoadsForOwner:(id)owner;
+
+- (void)removeAllImages;
+
+@end
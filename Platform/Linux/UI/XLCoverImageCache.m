@@ -0,0 +1,251 @@
+//
+//  XLCoverImageCache.m
+//  Xenolexia
+//
+
+#import "XLCoverImageCache.h"
+
+/// Node in the LRU list; confined to the main thread
+@interface XLCoverCacheEntry : NSObject {
+@public
+    NSString *_path;
+    NSImage *_image;
+    NSUInteger _cost;
+    XLCoverCacheEntry *_prev;   // not retained; _entries owns the nodes
+    XLCoverCacheEntry *_next;
+}
+@end
+
+@implementation XLCoverCacheEntry
+- (void)dealloc {
+    [_path release];
+    [_image release];
+    [super dealloc];
+}
+@end
+
+/// One in-flight decode and everyone waiting on it
+@interface XLCoverLoad : NSObject {
+@public
+    NSString *_path;
+    NSMutableArray *_owners;        // NSValue, non-retained owner
+    NSMutableArray *_completions;   // XLCoverImageCompletion, parallel to _owners
+    volatile BOOL _cancelled;       // read by the decode queue
+}
+@end
+
+@implementation XLCoverLoad
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _owners = [[NSMutableArray alloc] init];
+        _completions = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+- (void)dealloc {
+    [_path release];
+    [_owners release];
+    [_completions release];
+    [super dealloc];
+}
+@end
+
+@interface XLCoverImageCache ()
+- (void)unlinkEntry:(XLCoverCacheEntry *)entry;
+- (void)pushEntryToFront:(XLCoverCacheEntry *)entry;
+- (void)storeImage:(NSImage *)image cost:(NSUInteger)cost forPath:(NSString *)path;
+- (void)evictToLimits;
+@end
+
+@implementation XLCoverImageCache
+
+@synthesize countLimit = _countLimit;
+@synthesize costLimit = _costLimit;
+@synthesize totalCost = _totalCost;
+
++ (instancetype)sharedCache {
+    static XLCoverImageCache *sharedCache = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedCache = [[self alloc] init];
+    });
+    return sharedCache;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [[NSMutableDictionary alloc] init];
+        _loads = [[NSMutableDictionary alloc] init];
+        _countLimit = 256;
+        _costLimit = 64 * 1024 * 1024;
+        _decodeQueue = dispatch_queue_create("com.xenolexia.covers.decode", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (XLCoverLoad *load in [_loads allValues]) {
+        load->_cancelled = YES;
+    }
+    [_loads release];
+    [_entries release];
+    dispatch_release(_decodeQueue);
+    [super dealloc];
+}
+
+- (void)setCountLimit:(NSUInteger)countLimit {
+    _countLimit = countLimit;
+    [self evictToLimits];
+}
+
+- (void)setCostLimit:(NSUInteger)costLimit {
+    _costLimit = costLimit;
+    [self evictToLimits];
+}
+
+#pragma mark - LRU list
+
+- (void)unlinkEntry:(XLCoverCacheEntry *)entry {
+    if (entry->_prev) entry->_prev->_next = entry->_next;
+    else _head = entry->_next;
+    if (entry->_next) entry->_next->_prev = entry->_prev;
+    else _tail = entry->_prev;
+    entry->_prev = nil;
+    entry->_next = nil;
+}
+
+- (void)pushEntryToFront:(XLCoverCacheEntry *)entry {
+    entry->_prev = nil;
+    entry->_next = _head;
+    if (_head) _head->_prev = entry;
+    _head = entry;
+    if (!_tail) _tail = entry;
+}
+
+- (void)storeImage:(NSImage *)image cost:(NSUInteger)cost forPath:(NSString *)path {
+    XLCoverCacheEntry *old = [_entries objectForKey:path];
+    if (old) {
+        [self unlinkEntry:old];
+        _totalCost -= old->_cost;
+        [_entries removeObjectForKey:path];
+    }
+    XLCoverCacheEntry *entry = [[XLCoverCacheEntry alloc] init];
+    entry->_path = [path copy];
+    entry->_image = [image retain];
+    entry->_cost = cost;
+    [_entries setObject:entry forKey:path];
+    [self pushEntryToFront:entry];
+    [entry release];
+    _totalCost += cost;
+    [self evictToLimits];
+}
+
+/// Drop from the tail until both limits hold; the newest cover always stays, even if it alone is over budget
+- (void)evictToLimits {
+    while (_tail && _tail != _head && ([_entries count] > _countLimit || _totalCost > _costLimit)) {
+        XLCoverCacheEntry *victim = _tail;
+        [self unlinkEntry:victim];
+        _totalCost -= victim->_cost;
+        [_entries removeObjectForKey:victim->_path];
+    }
+}
+
+#pragma mark - Public
+
+- (NSImage *)cachedImageForPath:(NSString *)path {
+    if (!path) return nil;
+    XLCoverCacheEntry *entry = [_entries objectForKey:path];
+    if (!entry) return nil;
+    if (entry != _head) {
+        [self unlinkEntry:entry];
+        [self pushEntryToFront:entry];
+    }
+    return [[entry->_image retain] autorelease];
+}
+
+- (void)loadImageForPath:(NSString *)path owner:(id)owner completion:(XLCoverImageCompletion)completion {
+    if (!completion) return;
+    if (!path) {
+        completion(nil);
+        return;
+    }
+    NSImage *cached = [self cachedImageForPath:path];
+    if (cached) {
+        completion(cached);
+        return;
+    }
+    XLCoverLoad *load = [_loads objectForKey:path];
+    BOOL start = (load == nil);
+    if (start) {
+        load = [[[XLCoverLoad alloc] init] autorelease];
+        load->_path = [path copy];
+        [_loads setObject:load forKey:path];
+    }
+    [load->_owners addObject:[NSValue valueWithNonretainedObject:owner]];
+    XLCoverImageCompletion copied = [completion copy];
+    [load->_completions addObject:copied];
+    [copied release];
+    if (!start) return;
+
+    [self retain];
+    dispatch_async(_decodeQueue, ^{
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSBitmapImageRep *rep = nil;
+        if (!load->_cancelled) {
+            NSData *data = [NSData dataWithContentsOfFile:path];
+            if (data) {
+                rep = [NSBitmapImageRep imageRepWithData:data];
+                /* Touch the pixels so decoding happens here rather than at first draw */
+                [rep bitmapData];
+            }
+        }
+        [rep retain];
+        [pool drain];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (!load->_cancelled && [_loads objectForKey:path] == load) {
+                NSImage *image = nil;
+                if (rep && [rep pixelsWide] > 0 && [rep pixelsHigh] > 0) {
+                    image = [[[NSImage alloc] initWithSize:NSMakeSize([rep pixelsWide], [rep pixelsHigh])] autorelease];
+                    [image addRepresentation:rep];
+                    [self storeImage:image cost:(NSUInteger)[rep pixelsWide] * (NSUInteger)[rep pixelsHigh] * 4 forPath:path];
+                }
+                [[load retain] autorelease];
+                [_loads removeObjectForKey:path];
+                NSArray *completions = [[load->_completions copy] autorelease];
+                for (XLCoverImageCompletion block in completions) {
+                    block(image);
+                }
+            }
+            [rep release];
+            [self release];
+        });
+    });
+}
+
+- (void)cancelLoadsForOwner:(id)owner {
+    if (!owner) return;
+    NSValue *key = [NSValue valueWithNonretainedObject:owner];
+    for (NSString *path in [_loads allKeys]) {
+        XLCoverLoad *load = [_loads objectForKey:path];
+        NSUInteger i;
+        while ((i = [load->_owners indexOfObject:key]) != NSNotFound) {
+            [load->_owners removeObjectAtIndex:i];
+            [load->_completions removeObjectAtIndex:i];
+        }
+        if ([load->_owners count] == 0) {
+            load->_cancelled = YES;
+            [_loads removeObjectForKey:path];
+        }
+    }
+}
+
+- (void)removeAllImages {
+    _head = nil;
+    _tail = nil;
+    _totalCost = 0;
+    [_entries removeAllObjects];
+}
+
+@end
@@ -7,10 +7,14 @@
 #import <Foundation/Foundation.h>
 #import <AppKit/AppKit.h>
 #import "UI/XLLinuxApp.h"
+#import "XLTrace.h"
 
 int main(int argc, const char * argv[]) {
     NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
     
+    // XENOLEXIA_TRACE=/tmp/xenolexia-trace.json records hot-path spans, written at exit
+    XLTraceStartFromEnvironment();
+    
     XLLinuxApp *app = [XLLinuxApp sharedApp];
     [app run];
     